@@ -0,0 +1,123 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "broadcast.h"
+#include "decode.h"
+#include "packet.h"
+#include "planner.h"
+
+
+static sbus_result_t write_range(const sbus_request_t *request, sbus_media_type_t *media, uint16_t *start,
+                                 size_t *count);
+static uint32_t      expected_value(const sbus_request_t *request, sbus_media_type_t media, size_t index);
+
+
+/*
+ * Builds a broadcast of `count` registers, counters or timers starting from `start`.
+ */
+sbus_result_t sbus_broadcast_values_request(sbus_media_type_t media, uint16_t start, const uint32_t *values,
+                                            size_t count, sbus_request_t *request) {
+    return sbus_packet_write_values_request(SBUS_BROADCAST_ADDRESS, media, start, values, count, request);
+}
+
+
+/*
+ * Builds a broadcast of `count` flags or outputs starting from `start`; `bits` is packed with the SBUS_FIO_* layout,
+ * the first bit being the one for `start`.
+ */
+sbus_result_t sbus_broadcast_bits_request(sbus_media_type_t media, uint16_t start, const uint8_t *bits, size_t count,
+                                          sbus_request_t *request) {
+    return sbus_packet_write_bits_request(SBUS_BROADCAST_ADDRESS, media, start, bits, count, request);
+}
+
+
+/*
+ * Sets the clock of every station. There is no read-back for the clock, it moves on by itself.
+ */
+void sbus_broadcast_clock_request(const sbus_clock_t *clock, sbus_request_t *request) {
+    request->destination = SBUS_BROADCAST_ADDRESS;
+    request->command     = SBUS_COMMAND_WRITE_REAL_TIME_CLOCK;
+    request->data_len    = 6;
+    sbus_clock_to_bcd(clock, request->data);
+}
+
+
+/*
+ * Fills `points` with every element written by the broadcast `request` on each of `stations`, ready for
+ * `sbus_planner_plan`. SBUS_INVALID_ARGS if the request is not a media write or the points do not fit.
+ */
+sbus_result_t sbus_broadcast_readback(const sbus_request_t *request, const uint8_t *stations, size_t num_stations,
+                                      sbus_point_t *points, size_t max_points, size_t *num_points) {
+    sbus_media_type_t media;
+    uint16_t          start;
+    size_t            count;
+
+    *num_points = 0;
+    if (write_range(request, &media, &start, &count) != SBUS_OK || num_stations * count > max_points)
+        return SBUS_INVALID_ARGS;
+
+    for (size_t i = 0; i < num_stations; i++) {
+        for (size_t j = 0; j < count; j++) {
+            points[(*num_points)++] = (sbus_point_t){
+                .station = stations[i], .media = media, .address = (uint16_t)(start + j), .valid = 0, .value = 0};
+        }
+    }
+
+    return SBUS_OK;
+}
+
+
+/*
+ * Compares the points read back (scattered by the planner) with the values sent by `request`. Stations with a
+ * point that differs or was not read are stored in `failed`, once each and up to `max_failed` of them; the result
+ * is the number of such stations. The points are expected in planner order, grouped by station.
+ */
+size_t sbus_broadcast_verify(const sbus_request_t *request, const sbus_point_t *points, size_t num_points,
+                             uint8_t *failed, size_t max_failed) {
+    sbus_media_type_t media;
+    uint16_t          start;
+    size_t            count;
+    size_t            num_failed = 0;
+    int               last       = -1;
+
+    if (write_range(request, &media, &start, &count) != SBUS_OK)
+        return 0;
+
+    for (size_t i = 0; i < num_points; i++) {
+        const sbus_point_t *point = &points[i];
+
+        if (point->station == last || point->media != media || point->address < start ||
+            point->address >= start + count)
+            continue;
+        if (point->valid && point->value == expected_value(request, media, point->address - start))
+            continue;
+
+        if (num_failed < max_failed)
+            failed[num_failed] = point->station;
+        num_failed++;
+        last = point->station;
+    }
+
+    return num_failed;
+}
+
+
+static sbus_result_t write_range(const sbus_request_t *request, sbus_media_type_t *media, uint16_t *start,
+                                 size_t *count) {
+    if (sbus_command_describe(request->command)->kind != SBUS_COMMAND_KIND_WRITE ||
+        sbus_media_from_command(request->command, media) != SBUS_OK || request->data_len < 4)
+        return SBUS_INVALID_ARGS;
+
+    *start = SBUS_PACKET_REG_ADDR(request);
+    *count = sbus_media_is_bit(*media) ? (size_t)request->data[3] + 1 : (size_t)(request->data[0] - 1) / 4;
+    return SBUS_OK;
+}
+
+
+static uint32_t expected_value(const sbus_request_t *request, sbus_media_type_t media, size_t index) {
+    if (sbus_media_is_bit(media))
+        return (request->data[4 + SBUS_FIO_BYTE(index)] & SBUS_FIO_MASK(index)) ? 1 : 0;
+
+    const uint8_t *data = &request->data[3 + index * 4];
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+}
@@ -0,0 +1,28 @@
+#ifndef SBUS_BROADCAST_H_INCLUDED
+#define SBUS_BROADCAST_H_INCLUDED
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "decode.h"
+#include "packet.h"
+#include "planner.h"
+
+/*
+ * Writes addressed to every station at once. Broadcasts are never answered: the master leaves the guard time of
+ * `sbus_wire_guard_us` before the next frame and, where it matters, reads the values back from selected stations.
+ * The read-back is a list of points to give to the planner, so stations are verified with as few frames as
+ * possible, and `sbus_broadcast_verify` compares what was read with what was sent.
+ */
+
+sbus_result_t sbus_broadcast_values_request(sbus_media_type_t media, uint16_t start, const uint32_t *values,
+                                            size_t count, sbus_request_t *request);
+sbus_result_t sbus_broadcast_bits_request(sbus_media_type_t media, uint16_t start, const uint8_t *bits, size_t count,
+                                          sbus_request_t *request);
+void          sbus_broadcast_clock_request(const sbus_clock_t *clock, sbus_request_t *request);
+sbus_result_t sbus_broadcast_readback(const sbus_request_t *request, const uint8_t *stations, size_t num_stations,
+                                      sbus_point_t *points, size_t max_points, size_t *num_points);
+size_t        sbus_broadcast_verify(const sbus_request_t *request, const sbus_point_t *points, size_t num_points,
+                                    uint8_t *failed, size_t max_failed);
+
+#endif
@@ -0,0 +1,254 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+#include "packet.h"
+#include "planner.h"
+
+
+#define PROBE_LIMIT 8
+
+static sbus_cache_entry_t *find(sbus_cache_t *cache, uint8_t station, sbus_media_type_t media, uint16_t address);
+static size_t              hash(const sbus_cache_t *cache, uint8_t station, sbus_media_type_t media, uint16_t address);
+static sbus_result_t       update(sbus_cache_t *cache, const sbus_request_t *request, const uint16_t *wide,
+                                  const uint8_t *narrow, size_t len, uint32_t now);
+
+
+/*
+ * `capacity` must be a power of two.
+ */
+sbus_result_t sbus_cache_init(sbus_cache_t *cache, sbus_cache_entry_t *entries, size_t capacity) {
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+        return SBUS_INVALID_ARGS;
+
+    cache->entries  = entries;
+    cache->capacity = capacity;
+    sbus_cache_clear(cache);
+    return SBUS_OK;
+}
+
+
+void sbus_cache_clear(sbus_cache_t *cache) {
+    memset(cache->entries, 0, cache->capacity * sizeof(sbus_cache_entry_t));
+    cache->hits   = 0;
+    cache->misses = 0;
+    cache->stale  = 0;
+}
+
+
+void sbus_cache_invalidate_station(sbus_cache_t *cache, uint8_t station) {
+    for (size_t i = 0; i < cache->capacity; i++) {
+        if (cache->entries[i].used && cache->entries[i].station == station)
+            cache->entries[i].valid = 0;
+    }
+}
+
+
+void sbus_cache_put(sbus_cache_t *cache, uint8_t station, sbus_media_type_t media, uint16_t address,
+                    uint32_t value, uint32_t now) {
+    size_t              index  = hash(cache, station, media, address);
+    sbus_cache_entry_t *oldest = NULL;
+    sbus_cache_entry_t *entry  = NULL;
+
+    for (size_t i = 0; i < PROBE_LIMIT && i < cache->capacity; i++) {
+        sbus_cache_entry_t *candidate = &cache->entries[(index + i) & (cache->capacity - 1)];
+
+        if (!candidate->used ||
+            (candidate->station == station && candidate->media == media && candidate->address == address)) {
+            entry = candidate;
+            break;
+        }
+        // Prefer evicting invalidated entries, then the least recently refreshed one
+        if (oldest == NULL || (oldest->valid && !candidate->valid) ||
+            (oldest->valid == candidate->valid && (int32_t)(candidate->timestamp - oldest->timestamp) < 0))
+            oldest = candidate;
+    }
+
+    if (entry == NULL)
+        entry = oldest;
+
+    entry->used      = 1;
+    entry->valid     = 1;
+    entry->station   = station;
+    entry->media     = (uint8_t)media;
+    entry->address   = address;
+    entry->value     = value;
+    entry->timestamp = now;
+}
+
+
+/*
+ * Returns SBUS_OK and the cached value if it was refreshed no more than `max_age` milliseconds before `now`,
+ * SBUS_NOT_FOUND otherwise.
+ */
+sbus_result_t sbus_cache_get(sbus_cache_t *cache, uint8_t station, sbus_media_type_t media, uint16_t address,
+                             uint32_t now, uint32_t max_age, uint32_t *value) {
+    sbus_cache_entry_t *entry = find(cache, station, media, address);
+
+    if (entry == NULL) {
+        cache->misses++;
+        return SBUS_NOT_FOUND;
+    }
+
+    if (now - entry->timestamp > max_age) {
+        cache->misses++;
+        cache->stale++;
+        return SBUS_NOT_FOUND;
+    }
+
+    cache->hits++;
+    *value = entry->value;
+    return SBUS_OK;
+}
+
+
+/*
+ * Feeds an exchange to the cache: the values of a validated read response are stored, the values of an ACKed write
+ * request are applied. Other exchanges are ignored.
+ */
+sbus_result_t sbus_cache_update_9bit(sbus_cache_t *cache, const sbus_request_t *request, const uint16_t *response,
+                                     size_t len, uint32_t now) {
+    return update(cache, request, response, NULL, len, now);
+}
+
+
+sbus_result_t sbus_cache_update_8bit(sbus_cache_t *cache, const sbus_request_t *request, const uint8_t *response,
+                                     size_t len, uint32_t now) {
+    return update(cache, request, NULL, response, len, now);
+}
+
+
+/*
+ * Fills the points that have a fresh enough cached value and moves them after the others. Returns the number of
+ * points, now at the start of the array, that still have to be read from the bus.
+ */
+size_t sbus_cache_resolve(sbus_cache_t *cache, sbus_point_t *points, size_t num_points, uint32_t now,
+                          uint32_t max_age) {
+    size_t missing = 0;
+
+    for (size_t i = 0; i < num_points; i++) {
+        uint32_t value = 0;
+
+        if (sbus_cache_get(cache, points[i].station, points[i].media, points[i].address, now, max_age, &value) ==
+            SBUS_OK) {
+            points[i].value = value;
+            points[i].valid = 1;
+        } else {
+            sbus_point_t swap = points[missing];
+            points[missing]   = points[i];
+            points[i]         = swap;
+            missing++;
+        }
+    }
+
+    return missing;
+}
+
+
+static sbus_result_t update(sbus_cache_t *cache, const sbus_request_t *request, const uint16_t *wide,
+                            const uint8_t *narrow, size_t len, uint32_t now) {
+#define BYTE(i) (wide != NULL ? (uint8_t)(wide[i] & 0xFF) : narrow[i])
+    sbus_media_type_t media;
+
+    if (sbus_media_from_command(request->command, &media) != SBUS_OK || request->data_len < 3)
+        return SBUS_INVALID_ARGS;
+
+    uint16_t address = SBUS_PACKET_REG_ADDR(request);
+
+    switch (request->command) {
+        case SBUS_COMMAND_READ_REGISTER:
+        case SBUS_COMMAND_READ_COUNTER:
+        case SBUS_COMMAND_READ_TIMER: {
+            size_t count = (size_t)SBUS_PACKET_R_COUNT(request) + 1;
+            if (len < count * 4)
+                return SBUS_INCOMPLETE_PACKET;
+
+            for (size_t i = 0; i < count; i++) {
+                uint32_t value = ((uint32_t)BYTE(i * 4) << 24) | ((uint32_t)BYTE(i * 4 + 1) << 16) |
+                                 ((uint32_t)BYTE(i * 4 + 2) << 8) | (uint32_t)BYTE(i * 4 + 3);
+                sbus_cache_put(cache, request->destination, media, (uint16_t)(address + i), value, now);
+            }
+            break;
+        }
+
+        case SBUS_COMMAND_READ_FLAG:
+        case SBUS_COMMAND_READ_INPUT:
+        case SBUS_COMMAND_READ_OUTPUT: {
+            size_t count = (size_t)SBUS_PACKET_R_COUNT(request) + 1;
+            if (len < SBUS_FIO_BYTES(count))
+                return SBUS_INCOMPLETE_PACKET;
+
+            for (size_t i = 0; i < count; i++) {
+                uint32_t value = (BYTE(SBUS_FIO_BYTE(i)) & SBUS_FIO_MASK(i)) ? 1 : 0;
+                sbus_cache_put(cache, request->destination, media, (uint16_t)(address + i), value, now);
+            }
+            break;
+        }
+
+        case SBUS_COMMAND_WRITE_REGISTER:
+        case SBUS_COMMAND_WRITE_COUNTER:
+        case SBUS_COMMAND_WRITE_TIMER: {
+            if (len < 1 || BYTE(0) != SBUS_ACK)
+                return SBUS_OK;
+
+            size_t count = (size_t)(request->data[0] - 1) / 4;
+            if (request->data_len < 3 + count * 4)
+                return SBUS_INVALID_ARGS;
+
+            for (size_t i = 0; i < count; i++) {
+                const uint8_t *data  = &request->data[3 + i * 4];
+                uint32_t       value = ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) |
+                                 ((uint32_t)data[2] << 8) | (uint32_t)data[3];
+                sbus_cache_put(cache, request->destination, media, (uint16_t)(address + i), value, now);
+            }
+            break;
+        }
+
+        case SBUS_COMMAND_WRITE_FLAG:
+        case SBUS_COMMAND_WRITE_OUTPUT: {
+            if (len < 1 || BYTE(0) != SBUS_ACK)
+                return SBUS_OK;
+
+            size_t count = (size_t)request->data[3] + 1;
+            if (request->data_len < 4 || (size_t)request->data_len - 4 < SBUS_FIO_BYTES(count))
+                return SBUS_INVALID_ARGS;
+
+            for (size_t i = 0; i < count; i++) {
+                uint32_t value = (request->data[4 + SBUS_FIO_BYTE(i)] & SBUS_FIO_MASK(i)) ? 1 : 0;
+                sbus_cache_put(cache, request->destination, media, (uint16_t)(address + i), value, now);
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    return SBUS_OK;
+#undef BYTE
+}
+
+
+static sbus_cache_entry_t *find(sbus_cache_t *cache, uint8_t station, sbus_media_type_t media, uint16_t address) {
+    size_t index = hash(cache, station, media, address);
+
+    for (size_t i = 0; i < PROBE_LIMIT && i < cache->capacity; i++) {
+        sbus_cache_entry_t *entry = &cache->entries[(index + i) & (cache->capacity - 1)];
+
+        if (!entry->used)
+            return NULL;
+        if (entry->station == station && entry->media == media && entry->address == address)
+            return entry->valid ? entry : NULL;
+    }
+
+    return NULL;
+}
+
+
+static size_t hash(const sbus_cache_t *cache, uint8_t station, sbus_media_type_t media, uint16_t address) {
+    uint32_t key = ((uint32_t)station << 19) ^ ((uint32_t)media << 16) ^ address;
+    key *= 2654435761u;
+    key ^= key >> 15;
+    return key & (cache->capacity - 1);
+}
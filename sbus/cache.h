@@ -0,0 +1,49 @@
+#ifndef SBUS_CACHE_H_INCLUDED
+#define SBUS_CACHE_H_INCLUDED
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "packet.h"
+#include "planner.h"
+
+
+typedef struct {
+    uint8_t  used;
+    uint8_t  valid;
+    uint8_t  station;
+    uint8_t  media;
+    uint16_t address;
+    uint32_t value;
+    uint32_t timestamp;     // Milliseconds, from the same clock passed as `now` to the other functions
+} sbus_cache_entry_t;
+
+
+/*
+ * Master side cache of media values keyed by (station, media type, address). The entries are provided by the
+ * caller; when the table is crowded the oldest entry around the key is replaced.
+ */
+typedef struct {
+    sbus_cache_entry_t *entries;
+    size_t              capacity;
+    unsigned long       hits;
+    unsigned long       misses;
+    unsigned long       stale;     // Misses due to an entry older than the requested maximum age
+} sbus_cache_t;
+
+
+sbus_result_t sbus_cache_init(sbus_cache_t *cache, sbus_cache_entry_t *entries, size_t capacity);
+void          sbus_cache_clear(sbus_cache_t *cache);
+void          sbus_cache_invalidate_station(sbus_cache_t *cache, uint8_t station);
+void          sbus_cache_put(sbus_cache_t *cache, uint8_t station, sbus_media_type_t media, uint16_t address,
+                             uint32_t value, uint32_t now);
+sbus_result_t sbus_cache_get(sbus_cache_t *cache, uint8_t station, sbus_media_type_t media, uint16_t address,
+                             uint32_t now, uint32_t max_age, uint32_t *value);
+sbus_result_t sbus_cache_update_9bit(sbus_cache_t *cache, const sbus_request_t *request, const uint16_t *response,
+                                     size_t len, uint32_t now);
+sbus_result_t sbus_cache_update_8bit(sbus_cache_t *cache, const sbus_request_t *request, const uint8_t *response,
+                                     size_t len, uint32_t now);
+size_t        sbus_cache_resolve(sbus_cache_t *cache, sbus_point_t *points, size_t num_points, uint32_t now,
+                                 uint32_t max_age);
+
+#endif
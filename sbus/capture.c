@@ -0,0 +1,198 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture.h"
+#include "packet.h"
+
+
+#define ALIGNMENT         16     // Also the record header size, so that a padding record always fits
+#define ALIGN(x)          (((x) + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1))
+#define FLAG_NINE_BIT     0x01
+#define MAX_RECORD        ALIGN(SBUS_CAPTURE_RECORD_HEADER + SBUS_CAPTURE_MAX_CHARACTERS + \
+                                SBUS_ADDRESS_MAP_BYTES(SBUS_CAPTURE_MAX_CHARACTERS))
+#define MIN_CAPACITY      (4 * MAX_RECORD)
+
+// Stored at an aligned ring offset, followed by the characters and, for 9-bit captures, their address map
+typedef struct {
+    uint16_t length;     // Whole record, header included, multiple of ALIGNMENT
+    uint8_t  direction;
+    int8_t   result;
+    uint16_t count;
+    uint16_t flags;
+    uint64_t timestamp_us;
+} record_header_t;
+
+_Static_assert(sizeof(record_header_t) == SBUS_CAPTURE_RECORD_HEADER, "Unexpected record header size");
+
+static uint8_t *reserve(sbus_capture_t *capture, size_t length);
+static void     commit(sbus_capture_t *capture, uint8_t *record, size_t length, uint64_t timestamp_us,
+                       sbus_capture_direction_t direction, sbus_result_t result, size_t count, uint16_t flags);
+
+
+/*
+ * Formats `size` bytes of `memory` (aligned to 8 bytes at least) as an empty capture, discarding whatever was there.
+ */
+sbus_result_t sbus_capture_init(sbus_capture_t *capture, void *memory, size_t size) {
+    if (size < sizeof(sbus_capture_header_t) + MIN_CAPACITY ||
+        size - sizeof(sbus_capture_header_t) > UINT32_MAX)
+        return SBUS_INVALID_ARGS;
+
+    capture->header = memory;
+    capture->data   = (uint8_t *)memory + sizeof(sbus_capture_header_t);
+
+    memset(capture->header, 0, sizeof(sbus_capture_header_t));
+    memcpy(capture->header->magic, SBUS_CAPTURE_MAGIC, sizeof(SBUS_CAPTURE_MAGIC));
+    capture->header->version  = SBUS_CAPTURE_VERSION;
+    capture->header->capacity = (uint32_t)((size - sizeof(sbus_capture_header_t)) & ~(size_t)(ALIGNMENT - 1));
+    atomic_init(&capture->header->head, 0);
+    atomic_init(&capture->header->tail, 0);
+    return SBUS_OK;
+}
+
+
+/*
+ * Opens an existing capture, e.g. a file mapped by the offline decoder.
+ */
+sbus_result_t sbus_capture_attach(sbus_capture_t *capture, void *memory, size_t size) {
+    sbus_capture_header_t *header = memory;
+
+    if (size < sizeof(sbus_capture_header_t) || memcmp(header->magic, SBUS_CAPTURE_MAGIC, sizeof(SBUS_CAPTURE_MAGIC)))
+        return SBUS_INVALID_DATA;
+    if (header->version != SBUS_CAPTURE_VERSION || header->capacity < MIN_CAPACITY ||
+        header->capacity > size - sizeof(sbus_capture_header_t) || header->capacity % ALIGNMENT != 0)
+        return SBUS_INVALID_DATA;
+
+    capture->header = header;
+    capture->data   = (uint8_t *)memory + sizeof(sbus_capture_header_t);
+    return SBUS_OK;
+}
+
+
+/*
+ * Records a burst of 9-bit words. The cost on the hot path is a copy of the characters and an update of the ring
+ * positions; longer bursts are truncated to SBUS_CAPTURE_MAX_CHARACTERS.
+ */
+void sbus_capture_9bit(sbus_capture_t *capture, uint64_t timestamp_us, sbus_capture_direction_t direction,
+                       sbus_result_t result, const uint16_t *words, size_t count) {
+    if (count > SBUS_CAPTURE_MAX_CHARACTERS)
+        count = SBUS_CAPTURE_MAX_CHARACTERS;
+
+    size_t   length = ALIGN(SBUS_CAPTURE_RECORD_HEADER + count + SBUS_ADDRESS_MAP_BYTES(count));
+    uint8_t *record = reserve(capture, length);
+    uint8_t *bytes  = record + SBUS_CAPTURE_RECORD_HEADER;
+
+    sbus_packet_pack_9bit(words, count, bytes, bytes + count);
+    commit(capture, record, length, timestamp_us, direction, result, count, FLAG_NINE_BIT);
+}
+
+
+void sbus_capture_8bit(sbus_capture_t *capture, uint64_t timestamp_us, sbus_capture_direction_t direction,
+                       sbus_result_t result, const uint8_t *bytes, size_t count) {
+    if (count > SBUS_CAPTURE_MAX_CHARACTERS)
+        count = SBUS_CAPTURE_MAX_CHARACTERS;
+
+    size_t   length = ALIGN(SBUS_CAPTURE_RECORD_HEADER + count);
+    uint8_t *record = reserve(capture, length);
+
+    memcpy(record + SBUS_CAPTURE_RECORD_HEADER, bytes, count);
+    commit(capture, record, length, timestamp_us, direction, result, count, 0);
+}
+
+
+/*
+ * Position of the oldest record still in the ring, to be passed to `sbus_capture_next`.
+ */
+uint64_t sbus_capture_first(const sbus_capture_t *capture) {
+    return atomic_load_explicit(&capture->header->tail, memory_order_acquire);
+}
+
+
+/*
+ * Decodes the record at `*position` and moves past it. Returns SBUS_NOT_FOUND after the newest record and
+ * SBUS_INVALID_DATA if the ring is corrupted or `*position` was overwritten in the meantime.
+ */
+sbus_result_t sbus_capture_next(const sbus_capture_t *capture, uint64_t *position, sbus_capture_record_t *record) {
+    uint32_t capacity = capture->header->capacity;
+
+    for (;;) {
+        uint64_t head = atomic_load_explicit(&capture->header->head, memory_order_acquire);
+        uint64_t tail = atomic_load_explicit(&capture->header->tail, memory_order_acquire);
+
+        if (*position >= head)
+            return SBUS_NOT_FOUND;
+        if (*position < tail || *position % ALIGNMENT != 0)
+            return SBUS_INVALID_DATA;
+
+        size_t                 offset = (size_t)(*position % capacity);
+        const record_header_t *header = (const record_header_t *)&capture->data[offset];
+
+        if (header->length < SBUS_CAPTURE_RECORD_HEADER || header->length % ALIGNMENT != 0 ||
+            offset + header->length > capacity)
+            return SBUS_INVALID_DATA;
+
+        *position += header->length;
+        if (header->direction == SBUS_CAPTURE_PADDING)
+            continue;
+
+        size_t payload = header->count + ((header->flags & FLAG_NINE_BIT) ? SBUS_ADDRESS_MAP_BYTES(header->count) : 0);
+        if (SBUS_CAPTURE_RECORD_HEADER + payload > header->length)
+            return SBUS_INVALID_DATA;
+
+        record->timestamp_us = header->timestamp_us;
+        record->direction    = header->direction;
+        record->result       = header->result;
+        record->count        = header->count;
+        record->bytes        = (const uint8_t *)header + SBUS_CAPTURE_RECORD_HEADER;
+        record->address_map  = (header->flags & FLAG_NINE_BIT) ? record->bytes + header->count : NULL;
+        return SBUS_OK;
+    }
+}
+
+
+/*
+ * Makes room for a record of `length` bytes at the head, wrapping with a padding record when it would not fit before
+ * the end of the ring, and evicting the oldest records.
+ */
+static uint8_t *reserve(sbus_capture_t *capture, size_t length) {
+    sbus_capture_header_t *header   = capture->header;
+    uint32_t               capacity = header->capacity;
+    uint64_t               head     = atomic_load_explicit(&header->head, memory_order_relaxed);
+    uint64_t               tail     = atomic_load_explicit(&header->tail, memory_order_relaxed);
+    size_t                 offset   = (size_t)(head % capacity);
+    size_t                 padding  = offset + length > capacity ? capacity - offset : 0;
+
+    while (head + padding + length - tail > capacity) {
+        const record_header_t *oldest = (const record_header_t *)&capture->data[tail % capacity];
+        tail += oldest->length;
+        header->overwritten += oldest->direction != SBUS_CAPTURE_PADDING;
+    }
+    atomic_store_explicit(&header->tail, tail, memory_order_release);
+
+    if (padding > 0) {
+        record_header_t *filler = (record_header_t *)&capture->data[offset];
+        memset(filler, 0, SBUS_CAPTURE_RECORD_HEADER);
+        filler->length = (uint16_t)padding;
+        atomic_store_explicit(&header->head, head + padding, memory_order_release);
+        offset = 0;
+    }
+
+    return &capture->data[offset];
+}
+
+
+static void commit(sbus_capture_t *capture, uint8_t *record, size_t length, uint64_t timestamp_us,
+                   sbus_capture_direction_t direction, sbus_result_t result, size_t count, uint16_t flags) {
+    record_header_t *header = (record_header_t *)record;
+
+    header->length       = (uint16_t)length;
+    header->direction    = (uint8_t)direction;
+    header->result       = (int8_t)result;
+    header->count        = (uint16_t)count;
+    header->flags        = flags;
+    header->timestamp_us = timestamp_us;
+
+    capture->header->records++;
+    atomic_fetch_add_explicit(&capture->header->head, length, memory_order_release);
+}
@@ -0,0 +1,72 @@
+#ifndef SBUS_CAPTURE_H_INCLUDED
+#define SBUS_CAPTURE_H_INCLUDED
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "packet.h"
+
+#define SBUS_CAPTURE_MAGIC   "SBUSCAP"
+#define SBUS_CAPTURE_VERSION 1     // Also tells apart captures taken on a host with the other byte order
+
+#define SBUS_CAPTURE_RECORD_HEADER 16
+#define SBUS_CAPTURE_MAX_CHARACTERS 512
+
+typedef enum {
+    SBUS_CAPTURE_PADDING = 0,     // Filler up to the end of the ring, skipped by readers
+    SBUS_CAPTURE_TX,
+    SBUS_CAPTURE_RX,
+} sbus_capture_direction_t;
+
+
+/*
+ * Start of a capture region. Positions are byte counts since the capture was created: the ring offset of a position
+ * is `position % capacity`. Records between `tail` and `head` are complete; older ones have been overwritten.
+ * Everything is stored in host byte order.
+ */
+typedef struct {
+    char             magic[8];
+    uint32_t         version;
+    uint32_t         capacity;
+    _Atomic uint64_t head;
+    _Atomic uint64_t tail;
+    uint64_t         records;
+    uint64_t         overwritten;
+} sbus_capture_header_t;
+
+
+/*
+ * One captured burst of characters. 9-bit captures keep the low byte of every word in `bytes` and the address flags
+ * in `address_map`, packed like `sbus_packet_pack_9bit` does; 8-bit captures have no address map.
+ */
+typedef struct {
+    uint64_t       timestamp_us;
+    uint8_t        direction;
+    int8_t         result;
+    uint16_t       count;
+    const uint8_t *bytes;
+    const uint8_t *address_map;
+} sbus_capture_record_t;
+
+
+/*
+ * A ring of records in caller provided memory (typically a shared file mapping). A single thread may write;
+ * readers of a live capture may see records being overwritten, offline readers are always consistent.
+ */
+typedef struct {
+    sbus_capture_header_t *header;
+    uint8_t               *data;
+} sbus_capture_t;
+
+
+sbus_result_t sbus_capture_init(sbus_capture_t *capture, void *memory, size_t size);
+sbus_result_t sbus_capture_attach(sbus_capture_t *capture, void *memory, size_t size);
+void sbus_capture_9bit(sbus_capture_t *capture, uint64_t timestamp_us, sbus_capture_direction_t direction,
+                       sbus_result_t result, const uint16_t *words, size_t count);
+void sbus_capture_8bit(sbus_capture_t *capture, uint64_t timestamp_us, sbus_capture_direction_t direction,
+                       sbus_result_t result, const uint8_t *bytes, size_t count);
+uint64_t      sbus_capture_first(const sbus_capture_t *capture);
+sbus_result_t sbus_capture_next(const sbus_capture_t *capture, uint64_t *position, sbus_capture_record_t *record);
+
+#endif
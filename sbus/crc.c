@@ -0,0 +1,143 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "crc.h"
+
+
+#define POLYNOMIAL 0x1021
+
+/*
+ * The lookup tables are generated by the preprocessor. CRC-CCITT is linear, so every entry is the xor of the
+ * entries for the single bits of its index; those eight basis values are computed once as enumeration constants
+ * (bitwise for the first table, one byte step of the previous table for the others) and then combined for all 256
+ * indexes. Table k holds the CRC of the index byte followed by k zero bytes, as required by the slice-by-N loops.
+ */
+#define CRC_STEP(c)  ((((c) << 1) ^ (((c)&0x8000) ? POLYNOMIAL : 0)) & 0xFFFF)
+#define CRC_BYTE(c)  CRC_STEP(CRC_STEP(CRC_STEP(CRC_STEP(CRC_STEP(CRC_STEP(CRC_STEP(CRC_STEP(c))))))))
+#define CRC_BASIS(i) CRC_BYTE(0x0100 << (i))
+
+#define CRC_TERM(k, n, i) ((((n) >> (i)) & 1) ? CRC_BASIS_##k##_##i : 0)
+#define CRC_ENTRY(k, n)                                                                                                \
+    (CRC_TERM(k, n, 0) ^ CRC_TERM(k, n, 1) ^ CRC_TERM(k, n, 2) ^ CRC_TERM(k, n, 3) ^ CRC_TERM(k, n, 4) ^              \
+     CRC_TERM(k, n, 5) ^ CRC_TERM(k, n, 6) ^ CRC_TERM(k, n, 7))
+#define CRC_NEXT(k, i) ((((CRC_BASIS_##k##_##i) << 8) & 0xFFFF) ^ CRC_ENTRY(0, (CRC_BASIS_##k##_##i) >> 8))
+
+#define CRC_BASIS_SET(k, next)                                                                                         \
+    CRC_BASIS_##k##_0 = next(0), CRC_BASIS_##k##_1 = next(1), CRC_BASIS_##k##_2 = next(2),                             \
+    CRC_BASIS_##k##_3 = next(3), CRC_BASIS_##k##_4 = next(4), CRC_BASIS_##k##_5 = next(5),                             \
+    CRC_BASIS_##k##_6 = next(6), CRC_BASIS_##k##_7 = next(7)
+
+#define CRC_NEXT_0(i) CRC_NEXT(0, i)
+#define CRC_NEXT_1(i) CRC_NEXT(1, i)
+#define CRC_NEXT_2(i) CRC_NEXT(2, i)
+#define CRC_NEXT_3(i) CRC_NEXT(3, i)
+#define CRC_NEXT_4(i) CRC_NEXT(4, i)
+#define CRC_NEXT_5(i) CRC_NEXT(5, i)
+#define CRC_NEXT_6(i) CRC_NEXT(6, i)
+
+enum {
+    CRC_BASIS_SET(0, CRC_BASIS),
+    CRC_BASIS_SET(1, CRC_NEXT_0),
+    CRC_BASIS_SET(2, CRC_NEXT_1),
+    CRC_BASIS_SET(3, CRC_NEXT_2),
+    CRC_BASIS_SET(4, CRC_NEXT_3),
+    CRC_BASIS_SET(5, CRC_NEXT_4),
+    CRC_BASIS_SET(6, CRC_NEXT_5),
+    CRC_BASIS_SET(7, CRC_NEXT_6),
+};
+
+#define CRC_ROW(k, h)                                                                                                  \
+    CRC_ENTRY(k, (h)*16 + 0), CRC_ENTRY(k, (h)*16 + 1), CRC_ENTRY(k, (h)*16 + 2), CRC_ENTRY(k, (h)*16 + 3),            \
+        CRC_ENTRY(k, (h)*16 + 4), CRC_ENTRY(k, (h)*16 + 5), CRC_ENTRY(k, (h)*16 + 6), CRC_ENTRY(k, (h)*16 + 7),        \
+        CRC_ENTRY(k, (h)*16 + 8), CRC_ENTRY(k, (h)*16 + 9), CRC_ENTRY(k, (h)*16 + 10), CRC_ENTRY(k, (h)*16 + 11),      \
+        CRC_ENTRY(k, (h)*16 + 12), CRC_ENTRY(k, (h)*16 + 13), CRC_ENTRY(k, (h)*16 + 14), CRC_ENTRY(k, (h)*16 + 15)
+#define CRC_TABLE(k)                                                                                                   \
+    {                                                                                                                  \
+        CRC_ROW(k, 0), CRC_ROW(k, 1), CRC_ROW(k, 2), CRC_ROW(k, 3), CRC_ROW(k, 4), CRC_ROW(k, 5), CRC_ROW(k, 6),       \
+            CRC_ROW(k, 7), CRC_ROW(k, 8), CRC_ROW(k, 9), CRC_ROW(k, 10), CRC_ROW(k, 11), CRC_ROW(k, 12),               \
+            CRC_ROW(k, 13), CRC_ROW(k, 14), CRC_ROW(k, 15)                                                             \
+    }
+
+
+const uint16_t sbus_crc16_table[SBUS_CRC_SLICES][256] = {
+    CRC_TABLE(0),
+#if SBUS_CRC_SLICES >= 4
+    CRC_TABLE(1),
+    CRC_TABLE(2),
+    CRC_TABLE(3),
+#endif
+#if SBUS_CRC_SLICES >= 8
+    CRC_TABLE(4),
+    CRC_TABLE(5),
+    CRC_TABLE(6),
+    CRC_TABLE(7),
+#endif
+};
+
+
+#if SBUS_CRC_SLICES > 1
+#define T(k, n) sbus_crc16_table[k][(uint8_t)(n)]
+
+/*
+ * The running CRC is folded into the first two bytes of the block, so the whole block can be treated as a message
+ * processed from a zero register: each byte contributes its table entry shifted by the number of bytes following it.
+ */
+#if SBUS_CRC_SLICES == 8
+#define SLICE(crc, b)                                                                                                  \
+    do {                                                                                                               \
+        uint16_t x = (uint16_t)(crc ^ (((uint8_t)(b)[0] << 8) | (uint8_t)(b)[1]));                                     \
+        crc        = (uint16_t)(T(7, x >> 8) ^ T(6, x) ^ T(5, (b)[2]) ^ T(4, (b)[3]) ^ T(3, (b)[4]) ^ T(2, (b)[5]) ^   \
+                         T(1, (b)[6]) ^ T(0, (b)[7]));                                                                 \
+    } while (0)
+#else
+#define SLICE(crc, b)                                                                                                  \
+    do {                                                                                                               \
+        uint16_t x = (uint16_t)(crc ^ (((uint8_t)(b)[0] << 8) | (uint8_t)(b)[1]));                                     \
+        crc        = (uint16_t)(T(3, x >> 8) ^ T(2, x) ^ T(1, (b)[2]) ^ T(0, (b)[3]));                                 \
+    } while (0)
+#endif
+#endif
+
+
+uint16_t sbus_crc16_update_8bit(uint16_t crc, const uint8_t *buffer, size_t length) {
+#if SBUS_CRC_SLICES > 1
+    while (length >= SBUS_CRC_SLICES) {
+        SLICE(crc, buffer);
+        buffer += SBUS_CRC_SLICES;
+        length -= SBUS_CRC_SLICES;
+    }
+#endif
+
+    while (length-- > 0) {
+        crc = sbus_crc16_update_byte(crc, *buffer++);
+    }
+
+    return crc;
+}
+
+
+uint16_t sbus_crc16_update_9bit(uint16_t crc, const uint16_t *buffer, size_t length) {
+#if SBUS_CRC_SLICES > 1
+    while (length >= SBUS_CRC_SLICES) {
+        SLICE(crc, buffer);
+        buffer += SBUS_CRC_SLICES;
+        length -= SBUS_CRC_SLICES;
+    }
+#endif
+
+    while (length-- > 0) {
+        crc = sbus_crc16_update_byte(crc, (uint8_t)*buffer++);
+    }
+
+    return crc;
+}
+
+
+uint16_t sbus_crc16_8bit(uint8_t *buffer, size_t length) {
+    return sbus_crc16_final(sbus_crc16_update_8bit(sbus_crc16_init(), buffer, length));
+}
+
+
+uint16_t sbus_crc16_9bit(uint16_t *buffer, size_t length) {
+    return sbus_crc16_final(sbus_crc16_update_9bit(sbus_crc16_init(), buffer, length));
+}
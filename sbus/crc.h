@@ -0,0 +1,44 @@
+#ifndef SBUS_CRC_H_INCLUDED
+#define SBUS_CRC_H_INCLUDED
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * Number of lookup tables used by the CRC engine. 1 uses a single 256 entry table (512 bytes), 4 and 8 enable the
+ * slice-by-4 and slice-by-8 paths for long frames at the cost of 2 and 4 KB of constant data respectively.
+ */
+#ifndef SBUS_CRC_SLICES
+#define SBUS_CRC_SLICES 1
+#endif
+
+#if SBUS_CRC_SLICES != 1 && SBUS_CRC_SLICES != 4 && SBUS_CRC_SLICES != 8
+#error "SBUS_CRC_SLICES must be 1, 4 or 8"
+#endif
+
+#define SBUS_CRC16_INIT 0x0000
+
+extern const uint16_t sbus_crc16_table[SBUS_CRC_SLICES][256];
+
+/*
+ * Incremental CRC-CCITT (polynomial 0x1021, initial value 0, no final xor). Start from `sbus_crc16_init`, fold in
+ * the bytes as they arrive and get the result with `sbus_crc16_final`.
+ */
+static inline uint16_t sbus_crc16_init(void) {
+    return SBUS_CRC16_INIT;
+}
+
+static inline uint16_t sbus_crc16_update_byte(uint16_t crc, uint8_t byte) {
+    return (uint16_t)((crc << 8) ^ sbus_crc16_table[0][(uint8_t)((crc >> 8) ^ byte)]);
+}
+
+static inline uint16_t sbus_crc16_final(uint16_t crc) {
+    return crc;
+}
+
+uint16_t sbus_crc16_update_8bit(uint16_t crc, const uint8_t *buffer, size_t length);
+uint16_t sbus_crc16_update_9bit(uint16_t crc, const uint16_t *buffer, size_t length);
+uint16_t sbus_crc16_9bit(uint16_t *buffer, size_t length);
+uint16_t sbus_crc16_8bit(uint8_t *buffer, size_t length);
+
+#endif
@@ -0,0 +1,268 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "crc.h"
+#include "datamode.h"
+#include "packet.h"
+
+
+typedef struct {
+    uint8_t *buffer;
+    size_t   len;
+    size_t   pos;
+    uint16_t crc;
+    int      overflow;
+} encoder_t;
+
+static void          encoder_start(encoder_t *encoder, uint8_t *buffer, size_t len, sbus_attribute_t attribute);
+static void          encoder_put(encoder_t *encoder, const uint8_t *bytes, size_t count);
+static size_t        encoder_finish(encoder_t *encoder);
+static void          stuff(encoder_t *encoder, const uint8_t *bytes, size_t count);
+static sbus_result_t abort_frame(sbus_data_mode_decoder_t *decoder, sbus_result_t result);
+
+// Second character of the stuffed sequence with the top bit set, zero for characters that are sent as they are
+static const uint8_t stuffing[256] = {
+    [SBUS_DATA_MODE_SYN] = 0x80 | 0x00,
+    [SBUS_DATA_MODE_DLE] = 0x80 | 0x01,
+};
+
+
+/*
+ * Encodes a whole frame. Returns the number of characters written, or 0 if `buffer` is too small (a buffer of
+ * `SBUS_DATA_MODE_FRAME_SIZE(payload_len)` is always enough).
+ */
+size_t sbus_data_mode_encode(uint8_t *buffer, size_t len, sbus_attribute_t attribute, const uint8_t *payload,
+                             size_t payload_len) {
+    encoder_t encoder;
+    encoder_start(&encoder, buffer, len, attribute);
+    encoder_put(&encoder, payload, payload_len);
+    return encoder_finish(&encoder);
+}
+
+
+size_t sbus_data_mode_serialize_request(uint8_t *buffer, size_t len, const sbus_request_t *request) {
+    uint8_t   header[2] = {request->destination, (uint8_t)request->command};
+    encoder_t encoder;
+
+    encoder_start(&encoder, buffer, len, SBUS_ATTRIBUTE_REQUEST);
+    encoder_put(&encoder, header, sizeof(header));
+    encoder_put(&encoder, request->data, request->data_len);
+    return encoder_finish(&encoder);
+}
+
+
+void sbus_data_mode_decoder_init(sbus_data_mode_decoder_t *decoder) {
+    decoder->discarded = 0;
+    decoder->expected  = 0;
+    sbus_data_mode_decoder_reset(decoder);
+}
+
+
+void sbus_data_mode_decoder_reset(sbus_data_mode_decoder_t *decoder) {
+    decoder->state        = SBUS_DATA_MODE_STATE_SYN;
+    decoder->escape       = 0;
+    decoder->attribute    = 0;
+    decoder->length_known = 0;
+    decoder->crc          = sbus_crc16_init();
+    decoder->required     = 0;
+    decoder->len          = 0;
+}
+
+
+/*
+ * Sets the length of the response to `request`, to be used for the next response frame.
+ */
+void sbus_data_mode_expect_response(sbus_data_mode_decoder_t *decoder, sbus_request_t *request) {
+    decoder->expected = sbus_packet_response_length(request);
+}
+
+
+/*
+ * Returns SBUS_INCOMPLETE_PACKET while a frame is in progress, SBUS_OK when `decoder->payload` holds a complete frame
+ * (`decoder->len` characters, CRC included, of the kind given by `decoder->attribute`) and SBUS_INVALID_DATA,
+ * SBUS_UNKNOWN_COMMAND or SBUS_WRONG_CRC when a frame is rejected. SYN in the middle of a frame aborts it and starts
+ * the next one.
+ */
+sbus_result_t sbus_data_mode_feed_byte(sbus_data_mode_decoder_t *decoder, uint8_t byte) {
+    if (byte == SBUS_DATA_MODE_SYN) {
+        sbus_data_mode_state_t previous = decoder->state;
+        sbus_data_mode_decoder_reset(decoder);
+        decoder->crc   = sbus_crc16_update_byte(decoder->crc, byte);
+        decoder->state = SBUS_DATA_MODE_STATE_ATTRIBUTE;
+        return previous == SBUS_DATA_MODE_STATE_SYN ? SBUS_INCOMPLETE_PACKET : SBUS_INVALID_DATA;
+    }
+
+    switch (decoder->state) {
+        case SBUS_DATA_MODE_STATE_SYN:
+            decoder->discarded++;
+            return SBUS_INCOMPLETE_PACKET;
+
+        case SBUS_DATA_MODE_STATE_ATTRIBUTE:
+            decoder->crc       = sbus_crc16_update_byte(decoder->crc, byte);
+            decoder->attribute = byte;
+            decoder->state     = SBUS_DATA_MODE_STATE_PAYLOAD;
+
+            switch (byte) {
+                case SBUS_ATTRIBUTE_REQUEST:
+                    break;
+                case SBUS_ATTRIBUTE_RESPONSE:
+                    if (decoder->expected == 0)
+                        return abort_frame(decoder, SBUS_INVALID_DATA);     // Nobody asked for it
+                    decoder->required     = decoder->expected;
+                    decoder->length_known = 1;
+                    break;
+                case SBUS_ATTRIBUTE_ACK:
+                    decoder->required     = 2 + 2;
+                    decoder->length_known = 1;
+                    break;
+                default:
+                    return abort_frame(decoder, SBUS_INVALID_DATA);
+            }
+            return SBUS_INCOMPLETE_PACKET;
+
+        case SBUS_DATA_MODE_STATE_PAYLOAD:
+            if (decoder->escape) {
+                decoder->escape = 0;
+                if (byte == 0x00)
+                    byte = SBUS_DATA_MODE_SYN;
+                else if (byte == 0x01)
+                    byte = SBUS_DATA_MODE_DLE;
+                else
+                    return abort_frame(decoder, SBUS_INVALID_DATA);
+            } else if (byte == SBUS_DATA_MODE_DLE) {
+                decoder->escape = 1;
+                return SBUS_INCOMPLETE_PACKET;
+            }
+
+            if (decoder->len >= SBUS_DATA_MODE_MAX_PAYLOAD)
+                return abort_frame(decoder, SBUS_INVALID_DATA);
+            decoder->payload[decoder->len++] = byte;
+
+            // The station and the command come before the data
+            if (!decoder->length_known && decoder->len >= 2) {
+                sbus_result_t res = sbus_packet_request_data_length(decoder->payload[1], &decoder->payload[2],
+                                                                    decoder->len - 2, &decoder->required);
+                if (res == SBUS_OK) {
+                    decoder->required += 2 + 2;
+                    decoder->length_known = 1;
+                } else if (res != SBUS_INCOMPLETE_PACKET) {
+                    return abort_frame(decoder, res);
+                }
+            }
+
+            // The length fields are always within the data, so everything before the length is known is covered
+            if (!decoder->length_known || decoder->len + 2 <= decoder->required)
+                decoder->crc = sbus_crc16_update_byte(decoder->crc, byte);
+
+            if (decoder->length_known && decoder->len >= decoder->required) {
+                uint16_t crc       = sbus_crc16_final(decoder->crc);
+                uint16_t found_crc = (uint16_t)((decoder->payload[decoder->len - 2] << 8) |
+                                                decoder->payload[decoder->len - 1]);
+                decoder->state     = SBUS_DATA_MODE_STATE_SYN;
+                if (decoder->attribute != SBUS_ATTRIBUTE_REQUEST)
+                    decoder->expected = 0;
+
+                if (crc != found_crc)
+                    return SBUS_WRONG_CRC;
+                else
+                    return SBUS_OK;
+            }
+            return SBUS_INCOMPLETE_PACKET;
+    }
+
+    return SBUS_INCOMPLETE_PACKET;
+}
+
+
+/*
+ * Feeds characters until an event occurs. On return `len` holds the number of characters consumed; when the whole
+ * buffer was consumed without completing a frame the result is SBUS_INCOMPLETE_PACKET.
+ */
+sbus_result_t sbus_data_mode_feed(sbus_data_mode_decoder_t *decoder, const uint8_t *buffer, size_t *len) {
+    for (size_t i = 0; i < *len; i++) {
+        sbus_result_t res = sbus_data_mode_feed_byte(decoder, buffer[i]);
+        if (res != SBUS_INCOMPLETE_PACKET) {
+            *len = i + 1;
+            return res;
+        }
+    }
+
+    return SBUS_INCOMPLETE_PACKET;
+}
+
+
+/*
+ * Copies the request frame just decoded into `request`.
+ */
+sbus_result_t sbus_data_mode_get_request(const sbus_data_mode_decoder_t *decoder, sbus_request_t *request) {
+    if (decoder->attribute != SBUS_ATTRIBUTE_REQUEST || !decoder->length_known || decoder->len < 4)
+        return SBUS_INVALID_ARGS;
+
+    request->destination = decoder->payload[0];
+    request->command     = decoder->payload[1];
+    request->data_len    = (uint8_t)(decoder->len - 4);
+    for (size_t i = 0; i < request->data_len; i++) {
+        request->data[i] = decoder->payload[2 + i];
+    }
+    return SBUS_OK;
+}
+
+
+static void encoder_start(encoder_t *encoder, uint8_t *buffer, size_t len, sbus_attribute_t attribute) {
+    encoder->buffer   = buffer;
+    encoder->len      = len;
+    encoder->pos      = 2;
+    encoder->overflow = len < 2;
+    encoder->crc      = sbus_crc16_update_byte(sbus_crc16_init(), SBUS_DATA_MODE_SYN);
+    encoder->crc      = sbus_crc16_update_byte(encoder->crc, (uint8_t)attribute);
+
+    if (!encoder->overflow) {
+        buffer[0] = SBUS_DATA_MODE_SYN;
+        buffer[1] = (uint8_t)attribute;
+    }
+}
+
+
+static void encoder_put(encoder_t *encoder, const uint8_t *bytes, size_t count) {
+    encoder->crc = sbus_crc16_update_8bit(encoder->crc, bytes, count);
+    stuff(encoder, bytes, count);
+}
+
+
+static size_t encoder_finish(encoder_t *encoder) {
+    uint16_t crc      = sbus_crc16_final(encoder->crc);
+    uint8_t  bytes[2] = {(uint8_t)(crc >> 8), (uint8_t)(crc & 0xFF)};
+
+    stuff(encoder, bytes, sizeof(bytes));
+    return encoder->overflow ? 0 : encoder->pos;
+}
+
+
+/*
+ * Single pass over the characters: the table tells which ones need a DLE sequence and its second character.
+ */
+static void stuff(encoder_t *encoder, const uint8_t *bytes, size_t count) {
+    uint8_t *buffer = encoder->buffer;
+    size_t   pos    = encoder->pos;
+
+    for (size_t i = 0; i < count && !encoder->overflow; i++) {
+        uint8_t code = stuffing[bytes[i]];
+
+        if (code == 0 && pos < encoder->len) {
+            buffer[pos++] = bytes[i];
+        } else if (code != 0 && pos + 1 < encoder->len) {
+            buffer[pos++] = SBUS_DATA_MODE_DLE;
+            buffer[pos++] = code & 0x7F;
+        } else {
+            encoder->overflow = 1;
+        }
+    }
+
+    encoder->pos = pos;
+}
+
+
+static sbus_result_t abort_frame(sbus_data_mode_decoder_t *decoder, sbus_result_t result) {
+    decoder->state = SBUS_DATA_MODE_STATE_SYN;
+    return result;
+}
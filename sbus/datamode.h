@@ -0,0 +1,62 @@
+#ifndef SBUS_DATAMODE_H_INCLUDED
+#define SBUS_DATAMODE_H_INCLUDED
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "packet.h"
+
+/*
+ * S-Bus data mode: plain 8-bit characters, each frame starts with SYN and an attribute character. SYN and DLE never
+ * appear inside a frame, they are replaced by DLE followed by 0x00 and 0x01 respectively. The CRC covers the
+ * unstuffed frame starting from SYN.
+ */
+#define SBUS_DATA_MODE_SYN 0xB5
+#define SBUS_DATA_MODE_DLE 0xC5
+
+#define SBUS_DATA_MODE_MAX_PAYLOAD 260
+
+// Worst case encoded size of a frame carrying `len` payload characters: everything after the attribute is stuffed
+#define SBUS_DATA_MODE_FRAME_SIZE(len) (2 + ((len) + 2) * 2)
+
+typedef enum {
+    SBUS_ATTRIBUTE_REQUEST  = 0,
+    SBUS_ATTRIBUTE_RESPONSE = 1,
+    SBUS_ATTRIBUTE_ACK      = 2,
+} sbus_attribute_t;
+
+typedef enum {
+    SBUS_DATA_MODE_STATE_SYN = 0,
+    SBUS_DATA_MODE_STATE_ATTRIBUTE,
+    SBUS_DATA_MODE_STATE_PAYLOAD,
+} sbus_data_mode_state_t;
+
+
+/*
+ * Incremental data mode decoder. Requests are delimited through their own length fields; responses carry no length,
+ * so the one expected by the pending request must be set with `sbus_data_mode_expect_response`.
+ */
+typedef struct {
+    sbus_data_mode_state_t state;
+    uint8_t                escape;
+    uint8_t                attribute;
+    uint8_t                length_known;
+    uint16_t               crc;
+    size_t                 required;     // Payload length including the CRC, once known
+    size_t                 expected;     // Length of the response payload (CRC included) for the pending request
+    size_t                 len;
+    uint8_t                payload[SBUS_DATA_MODE_MAX_PAYLOAD];
+    size_t                 discarded;     // Characters thrown away while looking for SYN
+} sbus_data_mode_decoder_t;
+
+size_t        sbus_data_mode_encode(uint8_t *buffer, size_t len, sbus_attribute_t attribute, const uint8_t *payload,
+                                    size_t payload_len);
+size_t        sbus_data_mode_serialize_request(uint8_t *buffer, size_t len, const sbus_request_t *request);
+void          sbus_data_mode_decoder_init(sbus_data_mode_decoder_t *decoder);
+void          sbus_data_mode_decoder_reset(sbus_data_mode_decoder_t *decoder);
+void          sbus_data_mode_expect_response(sbus_data_mode_decoder_t *decoder, sbus_request_t *request);
+sbus_result_t sbus_data_mode_feed_byte(sbus_data_mode_decoder_t *decoder, uint8_t byte);
+sbus_result_t sbus_data_mode_feed(sbus_data_mode_decoder_t *decoder, const uint8_t *buffer, size_t *len);
+sbus_result_t sbus_data_mode_get_request(const sbus_data_mode_decoder_t *decoder, sbus_request_t *request);
+
+#endif
@@ -0,0 +1,304 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "crc.h"
+#include "decode.h"
+#include "packet.h"
+#include "stats.h"
+
+
+#define ADDRESS_MASK 0x0100
+#define BYTE(word)   ((uint8_t)((word)&0xFF))
+
+typedef enum {
+    SHAPE_VALUES,
+    SHAPE_BITS,
+    SHAPE_CLOCK,
+} shape_t;
+
+static sbus_result_t expect(const sbus_request_t *request, shape_t shape, size_t *len, size_t *data_len);
+static sbus_result_t finish_9bit(const sbus_request_t *request, const uint16_t *buffer, size_t *len,
+                                 size_t data_len, uint16_t crc, uint16_t marks);
+static sbus_result_t finish_8bit(const sbus_request_t *request, const uint8_t *buffer, size_t *len, size_t data_len,
+                                 uint16_t crc);
+static int           from_bcd(uint8_t bcd, uint8_t max, uint8_t *value);
+
+
+void sbus_decode_be32_8bit(const uint8_t *bytes, size_t count, uint32_t *values) {
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t *byte = &bytes[i * 4];
+        values[i] = ((uint32_t)byte[0] << 24) | ((uint32_t)byte[1] << 16) | ((uint32_t)byte[2] << 8) | byte[3];
+    }
+}
+
+
+/*
+ * Narrows the words to their low byte and byte swaps in one step; written without carried dependencies so that the
+ * compiler can vectorize it.
+ */
+void sbus_decode_be32_9bit(const uint16_t *words, size_t count, uint32_t *values) {
+    for (size_t i = 0; i < count; i++) {
+        const uint16_t *word = &words[i * 4];
+        values[i]            = ((uint32_t)BYTE(word[0]) << 24) | ((uint32_t)BYTE(word[1]) << 16) |
+                    ((uint32_t)BYTE(word[2]) << 8) | (uint32_t)BYTE(word[3]);
+    }
+}
+
+
+/*
+ * Unpacks `count` bits with the SBUS_FIO_* layout to one byte (0 or 1) each.
+ */
+void sbus_decode_bits_8bit(const uint8_t *bytes, size_t count, uint8_t *bits) {
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        uint8_t byte = bytes[i / 8];
+        for (size_t j = 0; j < 8; j++)
+            bits[i + j] = (byte >> j) & 1;
+    }
+    for (; i < count; i++)
+        bits[i] = (bytes[SBUS_FIO_BYTE(i)] & SBUS_FIO_MASK(i)) ? 1 : 0;
+}
+
+
+void sbus_decode_bits_9bit(const uint16_t *words, size_t count, uint8_t *bits) {
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        uint8_t byte = BYTE(words[i / 8]);
+        for (size_t j = 0; j < 8; j++)
+            bits[i + j] = (byte >> j) & 1;
+    }
+    for (; i < count; i++)
+        bits[i] = (BYTE(words[SBUS_FIO_BYTE(i)]) & SBUS_FIO_MASK(i)) ? 1 : 0;
+}
+
+
+/*
+ * Response to a register, counter, timer or display register read: `values` receives r-count + 1 values (one for
+ * the display register). Its content is undefined unless SBUS_OK is returned.
+ */
+sbus_result_t sbus_decode_values_9bit(const sbus_request_t *request, const uint16_t *buffer, size_t *len,
+                                      uint32_t *values) {
+    size_t        data_len;
+    sbus_result_t res = expect(request, SHAPE_VALUES, len, &data_len);
+    if (res != SBUS_OK)
+        return res;
+
+    uint16_t crc   = sbus_crc16_init();
+    uint16_t marks = 0;
+    for (size_t i = 0; i < data_len / 4; i++) {
+        const uint16_t *word = &buffer[i * 4];
+        marks |= word[0] | word[1] | word[2] | word[3];
+        crc = sbus_crc16_update_byte(crc, BYTE(word[0]));
+        crc = sbus_crc16_update_byte(crc, BYTE(word[1]));
+        crc = sbus_crc16_update_byte(crc, BYTE(word[2]));
+        crc = sbus_crc16_update_byte(crc, BYTE(word[3]));
+        values[i] = ((uint32_t)BYTE(word[0]) << 24) | ((uint32_t)BYTE(word[1]) << 16) |
+                    ((uint32_t)BYTE(word[2]) << 8) | (uint32_t)BYTE(word[3]);
+    }
+
+    return finish_9bit(request, buffer, len, data_len, crc, marks);
+}
+
+
+sbus_result_t sbus_decode_values_8bit(const sbus_request_t *request, const uint8_t *buffer, size_t *len,
+                                      uint32_t *values) {
+    size_t        data_len;
+    sbus_result_t res = expect(request, SHAPE_VALUES, len, &data_len);
+    if (res != SBUS_OK)
+        return res;
+
+    uint16_t crc = sbus_crc16_init();
+    for (size_t i = 0; i < data_len / 4; i++) {
+        const uint8_t *byte = &buffer[i * 4];
+        crc                 = sbus_crc16_update_byte(crc, byte[0]);
+        crc                 = sbus_crc16_update_byte(crc, byte[1]);
+        crc                 = sbus_crc16_update_byte(crc, byte[2]);
+        crc                 = sbus_crc16_update_byte(crc, byte[3]);
+        values[i] = ((uint32_t)byte[0] << 24) | ((uint32_t)byte[1] << 16) | ((uint32_t)byte[2] << 8) | byte[3];
+    }
+
+    return finish_8bit(request, buffer, len, data_len, crc);
+}
+
+
+/*
+ * Response to a flag, input or output read: `bits` receives r-count + 1 bytes, 0 or 1.
+ */
+sbus_result_t sbus_decode_flags_9bit(const sbus_request_t *request, const uint16_t *buffer, size_t *len,
+                                     uint8_t *bits) {
+    size_t        data_len;
+    sbus_result_t res = expect(request, SHAPE_BITS, len, &data_len);
+    if (res != SBUS_OK)
+        return res;
+
+    size_t   count = (size_t)SBUS_PACKET_R_COUNT(request) + 1;
+    uint16_t crc   = sbus_crc16_init();
+    uint16_t marks = 0;
+    for (size_t i = 0; i < data_len; i++) {
+        uint8_t byte = BYTE(buffer[i]);
+        marks |= buffer[i];
+        crc = sbus_crc16_update_byte(crc, byte);
+        for (size_t j = 0; j < 8 && i * 8 + j < count; j++)
+            bits[i * 8 + j] = (byte >> j) & 1;
+    }
+
+    return finish_9bit(request, buffer, len, data_len, crc, marks);
+}
+
+
+sbus_result_t sbus_decode_flags_8bit(const sbus_request_t *request, const uint8_t *buffer, size_t *len,
+                                     uint8_t *bits) {
+    size_t        data_len;
+    sbus_result_t res = expect(request, SHAPE_BITS, len, &data_len);
+    if (res != SBUS_OK)
+        return res;
+
+    size_t   count = (size_t)SBUS_PACKET_R_COUNT(request) + 1;
+    uint16_t crc   = sbus_crc16_init();
+    for (size_t i = 0; i < data_len; i++) {
+        crc = sbus_crc16_update_byte(crc, buffer[i]);
+        for (size_t j = 0; j < 8 && i * 8 + j < count; j++)
+            bits[i * 8 + j] = (buffer[i] >> j) & 1;
+    }
+
+    return finish_8bit(request, buffer, len, data_len, crc);
+}
+
+
+/*
+ * Response to a real time clock read. A clock that is not valid BCD, or out of range, gives SBUS_INVALID_DATA.
+ */
+sbus_result_t sbus_decode_clock_9bit(const sbus_request_t *request, const uint16_t *buffer, size_t *len,
+                                     sbus_clock_t *clock) {
+    size_t        data_len;
+    sbus_result_t res = expect(request, SHAPE_CLOCK, len, &data_len);
+    if (res != SBUS_OK)
+        return res;
+
+    uint8_t  bcd[SBUS_CLOCK_SIZE];
+    uint16_t crc   = sbus_crc16_init();
+    uint16_t marks = 0;
+    for (size_t i = 0; i < SBUS_CLOCK_SIZE; i++) {
+        bcd[i] = BYTE(buffer[i]);
+        marks |= buffer[i];
+        crc = sbus_crc16_update_byte(crc, bcd[i]);
+    }
+
+    res = finish_9bit(request, buffer, len, data_len, crc, marks);
+    return res == SBUS_OK ? sbus_clock_from_bcd(bcd, clock) : res;
+}
+
+
+sbus_result_t sbus_decode_clock_8bit(const sbus_request_t *request, const uint8_t *buffer, size_t *len,
+                                     sbus_clock_t *clock) {
+    size_t        data_len;
+    sbus_result_t res = expect(request, SHAPE_CLOCK, len, &data_len);
+    if (res != SBUS_OK)
+        return res;
+
+    res = finish_8bit(request, buffer, len, data_len, sbus_crc16_update_8bit(sbus_crc16_init(), buffer, data_len));
+    return res == SBUS_OK ? sbus_clock_from_bcd(buffer, clock) : res;
+}
+
+
+sbus_result_t sbus_clock_from_bcd(const uint8_t *bcd, sbus_clock_t *clock) {
+    sbus_clock_t decoded;
+
+    if (from_bcd(bcd[0], 99, &decoded.year) || from_bcd(bcd[1], 12, &decoded.month) ||
+        from_bcd(bcd[2], 31, &decoded.day) || from_bcd(bcd[3], 23, &decoded.hour) ||
+        from_bcd(bcd[4], 59, &decoded.minute) || from_bcd(bcd[5], 59, &decoded.second) || decoded.month == 0 ||
+        decoded.day == 0)
+        return SBUS_INVALID_DATA;
+
+    *clock = decoded;
+    return SBUS_OK;
+}
+
+
+void sbus_clock_to_bcd(const sbus_clock_t *clock, uint8_t *bcd) {
+    const uint8_t fields[SBUS_CLOCK_SIZE] = {clock->year, clock->month,  clock->day,
+                                             clock->hour, clock->minute, clock->second};
+    for (size_t i = 0; i < SBUS_CLOCK_SIZE; i++)
+        bcd[i] = (uint8_t)(((fields[i] / 10) << 4) | (fields[i] % 10));
+}
+
+
+/*
+ * Checks that the request reads the expected kind of data and that the whole response is there. `data_len` is the
+ * length of the response without the CRC.
+ */
+static sbus_result_t expect(const sbus_request_t *request, shape_t shape, size_t *len, size_t *data_len) {
+    const sbus_command_descriptor_t *descriptor = sbus_command_describe(request->command);
+    int                              matches    = 0;
+
+    switch (shape) {
+        case SHAPE_VALUES:
+            // Reads of a media that is not bits, or of the single value without media of the display register
+            matches = descriptor->has_media ? !sbus_media_is_bit((sbus_media_type_t)descriptor->media)
+                                            : descriptor->response_base == 4 + 2;
+            break;
+        case SHAPE_BITS:
+            matches = descriptor->has_media && sbus_media_is_bit((sbus_media_type_t)descriptor->media);
+            break;
+        case SHAPE_CLOCK:
+            matches = request->command == SBUS_COMMAND_READ_REAL_TIME_CLOCK;
+            break;
+    }
+
+    size_t required = sbus_packet_response_length(request);
+    if (!matches || descriptor->kind != SBUS_COMMAND_KIND_READ || required == 0)
+        return SBUS_INVALID_ARGS;
+
+    if (*len < required) {
+        *len = 0;
+        return SBUS_INCOMPLETE_PACKET;
+    }
+
+    *data_len = required - 2;
+    return SBUS_OK;
+}
+
+
+static sbus_result_t finish_9bit(const sbus_request_t *request, const uint16_t *buffer, size_t *len,
+                                 size_t data_len, uint16_t crc, uint16_t marks) {
+    sbus_result_t res;
+
+    marks |= buffer[data_len] | buffer[data_len + 1];
+    if (marks & ADDRESS_MASK) {
+        size_t index = 0;
+        while ((buffer[index] & ADDRESS_MASK) == 0)
+            index++;
+        *len = index;
+        res  = SBUS_NOT_FOUND;
+    } else {
+        uint16_t found_crc = (uint16_t)((BYTE(buffer[data_len]) << 8) | BYTE(buffer[data_len + 1]));
+        *len               = data_len + 2;
+        res                = sbus_crc16_final(crc) != found_crc ? SBUS_WRONG_CRC : SBUS_OK;
+    }
+
+    SBUS_STATS_RESULT(request->command, res);
+    return res;
+}
+
+
+static sbus_result_t finish_8bit(const sbus_request_t *request, const uint8_t *buffer, size_t *len, size_t data_len,
+                                 uint16_t crc) {
+    uint16_t      found_crc = (uint16_t)((buffer[data_len] << 8) | buffer[data_len + 1]);
+    sbus_result_t res       = sbus_crc16_final(crc) != found_crc ? SBUS_WRONG_CRC : SBUS_OK;
+
+    *len = data_len + 2;
+    SBUS_STATS_RESULT(request->command, res);
+    return res;
+}
+
+
+static int from_bcd(uint8_t bcd, uint8_t max, uint8_t *value) {
+    if ((bcd >> 4) > 9 || (bcd & 0x0F) > 9)
+        return -1;
+
+    *value = (uint8_t)((bcd >> 4) * 10 + (bcd & 0x0F));
+    return *value > max ? -1 : 0;
+}
@@ -0,0 +1,46 @@
+#ifndef SBUS_DECODE_H_INCLUDED
+#define SBUS_DECODE_H_INCLUDED
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "packet.h"
+
+
+/*
+ * Real time clock, as carried by READ_REAL_TIME_CLOCK responses and WRITE_REAL_TIME_CLOCK requests: six BCD bytes
+ * (year, month, day, hour, minute, second), the layout used by `sbus_slave_t`.
+ */
+typedef struct {
+    uint8_t year;     // 0-99
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+} sbus_clock_t;
+
+
+// Kernels: big endian 32 bit values and packed bits, from bytes or from the low byte of 9-bit words
+void sbus_decode_be32_8bit(const uint8_t *bytes, size_t count, uint32_t *values);
+void sbus_decode_be32_9bit(const uint16_t *words, size_t count, uint32_t *values);
+void sbus_decode_bits_8bit(const uint8_t *bytes, size_t count, uint8_t *bits);
+void sbus_decode_bits_9bit(const uint16_t *words, size_t count, uint8_t *bits);
+
+// Validation and decoding in a single pass; same results and `len` handling as `sbus_packet_validate_response_*`
+sbus_result_t sbus_decode_values_9bit(const sbus_request_t *request, const uint16_t *buffer, size_t *len,
+                                      uint32_t *values);
+sbus_result_t sbus_decode_values_8bit(const sbus_request_t *request, const uint8_t *buffer, size_t *len,
+                                      uint32_t *values);
+sbus_result_t sbus_decode_flags_9bit(const sbus_request_t *request, const uint16_t *buffer, size_t *len,
+                                     uint8_t *bits);
+sbus_result_t sbus_decode_flags_8bit(const sbus_request_t *request, const uint8_t *buffer, size_t *len,
+                                     uint8_t *bits);
+sbus_result_t sbus_decode_clock_9bit(const sbus_request_t *request, const uint16_t *buffer, size_t *len,
+                                     sbus_clock_t *clock);
+sbus_result_t sbus_decode_clock_8bit(const sbus_request_t *request, const uint8_t *buffer, size_t *len,
+                                     sbus_clock_t *clock);
+sbus_result_t sbus_clock_from_bcd(const uint8_t *bcd, sbus_clock_t *clock);
+void          sbus_clock_to_bcd(const sbus_clock_t *clock, uint8_t *bcd);
+
+#endif
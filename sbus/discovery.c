@@ -0,0 +1,261 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "discovery.h"
+#include "packet.h"
+#include "wire.h"
+
+
+// Station bitmaps use the packing of flags
+#define STATION_GET(map, station) (((map)[SBUS_FIO_BYTE(station)] & SBUS_FIO_MASK(station)) ? 1 : 0)
+#define STATION_SET(map, station) ((map)[SBUS_FIO_BYTE(station)] |= SBUS_FIO_MASK(station))
+
+static int      next_station(sbus_discovery_t *discovery, const uint8_t *map, uint8_t *station);
+static void     make_probe(sbus_discovery_t *discovery, size_t setting, uint8_t station, sbus_command_code_t command,
+                           sbus_probe_t *probe);
+static uint32_t probe_timeout(const sbus_wire_t *setting, const sbus_request_t *request);
+static void     sort_settings(sbus_discovery_t *discovery);
+
+
+/*
+ * Prepares the discovery of the addresses `first` to `last` (254 at most), trying the candidate `settings` in the
+ * given order. `topology` is optional; one saved for a setting that is not among the candidates is ignored, one
+ * that is not a topology at all gives SBUS_INVALID_DATA.
+ */
+sbus_result_t sbus_discovery_init(sbus_discovery_t *discovery, const sbus_wire_t *settings, size_t num_settings,
+                                  uint8_t first, uint8_t last, const sbus_topology_t *topology) {
+    if (num_settings == 0 || num_settings > SBUS_DISCOVERY_MAX_SETTINGS || first > last ||
+        last >= SBUS_BROADCAST_ADDRESS)
+        return SBUS_INVALID_ARGS;
+    for (size_t i = 0; i < num_settings; i++) {
+        if (settings[i].baud == 0)
+            return SBUS_INVALID_ARGS;
+    }
+    if (topology != NULL && (memcmp(topology->magic, SBUS_TOPOLOGY_MAGIC, sizeof(SBUS_TOPOLOGY_MAGIC)) != 0 ||
+                             topology->version != SBUS_TOPOLOGY_VERSION))
+        return SBUS_INVALID_DATA;
+
+    memset(discovery, 0, sizeof(sbus_discovery_t));
+    memcpy(discovery->settings, settings, num_settings * sizeof(sbus_wire_t));
+    discovery->num_settings = num_settings;
+    discovery->first        = first;
+    discovery->last         = last;
+    discovery->phase        = SBUS_DISCOVERY_SCAN;
+    discovery->locked       = -1;
+    discovery->address      = first;
+
+    for (size_t i = 0; topology != NULL && i < num_settings; i++) {
+        if (settings[i].baud == topology->baud && settings[i].format == (sbus_wire_format_t)topology->format) {
+            // Start from the saved line setting, until the known stations say otherwise
+            discovery->phase  = SBUS_DISCOVERY_VERIFY;
+            discovery->locked = (int)i;
+            for (size_t station = first; station <= last; station++) {
+                if (STATION_GET(topology->present, station))
+                    STATION_SET(discovery->known, station);
+            }
+            break;
+        }
+    }
+
+    return SBUS_OK;
+}
+
+
+/*
+ * Hands out the next probe; SBUS_NOT_FOUND once the discovery is over. Probes go out one at a time: each one must
+ * be completed before asking for the next.
+ */
+sbus_result_t sbus_discovery_next(sbus_discovery_t *discovery, sbus_probe_t *probe) {
+    uint8_t station;
+
+    for (;;) {
+        switch (discovery->phase) {
+            case SBUS_DISCOVERY_VERIFY:
+                if (next_station(discovery, discovery->known, &station)) {
+                    make_probe(discovery, (size_t)discovery->locked, station, SBUS_COMMAND_READ_STATION_NUMBER, probe);
+                    return SBUS_OK;
+                }
+
+                if (sbus_discovery_count(discovery) > 0 &&
+                    memcmp(discovery->known, discovery->present, sizeof(discovery->present)) == 0) {
+                    discovery->phase = SBUS_DISCOVERY_STATUS;
+                } else {
+                    // Somebody is missing: scan everything, on every setting if nobody answered at all
+                    if (sbus_discovery_count(discovery) == 0)
+                        discovery->locked = -1;
+                    discovery->phase = SBUS_DISCOVERY_SCAN;
+                }
+                discovery->address = discovery->first;
+                break;
+
+            case SBUS_DISCOVERY_SCAN:
+                while (discovery->address <= discovery->last &&
+                       STATION_GET(discovery->present, discovery->address))
+                    discovery->address++;
+
+                if (discovery->address > discovery->last) {
+                    discovery->phase   = SBUS_DISCOVERY_STATUS;
+                    discovery->address = discovery->first;
+                    break;
+                }
+
+                station = (uint8_t)discovery->address;
+                if (discovery->locked >= 0) {
+                    make_probe(discovery, (size_t)discovery->locked, station, SBUS_COMMAND_READ_STATION_NUMBER, probe);
+                    discovery->address++;
+                } else {
+                    if (discovery->tried == 0)
+                        sort_settings(discovery);
+                    make_probe(discovery, discovery->order[discovery->tried++], station,
+                               SBUS_COMMAND_READ_STATION_NUMBER, probe);
+                    if (discovery->tried == discovery->num_settings) {
+                        discovery->tried = 0;
+                        discovery->address++;
+                    }
+                }
+                return SBUS_OK;
+
+            case SBUS_DISCOVERY_STATUS:
+                if (discovery->locked >= 0 && next_station(discovery, discovery->present, &station)) {
+                    make_probe(discovery, (size_t)discovery->locked, station, SBUS_COMMAND_READ_PCD_STATUS_SELF,
+                               probe);
+                    return SBUS_OK;
+                }
+                discovery->phase = SBUS_DISCOVERY_DONE;
+                break;
+
+            case SBUS_DISCOVERY_DONE:
+            default:
+                return SBUS_NOT_FOUND;
+        }
+    }
+}
+
+
+/*
+ * Hands back the outcome of `probe`: the validation result and the single data byte of the response (station
+ * number or PCD status).
+ */
+void sbus_discovery_complete(sbus_discovery_t *discovery, const sbus_probe_t *probe, sbus_result_t result,
+                             uint8_t value) {
+    uint8_t station = probe->request.destination;
+
+    if (probe->request.command == SBUS_COMMAND_READ_PCD_STATUS_SELF) {
+        if (result == SBUS_OK)
+            discovery->status[station] = value;
+        return;
+    }
+
+    if (result == SBUS_OK && value == station) {
+        STATION_SET(discovery->present, station);
+        if (discovery->locked < 0) {
+            discovery->locked = (int)probe->setting;
+            // No need to try the other settings on this address
+            if (discovery->phase == SBUS_DISCOVERY_SCAN && discovery->tried > 0 && discovery->address == station) {
+                discovery->tried = 0;
+                discovery->address++;
+            }
+        }
+    } else if (result == SBUS_OK || result == SBUS_WRONG_CRC || result == SBUS_INVALID_DATA) {
+        // Something answered, just not as expected
+        discovery->garbled[probe->setting]++;
+    }
+}
+
+
+int sbus_discovery_present(const sbus_discovery_t *discovery, uint8_t station) {
+    return STATION_GET(discovery->present, station);
+}
+
+
+size_t sbus_discovery_count(const sbus_discovery_t *discovery) {
+    size_t count = 0;
+
+    for (size_t station = 0; station < SBUS_DISCOVERY_STATIONS; station++)
+        count += (size_t)STATION_GET(discovery->present, station);
+    return count;
+}
+
+
+/*
+ * Stores the line setting and the stations found, for the next `sbus_discovery_init`.
+ */
+void sbus_discovery_save(const sbus_discovery_t *discovery, sbus_topology_t *topology) {
+    memset(topology, 0, sizeof(sbus_topology_t));
+    memcpy(topology->magic, SBUS_TOPOLOGY_MAGIC, sizeof(SBUS_TOPOLOGY_MAGIC));
+    topology->version = SBUS_TOPOLOGY_VERSION;
+
+    if (discovery->locked >= 0) {
+        topology->baud   = discovery->settings[discovery->locked].baud;
+        topology->format = (uint32_t)discovery->settings[discovery->locked].format;
+        memcpy(topology->present, discovery->present, sizeof(topology->present));
+        memcpy(topology->status, discovery->status, sizeof(topology->status));
+    }
+}
+
+
+/*
+ * Next station of `map` from the cursor on, which is moved past it.
+ */
+static int next_station(sbus_discovery_t *discovery, const uint8_t *map, uint8_t *station) {
+    while (discovery->address <= discovery->last) {
+        uint16_t address = discovery->address++;
+        if (STATION_GET(map, address)) {
+            *station = (uint8_t)address;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+static void make_probe(sbus_discovery_t *discovery, size_t setting, uint8_t station, sbus_command_code_t command,
+                       sbus_probe_t *probe) {
+    probe->setting             = setting;
+    probe->request.destination = station;
+    probe->request.command     = command;
+    probe->request.data_len    = 0;
+    probe->timeout_us          = probe_timeout(&discovery->settings[setting], &probe->request);
+
+    discovery->probes++;
+    discovery->budget_us += probe->timeout_us;
+}
+
+
+/*
+ * Both frames on the wire, fully stuffed in data mode, plus the turnaround allowance.
+ */
+static uint32_t probe_timeout(const sbus_wire_t *setting, const sbus_request_t *request) {
+    size_t characters =
+        sbus_wire_request_characters(setting, request) + sbus_wire_response_characters(setting, request);
+
+    if (setting->format == SBUS_WIRE_DATA)
+        characters *= 2;
+    return sbus_wire_characters_us(setting, characters) + setting->turnaround_us;
+}
+
+
+/*
+ * Candidate settings by number of garbled answers at their baud rate, most first: a station answering in the other
+ * wire format still gives away the baud rate. The configured order breaks ties.
+ */
+static void sort_settings(sbus_discovery_t *discovery) {
+    unsigned long score[SBUS_DISCOVERY_MAX_SETTINGS] = {0};
+
+    for (size_t i = 0; i < discovery->num_settings; i++) {
+        for (size_t j = 0; j < discovery->num_settings; j++) {
+            if (discovery->settings[j].baud == discovery->settings[i].baud)
+                score[i] += discovery->garbled[j];
+        }
+    }
+
+    for (size_t i = 0; i < discovery->num_settings; i++) {
+        size_t j = i;
+        while (j > 0 && score[discovery->order[j - 1]] < score[i]) {
+            discovery->order[j] = discovery->order[j - 1];
+            j--;
+        }
+        discovery->order[j] = i;
+    }
+}
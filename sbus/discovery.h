@@ -0,0 +1,90 @@
+#ifndef SBUS_DISCOVERY_H_INCLUDED
+#define SBUS_DISCOVERY_H_INCLUDED
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "packet.h"
+#include "wire.h"
+
+#define SBUS_DISCOVERY_MAX_SETTINGS 16
+#define SBUS_DISCOVERY_STATIONS     256
+
+#define SBUS_TOPOLOGY_MAGIC   "SBUSTOP"
+#define SBUS_TOPOLOGY_VERSION 1     // Also tells apart topologies saved on a host with the other byte order
+
+typedef enum {
+    SBUS_DISCOVERY_VERIFY = 0,     // Known stations, at the saved line setting
+    SBUS_DISCOVERY_SCAN,           // Every address, every setting until one is confirmed
+    SBUS_DISCOVERY_STATUS,         // PCD status of the stations found
+    SBUS_DISCOVERY_DONE,
+} sbus_discovery_phase_t;
+
+
+/*
+ * What was found on a line, in a form that can be stored as is (host byte order) and handed back to
+ * `sbus_discovery_init` on the next start.
+ */
+typedef struct {
+    char     magic[8];
+    uint32_t version;
+    uint32_t baud;
+    uint32_t format;
+    uint8_t  present[SBUS_FIO_BYTES(SBUS_DISCOVERY_STATIONS)];
+    uint8_t  status[SBUS_DISCOVERY_STATIONS];     // PCD status character, 0 if it could not be read
+} sbus_topology_t;
+
+
+/*
+ * One request to put on the line: the line must be switched to `settings[setting]` first. `timeout_us` is the time
+ * the exchange takes on the wire plus the turnaround allowance of the setting.
+ */
+typedef struct {
+    size_t         setting;
+    sbus_request_t request;
+    uint32_t       timeout_us;
+} sbus_probe_t;
+
+
+/*
+ * Station discovery for one line, driven by the caller like the writer and the scheduler: `sbus_discovery_next`
+ * hands out probes and `sbus_discovery_complete` takes their outcome. Lines are independent, so several of them can
+ * be discovered at the same time.
+ *
+ * With a saved topology only the known stations are probed, at the saved setting; a full scan follows only if some
+ * of them do not answer. The scan probes every address with READ_STATION_NUMBER, trying every candidate setting
+ * (baud rate and wire format) until a station validates on one of them; from then on the line is locked to that
+ * setting. Baud rates at which garbled responses (wrong CRC, invalid data) were seen are tried first, since
+ * something answered there. Finally the PCD status of every station found is read.
+ */
+typedef struct {
+    sbus_wire_t settings[SBUS_DISCOVERY_MAX_SETTINGS];     // `turnaround_us` is the allowance for the answer
+    size_t      num_settings;
+    uint8_t     first;
+    uint8_t     last;
+
+    sbus_discovery_phase_t phase;
+    int                    locked;     // Index of the line setting, -1 until a station answered
+    uint16_t               address;
+    size_t                 tried;      // Settings already tried on `address` while not locked
+    uint8_t                known[SBUS_FIO_BYTES(SBUS_DISCOVERY_STATIONS)];
+    uint8_t                present[SBUS_FIO_BYTES(SBUS_DISCOVERY_STATIONS)];
+    uint8_t                status[SBUS_DISCOVERY_STATIONS];
+    unsigned long          garbled[SBUS_DISCOVERY_MAX_SETTINGS];
+    size_t                 order[SBUS_DISCOVERY_MAX_SETTINGS];
+
+    unsigned long probes;
+    uint64_t      budget_us;     // Sum of the probe timeouts, an upper bound of the bus time spent
+} sbus_discovery_t;
+
+
+sbus_result_t sbus_discovery_init(sbus_discovery_t *discovery, const sbus_wire_t *settings, size_t num_settings,
+                                  uint8_t first, uint8_t last, const sbus_topology_t *topology);
+sbus_result_t sbus_discovery_next(sbus_discovery_t *discovery, sbus_probe_t *probe);
+void          sbus_discovery_complete(sbus_discovery_t *discovery, const sbus_probe_t *probe, sbus_result_t result,
+                                      uint8_t value);
+int           sbus_discovery_present(const sbus_discovery_t *discovery, uint8_t station);
+size_t        sbus_discovery_count(const sbus_discovery_t *discovery);
+void          sbus_discovery_save(const sbus_discovery_t *discovery, sbus_topology_t *topology);
+
+#endif
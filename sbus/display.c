@@ -1,22 +1,48 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdarg.h>
 
 #include "packet.h"
+#include "display.h"
 
 
+static size_t append(char *string, size_t len, size_t offset, const char *format, ...);
+
+
+/*
+ * Same contract as `snprintf`: the output is truncated (and terminated) to fit `len`, while the return value is the
+ * length the full text would have.
+ */
 size_t sbus_request_display(char *string, size_t len, sbus_request_t *request) {
     size_t final_length = 0;
-    final_length +=
-        snprintf(string + final_length, len, "Request for %i, command %i\n", request->destination, request->command);
+    final_length += append(string, len, final_length, "Request for %i, command %i (%s)\n", request->destination,
+                           request->command, sbus_command_name(request->command));
 
     if (request->data_len > 0) {
-        final_length += snprintf(string + final_length, len, "\tData:");
+        final_length += append(string, len, final_length, "\tData:");
         for (size_t i = 0; i < request->data_len; i++)
-            final_length += snprintf(string + final_length, len, " 0x%02X", request->data[i]);
+            final_length += append(string, len, final_length, " 0x%02X", request->data[i]);
     }
 
-    final_length += snprintf(string + final_length, len, "\n");
+    final_length += append(string, len, final_length, "\n");
 
     return final_length;
-}
\ No newline at end of file
+}
+
+
+const char *sbus_command_name(sbus_command_code_t command) {
+    return sbus_command_describe(command)->name;
+}
+
+
+static size_t append(char *string, size_t len, size_t offset, const char *format, ...) {
+    va_list args;
+    size_t  used = offset < len ? offset : len;
+
+    va_start(args, format);
+    int res = vsnprintf(len > used ? string + used : NULL, len - used, format, args);
+    va_end(args);
+
+    return res > 0 ? (size_t)res : 0;
+}
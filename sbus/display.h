@@ -5,6 +5,7 @@
 
 #include "packet.h"
 
-size_t sbus_request_display(char *string, size_t len, sbus_request_t *request);
+size_t      sbus_request_display(char *string, size_t len, sbus_request_t *request);
+const char *sbus_command_name(sbus_command_code_t command);
 
-#endif
\ No newline at end of file
+#endif
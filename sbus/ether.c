@@ -0,0 +1,173 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "crc.h"
+#include "datamode.h"
+#include "ether.h"
+#include "packet.h"
+
+
+static size_t   write_header(uint8_t *buffer, size_t total, uint16_t sequence, sbus_attribute_t attribute);
+static uint16_t frame_crc(const uint8_t *buffer, size_t len);
+
+
+/*
+ * Returns the size of the datagram, or 0 if `buffer` is too small.
+ */
+size_t sbus_ether_serialize_request(uint8_t *buffer, size_t len, uint16_t sequence, const sbus_request_t *request) {
+    size_t total = SBUS_ETHER_HEADER_SIZE + 2 + request->data_len + 2;
+    if (len < total)
+        return 0;
+
+    size_t pos    = write_header(buffer, total, sequence, SBUS_ATTRIBUTE_REQUEST);
+    buffer[pos++] = request->destination;
+    buffer[pos++] = (uint8_t)request->command;
+    memcpy(&buffer[pos], request->data, request->data_len);
+    pos += request->data_len;
+
+    uint16_t crc  = frame_crc(buffer, pos);
+    buffer[pos++] = (uint8_t)(crc >> 8);
+    buffer[pos++] = (uint8_t)(crc & 0xFF);
+    return pos;
+}
+
+
+/*
+ * `data` is the content of the telegram without CRC: the response data or the two bytes of the ACK/NAK code.
+ */
+size_t sbus_ether_serialize_response(uint8_t *buffer, size_t len, uint16_t sequence, sbus_attribute_t attribute,
+                                     const uint8_t *data, size_t data_len) {
+    size_t total = SBUS_ETHER_HEADER_SIZE + data_len + 2;
+    if (len < total)
+        return 0;
+
+    size_t pos = write_header(buffer, total, sequence, attribute);
+    memcpy(&buffer[pos], data, data_len);
+    pos += data_len;
+
+    uint16_t crc  = frame_crc(buffer, pos);
+    buffer[pos++] = (uint8_t)(crc >> 8);
+    buffer[pos++] = (uint8_t)(crc & 0xFF);
+    return pos;
+}
+
+
+sbus_result_t sbus_ether_parse_header(const uint8_t *buffer, size_t len, uint16_t *sequence,
+                                      sbus_attribute_t *attribute) {
+    if (len < SBUS_ETHER_HEADER_SIZE + 2)
+        return SBUS_INCOMPLETE_PACKET;
+
+    uint32_t total = ((uint32_t)buffer[0] << 24) | ((uint32_t)buffer[1] << 16) | ((uint32_t)buffer[2] << 8) |
+                     (uint32_t)buffer[3];
+    if (total != len || buffer[4] != SBUS_ETHER_VERSION || buffer[5] != SBUS_ETHER_PROTOCOL_SBUS ||
+        buffer[8] > SBUS_ATTRIBUTE_ACK)
+        return SBUS_INVALID_DATA;
+
+    *sequence  = (uint16_t)((buffer[6] << 8) | buffer[7]);
+    *attribute = (sbus_attribute_t)buffer[8];
+    return SBUS_OK;
+}
+
+
+/*
+ * Slave side: decodes a request datagram. The request length must agree with the datagram length.
+ */
+sbus_result_t sbus_ether_parse_request(const uint8_t *buffer, size_t len, uint16_t *sequence,
+                                       sbus_request_t *request) {
+    sbus_attribute_t attribute;
+    sbus_result_t    res = sbus_ether_parse_header(buffer, len, sequence, &attribute);
+    if (res != SBUS_OK)
+        return res;
+    if (attribute != SBUS_ATTRIBUTE_REQUEST || len < SBUS_ETHER_HEADER_SIZE + 2 + 2)
+        return SBUS_INVALID_DATA;
+
+    const uint8_t *telegram = &buffer[SBUS_ETHER_HEADER_SIZE];
+    size_t         data_len = len - SBUS_ETHER_HEADER_SIZE - 2 - 2;
+    size_t         required = 0;
+
+    res = sbus_packet_request_data_length(telegram[1], &telegram[2], data_len, &required);
+    if (res == SBUS_INCOMPLETE_PACKET || (res == SBUS_OK && required != data_len))
+        return SBUS_INVALID_DATA;
+    else if (res != SBUS_OK)
+        return res;
+
+    request->destination = telegram[0];
+    request->command     = telegram[1];
+    request->data_len    = (uint8_t)data_len;
+    memcpy(request->data, &telegram[2], data_len);
+
+    uint16_t found_crc = (uint16_t)((buffer[len - 2] << 8) | buffer[len - 1]);
+    return frame_crc(buffer, len - 2) == found_crc ? SBUS_OK : SBUS_WRONG_CRC;
+}
+
+
+/*
+ * Master side: checks a reply datagram (whose sequence number was already matched) against `request`. The telegram
+ * is copied to `response` in the same form the serial validators accept: response data followed by the CRC, or
+ * SBUS_ACK/SBUS_NAK followed by 0x00 for ACK telegrams. `response` must hold at least 256 bytes.
+ */
+sbus_result_t sbus_ether_validate_response(sbus_request_t *request, uint8_t *buffer, size_t len, uint8_t *response,
+                                           size_t *response_len) {
+    uint16_t         sequence;
+    sbus_attribute_t attribute;
+    sbus_result_t    res = sbus_ether_parse_header(buffer, len, &sequence, &attribute);
+
+    *response_len = 0;
+    if (res != SBUS_OK)
+        return res;
+
+    size_t telegram_len = len - SBUS_ETHER_HEADER_SIZE;
+
+    switch (attribute) {
+        case SBUS_ATTRIBUTE_RESPONSE: {
+            uint16_t crc = sbus_crc16_update_8bit(sbus_crc16_init(), buffer, SBUS_ETHER_HEADER_SIZE);
+            if (telegram_len != sbus_packet_response_length(request) || telegram_len > 256)
+                return SBUS_INVALID_DATA;
+
+            memcpy(response, &buffer[SBUS_ETHER_HEADER_SIZE], telegram_len);
+            *response_len = telegram_len;
+            return sbus_packet_validate_response_8bit_crc(request, crc, response, response_len);
+        }
+
+        case SBUS_ATTRIBUTE_ACK: {
+            uint16_t found_crc = (uint16_t)((buffer[len - 2] << 8) | buffer[len - 1]);
+            if (telegram_len != 2 + 2)
+                return SBUS_INVALID_DATA;
+            if (frame_crc(buffer, len - 2) != found_crc)
+                return SBUS_WRONG_CRC;
+
+            uint16_t code = (uint16_t)((buffer[SBUS_ETHER_HEADER_SIZE] << 8) | buffer[SBUS_ETHER_HEADER_SIZE + 1]);
+            response[0]   = code == SBUS_ETHER_ACK_CODE ? SBUS_ACK : SBUS_NAK;
+            response[1]   = 0x00;
+            *response_len = 2;
+
+            // Reads are refused with a NAK telegram, which carries no data
+            if (sbus_packet_response_length(request) != 2)
+                return SBUS_INVALID_DATA;
+            return sbus_packet_validate_response_8bit(request, response, response_len);
+        }
+
+        default:
+            return SBUS_INVALID_DATA;
+    }
+}
+
+
+static size_t write_header(uint8_t *buffer, size_t total, uint16_t sequence, sbus_attribute_t attribute) {
+    buffer[0] = (uint8_t)((total >> 24) & 0xFF);
+    buffer[1] = (uint8_t)((total >> 16) & 0xFF);
+    buffer[2] = (uint8_t)((total >> 8) & 0xFF);
+    buffer[3] = (uint8_t)(total & 0xFF);
+    buffer[4] = SBUS_ETHER_VERSION;
+    buffer[5] = SBUS_ETHER_PROTOCOL_SBUS;
+    buffer[6] = (uint8_t)(sequence >> 8);
+    buffer[7] = (uint8_t)(sequence & 0xFF);
+    buffer[8] = (uint8_t)attribute;
+    return SBUS_ETHER_HEADER_SIZE;
+}
+
+
+static uint16_t frame_crc(const uint8_t *buffer, size_t len) {
+    return sbus_crc16_final(sbus_crc16_update_8bit(sbus_crc16_init(), buffer, len));
+}
@@ -0,0 +1,36 @@
+#ifndef SBUS_ETHER_H_INCLUDED
+#define SBUS_ETHER_H_INCLUDED
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "datamode.h"
+#include "packet.h"
+
+/*
+ * Ether-S-Bus: every S-Bus telegram travels in a UDP datagram behind a 9 byte header
+ *  <length:4> <version:1> <protocol:1> <sequence:2> <attribute:1>
+ * where `length` counts the whole datagram and the attribute has the same values as in data mode. The CRC at the
+ * end covers the header as well.
+ */
+#define SBUS_ETHER_PORT           5050
+#define SBUS_ETHER_HEADER_SIZE    9
+#define SBUS_ETHER_VERSION        1
+#define SBUS_ETHER_PROTOCOL_SBUS  0
+#define SBUS_ETHER_MAX_DATAGRAM   (SBUS_ETHER_HEADER_SIZE + 2 + 256 + 2)
+
+#define SBUS_ETHER_ACK_CODE 0x0000     // Any other code in an ACK telegram is a NAK
+
+
+size_t        sbus_ether_serialize_request(uint8_t *buffer, size_t len, uint16_t sequence,
+                                           const sbus_request_t *request);
+size_t        sbus_ether_serialize_response(uint8_t *buffer, size_t len, uint16_t sequence, sbus_attribute_t attribute,
+                                            const uint8_t *data, size_t data_len);
+sbus_result_t sbus_ether_parse_header(const uint8_t *buffer, size_t len, uint16_t *sequence,
+                                      sbus_attribute_t *attribute);
+sbus_result_t sbus_ether_parse_request(const uint8_t *buffer, size_t len, uint16_t *sequence,
+                                       sbus_request_t *request);
+sbus_result_t sbus_ether_validate_response(sbus_request_t *request, uint8_t *buffer, size_t len, uint8_t *response,
+                                           size_t *response_len);
+
+#endif
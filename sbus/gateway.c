@@ -0,0 +1,600 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "decode.h"
+#include "gateway.h"
+#include "packet.h"
+#include "planner.h"
+
+
+#define MBAP_LEN        7
+#define DATA_OFFSET     9      // Response data: MBAP, function code, byte count
+#define WRITE_OFFSET    13     // Request data of multiple writes: MBAP, function, address, quantity, byte count
+#define MAX_READ_COILS  2000
+#define MAX_READ_WORDS  125
+#define MAX_WRITE_COILS 1968
+#define MAX_WRITE_WORDS 123
+
+static uint8_t       accept(sbus_gateway_t *gateway, void *client, const uint8_t *adu, size_t len);
+static int           attach_reads(sbus_gateway_t *gateway, sbus_gateway_call_t *call);
+static size_t        join_read(sbus_gateway_t *gateway, const sbus_gateway_call_t *call, uint32_t cursor,
+                               uint32_t last);
+static int           written_after(const sbus_gateway_t *gateway, const sbus_gateway_read_t *read, uint32_t first,
+                                   uint32_t last);
+static size_t        new_read(sbus_gateway_t *gateway, const sbus_gateway_call_t *call, uint32_t cursor, uint32_t last);
+static void          release_reads(sbus_gateway_t *gateway, sbus_gateway_call_t *call);
+static void          close_reads(sbus_gateway_t *gateway, const sbus_gateway_call_t *call);
+static sbus_result_t write_frame(sbus_gateway_t *gateway, sbus_gateway_call_t *call, sbus_request_t *request);
+static void          scatter(const sbus_gateway_t *gateway, sbus_gateway_call_t *call, const sbus_gateway_read_t *read);
+static void          finish_call(sbus_gateway_t *gateway, sbus_gateway_call_t *call);
+static size_t        exception_response(uint8_t *adu, uint8_t code);
+static uint8_t       exception_code(sbus_result_t result);
+static int           before(uint32_t a, uint32_t b);
+static uint16_t      be16(const uint8_t *bytes);
+
+
+sbus_result_t sbus_gateway_init(sbus_gateway_t *gateway, const sbus_gateway_config_t *config,
+                                sbus_gateway_read_t *reads, size_t num_reads, sbus_gateway_call_t *calls,
+                                size_t num_calls) {
+    if (reads == NULL || num_reads == 0 || calls == NULL || num_calls == 0 ||
+        (config->register_words != 1 && config->register_words != 2))
+        return SBUS_INVALID_ARGS;
+
+    memset(gateway, 0, sizeof(sbus_gateway_t));
+    gateway->config    = *config;
+    gateway->reads     = reads;
+    gateway->num_reads = num_reads;
+    gateway->calls     = calls;
+    gateway->num_calls = num_calls;
+    memset(reads, 0, num_reads * sizeof(sbus_gateway_read_t));
+    memset(calls, 0, num_calls * sizeof(sbus_gateway_call_t));
+
+    return SBUS_OK;
+}
+
+
+/*
+ * Takes the Modbus TCP request at the beginning of `buffer`, `len` bytes long. SBUS_INCOMPLETE_PACKET if more bytes
+ * are needed; SBUS_INVALID_DATA if the stream is not Modbus TCP, in which case the connection should be dropped.
+ * On SBUS_OK `len` is set to the length of the request, which is either queued or already answered with an
+ * exception.
+ */
+sbus_result_t sbus_gateway_submit(sbus_gateway_t *gateway, void *client, const uint8_t *buffer, size_t *len) {
+    if (*len < MBAP_LEN + 1)
+        return SBUS_INCOMPLETE_PACKET;
+
+    // <transaction> <protocol> <length> <unit> <function> ...
+    size_t length = be16(&buffer[4]);
+    if (be16(&buffer[2]) != 0 || length < 2 || length > SBUS_MODBUS_MAX_ADU - 6)
+        return SBUS_INVALID_DATA;
+    if (*len < 6 + length)
+        return SBUS_INCOMPLETE_PACKET;
+
+    *len = 6 + length;
+    gateway->requests++;
+
+    uint8_t code = accept(gateway, client, buffer, *len);
+    if (code != 0) {
+        uint8_t adu[DATA_OFFSET];
+        memcpy(adu, buffer, MBAP_LEN + 1);
+        gateway->exceptions++;
+        if (gateway->reply != NULL)
+            gateway->reply(gateway, client, adu, exception_response(adu, code));
+    }
+
+    return SBUS_OK;
+}
+
+
+/*
+ * The client went away: its requests are carried out all the same (others may be sharing their reads), but not
+ * answered.
+ */
+void sbus_gateway_forget(sbus_gateway_t *gateway, void *client) {
+    for (size_t i = 0; i < gateway->num_calls; i++) {
+        if (gateway->calls[i].client == client)
+            gateway->calls[i].client = NULL;
+    }
+}
+
+
+/*
+ * Hands out the oldest S-Bus exchange waiting to be sent; SBUS_NOT_FOUND if there is none.
+ */
+sbus_result_t sbus_gateway_next(sbus_gateway_t *gateway, sbus_gateway_exchange_t *exchange, sbus_request_t *request) {
+    int      found = 0;
+    uint32_t order = 0;
+
+    for (size_t i = 0; i < gateway->num_reads; i++) {
+        sbus_gateway_read_t *read = &gateway->reads[i];
+        if (read->state == SBUS_GATEWAY_READ_PENDING && (!found || before(read->order, order))) {
+            *exchange = (sbus_gateway_exchange_t){.write = 0, .index = i};
+            order     = read->order;
+            found     = 1;
+        }
+    }
+    for (size_t i = 0; i < gateway->num_calls; i++) {
+        sbus_gateway_call_t *call = &gateway->calls[i];
+        if (call->state == SBUS_GATEWAY_CALL_WRITING && (!found || before(call->order, order))) {
+            *exchange = (sbus_gateway_exchange_t){.write = 1, .index = i};
+            order     = call->order;
+            found     = 1;
+        }
+    }
+
+    if (!found)
+        return SBUS_NOT_FOUND;
+
+    if (exchange->write) {
+        sbus_gateway_call_t *call   = &gateway->calls[exchange->index];
+        sbus_result_t        result = write_frame(gateway, call, request);
+
+        if (result != SBUS_OK) {
+            // A frame that cannot be built is never sent: the write fails and the next exchange goes instead
+            call->exception = exception_code(result);
+            finish_call(gateway, call);
+            return sbus_gateway_next(gateway, exchange, request);
+        }
+        gateway->writes_sent++;
+    } else {
+        sbus_gateway_read_t *read  = &gateway->reads[exchange->index];
+        sbus_read_frame_t    frame = {.station = read->station,
+                                      .media   = (sbus_media_type_t)read->media,
+                                      .start   = read->start,
+                                      .count   = read->count};
+
+        sbus_planner_frame_request(&frame, request);
+        read->state = SBUS_GATEWAY_READ_IN_FLIGHT;
+        gateway->reads_sent++;
+    }
+    return SBUS_OK;
+}
+
+
+/*
+ * Hands back the outcome of `exchange`: the validation result and the response data (values, packed bits or the
+ * acknowledge character). Modbus requests that are complete are answered through `reply` from here.
+ */
+void sbus_gateway_complete(sbus_gateway_t *gateway, const sbus_gateway_exchange_t *exchange, sbus_result_t result,
+                           const uint8_t *response, size_t len) {
+    if (exchange->write) {
+        sbus_gateway_call_t *call = &gateway->calls[exchange->index];
+
+        if (result == SBUS_OK && len > 0 && response[0] == SBUS_ACK) {
+            call->done += call->frame;
+            call->state = SBUS_GATEWAY_CALL_WRITING;
+        } else {
+            // A refused frame stops the write; the frames before it stay written
+            call->exception = exception_code(result);
+        }
+        if (call->exception != 0 || call->done == call->count)
+            finish_call(gateway, call);
+        return;
+    }
+
+    sbus_gateway_read_t *read = &gateway->reads[exchange->index];
+    size_t               size = sbus_media_is_bit((sbus_media_type_t)read->media) ? SBUS_FIO_BYTES((size_t)read->count)
+                                                                                  : (size_t)read->count * 4;
+    if (result == SBUS_OK && len < size)
+        result = SBUS_INVALID_DATA;
+    if (result == SBUS_OK)
+        memcpy(read->data, response, size);
+
+    for (size_t i = 0; i < gateway->num_calls; i++) {
+        sbus_gateway_call_t *call    = &gateway->calls[i];
+        size_t               waiting = 0;
+
+        if (call->state != SBUS_GATEWAY_CALL_READING)
+            continue;
+
+        for (size_t j = 0; j < call->num_parts; j++) {
+            if (call->parts[j] == exchange->index) {
+                if (result == SBUS_OK)
+                    scatter(gateway, call, read);
+                else if (call->exception == 0)
+                    call->exception = exception_code(result);
+                call->parts[j] = SIZE_MAX;
+            }
+            waiting += call->parts[j] != SIZE_MAX;
+        }
+        if (waiting == 0)
+            finish_call(gateway, call);
+    }
+
+    read->state = 0;
+}
+
+
+/*
+ * Validates a request and queues it; the result is the exception to answer with, 0 if it was queued.
+ */
+static uint8_t accept(sbus_gateway_t *gateway, void *client, const uint8_t *adu, size_t len) {
+    const uint8_t *pdu      = &adu[MBAP_LEN];
+    size_t         pdu_len  = len - MBAP_LEN;
+    uint8_t        words    = gateway->config.register_words;
+    uint32_t       address  = pdu_len >= 5 ? be16(&pdu[1]) : 0;
+    uint32_t       quantity = pdu_len >= 5 ? be16(&pdu[3]) : 0;
+    uint32_t       start    = address;
+    uint32_t       count    = quantity;
+
+    switch (pdu[0]) {
+        case SBUS_MODBUS_READ_COILS:
+        case SBUS_MODBUS_WRITE_MULTIPLE_COILS: {
+            int read = pdu[0] == SBUS_MODBUS_READ_COILS;
+            if (pdu_len < 5 || quantity == 0 || quantity > (read ? MAX_READ_COILS : MAX_WRITE_COILS))
+                return SBUS_MODBUS_ILLEGAL_DATA_VALUE;
+            if (!read && (pdu_len < 6 || pdu[5] != SBUS_FIO_BYTES(quantity) || pdu_len != 6u + pdu[5]))
+                return SBUS_MODBUS_ILLEGAL_DATA_VALUE;
+            break;
+        }
+
+        case SBUS_MODBUS_READ_HOLDING_REGISTERS:
+        case SBUS_MODBUS_WRITE_MULTIPLE_REGISTERS: {
+            int read = pdu[0] == SBUS_MODBUS_READ_HOLDING_REGISTERS;
+            if (pdu_len < 5 || quantity == 0 || quantity > (read ? MAX_READ_WORDS : MAX_WRITE_WORDS))
+                return SBUS_MODBUS_ILLEGAL_DATA_VALUE;
+            if (!read && (pdu_len < 6 || pdu[5] != quantity * 2 || pdu_len != 6u + pdu[5]))
+                return SBUS_MODBUS_ILLEGAL_DATA_VALUE;
+            // Writes must not leave half of an S-Bus register to guess
+            if (!read && (address % words != 0 || quantity % words != 0))
+                return SBUS_MODBUS_ILLEGAL_DATA_ADDRESS;
+            start = address / words;
+            count = (address + quantity - 1) / words - start + 1;
+            break;
+        }
+
+        case SBUS_MODBUS_WRITE_SINGLE_COIL:
+            if (pdu_len != 5 || (quantity != 0xFF00 && quantity != 0x0000))
+                return SBUS_MODBUS_ILLEGAL_DATA_VALUE;
+            count    = 1;
+            quantity = 1;
+            break;
+
+        case SBUS_MODBUS_WRITE_SINGLE_REGISTER:
+            if (pdu_len != 5)
+                return SBUS_MODBUS_ILLEGAL_DATA_VALUE;
+            if (words != 1)
+                return SBUS_MODBUS_ILLEGAL_DATA_ADDRESS;
+            count    = 1;
+            quantity = 1;
+            break;
+
+        default:
+            return SBUS_MODBUS_ILLEGAL_FUNCTION;
+    }
+
+    if (address + quantity > UINT16_MAX + 1)
+        return SBUS_MODBUS_ILLEGAL_DATA_ADDRESS;
+    if (adu[6] == SBUS_BROADCAST_ADDRESS)
+        return SBUS_MODBUS_GATEWAY_PATH_UNAVAILABLE;
+
+    sbus_gateway_call_t *call = NULL;
+    for (size_t i = 0; i < gateway->num_calls && call == NULL; i++) {
+        if (gateway->calls[i].state == 0)
+            call = &gateway->calls[i];
+    }
+    if (call == NULL)
+        return SBUS_MODBUS_SERVER_DEVICE_BUSY;
+
+    memset(call, 0, sizeof(sbus_gateway_call_t));
+    memcpy(call->adu, adu, len);
+    call->client   = client;
+    call->function = pdu[0];
+    call->station  = adu[6];
+    call->media    = pdu[0] == SBUS_MODBUS_READ_COILS || pdu[0] == SBUS_MODBUS_WRITE_SINGLE_COIL ||
+                           pdu[0] == SBUS_MODBUS_WRITE_MULTIPLE_COILS
+                       ? SBUS_MEDIA_FLAG
+                       : SBUS_MEDIA_REGISTER;
+    call->address  = (uint16_t)address;
+    call->quantity = (uint16_t)quantity;
+    call->start    = (uint16_t)start;
+    call->count    = (uint16_t)count;
+
+    switch (pdu[0]) {
+        case SBUS_MODBUS_READ_COILS:
+        case SBUS_MODBUS_READ_HOLDING_REGISTERS:
+            // The response is built in place, bits are or-ed into it
+            memset(&call->adu[DATA_OFFSET - 1], 0, sizeof(call->adu) - (DATA_OFFSET - 1));
+            if (attach_reads(gateway, call) < 0) {
+                release_reads(gateway, call);
+                return SBUS_MODBUS_SERVER_DEVICE_BUSY;
+            }
+            call->state = SBUS_GATEWAY_CALL_READING;
+            return 0;
+
+        case SBUS_MODBUS_WRITE_SINGLE_COIL:
+            call->adu[WRITE_OFFSET] = pdu[3] != 0;
+            break;
+
+        case SBUS_MODBUS_WRITE_SINGLE_REGISTER:
+            // Zero extended, like every value written with single word registers
+            call->adu[WRITE_OFFSET]     = 0;
+            call->adu[WRITE_OFFSET + 1] = 0;
+            call->adu[WRITE_OFFSET + 2] = pdu[3];
+            call->adu[WRITE_OFFSET + 3] = pdu[4];
+            break;
+
+        default:
+            break;
+    }
+
+    close_reads(gateway, call);
+    call->order = gateway->order++;
+    call->state = SBUS_GATEWAY_CALL_WRITING;
+    return 0;
+}
+
+
+/*
+ * Covers the S-Bus range of a read request with shared reads: one that already covers the next address, one still
+ * queued that can grow to it, or a new one. -1 if the reads or the parts run out.
+ */
+static int attach_reads(sbus_gateway_t *gateway, sbus_gateway_call_t *call) {
+    uint32_t cursor = call->start;
+    uint32_t last   = (uint32_t)call->start + call->count - 1;
+
+    while (cursor <= last) {
+        if (call->num_parts == SBUS_GATEWAY_PARTS)
+            return -1;
+
+        size_t index = join_read(gateway, call, cursor, last);
+        if (index == SIZE_MAX && (index = new_read(gateway, call, cursor, last)) == SIZE_MAX)
+            return -1;
+
+        sbus_gateway_read_t *read = &gateway->reads[index];
+        // A queued read of this very request may just have grown further
+        if (call->num_parts == 0 || call->parts[call->num_parts - 1] != index) {
+            gateway->collapsed += read->waiters > 0;
+            read->waiters++;
+            call->parts[call->num_parts++] = index;
+        }
+        cursor = (uint32_t)read->start + read->count;
+    }
+
+    return 0;
+}
+
+
+/*
+ * A read of the same station and media that covers `cursor`, or that is still queued and can be extended to it
+ * without going past the frame limit nor into a write queued after it; SIZE_MAX if there is none.
+ */
+static size_t join_read(sbus_gateway_t *gateway, const sbus_gateway_call_t *call, uint32_t cursor, uint32_t last) {
+    size_t max = sbus_media_max_count((sbus_media_type_t)call->media);
+
+    for (size_t i = 0; i < gateway->num_reads; i++) {
+        sbus_gateway_read_t *read = &gateway->reads[i];
+        if (read->state == 0 || read->closed || read->station != call->station || read->media != call->media)
+            continue;
+
+        uint32_t start = read->start;
+        uint32_t end   = start + read->count - 1;
+
+        if (start <= cursor && cursor <= end)
+            return i;
+        if (read->state != SBUS_GATEWAY_READ_PENDING)
+            continue;
+
+        if (end + 1 == cursor && start + max - 1 >= cursor) {
+            // Grows upwards, as far as the request and the frame go
+            uint32_t new_end = last < start + max - 1 ? last : start + max - 1;
+            if (written_after(gateway, read, cursor, new_end))
+                continue;
+            read->count = (uint8_t)(new_end - start + 1);
+            return i;
+        }
+        if (start > cursor && start <= last + 1 && end - cursor + 1 <= max &&
+            !written_after(gateway, read, cursor, start - 1)) {
+            // Grows downwards, the range before it being the request's
+            read->start = (uint16_t)cursor;
+            read->count = (uint8_t)(end - cursor + 1);
+            return i;
+        }
+    }
+
+    return SIZE_MAX;
+}
+
+
+/*
+ * Whether a write submitted after `read` touches `first`-`last`: growing the read there would send it the old values
+ * while it goes out before the write.
+ */
+static int written_after(const sbus_gateway_t *gateway, const sbus_gateway_read_t *read, uint32_t first,
+                         uint32_t last) {
+    for (size_t i = 0; i < gateway->num_calls; i++) {
+        const sbus_gateway_call_t *call = &gateway->calls[i];
+        if ((call->state == SBUS_GATEWAY_CALL_WRITING || call->state == SBUS_GATEWAY_CALL_WRITE_IN_FLIGHT) &&
+            call->station == read->station && call->media == read->media && before(read->order, call->order) &&
+            call->start <= last && first < (uint32_t)call->start + call->count)
+            return 1;
+    }
+
+    return 0;
+}
+
+
+static size_t new_read(sbus_gateway_t *gateway, const sbus_gateway_call_t *call, uint32_t cursor, uint32_t last) {
+    size_t max = sbus_media_max_count((sbus_media_type_t)call->media);
+
+    for (size_t i = 0; i < gateway->num_reads; i++) {
+        sbus_gateway_read_t *read = &gateway->reads[i];
+        if (read->state != 0)
+            continue;
+
+        memset(read, 0, sizeof(sbus_gateway_read_t));
+        read->state   = SBUS_GATEWAY_READ_PENDING;
+        read->station = call->station;
+        read->media   = call->media;
+        read->start   = (uint16_t)cursor;
+        read->count   = (uint8_t)(last - cursor + 1 < max ? last - cursor + 1 : max);
+        read->order   = gateway->order++;
+        return i;
+    }
+
+    return SIZE_MAX;
+}
+
+
+static void release_reads(sbus_gateway_t *gateway, sbus_gateway_call_t *call) {
+    for (size_t i = 0; i < call->num_parts; i++) {
+        sbus_gateway_read_t *read = &gateway->reads[call->parts[i]];
+        if (--read->waiters == 0 && read->state == SBUS_GATEWAY_READ_PENDING)
+            read->state = 0;
+    }
+    call->num_parts = 0;
+}
+
+
+/*
+ * Reads overlapping a write may have been (or be) sent before it: they keep their waiters but take no more.
+ */
+static void close_reads(sbus_gateway_t *gateway, const sbus_gateway_call_t *call) {
+    for (size_t i = 0; i < gateway->num_reads; i++) {
+        sbus_gateway_read_t *read = &gateway->reads[i];
+        if (read->state != 0 && read->station == call->station && read->media == call->media &&
+            read->start < call->start + call->count && call->start < read->start + read->count)
+            read->closed = 1;
+    }
+}
+
+
+/*
+ * Next frame of a write request, as many elements as fit, addressed to the station of the call.
+ */
+static sbus_result_t write_frame(sbus_gateway_t *gateway, sbus_gateway_call_t *call, sbus_request_t *request) {
+    sbus_media_type_t media     = (sbus_media_type_t)call->media;
+    size_t            remaining = (size_t)call->count - call->done;
+    uint16_t          start     = (uint16_t)(call->start + call->done);
+    size_t            count;
+    sbus_result_t     result;
+
+    if (sbus_media_is_bit(media)) {
+        // Frames hold a multiple of 8 bits, so each one starts on a byte of the request
+        count  = remaining < SBUS_MAX_BITS_PER_WRITE ? remaining : SBUS_MAX_BITS_PER_WRITE;
+        result = sbus_packet_write_bits_request(call->station, media, start,
+                                                &call->adu[WRITE_OFFSET + SBUS_FIO_BYTE(call->done)], count, request);
+    } else {
+        uint32_t values[SBUS_MAX_VALUES_PER_FRAME];
+        count = remaining < SBUS_MAX_VALUES_PER_FRAME ? remaining : SBUS_MAX_VALUES_PER_FRAME;
+
+        if (gateway->config.register_words == 2 || call->function == SBUS_MODBUS_WRITE_SINGLE_REGISTER) {
+            sbus_decode_be32_8bit(&call->adu[WRITE_OFFSET + call->done * 4], count, values);
+        } else {
+            for (size_t i = 0; i < count; i++)
+                values[i] = be16(&call->adu[WRITE_OFFSET + (call->done + i) * 2]);
+        }
+        result = sbus_packet_write_values_request(call->station, media, start, values, count, request);
+    }
+
+    if (result == SBUS_OK) {
+        call->frame = (uint8_t)count;
+        call->state = SBUS_GATEWAY_CALL_WRITE_IN_FLIGHT;
+    }
+    return result;
+}
+
+
+/*
+ * Copies the part of `read` that the read request asked for into its response.
+ */
+static void scatter(const sbus_gateway_t *gateway, sbus_gateway_call_t *call, const sbus_gateway_read_t *read) {
+    uint32_t first = read->start > call->start ? read->start : call->start;
+    uint32_t last  = (uint32_t)read->start + read->count < (uint32_t)call->start + call->count
+                         ? (uint32_t)read->start + read->count - 1
+                         : (uint32_t)call->start + call->count - 1;
+    uint8_t *data  = &call->adu[DATA_OFFSET];
+
+    for (uint32_t element = first; element <= last; element++) {
+        size_t offset = element - read->start;
+
+        if (call->media == SBUS_MEDIA_FLAG) {
+            size_t bit = element - call->address;
+            if (read->data[SBUS_FIO_BYTE(offset)] & SBUS_FIO_MASK(offset))
+                data[SBUS_FIO_BYTE(bit)] |= SBUS_FIO_MASK(bit);
+            continue;
+        }
+
+        uint32_t value;
+        sbus_decode_be32_8bit(&read->data[offset * 4], 1, &value);
+        for (uint32_t word = 0; word < gateway->config.register_words; word++) {
+            uint32_t address = element * gateway->config.register_words + word;
+            if (address < call->address || address >= (uint32_t)call->address + call->quantity)
+                continue;
+
+            // High word first
+            uint16_t half = (uint16_t)(gateway->config.register_words == 2 && word == 0 ? value >> 16 : value);
+            data[(address - call->address) * 2]     = (uint8_t)(half >> 8);
+            data[(address - call->address) * 2 + 1] = (uint8_t)half;
+        }
+    }
+}
+
+
+static void finish_call(sbus_gateway_t *gateway, sbus_gateway_call_t *call) {
+    uint8_t *adu = call->adu;
+    size_t   len;
+
+    if (call->exception != 0) {
+        len = exception_response(adu, call->exception);
+        gateway->exceptions++;
+    } else {
+        switch (call->function) {
+            case SBUS_MODBUS_READ_COILS:
+                adu[DATA_OFFSET - 1] = (uint8_t)SBUS_FIO_BYTES(call->quantity);
+                len                  = DATA_OFFSET + adu[DATA_OFFSET - 1];
+                break;
+            case SBUS_MODBUS_READ_HOLDING_REGISTERS:
+                adu[DATA_OFFSET - 1] = (uint8_t)(call->quantity * 2);
+                len                  = DATA_OFFSET + adu[DATA_OFFSET - 1];
+                break;
+            default:
+                // Writes echo the address and the quantity (or the value) of the request
+                len = MBAP_LEN + 5;
+                break;
+        }
+        adu[4] = (uint8_t)((len - 6) >> 8);
+        adu[5] = (uint8_t)(len - 6);
+    }
+
+    if (call->client != NULL && gateway->reply != NULL)
+        gateway->reply(gateway, call->client, adu, len);
+    call->state = 0;
+}
+
+
+static size_t exception_response(uint8_t *adu, uint8_t code) {
+    adu[4] = 0;
+    adu[5] = 3;
+    adu[7] |= 0x80;
+    adu[8] = code;
+    return DATA_OFFSET;
+}
+
+
+static uint8_t exception_code(sbus_result_t result) {
+    switch (result) {
+        case SBUS_OK:     // Answered with NAK
+        case SBUS_INVALID_DATA:
+            return SBUS_MODBUS_ILLEGAL_DATA_ADDRESS;
+        case SBUS_TIMEOUT:
+        case SBUS_WRONG_CRC:
+        case SBUS_INCOMPLETE_PACKET:
+        case SBUS_IO_ERROR:
+            return SBUS_MODBUS_GATEWAY_TARGET_FAILED;
+        default:
+            return SBUS_MODBUS_SERVER_DEVICE_FAILURE;
+    }
+}
+
+
+// Wrap-around safe comparison of submission orders
+static int before(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+
+static uint16_t be16(const uint8_t *bytes) {
+    return (uint16_t)((bytes[0] << 8) | bytes[1]);
+}
@@ -0,0 +1,140 @@
+#ifndef SBUS_GATEWAY_H_INCLUDED
+#define SBUS_GATEWAY_H_INCLUDED
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "packet.h"
+
+#define SBUS_MODBUS_PORT     502
+#define SBUS_MODBUS_MAX_ADU  260     // MBAP header (7 bytes) and a PDU of up to 253 bytes
+#define SBUS_GATEWAY_PARTS   16      // S-Bus reads a single Modbus read may wait for: 2000 coils are 16 flag reads
+
+typedef enum {
+    SBUS_MODBUS_READ_COILS               = 0x01,
+    SBUS_MODBUS_READ_HOLDING_REGISTERS   = 0x03,
+    SBUS_MODBUS_WRITE_SINGLE_COIL        = 0x05,
+    SBUS_MODBUS_WRITE_SINGLE_REGISTER    = 0x06,
+    SBUS_MODBUS_WRITE_MULTIPLE_COILS     = 0x0F,
+    SBUS_MODBUS_WRITE_MULTIPLE_REGISTERS = 0x10,
+} sbus_modbus_function_t;
+
+typedef enum {
+    SBUS_MODBUS_ILLEGAL_FUNCTION         = 0x01,
+    SBUS_MODBUS_ILLEGAL_DATA_ADDRESS     = 0x02,
+    SBUS_MODBUS_ILLEGAL_DATA_VALUE       = 0x03,
+    SBUS_MODBUS_SERVER_DEVICE_FAILURE    = 0x04,
+    SBUS_MODBUS_SERVER_DEVICE_BUSY       = 0x06,
+    SBUS_MODBUS_GATEWAY_PATH_UNAVAILABLE = 0x0A,
+    SBUS_MODBUS_GATEWAY_TARGET_FAILED    = 0x0B,
+} sbus_modbus_exception_t;
+
+typedef enum {
+    SBUS_GATEWAY_READ_PENDING = 1,
+    SBUS_GATEWAY_READ_IN_FLIGHT,
+} sbus_gateway_read_state_t;
+
+typedef enum {
+    SBUS_GATEWAY_CALL_READING = 1,       // Waiting for its S-Bus reads
+    SBUS_GATEWAY_CALL_WRITING,           // Next write frame ready to go
+    SBUS_GATEWAY_CALL_WRITE_IN_FLIGHT,
+} sbus_gateway_call_state_t;
+
+
+typedef struct {
+    // Holding registers per S-Bus register: 2 maps register `n` to holding registers `2n` (high word) and `2n + 1`
+    // (low word), and writes must cover whole registers; 1 maps it to holding register `n`, its low word only
+    uint8_t register_words;
+} sbus_gateway_config_t;
+
+
+/*
+ * An S-Bus read shared by every Modbus request that needs (part of) its range.
+ */
+typedef struct {
+    uint8_t  state;      // 0 when the entry is free
+    uint8_t  closed;     // A write to the range came after it: later reads must not join
+    uint8_t  station;
+    uint8_t  media;
+    uint16_t start;
+    uint8_t  count;
+    unsigned waiters;
+    uint32_t order;      // Submission order, reads and write frames are sent first come first served
+    uint8_t  data[SBUS_MAX_VALUES_PER_FRAME * 4];     // Response data, big endian values or packed bits
+} sbus_gateway_read_t;
+
+
+/*
+ * A Modbus request being served. `adu` holds the request and, in place, the response being built.
+ */
+typedef struct {
+    uint8_t  state;     // 0 when the entry is free
+    void    *client;    // Handed back to `reply`, NULL once the client is gone
+    uint8_t  function;
+    uint8_t  station;
+    uint8_t  media;
+    uint8_t  exception;     // First failure, 0 if none
+    uint16_t address;       // Modbus address and quantity
+    uint16_t quantity;
+    uint16_t start;         // S-Bus range
+    uint16_t count;
+    uint16_t done;          // S-Bus elements written so far
+    uint8_t  frame;         // Elements in the write frame in flight
+    uint32_t order;
+    size_t   parts[SBUS_GATEWAY_PARTS];     // Reads still awaited, `SIZE_MAX` once they arrived
+    size_t   num_parts;
+    uint8_t  adu[SBUS_MODBUS_MAX_ADU];
+} sbus_gateway_call_t;
+
+
+/*
+ * One S-Bus exchange handed out by `sbus_gateway_next`: a shared read, or a frame of a write request.
+ */
+typedef struct {
+    int    write;
+    size_t index;     // In `reads`, or in `calls` for write frames
+} sbus_gateway_exchange_t;
+
+
+typedef struct sbus_gateway sbus_gateway_t;
+
+/*
+ * Modbus TCP server side of a gateway to the S-Bus stations of one line: the Modbus unit identifier is the station
+ * number, holding registers map to registers and coils to flags. Concurrent reads of the same or of overlapping
+ * ranges are collapsed into a single S-Bus read whose result is handed to all of them; writes become multi-value
+ * WRITE_* frames. Writes close the reads of their range that are queued or in flight, so that a read submitted after
+ * a write always sees it.
+ *
+ * Like the writer, the gateway moves no bytes itself: the caller feeds it Modbus requests, moves the S-Bus frames
+ * on the bus (`sbus_gateway_next`, `sbus_gateway_complete`) and sends back the responses passed to `reply`. Reads
+ * and calls are provided by the caller.
+ */
+struct sbus_gateway {
+    sbus_gateway_config_t config;
+    sbus_gateway_read_t  *reads;
+    size_t                num_reads;
+    sbus_gateway_call_t  *calls;
+    size_t                num_calls;
+    uint32_t              order;
+
+    void (*reply)(sbus_gateway_t *gateway, void *client, const uint8_t *adu, size_t len);
+    void *arg;
+
+    unsigned long requests;
+    unsigned long exceptions;
+    unsigned long reads_sent;
+    unsigned long writes_sent;
+    unsigned long collapsed;     // Parts of Modbus reads served by a read somebody else asked for first
+};
+
+
+sbus_result_t sbus_gateway_init(sbus_gateway_t *gateway, const sbus_gateway_config_t *config,
+                                sbus_gateway_read_t *reads, size_t num_reads, sbus_gateway_call_t *calls,
+                                size_t num_calls);
+sbus_result_t sbus_gateway_submit(sbus_gateway_t *gateway, void *client, const uint8_t *buffer, size_t *len);
+void          sbus_gateway_forget(sbus_gateway_t *gateway, void *client);
+sbus_result_t sbus_gateway_next(sbus_gateway_t *gateway, sbus_gateway_exchange_t *exchange, sbus_request_t *request);
+void          sbus_gateway_complete(sbus_gateway_t *gateway, const sbus_gateway_exchange_t *exchange,
+                                    sbus_result_t result, const uint8_t *response, size_t len);
+
+#endif
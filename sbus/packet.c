@@ -1,15 +1,72 @@
 #include <stdlib.h>
-#include <assert.h>
+#include <string.h>
 
 #include "packet.h"
+#include "stats.h"
 
 
 #define ADDRESS_MASK  0x0100
 #define IS_ADDRESS(x) (((x)&ADDRESS_MASK) > 0)
 #define IS_DATA(x)    (!IS_ADDRESS(x))
 
-static int unpack_command(sbus_command_code_t command, uint16_t *buffer, size_t *len, sbus_request_t *request);
-static int check_data(uint16_t *buffer, size_t len);
+#define READ_VALUES(n, m)                                                                                              \
+    {.name = n, .kind = SBUS_COMMAND_KIND_READ, .has_media = 1, .media = m, .max_count = SBUS_MAX_VALUES_PER_FRAME,    \
+     .request_len = 3, .response_base = 2, .response_scale = 4}
+#define READ_BITS(n, m)                                                                                                \
+    {.name = n, .kind = SBUS_COMMAND_KIND_READ, .has_media = 1, .media = m, .max_count = SBUS_MAX_BITS_PER_FRAME,      \
+     .request_len = 3, .response_base = 2, .response_scale = 1, .response_round = 7, .response_shift = 3}
+#define READ_FIXED(n, len) {.name = n, .kind = SBUS_COMMAND_KIND_READ, .response_base = (len) + 2}
+// <w-count> <address> {<value>}+
+#define WRITE_VALUES(n, m)                                                                                             \
+    {.name = n, .kind = SBUS_COMMAND_KIND_WRITE, .has_media = 1, .media = m, .max_count = SBUS_MAX_VALUES_PER_FRAME,   \
+     .request_prefix = 1, .w_count_min = 5, .w_count_max = 129, .w_count_step = 4, .response_base = 2}
+// <w-count> <address> <fio-count> {<fio-byte>}+
+#define WRITE_BITS(n, m)                                                                                               \
+    {.name = n, .kind = SBUS_COMMAND_KIND_WRITE, .has_media = 1, .media = m, .max_count = SBUS_MAX_BITS_PER_FRAME,     \
+     .request_prefix = 4, .w_count_min = 2, .w_count_max = 17, .w_count_step = 1, .response_base = 2}
+#define WRITE_FIXED(n, len) {.name = n, .kind = SBUS_COMMAND_KIND_WRITE, .request_len = (len), .response_base = 2}
+
+// Codes that are not listed stay zeroed, i.e. SBUS_COMMAND_KIND_UNKNOWN, and are described by `unknown_command`
+static const sbus_command_descriptor_t descriptors[SBUS_COMMAND_CODES] = {
+    [SBUS_COMMAND_READ_COUNTER]          = READ_VALUES("READ_COUNTER", SBUS_MEDIA_COUNTER),
+    [SBUS_COMMAND_READ_DISPLAY_REGISTER] = READ_FIXED("READ_DISPLAY_REGISTER", 4),
+    [SBUS_COMMAND_READ_FLAG]             = READ_BITS("READ_FLAG", SBUS_MEDIA_FLAG),
+    [SBUS_COMMAND_READ_INPUT]            = READ_BITS("READ_INPUT", SBUS_MEDIA_INPUT),
+    [SBUS_COMMAND_READ_REAL_TIME_CLOCK]  = READ_FIXED("READ_REAL_TIME_CLOCK", SBUS_CLOCK_SIZE),
+    [SBUS_COMMAND_READ_OUTPUT]           = READ_BITS("READ_OUTPUT", SBUS_MEDIA_OUTPUT),
+    [SBUS_COMMAND_READ_REGISTER]         = READ_VALUES("READ_REGISTER", SBUS_MEDIA_REGISTER),
+    [SBUS_COMMAND_READ_TIMER]            = READ_VALUES("READ_TIMER", SBUS_MEDIA_TIMER),
+    [SBUS_COMMAND_WRITE_COUNTER]         = WRITE_VALUES("WRITE_COUNTER", SBUS_MEDIA_COUNTER),
+    [SBUS_COMMAND_WRITE_FLAG]            = WRITE_BITS("WRITE_FLAG", SBUS_MEDIA_FLAG),
+    [SBUS_COMMAND_WRITE_REAL_TIME_CLOCK] = WRITE_FIXED("WRITE_REAL_TIME_CLOCK", SBUS_CLOCK_SIZE),
+    [SBUS_COMMAND_WRITE_OUTPUT]          = WRITE_BITS("WRITE_OUTPUT", SBUS_MEDIA_OUTPUT),
+    [SBUS_COMMAND_WRITE_REGISTER]        = WRITE_VALUES("WRITE_REGISTER", SBUS_MEDIA_REGISTER),
+    [SBUS_COMMAND_WRITE_TIMER]           = WRITE_VALUES("WRITE_TIMER", SBUS_MEDIA_TIMER),
+    [SBUS_COMMAND_READ_PCD_STATUS_CPU_0] = READ_FIXED("READ_PCD_STATUS_CPU_0", 1),
+    [SBUS_COMMAND_READ_PCD_STATUS_CPU_1] = READ_FIXED("READ_PCD_STATUS_CPU_1", 1),
+    [SBUS_COMMAND_READ_PCD_STATUS_CPU_2] = READ_FIXED("READ_PCD_STATUS_CPU_2", 1),
+    [SBUS_COMMAND_READ_PCD_STATUS_CPU_3] = READ_FIXED("READ_PCD_STATUS_CPU_3", 1),
+    [SBUS_COMMAND_READ_PCD_STATUS_CPU_4] = READ_FIXED("READ_PCD_STATUS_CPU_4", 1),
+    [SBUS_COMMAND_READ_PCD_STATUS_CPU_5] = READ_FIXED("READ_PCD_STATUS_CPU_5", 1),
+    [SBUS_COMMAND_READ_PCD_STATUS_CPU_6] = READ_FIXED("READ_PCD_STATUS_CPU_6", 1),
+    [SBUS_COMMAND_READ_PCD_STATUS_SELF]  = READ_FIXED("READ_PCD_STATUS_SELF", 1),
+    [SBUS_COMMAND_READ_STATION_NUMBER]   = READ_FIXED("READ_STATION_NUMBER", 1),
+};
+
+static const sbus_command_descriptor_t unknown_command = {.name = "UNKNOWN", .kind = SBUS_COMMAND_KIND_UNKNOWN};
+
+static int    unpack_command(sbus_command_code_t command, uint16_t *buffer, size_t *len);
+static int    check_data(uint16_t *buffer, size_t len);
+static size_t find_marker(const uint8_t *address_map, size_t from, size_t len);
+static size_t response_length(uint8_t destination, sbus_command_code_t command, uint8_t r_count);
+static sbus_result_t validate_response_9bit(sbus_command_code_t command, size_t required_len, uint16_t *buffer,
+                                            size_t *len);
+static sbus_result_t check_response_9bit(sbus_command_code_t command, size_t required_len, uint16_t *buffer,
+                                         size_t *len);
+static sbus_result_t validate_response_8bit(sbus_command_code_t command, size_t required_len, uint16_t crc,
+                                            uint8_t *buffer, size_t *len);
+static sbus_result_t check_response_8bit(sbus_command_code_t command, size_t required_len, uint16_t crc,
+                                         uint8_t *buffer, size_t *len);
 
 
 size_t sbus_packet_serialize_request(uint16_t *buffer, const sbus_request_t *request) {
@@ -25,12 +82,82 @@ size_t sbus_packet_serialize_request(uint16_t *buffer, const sbus_request_t *req
 }
 
 
+/*
+ * Builds a write of `count` registers, counters or timers starting from `start`.
+ */
+sbus_result_t sbus_packet_write_values_request(uint8_t station, sbus_media_type_t media, uint16_t start,
+                                               const uint32_t *values, size_t count, sbus_request_t *request) {
+    if (sbus_media_is_bit(media) || count == 0 || count > SBUS_MAX_VALUES_PER_FRAME ||
+        (size_t)start + count - 1 > UINT16_MAX || sbus_media_write_command(media, &request->command) != SBUS_OK)
+        return SBUS_INVALID_ARGS;
+
+    // <w-count> <address> {<4-byte>}+
+    request->destination = station;
+    request->data_len    = (uint8_t)(3 + count * 4);
+    request->data[0]     = (uint8_t)(1 + count * 4);
+    request->data[1]     = (start >> 8) & 0xFF;
+    request->data[2]     = start & 0xFF;
+    for (size_t i = 0; i < count; i++) {
+        uint8_t *data = &request->data[3 + i * 4];
+        data[0]       = (values[i] >> 24) & 0xFF;
+        data[1]       = (values[i] >> 16) & 0xFF;
+        data[2]       = (values[i] >> 8) & 0xFF;
+        data[3]       = values[i] & 0xFF;
+    }
+
+    return SBUS_OK;
+}
+
+
+/*
+ * Builds a write of `count` flags or outputs starting from `start`; `bits` is packed with the SBUS_FIO_* layout, the
+ * first bit being the one for `start`.
+ */
+sbus_result_t sbus_packet_write_bits_request(uint8_t station, sbus_media_type_t media, uint16_t start,
+                                             const uint8_t *bits, size_t count, sbus_request_t *request) {
+    if (!sbus_media_is_bit(media) || count == 0 || count > SBUS_MAX_BITS_PER_WRITE ||
+        (size_t)start + count - 1 > UINT16_MAX || sbus_media_write_command(media, &request->command) != SBUS_OK)
+        return SBUS_INVALID_ARGS;
+
+    // <w-count> <address> <fio-count> {<fio-byte>}+
+    request->destination = station;
+    request->data_len    = (uint8_t)(4 + SBUS_FIO_BYTES(count));
+    request->data[0]     = (uint8_t)(SBUS_FIO_BYTES(count) + 2);
+    request->data[1]     = (start >> 8) & 0xFF;
+    request->data[2]     = start & 0xFF;
+    request->data[3]     = (uint8_t)(count - 1);
+    memcpy(&request->data[4], bits, SBUS_FIO_BYTES(count));
+    // Bits past `count` in the last byte are not part of the write
+    if (count % 8 != 0)
+        request->data[4 + SBUS_FIO_BYTE(count - 1)] &= (uint8_t)(SBUS_FIO_MASK(count) - 1);
+
+    return SBUS_OK;
+}
+
+
 sbus_result_t sbus_packet_parse_request(uint16_t *buffer, size_t *len, sbus_request_t *request) {
+    sbus_request_view_t view;
+    sbus_result_t       res = sbus_packet_parse_request_view(buffer, len, &view);
+
+    if (res == SBUS_OK || res == SBUS_WRONG_CRC)
+        sbus_request_view_copy(&view, request);
+
+    return res;
+}
+
+
+/*
+ * Same as `sbus_packet_parse_request`, but the request is not copied: `view` points into `buffer`, which must
+ * outlive it.
+ */
+sbus_result_t sbus_packet_parse_request_view(uint16_t *buffer, size_t *len, sbus_request_view_t *view) {
     for (size_t i = 0; i < *len; i++) {
         if (IS_ADDRESS(buffer[i])) {
             size_t  start       = i;
             uint8_t destination = (uint8_t)(buffer[start] & 0xFF);
 
+            SBUS_STATS_DISCARDED(start);
+
             if (start + 3 > *len) {
                 *len = start;
                 return SBUS_INCOMPLETE_PACKET;     // The packet is not complete yet
@@ -38,12 +165,13 @@ sbus_result_t sbus_packet_parse_request(uint16_t *buffer, size_t *len, sbus_requ
 
             if (IS_ADDRESS(buffer[start + 1])) {
                 *len = start + 1;
+                SBUS_STATS_RESULT(0, SBUS_INVALID_DATA);
                 return SBUS_INVALID_DATA;     // Invalid data
             }
 
             uint8_t command  = (uint8_t)(buffer[start + 1] & 0xFF);
             size_t  data_len = *len - (start + 2);
-            int     res      = unpack_command(command, &buffer[start + 2], &data_len, request);
+            int     res      = unpack_command(command, &buffer[start + 2], &data_len);
 
             switch (res) {
                 case SBUS_OK:
@@ -56,6 +184,8 @@ sbus_result_t sbus_packet_parse_request(uint16_t *buffer, size_t *len, sbus_requ
                 case SBUS_UNKNOWN_COMMAND:
                 case SBUS_INVALID_DATA:
                 default:
+                    SBUS_STATS_DISCARDED(*len - start);
+                    SBUS_STATS_RESULT(command, res);
                     return res;     // Do not update len; everything is to be thrown away
             }
 
@@ -64,158 +194,193 @@ sbus_result_t sbus_packet_parse_request(uint16_t *buffer, size_t *len, sbus_requ
                 return SBUS_INCOMPLETE_PACKET;     // The packet is not complete yet
             }
 
-            *len                 = start + 2 + data_len + 2;
-            uint16_t crc         = sbus_crc16_9bit(&buffer[start], *len - 2 - start);
-            uint16_t found_crc   = (uint16_t)((buffer[start + 2 + data_len] << 8) | buffer[start + 2 + data_len + 1]);
-            request->destination = destination;
-
-            if (crc != found_crc)
-                return SBUS_WRONG_CRC;
-            else
-                return SBUS_OK;
+            *len               = start + 2 + data_len + 2;
+            uint16_t crc       = sbus_crc16_9bit(&buffer[start], *len - 2 - start);
+            uint16_t found_crc = (uint16_t)((buffer[start + 2 + data_len] << 8) | buffer[start + 2 + data_len + 1]);
+            view->destination  = destination;
+            view->command      = command;
+            view->data         = &buffer[start + 2];
+            view->data_len     = (uint8_t)data_len;
+
+            res = crc != found_crc ? SBUS_WRONG_CRC : SBUS_OK;
+            SBUS_STATS_RESULT(command, res);
+            return res;
         }
     }
 
+    SBUS_STATS_DISCARDED(*len);
+    SBUS_STATS_RESULT(0, SBUS_NOT_FOUND);
     return SBUS_NOT_FOUND;
 }
 
 
-sbus_result_t sbus_packet_validate_response_9bit(sbus_request_t *request, uint16_t *buffer, size_t *len) {
-    size_t required_len = sbus_packet_response_length(request);
+/*
+ * Same as `sbus_packet_parse_request`, but for a stream of plain bytes: the address flag travels out of band in
+ * `address_map`, a packed bitmap (same bit order as flag arrays) with the bits of the bytes received with the address
+ * marker (mark parity) set. Parsing starts from character `offset` of both, and `len` counts from there.
+ */
+sbus_result_t sbus_packet_parse_request_8bit(const uint8_t *buffer, const uint8_t *address_map, size_t offset,
+                                             size_t *len, sbus_request_t *request) {
+    size_t end   = offset + *len;
+    size_t start = find_marker(address_map, offset, end);
 
-    if (required_len == 0) {
-        *len = 0;
-        return SBUS_OK;
+    SBUS_STATS_DISCARDED(start - offset);
+    if (start == end) {
+        SBUS_STATS_RESULT(0, SBUS_NOT_FOUND);
+        return SBUS_NOT_FOUND;
     }
 
-    if (*len < required_len) {
-        *len = 0;
+    if (start + 3 > end) {
+        *len = start - offset;
+        return SBUS_INCOMPLETE_PACKET;     // The packet is not complete yet
+    }
+
+    if (SBUS_ADDRESS_MAP_GET(address_map, start + 1)) {
+        *len = start + 1 - offset;
+        SBUS_STATS_RESULT(0, SBUS_INVALID_DATA);
+        return SBUS_INVALID_DATA;     // Invalid data
+    }
+
+    // Same prefix rules as the 9-bit parser: marked characters saturate so that they fail the length checks
+    uint8_t prefix[4];
+    size_t  available  = end - (start + 2);
+    size_t  prefix_len = available < sizeof(prefix) ? available : sizeof(prefix);
+    for (size_t i = 0; i < prefix_len; i++) {
+        prefix[i] = SBUS_ADDRESS_MAP_GET(address_map, start + 2 + i) ? 0xFF : buffer[start + 2 + i];
+    }
+
+    size_t        data_len = 0;
+    sbus_result_t res      = sbus_packet_request_data_length(buffer[start + 1], prefix, prefix_len, &data_len);
+    if (res == SBUS_INCOMPLETE_PACKET || (res == SBUS_OK && available < data_len)) {
+        *len = start - offset;
         return SBUS_INCOMPLETE_PACKET;
+    } else if (res != SBUS_OK) {
+        SBUS_STATS_DISCARDED(end - start);
+        SBUS_STATS_RESULT(buffer[start + 1], res);
+        return res;     // Do not update len; everything is to be thrown away
     }
 
-    int index = check_data(buffer, required_len);
-    if (index >= 0) {
-        *len = (size_t)index;
-        return SBUS_NOT_FOUND;
+    if (find_marker(address_map, start + 2, start + 2 + data_len) != start + 2 + data_len) {
+        SBUS_STATS_DISCARDED(end - start);
+        SBUS_STATS_RESULT(buffer[start + 1], SBUS_INVALID_DATA);
+        return SBUS_INVALID_DATA;
     }
 
-    switch (request->command) {
-        case SBUS_COMMAND_WRITE_COUNTER:
-        case SBUS_COMMAND_WRITE_FLAG:
-        case SBUS_COMMAND_WRITE_REAL_TIME_CLOCK:
-        case SBUS_COMMAND_WRITE_OUTPUT:
-        case SBUS_COMMAND_WRITE_REGISTER:
-        case SBUS_COMMAND_WRITE_TIMER:
-            if ((buffer[0] == SBUS_ACK || buffer[0] == SBUS_NAK) && buffer[1] == 0x00)
-                return SBUS_OK;
-            else
-                return SBUS_INVALID_DATA;
-
-        default: {
-            uint16_t crc       = sbus_crc16_9bit(buffer, required_len - 2);
-            uint16_t found_crc = (uint16_t)((buffer[required_len - 2] << 8) | buffer[required_len - 1]);
-            *len               = required_len;
-
-            if (crc != found_crc)
-                return SBUS_WRONG_CRC;
-            else
-                return SBUS_OK;
-        }
+    if (start + 2 + data_len + 2 > end) {
+        *len = start - offset;
+        return SBUS_INCOMPLETE_PACKET;     // The packet is not complete yet
     }
 
-    return SBUS_OK;
+    *len               = start + 2 + data_len + 2 - offset;
+    uint16_t crc       = sbus_crc16_final(sbus_crc16_update_8bit(sbus_crc16_init(), &buffer[start], 2 + data_len));
+    uint16_t found_crc = (uint16_t)((buffer[start + 2 + data_len] << 8) | buffer[start + 2 + data_len + 1]);
+
+    request->destination = buffer[start];
+    request->command     = buffer[start + 1];
+    request->data_len    = (uint8_t)data_len;
+    memcpy(request->data, &buffer[start + 2], data_len);
+
+    res = crc != found_crc ? SBUS_WRONG_CRC : SBUS_OK;
+    SBUS_STATS_RESULT(request->command, res);
+    return res;
 }
 
 
-sbus_result_t sbus_packet_validate_response_8bit(sbus_request_t *request, uint8_t *buffer, size_t *len) {
-    size_t required_len = sbus_packet_response_length(request);
+/*
+ * Splits a 9-bit word stream into bytes and the matching address bitmap, which must hold
+ * `SBUS_ADDRESS_MAP_BYTES(len)` bytes. The loops work on groups of eight words so that they vectorize.
+ */
+void sbus_packet_pack_9bit(const uint16_t *words, size_t len, uint8_t *bytes, uint8_t *address_map) {
+    size_t i = 0;
 
-    if (required_len == 0) {
-        *len = 0;
-        return SBUS_OK;
+    for (; i + 8 <= len; i += 8) {
+        uint8_t map = 0;
+        for (size_t j = 0; j < 8; j++) {
+            bytes[i + j] = (uint8_t)(words[i + j] & 0xFF);
+            map |= (uint8_t)(((words[i + j] >> 8) & 1) << j);
+        }
+        address_map[i / 8] = map;
     }
 
-    if (*len < required_len) {
-        *len = 0;
-        return SBUS_INCOMPLETE_PACKET;
+    if (i < len) {
+        uint8_t map = 0;
+        for (size_t j = 0; i + j < len; j++) {
+            bytes[i + j] = (uint8_t)(words[i + j] & 0xFF);
+            map |= (uint8_t)(((words[i + j] >> 8) & 1) << j);
+        }
+        address_map[i / 8] = map;
     }
+}
 
-    switch (request->command) {
-        case SBUS_COMMAND_WRITE_COUNTER:
-        case SBUS_COMMAND_WRITE_FLAG:
-        case SBUS_COMMAND_WRITE_REAL_TIME_CLOCK:
-        case SBUS_COMMAND_WRITE_OUTPUT:
-        case SBUS_COMMAND_WRITE_REGISTER:
-        case SBUS_COMMAND_WRITE_TIMER:
-            if ((buffer[0] == SBUS_ACK || buffer[0] == SBUS_NAK) && buffer[1] == 0x00) {
-                return SBUS_OK;
-            } else {
-                return SBUS_INVALID_DATA;
-            }
 
-        default: {
-            uint16_t crc       = sbus_crc16_8bit(buffer, required_len - 2);
-            uint16_t found_crc = (uint16_t)((buffer[required_len - 2] << 8) | buffer[required_len - 1]);
-            *len               = required_len;
+/*
+ * Inverse of `sbus_packet_pack_9bit`.
+ */
+void sbus_packet_unpack_9bit(const uint8_t *bytes, const uint8_t *address_map, size_t len, uint16_t *words) {
+    size_t i = 0;
 
-            if (crc != found_crc)
-                return SBUS_WRONG_CRC;
-            else
-                return SBUS_OK;
+    for (; i + 8 <= len; i += 8) {
+        uint8_t map = address_map[i / 8];
+        for (size_t j = 0; j < 8; j++) {
+            words[i + j] = (uint16_t)(bytes[i + j] | (((map >> j) & 1) << 8));
         }
     }
 
-    return SBUS_OK;
+    for (; i < len; i++) {
+        words[i] = (uint16_t)(bytes[i] | (SBUS_ADDRESS_MAP_GET(address_map, i) << 8));
+    }
 }
 
 
+void sbus_request_view_copy(const sbus_request_view_t *view, sbus_request_t *request) {
+    request->destination = view->destination;
+    request->command     = view->command;
+    request->data_len    = view->data_len;
+    for (size_t i = 0; i < view->data_len; i++) {
+        request->data[i] = (uint8_t)view->data[i];
+    }
+}
 
-size_t sbus_packet_response_length(sbus_request_t *request) {
-    if (request->destination == SBUS_BROADCAST_ADDRESS)     // No answer to broadcast messages
-        return 0;
 
-    switch (request->command) {
-        case SBUS_COMMAND_READ_COUNTER:
-        case SBUS_COMMAND_READ_REGISTER:
-        case SBUS_COMMAND_READ_TIMER:
-            return (SBUS_PACKET_R_COUNT(request) + 1) * 4 + 2;
-
-        case SBUS_COMMAND_READ_DISPLAY_REGISTER:
-            return 4 + 2;
-
-        case SBUS_COMMAND_READ_FLAG:
-        case SBUS_COMMAND_READ_INPUT:
-        case SBUS_COMMAND_READ_OUTPUT:
-            return (SBUS_PACKET_R_COUNT(request) + 1) / 8 + 2;
-
-        case SBUS_COMMAND_READ_REAL_TIME_CLOCK:
-            return 6 + 2;
-
-        case SBUS_COMMAND_WRITE_COUNTER:
-        case SBUS_COMMAND_WRITE_FLAG:
-        case SBUS_COMMAND_WRITE_REAL_TIME_CLOCK:
-        case SBUS_COMMAND_WRITE_OUTPUT:
-        case SBUS_COMMAND_WRITE_REGISTER:
-        case SBUS_COMMAND_WRITE_TIMER:
-            return 2;
-
-        case SBUS_COMMAND_READ_PCD_STATUS_CPU_0:
-        case SBUS_COMMAND_READ_PCD_STATUS_CPU_1:
-        case SBUS_COMMAND_READ_PCD_STATUS_CPU_2:
-        case SBUS_COMMAND_READ_PCD_STATUS_CPU_3:
-        case SBUS_COMMAND_READ_PCD_STATUS_CPU_4:
-        case SBUS_COMMAND_READ_PCD_STATUS_CPU_5:
-        case SBUS_COMMAND_READ_PCD_STATUS_CPU_6:
-        case SBUS_COMMAND_READ_PCD_STATUS_SELF:
-        case SBUS_COMMAND_READ_STATION_NUMBER:
-            return 1 + 2;
+sbus_result_t sbus_packet_validate_response_9bit(sbus_request_t *request, uint16_t *buffer, size_t *len) {
+    return validate_response_9bit(request->command, sbus_packet_response_length(request), buffer, len);
+}
+
+
+sbus_result_t sbus_packet_validate_response_8bit(sbus_request_t *request, uint8_t *buffer, size_t *len) {
+    return validate_response_8bit(request->command, sbus_packet_response_length(request), sbus_crc16_init(), buffer,
+                                  len);
+}
+
+
+/*
+ * Same as `sbus_packet_validate_response_8bit`, for responses whose CRC also covers some preceding bytes (the
+ * Ether-S-Bus header): `crc` is the running CRC over them.
+ */
+sbus_result_t sbus_packet_validate_response_8bit_crc(sbus_request_t *request, uint16_t crc, uint8_t *buffer,
+                                                     size_t *len) {
+    return validate_response_8bit(request->command, sbus_packet_response_length(request), crc, buffer, len);
+}
 
-        default:
-            assert(0);
-            break;
-    }
 
-    return 0;
+sbus_result_t sbus_packet_validate_response_view_9bit(const sbus_request_view_t *view, uint16_t *buffer, size_t *len) {
+    return validate_response_9bit(view->command, sbus_packet_response_length_view(view), buffer, len);
+}
+
+
+sbus_result_t sbus_packet_validate_response_view_8bit(const sbus_request_view_t *view, uint8_t *buffer, size_t *len) {
+    return validate_response_8bit(view->command, sbus_packet_response_length_view(view), sbus_crc16_init(), buffer,
+                                  len);
+}
+
+
+size_t sbus_packet_response_length(const sbus_request_t *request) {
+    return response_length(request->destination, request->command, SBUS_PACKET_R_COUNT(request));
+}
+
+
+size_t sbus_packet_response_length_view(const sbus_request_view_t *view) {
+    return response_length(view->destination, view->command, sbus_request_view_r_count(view));
 }
 
 
@@ -226,11 +391,23 @@ int sbus_packet_serialize_register_read_response(uint16_t *buffer, size_t len, u
         return -1;
     }
 
+    return sbus_packet_serialize_values_response(buffer, len, registers, count);
+}
+
+
+/*
+ * Response to a register, counter, timer or display register read: `count` big endian 32 bit values and the CRC.
+ */
+int sbus_packet_serialize_values_response(uint16_t *buffer, size_t len, const uint32_t *values, size_t count) {
+    if (len < count * 4 + 2) {
+        return -1;
+    }
+
     for (size_t i = 0; i < count; i++) {
-        buffer[i * 4 + 0] = (registers[i] >> 24) & 0xFF;
-        buffer[i * 4 + 1] = (registers[i] >> 16) & 0xFF;
-        buffer[i * 4 + 2] = (registers[i] >> 8) & 0xFF;
-        buffer[i * 4 + 3] = registers[i] & 0xFF;
+        buffer[i * 4 + 0] = (values[i] >> 24) & 0xFF;
+        buffer[i * 4 + 1] = (values[i] >> 16) & 0xFF;
+        buffer[i * 4 + 2] = (values[i] >> 8) & 0xFF;
+        buffer[i * 4 + 3] = values[i] & 0xFF;
     }
 
     uint16_t crc          = sbus_crc16_9bit(buffer, count * 4);
@@ -241,134 +418,308 @@ int sbus_packet_serialize_register_read_response(uint16_t *buffer, size_t len, u
 }
 
 
-uint16_t sbus_crc16_8bit(uint8_t *buffer, size_t length) {
-    int      i;
-    uint16_t crc;
-    uint16_t data;
-    if (length == 0)
-        return (0);
-    crc = 0;
-    do {
-        data = *buffer;
-        crc  = (uint16_t)(crc ^ (data << 8));
-        for (i = 0; i < 8; i++) {
-            if (crc & 0x8000)
-                crc = (uint16_t)((crc << 1) ^ 0x1021);
-            else
-                crc <<= 1;
-        }
-        buffer++;
-    } while (--length);
-    return crc;
-}
-
-
-uint16_t sbus_crc16_9bit(uint16_t *buffer, size_t length) {
-    int      i;
-    uint16_t crc;
-    uint16_t data;
-    if (length == 0)
-        return (0);
-    crc = 0;
-    do {
-        data = (uint8_t)((*buffer) & 0xFF);
-        crc  = (uint16_t)(crc ^ (data << 8));
-        for (i = 0; i < 8; i++) {
-            if (crc & 0x8000)
-                crc = (uint16_t)((crc << 1) ^ 0x1021);
-            else
-                crc <<= 1;
-        }
-        buffer++;
-    } while (--length);
-    return crc;
+/*
+ * Response to a flag, input or output read: `count` elements taken from the packed array `bits` starting at element
+ * `first`, repacked from the first bit of the response.
+ */
+int sbus_packet_serialize_bits_response(uint16_t *buffer, size_t len, const uint8_t *bits, size_t first,
+                                        size_t count) {
+    size_t bytes = SBUS_FIO_BYTES(count);
+    if (len < bytes + 2) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < bytes; i++) {
+        buffer[i] = 0;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (bits[SBUS_FIO_BYTE(first + i)] & SBUS_FIO_MASK(first + i))
+            buffer[SBUS_FIO_BYTE(i)] |= SBUS_FIO_MASK(i);
+    }
+
+    uint16_t crc      = sbus_crc16_9bit(buffer, bytes);
+    buffer[bytes]     = (crc >> 8) & 0xFF;
+    buffer[bytes + 1] = crc & 0xFF;
+
+    return (int)bytes + 2;
 }
 
 
-static int unpack_command(sbus_command_code_t command, uint16_t *buffer, size_t *len, sbus_request_t *request) {
-#define CHECK_LEN(required)                                                                                            \
-    if (*len < required)                                                                                               \
-        return SBUS_INCOMPLETE_PACKET;                                                                                 \
-    *len = required;
+/*
+ * Response made of raw bytes and the CRC (real time clock, PCD status, station number).
+ */
+int sbus_packet_serialize_bytes_response(uint16_t *buffer, size_t len, const uint8_t *bytes, size_t count) {
+    if (len < count + 2) {
+        return -1;
+    }
 
-    request->command = command;
-
-    switch (command) {
-        case SBUS_COMMAND_READ_DISPLAY_REGISTER:
-        case SBUS_COMMAND_READ_REAL_TIME_CLOCK:
-        case SBUS_COMMAND_READ_PCD_STATUS_CPU_0:
-        case SBUS_COMMAND_READ_PCD_STATUS_CPU_1:
-        case SBUS_COMMAND_READ_PCD_STATUS_CPU_2:
-        case SBUS_COMMAND_READ_PCD_STATUS_CPU_3:
-        case SBUS_COMMAND_READ_PCD_STATUS_CPU_4:
-        case SBUS_COMMAND_READ_PCD_STATUS_CPU_5:
-        case SBUS_COMMAND_READ_PCD_STATUS_CPU_6:
-        case SBUS_COMMAND_READ_PCD_STATUS_SELF:
-        case SBUS_COMMAND_READ_STATION_NUMBER:
-            *len = 0;
-            break;
-
-        case SBUS_COMMAND_READ_COUNTER:
-        case SBUS_COMMAND_READ_FLAG:
-        case SBUS_COMMAND_READ_INPUT:
-        case SBUS_COMMAND_READ_OUTPUT:
-        case SBUS_COMMAND_READ_REGISTER:
-        case SBUS_COMMAND_READ_TIMER:
-            CHECK_LEN(3);
-            break;
-
-        case SBUS_COMMAND_WRITE_COUNTER:
-        case SBUS_COMMAND_WRITE_REGISTER:
-        case SBUS_COMMAND_WRITE_TIMER: {
-            if (*len < 1)
-                return SBUS_INCOMPLETE_PACKET;
-
-            if (buffer[0] < 5 || buffer[0] > 129)
-                return SBUS_INVALID_DATA;
-            if ((buffer[0] - 1) % 4 != 0)
-                return SBUS_INVALID_DATA;
-
-            size_t total_len = 2 + buffer[0];
-            CHECK_LEN(total_len);
-            break;
-        }
+    for (size_t i = 0; i < count; i++) {
+        buffer[i] = bytes[i];
+    }
 
-        case SBUS_COMMAND_WRITE_OUTPUT:
-        case SBUS_COMMAND_WRITE_FLAG: {
-            if (*len < 3)
-                return SBUS_INCOMPLETE_PACKET;
+    uint16_t crc      = sbus_crc16_9bit(buffer, count);
+    buffer[count]     = (crc >> 8) & 0xFF;
+    buffer[count + 1] = crc & 0xFF;
 
-            if (buffer[0] < 2 || buffer[0] > 17)
-                return SBUS_INVALID_DATA;
-            if (buffer[2] > 127)
-                return SBUS_INVALID_DATA;
+    return (int)count + 2;
+}
 
-            size_t total_len = 2 + buffer[0];
-            CHECK_LEN(total_len);
-            break;
-        }
 
-        case SBUS_COMMAND_WRITE_REAL_TIME_CLOCK:
-            CHECK_LEN(6);
-            break;
+/*
+ * Acknowledge to a write; `code` is either SBUS_ACK or SBUS_NAK.
+ */
+int sbus_packet_serialize_ack_response(uint16_t *buffer, size_t len, uint8_t code) {
+    if (len < 2) {
+        return -1;
+    }
+
+    buffer[0] = code;
+    buffer[1] = 0x00;
+    return 2;
+}
 
+
+sbus_command_code_t sbus_media_read_command(sbus_media_type_t media) {
+    switch (media) {
+        case SBUS_MEDIA_COUNTER:
+            return SBUS_COMMAND_READ_COUNTER;
+        case SBUS_MEDIA_TIMER:
+            return SBUS_COMMAND_READ_TIMER;
+        case SBUS_MEDIA_FLAG:
+            return SBUS_COMMAND_READ_FLAG;
+        case SBUS_MEDIA_INPUT:
+            return SBUS_COMMAND_READ_INPUT;
+        case SBUS_MEDIA_OUTPUT:
+            return SBUS_COMMAND_READ_OUTPUT;
+        case SBUS_MEDIA_REGISTER:
         default:
-            return SBUS_UNKNOWN_COMMAND;
+            return SBUS_COMMAND_READ_REGISTER;
     }
+}
 
-    if (check_data(buffer, *len) >= 0) {
+
+/*
+ * Inputs cannot be written: SBUS_INVALID_ARGS.
+ */
+sbus_result_t sbus_media_write_command(sbus_media_type_t media, sbus_command_code_t *command) {
+    switch (media) {
+        case SBUS_MEDIA_REGISTER:
+            *command = SBUS_COMMAND_WRITE_REGISTER;
+            return SBUS_OK;
+        case SBUS_MEDIA_COUNTER:
+            *command = SBUS_COMMAND_WRITE_COUNTER;
+            return SBUS_OK;
+        case SBUS_MEDIA_TIMER:
+            *command = SBUS_COMMAND_WRITE_TIMER;
+            return SBUS_OK;
+        case SBUS_MEDIA_FLAG:
+            *command = SBUS_COMMAND_WRITE_FLAG;
+            return SBUS_OK;
+        case SBUS_MEDIA_OUTPUT:
+            *command = SBUS_COMMAND_WRITE_OUTPUT;
+            return SBUS_OK;
+        default:
+            return SBUS_INVALID_ARGS;
+    }
+}
+
+
+/*
+ * Media type accessed by a read or write command; SBUS_UNKNOWN_COMMAND for commands that do not address media.
+ */
+sbus_result_t sbus_media_from_command(sbus_command_code_t command, sbus_media_type_t *media) {
+    const sbus_command_descriptor_t *descriptor = sbus_command_describe(command);
+
+    if (!descriptor->has_media)
+        return SBUS_UNKNOWN_COMMAND;
+
+    *media = (sbus_media_type_t)descriptor->media;
+    return SBUS_OK;
+}
+
+
+int sbus_media_is_bit(sbus_media_type_t media) {
+    return media == SBUS_MEDIA_FLAG || media == SBUS_MEDIA_INPUT || media == SBUS_MEDIA_OUTPUT;
+}
+
+
+size_t sbus_media_max_count(sbus_media_type_t media) {
+    return sbus_media_is_bit(media) ? SBUS_MAX_BITS_PER_FRAME : SBUS_MAX_VALUES_PER_FRAME;
+}
+
+
+/*
+ * Never NULL: codes that are not S-Bus commands get a descriptor of kind SBUS_COMMAND_KIND_UNKNOWN.
+ */
+const sbus_command_descriptor_t *sbus_command_describe(sbus_command_code_t command) {
+    if ((unsigned)command >= SBUS_COMMAND_CODES || descriptors[command].kind == SBUS_COMMAND_KIND_UNKNOWN)
+        return &unknown_command;
+    return &descriptors[command];
+}
+
+
+sbus_result_t sbus_packet_request_data_length(sbus_command_code_t command, const uint8_t *data, size_t len,
+                                              size_t *required) {
+    const sbus_command_descriptor_t *descriptor = sbus_command_describe(command);
+
+    if (descriptor->kind == SBUS_COMMAND_KIND_UNKNOWN)
+        return SBUS_UNKNOWN_COMMAND;
+
+    if (descriptor->request_prefix == 0) {
+        *required = descriptor->request_len;
+        return SBUS_OK;
+    }
+
+    if (len < descriptor->request_prefix)
+        return SBUS_INCOMPLETE_PACKET;
+
+    uint8_t w_count = data[0];
+    if (w_count < descriptor->w_count_min || w_count > descriptor->w_count_max ||
+        (w_count - descriptor->w_count_min) % descriptor->w_count_step != 0)
+        return SBUS_INVALID_DATA;
+    // The fio-count of flag and output writes
+    if (descriptor->request_prefix > 3 && data[3] >= SBUS_MAX_BITS_PER_FRAME)
         return SBUS_INVALID_DATA;
+
+    *required = 2 + (size_t)w_count;
+    return SBUS_OK;
+}
+
+
+static int unpack_command(sbus_command_code_t command, uint16_t *buffer, size_t *len) {
+    // At most the first four data bytes are needed to know the length of a request; address words saturate so that
+    // they still fail the range checks on the length fields
+    uint8_t prefix[4];
+    size_t  prefix_len = *len < sizeof(prefix) ? *len : sizeof(prefix);
+    for (size_t i = 0; i < prefix_len; i++) {
+        prefix[i] = IS_ADDRESS(buffer[i]) ? 0xFF : (uint8_t)buffer[i];
     }
 
-    request->data_len = (uint8_t)*len;
-    for (size_t i = 0; i < *len; i++) {
-        request->data[i] = (uint8_t)buffer[i];
+    size_t required = 0;
+    int    res      = sbus_packet_request_data_length(command, prefix, prefix_len, &required);
+    if (res != SBUS_OK)
+        return res;
+
+    if (*len < required)
+        return SBUS_INCOMPLETE_PACKET;
+    *len = required;
+
+    if (check_data(buffer, *len) >= 0) {
+        return SBUS_INVALID_DATA;
     }
 
     return SBUS_OK;
 }
 
 
+static sbus_result_t validate_response_9bit(sbus_command_code_t command, size_t required_len, uint16_t *buffer,
+                                            size_t *len) {
+    sbus_result_t res = check_response_9bit(command, required_len, buffer, len);
+    SBUS_STATS_RESULT(command, res);
+    return res;
+}
+
+
+static sbus_result_t check_response_9bit(sbus_command_code_t command, size_t required_len, uint16_t *buffer,
+                                         size_t *len) {
+    if (sbus_command_describe(command)->kind == SBUS_COMMAND_KIND_UNKNOWN) {
+        *len = 0;
+        return SBUS_UNKNOWN_COMMAND;
+    }
+
+    if (required_len == 0) {
+        *len = 0;
+        return SBUS_OK;
+    }
+
+    if (*len < required_len) {
+        *len = 0;
+        return SBUS_INCOMPLETE_PACKET;
+    }
+
+    int index = check_data(buffer, required_len);
+    if (index >= 0) {
+        *len = (size_t)index;
+        return SBUS_NOT_FOUND;
+    }
+
+    // Writes are answered with a bare ACK or NAK, without CRC
+    if (sbus_command_describe(command)->kind == SBUS_COMMAND_KIND_WRITE) {
+        if ((buffer[0] == SBUS_ACK || buffer[0] == SBUS_NAK) && buffer[1] == 0x00)
+            return SBUS_OK;
+        else
+            return SBUS_INVALID_DATA;
+    }
+
+    uint16_t crc       = sbus_crc16_9bit(buffer, required_len - 2);
+    uint16_t found_crc = (uint16_t)((buffer[required_len - 2] << 8) | buffer[required_len - 1]);
+    *len               = required_len;
+
+    if (crc != found_crc)
+        return SBUS_WRONG_CRC;
+    else
+        return SBUS_OK;
+}
+
+
+static sbus_result_t validate_response_8bit(sbus_command_code_t command, size_t required_len, uint16_t crc,
+                                            uint8_t *buffer, size_t *len) {
+    sbus_result_t res = check_response_8bit(command, required_len, crc, buffer, len);
+    SBUS_STATS_RESULT(command, res);
+    return res;
+}
+
+
+static sbus_result_t check_response_8bit(sbus_command_code_t command, size_t required_len, uint16_t crc,
+                                         uint8_t *buffer, size_t *len) {
+    if (sbus_command_describe(command)->kind == SBUS_COMMAND_KIND_UNKNOWN) {
+        *len = 0;
+        return SBUS_UNKNOWN_COMMAND;
+    }
+
+    if (required_len == 0) {
+        *len = 0;
+        return SBUS_OK;
+    }
+
+    if (*len < required_len) {
+        *len = 0;
+        return SBUS_INCOMPLETE_PACKET;
+    }
+
+    if (sbus_command_describe(command)->kind == SBUS_COMMAND_KIND_WRITE) {
+        if ((buffer[0] == SBUS_ACK || buffer[0] == SBUS_NAK) && buffer[1] == 0x00) {
+            return SBUS_OK;
+        } else {
+            return SBUS_INVALID_DATA;
+        }
+    }
+
+    uint16_t found_crc = (uint16_t)((buffer[required_len - 2] << 8) | buffer[required_len - 1]);
+    *len               = required_len;
+
+    if (sbus_crc16_final(sbus_crc16_update_8bit(crc, buffer, required_len - 2)) != found_crc)
+        return SBUS_WRONG_CRC;
+    else
+        return SBUS_OK;
+}
+
+
+/*
+ * Zero for broadcasts, which are not answered, and for unknown commands.
+ */
+static size_t response_length(uint8_t destination, sbus_command_code_t command, uint8_t r_count) {
+    const sbus_command_descriptor_t *descriptor = sbus_command_describe(command);
+
+    if (destination == SBUS_BROADCAST_ADDRESS)
+        return 0;
+
+    return descriptor->response_base +
+           ((((size_t)r_count + 1) * descriptor->response_scale + descriptor->response_round) >>
+            descriptor->response_shift);
+}
+
+
 static int check_data(uint16_t *buffer, size_t len) {
     for (int i = 0; i < (int)len; i++) {
         if (IS_ADDRESS(buffer[i]))
@@ -377,3 +728,23 @@ static int check_data(uint16_t *buffer, size_t len) {
 
     return -1;
 }
+
+
+/*
+ * Index of the first marked character in [from, len), or `len`. Unmarked bytes of the bitmap are skipped whole.
+ */
+static size_t find_marker(const uint8_t *address_map, size_t from, size_t len) {
+    size_t i = from;
+
+    while (i < len) {
+        if ((i % 8) == 0 && address_map[i / 8] == 0) {
+            i += 8;
+            continue;
+        }
+        if (SBUS_ADDRESS_MAP_GET(address_map, i))
+            return i;
+        i++;
+    }
+
+    return len;
+}
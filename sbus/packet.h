@@ -5,6 +5,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "crc.h"
+
 #define SBUS_REQUEST(dest, cmd, ...)                                                                                   \
     ({                                                                                                                 \
         uint8_t        buffer[] = __VA_ARGS__;                                                                         \
@@ -28,7 +30,7 @@
                                       (reg >> 8) & 0xFF, reg & 0xFF}})
 
 #define SBUS_PACKET_R_COUNT(packet)  (packet->data[0])
-#define SBUS_PACKET_REG_ADDR(packet) ((uint16_t)(packet->data[1] << 8) && (uint16_t)(packet->data[2]))
+#define SBUS_PACKET_REG_ADDR(packet) ((uint16_t)(((packet)->data[1] << 8) | (packet)->data[2]))
 
 #define SBUS_ADDRESS(addr) (0x0100 | addr)
 
@@ -36,6 +38,21 @@
 #define SBUS_NAK               0x15
 #define SBUS_BROADCAST_ADDRESS 0xFF
 
+#define SBUS_MAX_VALUES_PER_FRAME 32      // R-count range for registers, counters and timers is 0-31
+#define SBUS_MAX_BITS_PER_FRAME   128     // R-count range for flags, inputs and outputs is 0-127
+#define SBUS_MAX_BITS_PER_WRITE   120     // w-count is at most 17 for flags and outputs, i.e. 15 fio-bytes
+#define SBUS_CLOCK_SIZE           6       // Year, month, day, hours, minutes and seconds, in BCD
+
+// Flags, inputs and outputs travel packed eight per byte, the lowest address in the least significant bit
+#define SBUS_FIO_BYTES(count)  (((count) + 7) / 8)
+#define SBUS_FIO_BYTE(index)   ((index) / 8)
+#define SBUS_FIO_MASK(index)   ((uint8_t)(1 << ((index) % 8)))
+
+// Out of band address flags for 8-bit streams, packed like flags: one bit per received character
+#define SBUS_ADDRESS_MAP_BYTES(len)       SBUS_FIO_BYTES(len)
+#define SBUS_ADDRESS_MAP_GET(map, index)  (((map)[SBUS_FIO_BYTE(index)] & SBUS_FIO_MASK(index)) ? 1 : 0)
+#define SBUS_ADDRESS_MAP_SET(map, index)  ((map)[SBUS_FIO_BYTE(index)] |= SBUS_FIO_MASK(index))
+
 typedef enum {
     SBUS_COMMAND_READ_COUNTER          = 0,
     SBUS_COMMAND_READ_DISPLAY_REGISTER = 1,
@@ -62,6 +79,8 @@ typedef enum {
     SBUS_COMMAND_READ_STATION_NUMBER   = 29,
 } sbus_command_code_t;
 
+#define SBUS_COMMAND_CODES 32     // Command codes are below 32
+
 
 typedef enum {
     SBUS_OK                = 0,
@@ -71,9 +90,55 @@ typedef enum {
     SBUS_NOT_FOUND         = -4,
     SBUS_WRONG_CRC         = -5,
     SBUS_INVALID_ARGS      = -6,
+    SBUS_TIMEOUT           = -7,
+    SBUS_IO_ERROR          = -8,
 } sbus_result_t;
 
 
+typedef enum {
+    SBUS_MEDIA_REGISTER = 0,
+    SBUS_MEDIA_COUNTER,
+    SBUS_MEDIA_TIMER,
+    SBUS_MEDIA_FLAG,
+    SBUS_MEDIA_INPUT,
+    SBUS_MEDIA_OUTPUT,
+} sbus_media_type_t;
+
+#define SBUS_MEDIA_TYPES 6
+
+
+typedef enum {
+    SBUS_COMMAND_KIND_UNKNOWN = 0,
+    SBUS_COMMAND_KIND_READ,
+    SBUS_COMMAND_KIND_WRITE,
+} sbus_command_kind_t;
+
+
+/*
+ * Everything the parsers and validators need to know about a command code.
+ * The request data length is either fixed (`request_len`) or read from the leading w-count once `request_prefix`
+ * bytes are available. The response length is
+ * `response_base + (((r_count + 1) * response_scale + response_round) >> response_shift)`, which covers fixed
+ * answers, 32 bit values and packed bits alike.
+ */
+typedef struct {
+    const char *name;     // Command code name without the SBUS_COMMAND_ prefix, "UNKNOWN" for unknown codes
+    uint8_t     kind;
+    uint8_t     has_media;
+    uint8_t     media;
+    uint8_t     max_count;          // Values or bits per frame for media commands
+    uint8_t     request_len;        // Fixed data length, when request_prefix is 0
+    uint8_t     request_prefix;     // Data bytes needed to know the length of a variable request
+    uint8_t     w_count_min;
+    uint8_t     w_count_max;
+    uint8_t     w_count_step;
+    uint8_t     response_base;
+    uint8_t     response_scale;
+    uint8_t     response_round;
+    uint8_t     response_shift;
+} sbus_command_descriptor_t;
+
+
 typedef struct {
     uint8_t             destination;
     sbus_command_code_t command;
@@ -81,15 +146,79 @@ typedef struct {
     uint8_t             data[256];
 } sbus_request_t;
 
-uint16_t      sbus_crc16_9bit(uint16_t *buffer, size_t length);
-uint16_t      sbus_crc16_8bit(uint8_t *buffer, size_t length);
+
+/*
+ * Non owning counterpart of `sbus_request_t`: the data words are left in the 9-bit receive buffer they were parsed
+ * from, which must stay valid for as long as the view is used.
+ */
+typedef struct {
+    uint8_t             destination;
+    sbus_command_code_t command;
+    uint8_t             data_len;
+    const uint16_t     *data;
+} sbus_request_view_t;
+
+
+static inline uint8_t sbus_request_view_byte(const sbus_request_view_t *view, size_t index) {
+    return (uint8_t)(view->data[index] & 0xFF);
+}
+
+static inline uint8_t sbus_request_view_r_count(const sbus_request_view_t *view) {
+    return sbus_request_view_byte(view, 0);
+}
+
+static inline uint16_t sbus_request_view_address(const sbus_request_view_t *view) {
+    return (uint16_t)((sbus_request_view_byte(view, 1) << 8) | sbus_request_view_byte(view, 2));
+}
+
+// Number of 32 bit values carried by a register, counter or timer write
+static inline size_t sbus_request_view_value_count(const sbus_request_view_t *view) {
+    return (size_t)(sbus_request_view_byte(view, 0) - 1) / 4;
+}
+
+static inline uint32_t sbus_request_view_value(const sbus_request_view_t *view, size_t index) {
+    size_t offset = 3 + index * 4;
+    return ((uint32_t)sbus_request_view_byte(view, offset) << 24) |
+           ((uint32_t)sbus_request_view_byte(view, offset + 1) << 16) |
+           ((uint32_t)sbus_request_view_byte(view, offset + 2) << 8) |
+           (uint32_t)sbus_request_view_byte(view, offset + 3);
+}
+
+
 sbus_result_t sbus_packet_parse_request(uint16_t *buffer, size_t *len, sbus_request_t *request);
-size_t        sbus_packet_response_length(sbus_request_t *request);
+sbus_result_t sbus_packet_parse_request_view(uint16_t *buffer, size_t *len, sbus_request_view_t *view);
+sbus_result_t sbus_packet_parse_request_8bit(const uint8_t *buffer, const uint8_t *address_map, size_t offset,
+                                             size_t *len, sbus_request_t *request);
+void          sbus_packet_pack_9bit(const uint16_t *words, size_t len, uint8_t *bytes, uint8_t *address_map);
+void          sbus_packet_unpack_9bit(const uint8_t *bytes, const uint8_t *address_map, size_t len, uint16_t *words);
+void          sbus_request_view_copy(const sbus_request_view_t *view, sbus_request_t *request);
+sbus_result_t sbus_packet_request_data_length(sbus_command_code_t command, const uint8_t *data, size_t len,
+                                              size_t *required);
+size_t        sbus_packet_response_length(const sbus_request_t *request);
 sbus_result_t sbus_packet_validate_response_9bit(sbus_request_t *request, uint16_t *buffer, size_t *len);
 sbus_result_t sbus_packet_validate_response_8bit(sbus_request_t *request, uint8_t *buffer, size_t *len);
+sbus_result_t sbus_packet_validate_response_8bit_crc(sbus_request_t *request, uint16_t crc, uint8_t *buffer,
+                                                     size_t *len);
+sbus_result_t sbus_packet_validate_response_view_9bit(const sbus_request_view_t *view, uint16_t *buffer, size_t *len);
+sbus_result_t sbus_packet_validate_response_view_8bit(const sbus_request_view_t *view, uint8_t *buffer, size_t *len);
+size_t        sbus_packet_response_length_view(const sbus_request_view_t *view);
 size_t        sbus_packet_serialize_request(uint16_t *buffer, const sbus_request_t *request);
-size_t        sbus_packet_response_length(sbus_request_t *request);
+sbus_result_t sbus_packet_write_values_request(uint8_t station, sbus_media_type_t media, uint16_t start,
+                                               const uint32_t *values, size_t count, sbus_request_t *request);
+sbus_result_t sbus_packet_write_bits_request(uint8_t station, sbus_media_type_t media, uint16_t start,
+                                             const uint8_t *bits, size_t count, sbus_request_t *request);
+const sbus_command_descriptor_t *sbus_command_describe(sbus_command_code_t command);
+sbus_command_code_t sbus_media_read_command(sbus_media_type_t media);
+sbus_result_t       sbus_media_write_command(sbus_media_type_t media, sbus_command_code_t *command);
+sbus_result_t       sbus_media_from_command(sbus_command_code_t command, sbus_media_type_t *media);
+size_t              sbus_media_max_count(sbus_media_type_t media);
+int                 sbus_media_is_bit(sbus_media_type_t media);
 int sbus_packet_serialize_register_read_response(uint16_t *buffer, size_t len, uint32_t *registers, size_t count,
                                                  sbus_request_t *request);
+int sbus_packet_serialize_values_response(uint16_t *buffer, size_t len, const uint32_t *values, size_t count);
+int sbus_packet_serialize_bits_response(uint16_t *buffer, size_t len, const uint8_t *bits, size_t first,
+                                        size_t count);
+int sbus_packet_serialize_bytes_response(uint16_t *buffer, size_t len, const uint8_t *bytes, size_t count);
+int sbus_packet_serialize_ack_response(uint16_t *buffer, size_t len, uint8_t code);
 
 #endif
@@ -0,0 +1,140 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "crc.h"
+#include "packet.h"
+#include "parser.h"
+#include "stats.h"
+
+
+#define ADDRESS_MASK  0x0100
+#define IS_ADDRESS(x) (((x)&ADDRESS_MASK) > 0)
+
+static sbus_result_t step(sbus_parser_t *parser, uint16_t word);
+static void          start_frame(sbus_parser_t *parser, uint16_t word);
+static sbus_result_t check_length(sbus_parser_t *parser);
+
+
+void sbus_parser_init(sbus_parser_t *parser) {
+    parser->discarded = 0;
+    sbus_parser_reset(parser);
+}
+
+
+void sbus_parser_reset(sbus_parser_t *parser) {
+    parser->state            = SBUS_PARSER_STATE_ADDRESS;
+    parser->crc              = sbus_crc16_init();
+    parser->found_crc        = 0;
+    parser->length_known     = 0;
+    parser->required         = 0;
+    parser->request.data_len = 0;
+}
+
+
+/*
+ * Returns SBUS_INCOMPLETE_PACKET while a frame is in progress, SBUS_OK when `parser->request` holds a complete
+ * request and SBUS_INVALID_DATA, SBUS_UNKNOWN_COMMAND or SBUS_WRONG_CRC when a frame is rejected. An address word
+ * in the middle of a frame aborts it and immediately starts the next one.
+ */
+sbus_result_t sbus_parser_feed_byte(sbus_parser_t *parser, uint16_t word) {
+    sbus_result_t res = step(parser, word);
+    SBUS_STATS_RESULT(parser->request.command, res);
+    return res;
+}
+
+
+/*
+ * Feeds words until an event occurs. On return `len` holds the number of words consumed; when the whole buffer was
+ * consumed without completing a frame the result is SBUS_INCOMPLETE_PACKET.
+ */
+sbus_result_t sbus_parser_feed(sbus_parser_t *parser, const uint16_t *buffer, size_t *len) {
+    for (size_t i = 0; i < *len; i++) {
+        sbus_result_t res = sbus_parser_feed_byte(parser, buffer[i]);
+        if (res != SBUS_INCOMPLETE_PACKET) {
+            *len = i + 1;
+            return res;
+        }
+    }
+
+    return SBUS_INCOMPLETE_PACKET;
+}
+
+
+static sbus_result_t step(sbus_parser_t *parser, uint16_t word) {
+    uint8_t byte = (uint8_t)(word & 0xFF);
+
+    if (IS_ADDRESS(word)) {
+        sbus_parser_state_t previous = parser->state;
+        start_frame(parser, word);
+        return previous == SBUS_PARSER_STATE_ADDRESS ? SBUS_INCOMPLETE_PACKET : SBUS_INVALID_DATA;
+    }
+
+    switch (parser->state) {
+        case SBUS_PARSER_STATE_ADDRESS:
+            parser->discarded++;
+            SBUS_STATS_DISCARDED(1);
+            return SBUS_INCOMPLETE_PACKET;
+
+        case SBUS_PARSER_STATE_COMMAND:
+            parser->crc             = sbus_crc16_update_byte(parser->crc, byte);
+            parser->request.command = (sbus_command_code_t)byte;
+            parser->state           = SBUS_PARSER_STATE_DATA;
+            return check_length(parser);
+
+        case SBUS_PARSER_STATE_DATA:
+            parser->crc                                      = sbus_crc16_update_byte(parser->crc, byte);
+            parser->request.data[parser->request.data_len++] = byte;
+            return check_length(parser);
+
+        case SBUS_PARSER_STATE_CRC_HIGH:
+            parser->found_crc = (uint16_t)(byte << 8);
+            parser->state     = SBUS_PARSER_STATE_CRC_LOW;
+            return SBUS_INCOMPLETE_PACKET;
+
+        case SBUS_PARSER_STATE_CRC_LOW: {
+            uint16_t crc = sbus_crc16_final(parser->crc);
+            parser->found_crc |= byte;
+            parser->state = SBUS_PARSER_STATE_ADDRESS;
+
+            if (crc != parser->found_crc)
+                return SBUS_WRONG_CRC;
+            else
+                return SBUS_OK;
+        }
+    }
+
+    return SBUS_INCOMPLETE_PACKET;
+}
+
+
+static void start_frame(sbus_parser_t *parser, uint16_t word) {
+    sbus_parser_reset(parser);
+    parser->request.destination = (uint8_t)(word & 0xFF);
+    parser->crc                 = sbus_crc16_update_byte(parser->crc, parser->request.destination);
+    parser->state               = SBUS_PARSER_STATE_COMMAND;
+}
+
+
+static sbus_result_t check_length(sbus_parser_t *parser) {
+    if (!parser->length_known) {
+        sbus_result_t res = sbus_packet_request_data_length(parser->request.command, parser->request.data,
+                                                            parser->request.data_len, &parser->required);
+        switch (res) {
+            case SBUS_OK:
+                parser->length_known = 1;
+                break;
+
+            case SBUS_INCOMPLETE_PACKET:
+                return res;
+
+            default:
+                parser->state = SBUS_PARSER_STATE_ADDRESS;
+                return res;
+        }
+    }
+
+    if (parser->request.data_len >= parser->required)
+        parser->state = SBUS_PARSER_STATE_CRC_HIGH;
+
+    return SBUS_INCOMPLETE_PACKET;
+}
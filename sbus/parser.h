@@ -0,0 +1,37 @@
+#ifndef SBUS_PARSER_H_INCLUDED
+#define SBUS_PARSER_H_INCLUDED
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "packet.h"
+
+typedef enum {
+    SBUS_PARSER_STATE_ADDRESS = 0,
+    SBUS_PARSER_STATE_COMMAND,
+    SBUS_PARSER_STATE_DATA,
+    SBUS_PARSER_STATE_CRC_HIGH,
+    SBUS_PARSER_STATE_CRC_LOW,
+} sbus_parser_state_t;
+
+
+/*
+ * Resumable request parser for 9-bit words received one (or a few) at a time. Framing state, the running CRC and
+ * the partial request are kept between calls, so every word is looked at exactly once.
+ */
+typedef struct {
+    sbus_parser_state_t state;
+    uint16_t            crc;
+    uint16_t            found_crc;
+    uint8_t             length_known;
+    size_t              required;
+    size_t              discarded;     // Data words thrown away while looking for an address
+    sbus_request_t      request;
+} sbus_parser_t;
+
+void          sbus_parser_init(sbus_parser_t *parser);
+void          sbus_parser_reset(sbus_parser_t *parser);
+sbus_result_t sbus_parser_feed_byte(sbus_parser_t *parser, uint16_t word);
+sbus_result_t sbus_parser_feed(sbus_parser_t *parser, const uint16_t *buffer, size_t *len);
+
+#endif
@@ -0,0 +1,129 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "packet.h"
+#include "planner.h"
+
+
+static int      compare_points(const void *first, const void *second);
+static size_t   frame_limit(const sbus_planner_config_t *config, sbus_media_type_t media);
+static uint32_t element_value(const sbus_read_frame_t *frame, uint16_t address, const uint16_t *wide,
+                              const uint8_t *narrow);
+
+
+/*
+ * Sorts `points` by station, media and address and covers them with the smallest number of read frames: a frame is
+ * extended as long as the next point fits the per-command element limit and is no more than `gap_tolerance`
+ * addresses away from the previous one. Greedy extension is optimal here because frames only ever span a
+ * contiguous range of addresses.
+ */
+sbus_result_t sbus_planner_plan(const sbus_planner_config_t *config, sbus_point_t *points, size_t num_points,
+                                sbus_read_frame_t *frames, size_t max_frames, size_t *num_frames) {
+    *num_frames = 0;
+    if (num_points == 0)
+        return SBUS_OK;
+
+    qsort(points, num_points, sizeof(sbus_point_t), compare_points);
+
+    sbus_read_frame_t *frame = NULL;
+
+    for (size_t i = 0; i < num_points; i++) {
+        sbus_point_t *point = &points[i];
+        point->valid        = 0;
+
+        if (frame != NULL && frame->station == point->station && frame->media == point->media) {
+            uint16_t last = (uint16_t)(frame->start + frame->count - 1);
+            size_t   span = (size_t)point->address - frame->start + 1;
+
+            if (point->address <= last) {
+                // Duplicate point
+                frame->num_points++;
+                continue;
+            } else if ((size_t)point->address - last - 1 <= config->gap_tolerance &&
+                       span <= frame_limit(config, point->media)) {
+                frame->count = (uint8_t)span;
+                frame->num_points++;
+                continue;
+            }
+        }
+
+        if (*num_frames >= max_frames)
+            return SBUS_INVALID_ARGS;
+
+        frame              = &frames[(*num_frames)++];
+        frame->station     = point->station;
+        frame->media       = point->media;
+        frame->start       = point->address;
+        frame->count       = 1;
+        frame->first_point = i;
+        frame->num_points  = 1;
+    }
+
+    return SBUS_OK;
+}
+
+
+void sbus_planner_frame_request(const sbus_read_frame_t *frame, sbus_request_t *request) {
+    request->destination = frame->station;
+    request->command     = sbus_media_read_command(frame->media);
+    request->data_len    = 3;
+    request->data[0]     = (uint8_t)(frame->count - 1);
+    request->data[1]     = (frame->start >> 8) & 0xFF;
+    request->data[2]     = frame->start & 0xFF;
+}
+
+
+/*
+ * Copies the values of an already validated response to the points covered by `frame`.
+ */
+void sbus_planner_scatter_9bit(const sbus_read_frame_t *frame, sbus_point_t *points, const uint16_t *buffer) {
+    for (size_t i = frame->first_point; i < frame->first_point + frame->num_points; i++) {
+        points[i].value = element_value(frame, points[i].address, buffer, NULL);
+        points[i].valid = 1;
+    }
+}
+
+
+void sbus_planner_scatter_8bit(const sbus_read_frame_t *frame, sbus_point_t *points, const uint8_t *buffer) {
+    for (size_t i = frame->first_point; i < frame->first_point + frame->num_points; i++) {
+        points[i].value = element_value(frame, points[i].address, NULL, buffer);
+        points[i].valid = 1;
+    }
+}
+
+
+static uint32_t element_value(const sbus_read_frame_t *frame, uint16_t address, const uint16_t *wide,
+                              const uint8_t *narrow) {
+#define BYTE(i) (wide != NULL ? (uint8_t)(wide[i] & 0xFF) : narrow[i])
+    size_t index = (size_t)(address - frame->start);
+
+    if (sbus_media_is_bit(frame->media)) {
+        return (BYTE(SBUS_FIO_BYTE(index)) & SBUS_FIO_MASK(index)) ? 1 : 0;
+    } else {
+        size_t offset = index * 4;
+        return ((uint32_t)BYTE(offset) << 24) | ((uint32_t)BYTE(offset + 1) << 16) |
+               ((uint32_t)BYTE(offset + 2) << 8) | (uint32_t)BYTE(offset + 3);
+    }
+#undef BYTE
+}
+
+
+static size_t frame_limit(const sbus_planner_config_t *config, sbus_media_type_t media) {
+    size_t limit = sbus_media_max_count(media);
+    size_t max   = sbus_media_is_bit(media) ? config->max_bits : config->max_values;
+    return (max > 0 && max < limit) ? max : limit;
+}
+
+
+static int compare_points(const void *first, const void *second) {
+    const sbus_point_t *a = first;
+    const sbus_point_t *b = second;
+
+    if (a->station != b->station)
+        return a->station < b->station ? -1 : 1;
+    if (a->media != b->media)
+        return a->media < b->media ? -1 : 1;
+    if (a->address != b->address)
+        return a->address < b->address ? -1 : 1;
+    return 0;
+}
@@ -0,0 +1,48 @@
+#ifndef SBUS_PLANNER_H_INCLUDED
+#define SBUS_PLANNER_H_INCLUDED
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "packet.h"
+
+
+typedef struct {
+    uint8_t           station;
+    sbus_media_type_t media;
+    uint16_t          address;
+    uint8_t           valid;     // Set once a response has been scattered into `value`
+    uint32_t          value;     // Register, counter or timer value; 0 or 1 for flags, inputs and outputs
+} sbus_point_t;
+
+
+typedef struct {
+    // Maximum number of addresses nobody asked for that may be read to join two runs of points into one frame
+    uint16_t gap_tolerance;
+    // Upper bounds for the number of elements per frame; 0 or anything above the protocol limit means the limit
+    uint8_t  max_values;
+    uint8_t  max_bits;
+} sbus_planner_config_t;
+
+
+/*
+ * A single read frame of the plan, covering the points [first_point, first_point + num_points) of the (sorted)
+ * points array.
+ */
+typedef struct {
+    uint8_t           station;
+    sbus_media_type_t media;
+    uint16_t          start;
+    uint8_t           count;
+    size_t            first_point;
+    size_t            num_points;
+} sbus_read_frame_t;
+
+
+sbus_result_t sbus_planner_plan(const sbus_planner_config_t *config, sbus_point_t *points, size_t num_points,
+                                sbus_read_frame_t *frames, size_t max_frames, size_t *num_frames);
+void          sbus_planner_frame_request(const sbus_read_frame_t *frame, sbus_request_t *request);
+void          sbus_planner_scatter_9bit(const sbus_read_frame_t *frame, sbus_point_t *points, const uint16_t *buffer);
+void          sbus_planner_scatter_8bit(const sbus_read_frame_t *frame, sbus_point_t *points, const uint8_t *buffer);
+
+#endif
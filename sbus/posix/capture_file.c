@@ -0,0 +1,86 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../capture.h"
+#include "capture_file.h"
+
+
+static int map(sbus_capture_file_t *file, int fd, size_t size, int prot);
+
+
+/*
+ * Creates (or truncates) `path` as an empty capture of `size` bytes, ready for writing.
+ */
+int sbus_capture_file_create(sbus_capture_file_t *file, const char *path, size_t size) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return -1;
+
+    if (ftruncate(fd, (off_t)size) < 0 || map(file, fd, size, PROT_READ | PROT_WRITE) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    if (sbus_capture_init(&file->capture, file->memory, size) != SBUS_OK) {
+        sbus_capture_file_close(file);
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+
+/*
+ * Maps an existing capture read only, for decoding.
+ */
+int sbus_capture_file_open(sbus_capture_file_t *file, const char *path) {
+    struct stat st;
+    int         fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    if (fstat(fd, &st) < 0 || map(file, fd, (size_t)st.st_size, PROT_READ) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    if (sbus_capture_attach(&file->capture, file->memory, file->size) != SBUS_OK) {
+        sbus_capture_file_close(file);
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+
+void sbus_capture_file_close(sbus_capture_file_t *file) {
+    if (file->memory != NULL)
+        munmap(file->memory, file->size);
+    if (file->fd >= 0)
+        close(file->fd);
+    file->memory = NULL;
+    file->fd     = -1;
+}
+
+
+static int map(sbus_capture_file_t *file, int fd, size_t size, int prot) {
+    if (size == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    void *memory = mmap(NULL, size, prot, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED)
+        return -1;
+
+    file->fd     = fd;
+    file->memory = memory;
+    file->size   = size;
+    return 0;
+}
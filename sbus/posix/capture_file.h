@@ -0,0 +1,26 @@
+#ifndef SBUS_POSIX_CAPTURE_FILE_H_INCLUDED
+#define SBUS_POSIX_CAPTURE_FILE_H_INCLUDED
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "../capture.h"
+
+
+/*
+ * A capture ring backed by a shared file mapping: records land in the page cache with plain memory writes and the
+ * kernel writes them back on its own, so the file survives a crash of the process.
+ */
+typedef struct {
+    int            fd;
+    void          *memory;
+    size_t         size;
+    sbus_capture_t capture;
+} sbus_capture_file_t;
+
+
+int  sbus_capture_file_create(sbus_capture_file_t *file, const char *path, size_t size);
+int  sbus_capture_file_open(sbus_capture_file_t *file, const char *path);
+void sbus_capture_file_close(sbus_capture_file_t *file);
+
+#endif
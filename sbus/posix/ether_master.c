@@ -0,0 +1,242 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../ether.h"
+#include "../packet.h"
+#include "ether_master.h"
+#include "master.h"
+
+
+static void     start_next(sbus_ether_master_t *master, sbus_ether_station_t *station);
+static void     finish(sbus_ether_master_t *master, size_t index, sbus_result_t result);
+static void     handle_rx(sbus_ether_master_t *master);
+static void     handle_timeouts(sbus_ether_master_t *master);
+static int      transmit(sbus_ether_master_t *master, sbus_transaction_t *transaction);
+static uint64_t now_ms(void);
+
+
+int sbus_ether_master_init(sbus_ether_master_t *master, unsigned timeout_ms, unsigned retries) {
+    memset(master, 0, sizeof(sbus_ether_master_t));
+    master->timeout_ms = timeout_ms;
+    master->retries    = retries;
+
+    master->fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    return master->fd < 0 ? -1 : 0;
+}
+
+
+void sbus_ether_master_deinit(sbus_ether_master_t *master) {
+    if (master->fd >= 0)
+        close(master->fd);
+    master->fd = -1;
+}
+
+
+int sbus_ether_station_init(sbus_ether_station_t *station, const char *ip, uint16_t port, unsigned window) {
+    memset(station, 0, sizeof(sbus_ether_station_t));
+    station->address.sin_family = AF_INET;
+    station->address.sin_port   = htons(port);
+    station->window             = window > 0 ? window : 1;
+
+    if (inet_pton(AF_INET, ip, &station->address.sin_addr) != 1) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+
+int sbus_ether_master_submit(sbus_ether_master_t *master, sbus_ether_station_t *station,
+                             sbus_transaction_t *transaction) {
+    atomic_store_explicit(&transaction->done, 0, memory_order_relaxed);
+    transaction->result       = SBUS_INCOMPLETE_PACKET;
+    transaction->response_len = 0;
+    transaction->attempts     = 0;
+    transaction->owner        = station;
+    transaction->next         = NULL;
+
+    if (station->tail != NULL)
+        station->tail->next = transaction;
+    else
+        station->head = transaction;
+    station->tail = transaction;
+
+    start_next(master, station);
+    return 0;
+}
+
+
+/*
+ * Waits up to `timeout_ms` (or until the next retransmission is due) for replies and processes them. Returns 0 or -1.
+ */
+int sbus_ether_master_poll(sbus_ether_master_t *master, int timeout_ms) {
+    uint64_t now = now_ms();
+
+    for (size_t i = 0; i < master->num_in_flight; i++) {
+        uint64_t deadline = master->in_flight[i]->deadline_ms;
+        int      left     = deadline > now ? (int)(deadline - now) : 0;
+        if (timeout_ms < 0 || left < timeout_ms)
+            timeout_ms = left;
+    }
+
+    struct pollfd pfd = {.fd = master->fd, .events = POLLIN};
+    int           res = poll(&pfd, 1, timeout_ms);
+    if (res < 0)
+        return errno == EINTR ? 0 : -1;
+
+    if (res > 0)
+        handle_rx(master);
+    handle_timeouts(master);
+    return 0;
+}
+
+
+int sbus_ether_master_wait(sbus_ether_master_t *master, sbus_transaction_t *transaction) {
+    while (!atomic_load_explicit(&transaction->done, memory_order_acquire)) {
+        if (sbus_ether_master_poll(master, -1) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+
+static void start_next(sbus_ether_master_t *master, sbus_ether_station_t *station) {
+    while (station->head != NULL && station->in_flight < station->window &&
+           master->num_in_flight < SBUS_ETHER_MAX_IN_FLIGHT) {
+        sbus_transaction_t *transaction = station->head;
+        station->head                   = transaction->next;
+        if (station->head == NULL)
+            station->tail = NULL;
+
+        transaction->sequence                      = master->sequence++;
+        transaction->sent_us                       = sbus_master_now_us();
+        master->in_flight[master->num_in_flight++] = transaction;
+        station->in_flight++;
+
+        if (sbus_command_describe(transaction->request.command)->kind == SBUS_COMMAND_KIND_UNKNOWN) {
+            // No way to tell how long the answer is
+            finish(master, master->num_in_flight - 1, SBUS_UNKNOWN_COMMAND);
+        } else if (transmit(master, transaction) < 0) {
+            finish(master, master->num_in_flight - 1, SBUS_IO_ERROR);
+        } else if (sbus_packet_response_length(&transaction->request) == 0) {
+            finish(master, master->num_in_flight - 1, SBUS_OK);     // Broadcast, nothing to wait for
+        }
+    }
+}
+
+
+static void finish(sbus_ether_master_t *master, size_t index, sbus_result_t result) {
+    sbus_transaction_t   *transaction = master->in_flight[index];
+    sbus_ether_station_t *station     = transaction->owner;
+
+    master->in_flight[index] = master->in_flight[--master->num_in_flight];
+    station->in_flight--;
+
+    if (result == SBUS_OK && master->latency != NULL)
+        sbus_latency_record(master->latency, transaction->request.destination, transaction->request.command,
+                            (unsigned long)(sbus_master_now_us() - transaction->sent_us));
+
+    transaction->result = result;
+    atomic_store_explicit(&transaction->done, 1, memory_order_release);
+    if (transaction->callback != NULL)
+        transaction->callback(transaction);
+
+    start_next(master, station);
+}
+
+
+static void handle_rx(sbus_ether_master_t *master) {
+    uint8_t datagram[SBUS_ETHER_MAX_DATAGRAM];
+
+    for (;;) {
+        struct sockaddr_in from;
+        socklen_t          from_len = sizeof(from);
+        ssize_t res = recvfrom(master->fd, datagram, sizeof(datagram), 0, (struct sockaddr *)&from, &from_len);
+        if (res < 0)
+            break;
+
+        uint16_t         sequence;
+        sbus_attribute_t attribute;
+        if (sbus_ether_parse_header(datagram, (size_t)res, &sequence, &attribute) != SBUS_OK) {
+            master->unmatched++;
+            continue;
+        }
+
+        size_t index = 0;
+        for (; index < master->num_in_flight; index++) {
+            sbus_transaction_t   *transaction = master->in_flight[index];
+            sbus_ether_station_t *station     = transaction->owner;
+            if (transaction->sequence == sequence && station->address.sin_port == from.sin_port &&
+                station->address.sin_addr.s_addr == from.sin_addr.s_addr)
+                break;
+        }
+        if (index == master->num_in_flight) {
+            master->unmatched++;
+            continue;
+        }
+
+        sbus_transaction_t *transaction = master->in_flight[index];
+        sbus_result_t       result = sbus_ether_validate_response(&transaction->request, datagram, (size_t)res,
+                                                                  transaction->response, &transaction->response_len);
+        finish(master, index, result);
+    }
+}
+
+
+static void handle_timeouts(sbus_ether_master_t *master) {
+    uint64_t now = now_ms();
+    size_t   i   = 0;
+
+    while (i < master->num_in_flight) {
+        sbus_transaction_t *transaction = master->in_flight[i];
+
+        if (transaction->deadline_ms > now) {
+            i++;
+        } else if (transaction->attempts <= master->retries) {
+            master->retransmissions++;
+            if (transmit(master, transaction) < 0)
+                finish(master, i, SBUS_IO_ERROR);
+            else
+                i++;
+        } else {
+            finish(master, i, SBUS_TIMEOUT);     // The last slot was moved here, look at it again
+        }
+    }
+}
+
+
+static int transmit(sbus_ether_master_t *master, sbus_transaction_t *transaction) {
+    sbus_ether_station_t *station = transaction->owner;
+    uint8_t               datagram[SBUS_ETHER_MAX_DATAGRAM];
+    size_t len = sbus_ether_serialize_request(datagram, sizeof(datagram), transaction->sequence, &transaction->request);
+
+    transaction->attempts++;
+    transaction->deadline_ms = now_ms() + master->timeout_ms;
+
+    ssize_t res;
+    do {
+        res = sendto(master->fd, datagram, len, 0, (const struct sockaddr *)&station->address,
+                     sizeof(station->address));
+    } while (res < 0 && errno == EINTR);
+
+    // A full socket buffer is treated like a lost datagram: the retransmission timer takes care of it
+    if (res < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+        return -1;
+    return 0;
+}
+
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
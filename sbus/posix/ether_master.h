@@ -0,0 +1,59 @@
+#ifndef SBUS_POSIX_ETHER_MASTER_H_INCLUDED
+#define SBUS_POSIX_ETHER_MASTER_H_INCLUDED
+
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "../packet.h"
+#include "../stats.h"
+#include "master.h"
+
+#define SBUS_ETHER_MAX_IN_FLIGHT 64
+
+
+typedef struct sbus_ether_station sbus_ether_station_t;
+
+/*
+ * A PCD reachable over Ether-S-Bus. Up to `window` requests are kept in flight towards it, the others wait in
+ * submission order.
+ */
+struct sbus_ether_station {
+    struct sockaddr_in address;
+    unsigned           window;
+    unsigned           in_flight;
+
+    sbus_transaction_t *head;
+    sbus_transaction_t *tail;
+};
+
+
+/*
+ * Master side of Ether-S-Bus on a single UDP socket. Replies are matched to requests through the sequence number;
+ * requests left unanswered for `timeout_ms` are sent again (with the same sequence number) up to `retries` times.
+ */
+typedef struct {
+    int      fd;
+    unsigned timeout_ms;
+    unsigned retries;
+    uint16_t sequence;
+
+    sbus_transaction_t *in_flight[SBUS_ETHER_MAX_IN_FLIGHT];
+    size_t              num_in_flight;
+
+    unsigned long retransmissions;
+    unsigned long unmatched;     // Replies that matched no request in flight (late duplicates, strangers)
+
+    sbus_latency_table_t *latency;     // Optional, receives the latency of every successful exchange
+} sbus_ether_master_t;
+
+
+int  sbus_ether_master_init(sbus_ether_master_t *master, unsigned timeout_ms, unsigned retries);
+void sbus_ether_master_deinit(sbus_ether_master_t *master);
+int  sbus_ether_station_init(sbus_ether_station_t *station, const char *ip, uint16_t port, unsigned window);
+int  sbus_ether_master_submit(sbus_ether_master_t *master, sbus_ether_station_t *station,
+                              sbus_transaction_t *transaction);
+int  sbus_ether_master_poll(sbus_ether_master_t *master, int timeout_ms);
+int  sbus_ether_master_wait(sbus_ether_master_t *master, sbus_transaction_t *transaction);
+
+#endif
@@ -0,0 +1,452 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../packet.h"
+#include "../wire.h"
+#include "master.h"
+
+
+#define MAX_EVENTS              16
+#define BROADCAST_TURNAROUND_US 5000     // Execution time left to the stations after a broadcast, without a wire model
+
+static void     start_next(sbus_master_line_t *line);
+static void     finish(sbus_master_line_t *line, sbus_result_t result);
+static void     handle_rx(sbus_master_line_t *line);
+static void     handle_timer(sbus_master_line_t *line);
+static int      transmit(sbus_master_line_t *line, const sbus_request_t *request);
+static int      arm_timer(sbus_master_line_t *line, uint64_t timeout_us);
+static uint64_t broadcast_guard_us(const sbus_master_line_t *line, const sbus_request_t *request);
+static int      set_mark_parity(int fd, int mark);
+static int      write_all(int fd, const uint8_t *buffer, size_t len);
+static int      baud_to_speed(unsigned baud, speed_t *speed);
+static int      speed_to_baud(speed_t speed, uint32_t *baud);
+
+
+/*
+ * Opens a serial port in raw mode with 8 data bits and space parity, ready for S-Bus parity mode: the address
+ * character is sent by temporarily switching to mark parity. Parity is not checked on reception.
+ */
+int sbus_master_open_serial(const char *path, unsigned baud) {
+    speed_t speed;
+    if (baud_to_speed(baud, &speed) < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    struct termios tty;
+    if (tcgetattr(fd, &tty) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    cfmakeraw(&tty);
+    tty.c_cflag |= CLOCAL | CREAD | CS8 | PARENB | CMSPAR;
+    tty.c_cflag &= ~(PARODD | CSTOPB | CRTSCTS);
+    tty.c_iflag &= ~(INPCK | PARMRK);
+    tty.c_cc[VMIN]  = 0;
+    tty.c_cc[VTIME] = 0;
+    cfsetispeed(&tty, speed);
+    cfsetospeed(&tty, speed);
+
+    if (tcsetattr(fd, TCSANOW, &tty) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+
+/*
+ * Changes the baud rate of a port opened with `sbus_master_open_serial`, once the characters already written are out.
+ */
+int sbus_master_set_speed(int fd, unsigned baud) {
+    speed_t        speed;
+    struct termios tty;
+
+    if (baud_to_speed(baud, &speed) < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (tcgetattr(fd, &tty) < 0)
+        return -1;
+
+    cfsetispeed(&tty, speed);
+    cfsetospeed(&tty, speed);
+    return tcsetattr(fd, TCSADRAIN, &tty);
+}
+
+
+int sbus_master_init(sbus_master_t *master) {
+    master->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    return master->epoll_fd < 0 ? -1 : 0;
+}
+
+
+void sbus_master_deinit(sbus_master_t *master) {
+    if (master->epoll_fd >= 0)
+        close(master->epoll_fd);
+    master->epoll_fd = -1;
+}
+
+
+/*
+ * Drives the (already configured, non blocking) file descriptor `fd` from the event loop of `master`. Each line
+ * keeps at most one transaction on the wire; the others wait in submission order.
+ */
+int sbus_master_add_line(sbus_master_t *master, sbus_master_line_t *line, int fd, unsigned timeout_ms) {
+    memset(line, 0, sizeof(sbus_master_line_t));
+    line->fd          = fd;
+    line->parity_mode = 1;
+    line->timeout_ms  = timeout_ms;
+    line->timer_fd    = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (line->timer_fd < 0)
+        return -1;
+
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = line};
+    if (epoll_ctl(master->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0 ||
+        epoll_ctl(master->epoll_fd, EPOLL_CTL_ADD, line->timer_fd, &event) < 0) {
+        close(line->timer_fd);
+        line->timer_fd = -1;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+void sbus_master_remove_line(sbus_master_t *master, sbus_master_line_t *line) {
+    epoll_ctl(master->epoll_fd, EPOLL_CTL_DEL, line->fd, NULL);
+    if (line->timer_fd >= 0) {
+        epoll_ctl(master->epoll_fd, EPOLL_CTL_DEL, line->timer_fd, NULL);
+        close(line->timer_fd);
+        line->timer_fd = -1;
+    }
+}
+
+
+int sbus_master_submit(sbus_master_line_t *line, sbus_transaction_t *transaction) {
+    atomic_store_explicit(&transaction->done, 0, memory_order_relaxed);
+    transaction->result       = SBUS_INCOMPLETE_PACKET;
+    transaction->response_len = 0;
+    transaction->next         = NULL;
+
+    if (line->tail != NULL)
+        line->tail->next = transaction;
+    else
+        line->head = transaction;
+    line->tail = transaction;
+
+    start_next(line);
+    return 0;
+}
+
+
+/*
+ * Waits up to `timeout_ms` for activity on any line and processes it. Returns the number of events handled or -1.
+ */
+int sbus_master_poll(sbus_master_t *master, int timeout_ms) {
+    struct epoll_event events[MAX_EVENTS];
+
+    int num = epoll_wait(master->epoll_fd, events, MAX_EVENTS, timeout_ms);
+    if (num < 0)
+        return errno == EINTR ? 0 : -1;
+
+    for (int i = 0; i < num; i++) {
+        sbus_master_line_t *line = events[i].data.ptr;
+        handle_rx(line);
+        handle_timer(line);
+    }
+
+    return num;
+}
+
+
+int sbus_master_wait(sbus_master_t *master, sbus_transaction_t *transaction) {
+    while (!atomic_load_explicit(&transaction->done, memory_order_acquire)) {
+        if (sbus_master_poll(master, -1) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+
+uint64_t sbus_master_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+
+static void start_next(sbus_master_line_t *line) {
+    while (line->current == NULL && line->head != NULL) {
+        sbus_transaction_t *transaction = line->head;
+        line->head                      = transaction->next;
+        if (line->head == NULL)
+            line->tail = NULL;
+
+        line->current        = transaction;
+        line->received       = 0;
+        transaction->sent_us = sbus_master_now_us();
+
+        uint64_t timeout_us = line->timing != NULL ? sbus_timing_timeout_us(line->timing, &transaction->request)
+                                                    : (uint64_t)line->timeout_ms * 1000;
+        if (transaction->timeout_us != 0)
+            timeout_us = transaction->timeout_us;
+
+        if (sbus_command_describe(transaction->request.command)->kind == SBUS_COMMAND_KIND_UNKNOWN) {
+            finish(line, SBUS_UNKNOWN_COMMAND);     // No way to tell how long the answer is
+        } else if (line->timing != NULL &&
+                   sbus_timing_offline(line->timing, transaction->request.destination, transaction->sent_us)) {
+            finish(line, SBUS_TIMEOUT);     // Offline station, not worth the bus time until the backoff is over
+        } else if (transmit(line, &transaction->request) < 0) {
+            finish(line, SBUS_IO_ERROR);
+        } else if (sbus_packet_response_length(&transaction->request) == 0) {
+            // Broadcast: nothing to wait for but the guard time
+            if (arm_timer(line, broadcast_guard_us(line, &transaction->request)) < 0)
+                finish(line, SBUS_IO_ERROR);
+        } else if (arm_timer(line, timeout_us) < 0) {
+            finish(line, SBUS_IO_ERROR);
+        }
+    }
+}
+
+
+static void finish(sbus_master_line_t *line, sbus_result_t result) {
+    sbus_transaction_t *transaction = line->current;
+
+    line->current = NULL;
+    arm_timer(line, 0);
+
+    // Broadcasts only measure their guard time, and would all land under the broadcast address
+    if (result == SBUS_OK && line->latency != NULL && sbus_packet_response_length(&transaction->request) > 0)
+        sbus_latency_record(line->latency, transaction->request.destination, transaction->request.command,
+                            (unsigned long)(sbus_master_now_us() - transaction->sent_us));
+    if (result == SBUS_OK && line->timing != NULL)
+        sbus_timing_sample(line->timing, &transaction->request, sbus_master_now_us() - transaction->sent_us);
+
+    transaction->result = result;
+    atomic_store_explicit(&transaction->done, 1, memory_order_release);
+    if (transaction->callback != NULL)
+        transaction->callback(transaction);
+}
+
+
+static void handle_rx(sbus_master_line_t *line) {
+    for (;;) {
+        ssize_t res = read(line->fd, &line->rx[line->received], sizeof(line->rx) - line->received);
+        if (res <= 0)
+            break;
+
+        if (line->current == NULL || sbus_packet_response_length(&line->current->request) == 0) {
+            continue;     // Nobody is waiting for this, drop it
+        }
+
+        line->received += (size_t)res;
+
+        sbus_transaction_t *transaction = line->current;
+        size_t              len         = line->received;
+        sbus_result_t       result      = sbus_packet_validate_response_8bit(&transaction->request, line->rx, &len);
+
+        if (result == SBUS_INCOMPLETE_PACKET && line->received < sizeof(line->rx))
+            continue;
+
+        if (len > line->received)
+            len = line->received;
+        if (line->capture != NULL)
+            sbus_capture_8bit(line->capture, sbus_master_now_us(), SBUS_CAPTURE_RX, result, line->rx, line->received);
+        memcpy(transaction->response, line->rx, len);
+        transaction->response_len = len;
+        line->received            = 0;
+
+        finish(line, result);
+        start_next(line);
+    }
+}
+
+
+static void handle_timer(sbus_master_line_t *line) {
+    uint64_t expirations = 0;
+
+    if (read(line->timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations) || expirations == 0)
+        return;
+
+    if (line->current != NULL && sbus_packet_response_length(&line->current->request) == 0) {
+        finish(line, SBUS_OK);     // End of the broadcast guard time
+        start_next(line);
+    } else if (line->current != NULL) {
+        if (line->capture != NULL)
+            sbus_capture_8bit(line->capture, sbus_master_now_us(), SBUS_CAPTURE_RX, SBUS_TIMEOUT, line->rx,
+                              line->received);
+        tcflush(line->fd, TCIFLUSH);
+        line->received = 0;
+        if (line->timing != NULL)
+            sbus_timing_timeout(line->timing, line->current->request.destination, sbus_master_now_us());
+        finish(line, SBUS_TIMEOUT);
+        start_next(line);
+    }
+}
+
+
+static int transmit(sbus_master_line_t *line, const sbus_request_t *request) {
+    uint16_t words[SBUS_MASTER_MAX_RESPONSE + 4];
+    uint8_t  bytes[SBUS_MASTER_MAX_RESPONSE + 4];
+    size_t   len = sbus_packet_serialize_request(words, request);
+
+    for (size_t i = 0; i < len; i++) {
+        bytes[i] = (uint8_t)(words[i] & 0xFF);
+    }
+
+    if (line->capture != NULL)
+        sbus_capture_9bit(line->capture, sbus_master_now_us(), SBUS_CAPTURE_TX, SBUS_OK, words, len);
+
+    tcflush(line->fd, TCIFLUSH);
+
+    if (line->parity_mode) {
+        // The address character goes out alone with the parity bit set, the rest with the parity bit cleared
+        if (set_mark_parity(line->fd, 1) < 0 || write_all(line->fd, bytes, 1) < 0 || tcdrain(line->fd) < 0 ||
+            set_mark_parity(line->fd, 0) < 0)
+            return -1;
+        return write_all(line->fd, &bytes[1], len - 1);
+    } else {
+        return write_all(line->fd, bytes, len);
+    }
+}
+
+
+static int arm_timer(sbus_master_line_t *line, uint64_t timeout_us) {
+    struct itimerspec spec = {
+        .it_value = {.tv_sec = (time_t)(timeout_us / 1000000), .tv_nsec = (long)(timeout_us % 1000000) * 1000L},
+    };
+    return timerfd_settime(line->timer_fd, 0, &spec, NULL);
+}
+
+
+/*
+ * Time a broadcast keeps the line: taken from the wire model when there is one, otherwise from the speed of the port
+ * with a default turnaround. The line timeout is left when the speed cannot be told, e.g. for a pipe.
+ */
+static uint64_t broadcast_guard_us(const sbus_master_line_t *line, const sbus_request_t *request) {
+    sbus_wire_t    wire = {.format        = line->parity_mode ? SBUS_WIRE_PARITY : SBUS_WIRE_DATA,
+                           .turnaround_us = BROADCAST_TURNAROUND_US};
+    struct termios tty;
+
+    if (line->timing != NULL)
+        return sbus_wire_guard_us(&line->timing->wire, request);
+    if (tcgetattr(line->fd, &tty) < 0 || speed_to_baud(cfgetospeed(&tty), &wire.baud) < 0)
+        return (uint64_t)line->timeout_ms * 1000;
+    return sbus_wire_guard_us(&wire, request);
+}
+
+
+static int set_mark_parity(int fd, int mark) {
+    struct termios tty;
+    if (tcgetattr(fd, &tty) < 0)
+        return -1;
+
+    if (mark)
+        tty.c_cflag |= PARODD;
+    else
+        tty.c_cflag &= ~PARODD;
+
+    return tcsetattr(fd, TCSADRAIN, &tty);
+}
+
+
+static int write_all(int fd, const uint8_t *buffer, size_t len) {
+    while (len > 0) {
+        ssize_t res = write(fd, buffer, len);
+        if (res < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                struct pollfd pfd = {.fd = fd, .events = POLLOUT};
+                poll(&pfd, 1, -1);
+                continue;
+            } else if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        buffer += res;
+        len -= (size_t)res;
+    }
+    return 0;
+}
+
+
+static int baud_to_speed(unsigned baud, speed_t *speed) {
+    switch (baud) {
+        case 1200:
+            *speed = B1200;
+            break;
+        case 2400:
+            *speed = B2400;
+            break;
+        case 4800:
+            *speed = B4800;
+            break;
+        case 9600:
+            *speed = B9600;
+            break;
+        case 19200:
+            *speed = B19200;
+            break;
+        case 38400:
+            *speed = B38400;
+            break;
+        case 57600:
+            *speed = B57600;
+            break;
+        case 115200:
+            *speed = B115200;
+            break;
+        default:
+            return -1;
+    }
+    return 0;
+}
+
+
+static int speed_to_baud(speed_t speed, uint32_t *baud) {
+    switch (speed) {
+        case B1200:
+            *baud = 1200;
+            break;
+        case B2400:
+            *baud = 2400;
+            break;
+        case B4800:
+            *baud = 4800;
+            break;
+        case B9600:
+            *baud = 9600;
+            break;
+        case B19200:
+            *baud = 19200;
+            break;
+        case B38400:
+            *baud = 38400;
+            break;
+        case B57600:
+            *baud = 57600;
+            break;
+        case B115200:
+            *baud = 115200;
+            break;
+        default:
+            return -1;
+    }
+    return 0;
+}
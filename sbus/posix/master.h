@@ -0,0 +1,85 @@
+#ifndef SBUS_POSIX_MASTER_H_INCLUDED
+#define SBUS_POSIX_MASTER_H_INCLUDED
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "../capture.h"
+#include "../packet.h"
+#include "../stats.h"
+#include "../timing.h"
+
+#define SBUS_MASTER_MAX_RESPONSE 256
+
+
+typedef struct sbus_transaction sbus_transaction_t;
+
+/*
+ * A single request/response exchange. The structure is owned by the caller and must stay valid until it completes;
+ * completion is signalled both through `done` (for future-style waiting) and through the optional `callback`, which
+ * may submit further transactions. `done` is stored with release semantics once the result and the response are in
+ * place, so any thread can wait on it with an acquire load; it is set before the callback runs, so a transaction
+ * waited on from another thread should not have one.
+ */
+struct sbus_transaction {
+    sbus_request_t request;
+    uint8_t        response[SBUS_MASTER_MAX_RESPONSE];
+    size_t         response_len;
+    sbus_result_t  result;
+    atomic_int     done;
+
+    void (*callback)(sbus_transaction_t *transaction);
+    void    *arg;
+    uint32_t timeout_us;     // Serial lines only: replaces the line timeout when not 0
+
+    // Only used by `sbus_queue_submit`
+    unsigned priority;       // SBUS_PRIORITY_*, lower values are served first
+    uint64_t expires_us;     // Completed with SBUS_TIMEOUT if not transmitted by then (`sbus_master_now_us`); 0 never
+
+    // Bookkeeping of the transport currently carrying the transaction
+    sbus_transaction_t *next;
+    uint16_t            sequence;
+    unsigned            attempts;
+    uint64_t            deadline_ms;
+    uint64_t            sent_us;     // First transmission, for latency statistics
+    void               *owner;
+};
+
+
+typedef struct {
+    int      fd;
+    int      timer_fd;
+    int      parity_mode;     // Send the address character with mark parity (S-Bus parity mode)
+    unsigned timeout_ms;
+
+    sbus_transaction_t *head;
+    sbus_transaction_t *tail;
+    sbus_transaction_t *current;
+
+    uint8_t rx[SBUS_MASTER_MAX_RESPONSE];
+    size_t  received;
+
+    sbus_latency_table_t *latency;     // Optional, receives the latency of every successful exchange
+    sbus_capture_t       *capture;     // Optional, records every request and response
+    sbus_timing_t        *timing;      // Optional, replaces `timeout_ms` with learned per-station timeouts
+} sbus_master_line_t;
+
+
+typedef struct {
+    int epoll_fd;
+} sbus_master_t;
+
+
+int      sbus_master_open_serial(const char *path, unsigned baud);
+int      sbus_master_set_speed(int fd, unsigned baud);
+int      sbus_master_init(sbus_master_t *master);
+void     sbus_master_deinit(sbus_master_t *master);
+int      sbus_master_add_line(sbus_master_t *master, sbus_master_line_t *line, int fd, unsigned timeout_ms);
+void     sbus_master_remove_line(sbus_master_t *master, sbus_master_line_t *line);
+int      sbus_master_submit(sbus_master_line_t *line, sbus_transaction_t *transaction);
+int      sbus_master_poll(sbus_master_t *master, int timeout_ms);
+int      sbus_master_wait(sbus_master_t *master, sbus_transaction_t *transaction);
+uint64_t sbus_master_now_us(void);
+
+#endif
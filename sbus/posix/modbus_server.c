@@ -0,0 +1,225 @@
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../gateway.h"
+#include "master.h"
+#include "modbus_server.h"
+
+#define MAX_EVENTS 16
+
+
+static void accept_clients(sbus_modbus_server_t *server);
+static void handle_client(sbus_modbus_server_t *server, sbus_modbus_client_t *client);
+static void close_failed(sbus_modbus_server_t *server);
+static void pump(sbus_modbus_server_t *server);
+static void on_transaction(sbus_transaction_t *transaction);
+static void reply(sbus_gateway_t *gateway, void *client, const uint8_t *adu, size_t len);
+
+
+/*
+ * Listens on `ip`:`port` (0 for any free port, see `server->port`) for Modbus TCP clients; `line` must already be
+ * a line of `master`.
+ */
+int sbus_modbus_server_init(sbus_modbus_server_t *server, sbus_master_t *master, sbus_master_line_t *line,
+                            const sbus_gateway_config_t *config, const char *ip, uint16_t port) {
+    memset(server, 0, sizeof(sbus_modbus_server_t));
+    server->master    = master;
+    server->line      = line;
+    server->epoll_fd  = -1;
+    server->listen_fd = -1;
+    for (size_t i = 0; i < SBUS_MODBUS_MAX_CLIENTS; i++)
+        server->clients[i].fd = -1;
+
+    if (sbus_gateway_init(&server->gateway, config, server->reads, SBUS_MODBUS_READS, server->calls,
+                          SBUS_MODBUS_CALLS) != SBUS_OK) {
+        errno = EINVAL;
+        return -1;
+    }
+    server->gateway.reply = reply;
+    server->gateway.arg   = server;
+
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons(port)};
+    if (inet_pton(AF_INET, ip, &address.sin_addr) != 1) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int       reuse   = 1;
+    socklen_t size    = sizeof(address);
+    server->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    server->epoll_fd  = epoll_create1(EPOLL_CLOEXEC);
+    if (server->listen_fd < 0 || server->epoll_fd < 0 ||
+        setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0 ||
+        bind(server->listen_fd, (struct sockaddr *)&address, sizeof(address)) < 0 ||
+        listen(server->listen_fd, SBUS_MODBUS_MAX_CLIENTS) < 0 ||
+        getsockname(server->listen_fd, (struct sockaddr *)&address, &size) < 0) {
+        sbus_modbus_server_deinit(server);
+        return -1;
+    }
+    server->port = ntohs(address.sin_port);
+
+    // The listening socket and the master are told apart from the clients by their pointers
+    struct epoll_event listen_event = {.events = EPOLLIN, .data.ptr = &server->listen_fd};
+    struct epoll_event master_event = {.events = EPOLLIN, .data.ptr = server->master};
+    if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &listen_event) < 0 ||
+        epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, master->epoll_fd, &master_event) < 0) {
+        sbus_modbus_server_deinit(server);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+void sbus_modbus_server_deinit(sbus_modbus_server_t *server) {
+    for (size_t i = 0; i < SBUS_MODBUS_MAX_CLIENTS; i++) {
+        if (server->clients[i].fd >= 0)
+            close(server->clients[i].fd);
+        server->clients[i].fd = -1;
+    }
+    if (server->listen_fd >= 0)
+        close(server->listen_fd);
+    if (server->epoll_fd >= 0)
+        close(server->epoll_fd);
+    server->listen_fd = -1;
+    server->epoll_fd  = -1;
+}
+
+
+/*
+ * Waits up to `timeout_ms` for clients, requests and the serial line, and processes them. Returns the number of
+ * events handled or -1.
+ */
+int sbus_modbus_server_poll(sbus_modbus_server_t *server, int timeout_ms) {
+    struct epoll_event events[MAX_EVENTS];
+
+    int num = epoll_wait(server->epoll_fd, events, MAX_EVENTS, timeout_ms);
+    if (num < 0)
+        return errno == EINTR ? 0 : -1;
+
+    for (int i = 0; i < num; i++) {
+        if (events[i].data.ptr == &server->listen_fd)
+            accept_clients(server);
+        else if (events[i].data.ptr == server->master)
+            sbus_master_poll(server->master, 0);
+        else
+            handle_client(server, events[i].data.ptr);
+    }
+
+    close_failed(server);
+    pump(server);
+    return num;
+}
+
+
+static void accept_clients(sbus_modbus_server_t *server) {
+    int fd;
+
+    while ((fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        sbus_modbus_client_t *client = NULL;
+        for (size_t i = 0; i < SBUS_MODBUS_MAX_CLIENTS && client == NULL; i++) {
+            if (server->clients[i].fd < 0)
+                client = &server->clients[i];
+        }
+
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = client};
+        if (client == NULL || epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            close(fd);     // No room
+            continue;
+        }
+
+        memset(client, 0, sizeof(sbus_modbus_client_t));
+        client->fd = fd;
+    }
+}
+
+
+static void handle_client(sbus_modbus_server_t *server, sbus_modbus_client_t *client) {
+    for (;;) {
+        ssize_t res = recv(client->fd, &client->rx[client->received], sizeof(client->rx) - client->received, 0);
+        if (res == 0 || (res < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            client->failed = 1;
+            return;
+        }
+        if (res < 0)
+            return;
+
+        client->received += (size_t)res;
+
+        // Clients may pipeline requests
+        size_t        consumed = 0;
+        sbus_result_t result   = SBUS_OK;
+        while (result == SBUS_OK && !client->failed) {
+            size_t len = client->received - consumed;
+            result     = sbus_gateway_submit(&server->gateway, client, &client->rx[consumed], &len);
+            if (result == SBUS_OK)
+                consumed += len;
+        }
+        if (result == SBUS_INVALID_DATA)
+            client->failed = 1;
+        if (client->failed)
+            return;
+
+        memmove(client->rx, &client->rx[consumed], client->received - consumed);
+        client->received -= consumed;
+    }
+}
+
+
+static void close_failed(sbus_modbus_server_t *server) {
+    for (size_t i = 0; i < SBUS_MODBUS_MAX_CLIENTS; i++) {
+        sbus_modbus_client_t *client = &server->clients[i];
+        if (client->fd >= 0 && client->failed) {
+            sbus_gateway_forget(&server->gateway, client);
+            epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+            close(client->fd);
+            client->fd = -1;
+        }
+    }
+}
+
+
+/*
+ * Keeps one exchange of the gateway on the line.
+ */
+static void pump(sbus_modbus_server_t *server) {
+    while (!server->busy) {
+        if (sbus_gateway_next(&server->gateway, &server->exchange, &server->transaction.request) != SBUS_OK)
+            return;
+
+        server->transaction.callback   = on_transaction;
+        server->transaction.arg        = server;
+        server->transaction.timeout_us = 0;
+
+        server->busy = 1;
+        sbus_master_submit(server->line, &server->transaction);
+    }
+}
+
+
+static void on_transaction(sbus_transaction_t *transaction) {
+    sbus_modbus_server_t *server = transaction->arg;
+
+    server->busy = 0;
+    sbus_gateway_complete(&server->gateway, &server->exchange, transaction->result, transaction->response,
+                          transaction->response_len);
+}
+
+
+static void reply(sbus_gateway_t *gateway, void *arg, const uint8_t *adu, size_t len) {
+    sbus_modbus_client_t *client = arg;
+    (void)gateway;
+
+    if (client->failed)
+        return;
+    if (send(client->fd, adu, len, MSG_NOSIGNAL | MSG_DONTWAIT) != (ssize_t)len)
+        client->failed = 1;
+}
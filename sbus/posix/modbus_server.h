@@ -0,0 +1,51 @@
+#ifndef SBUS_POSIX_MODBUS_SERVER_H_INCLUDED
+#define SBUS_POSIX_MODBUS_SERVER_H_INCLUDED
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "../gateway.h"
+#include "master.h"
+
+#define SBUS_MODBUS_MAX_CLIENTS 16
+#define SBUS_MODBUS_READS       32
+#define SBUS_MODBUS_CALLS       64
+
+
+typedef struct {
+    int     fd;          // -1 when the slot is free
+    int     failed;      // Closed at the end of the current poll
+    uint8_t rx[2 * SBUS_MODBUS_MAX_ADU];
+    size_t  received;
+} sbus_modbus_client_t;
+
+
+/*
+ * Modbus TCP gateway (see sbus/gateway.h) to the stations of a serial line of `master`. The server waits on its own
+ * epoll set, holding the listening socket, the clients and the epoll set of the master, so that a single
+ * `sbus_modbus_server_poll` serves both sides. A client that does not take its responses is dropped.
+ */
+typedef struct {
+    sbus_gateway_t      gateway;
+    sbus_gateway_read_t reads[SBUS_MODBUS_READS];
+    sbus_gateway_call_t calls[SBUS_MODBUS_CALLS];
+
+    sbus_master_t          *master;
+    sbus_master_line_t     *line;
+    sbus_gateway_exchange_t exchange;
+    sbus_transaction_t      transaction;
+    int                     busy;
+
+    int                  epoll_fd;
+    int                  listen_fd;
+    uint16_t             port;     // Bound port, the one picked by the system if 0 was asked for
+    sbus_modbus_client_t clients[SBUS_MODBUS_MAX_CLIENTS];
+} sbus_modbus_server_t;
+
+
+int  sbus_modbus_server_init(sbus_modbus_server_t *server, sbus_master_t *master, sbus_master_line_t *line,
+                             const sbus_gateway_config_t *config, const char *ip, uint16_t port);
+void sbus_modbus_server_deinit(sbus_modbus_server_t *server);
+int  sbus_modbus_server_poll(sbus_modbus_server_t *server, int timeout_ms);
+
+#endif
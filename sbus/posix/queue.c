@@ -0,0 +1,219 @@
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "master.h"
+#include "queue.h"
+
+
+static void               *worker(void *arg);
+static void                collect(sbus_queue_t *queue);
+static void                dispatch(sbus_queue_t *queue);
+static sbus_transaction_t *pop(sbus_queue_t *queue);
+static void                complete(sbus_transaction_t *transaction, sbus_result_t result);
+
+
+/*
+ * Sets up a private event loop around `fd`, a configured serial port (see `sbus_master_open_serial`). The line
+ * (`queue->line`) can be tuned before the worker is started.
+ */
+int sbus_queue_init(sbus_queue_t *queue, int fd, unsigned timeout_ms) {
+    memset(queue, 0, sizeof(sbus_queue_t));
+    queue->event_fd = -1;
+
+    if (sbus_master_init(&queue->master) < 0)
+        return -1;
+    if (sbus_master_add_line(&queue->master, &queue->line, fd, timeout_ms) < 0) {
+        sbus_master_deinit(&queue->master);
+        return -1;
+    }
+
+    queue->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (queue->event_fd < 0) {
+        sbus_queue_deinit(queue);
+        return -1;
+    }
+
+    for (size_t i = 0; i < SBUS_PRIORITIES; i++)
+        atomic_init(&queue->incoming[i], NULL);
+    atomic_init(&queue->running, 0);
+    atomic_init(&queue->expired, 0);
+    return 0;
+}
+
+
+/*
+ * The serial port is left open, it belongs to the caller.
+ */
+void sbus_queue_deinit(sbus_queue_t *queue) {
+    sbus_master_remove_line(&queue->master, &queue->line);
+    sbus_master_deinit(&queue->master);
+    if (queue->event_fd >= 0)
+        close(queue->event_fd);
+    queue->event_fd = -1;
+}
+
+
+int sbus_queue_start(sbus_queue_t *queue) {
+    atomic_store(&queue->running, 1);
+
+    int res = pthread_create(&queue->thread, NULL, worker, queue);
+    if (res != 0) {
+        atomic_store(&queue->running, 0);
+        errno = res;
+        return -1;
+    }
+    return 0;
+}
+
+
+/*
+ * Lets the exchange on the wire (if any) finish and joins the worker. Transactions still waiting are completed with
+ * SBUS_IO_ERROR from the calling thread.
+ */
+void sbus_queue_stop(sbus_queue_t *queue) {
+    uint64_t one = 1;
+
+    atomic_store(&queue->running, 0);
+    if (write(queue->event_fd, &one, sizeof(one)) < 0) {
+        // The counter is already non zero, the worker will wake up anyway
+    }
+    pthread_join(queue->thread, NULL);
+
+    collect(queue);
+    sbus_transaction_t *transaction;
+    while ((transaction = pop(queue)) != NULL)
+        complete(transaction, SBUS_IO_ERROR);
+}
+
+
+/*
+ * Safe to call from any thread, including transaction callbacks. Lock free: the only system call is the wake up of
+ * the worker, and only when the priority class was empty.
+ */
+int sbus_queue_submit(sbus_queue_t *queue, sbus_transaction_t *transaction) {
+    unsigned priority = transaction->priority < SBUS_PRIORITIES ? transaction->priority : SBUS_PRIORITY_LOW;
+
+    atomic_store_explicit(&transaction->done, 0, memory_order_relaxed);
+    transaction->result       = SBUS_INCOMPLETE_PACKET;
+    transaction->response_len = 0;
+
+    sbus_transaction_t *top = atomic_load_explicit(&queue->incoming[priority], memory_order_relaxed);
+    do {
+        transaction->next = top;
+    } while (!atomic_compare_exchange_weak_explicit(&queue->incoming[priority], &top, transaction,
+                                                    memory_order_release, memory_order_relaxed));
+
+    if (top == NULL) {
+        uint64_t one = 1;
+        if (write(queue->event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+            return -1;
+    }
+    return 0;
+}
+
+
+static void *worker(void *arg) {
+    sbus_queue_t *queue  = arg;
+    struct pollfd fds[2] = {
+        {.fd = queue->event_fd, .events = POLLIN},
+        {.fd = queue->master.epoll_fd, .events = POLLIN},
+    };
+
+    while (atomic_load(&queue->running) || queue->line.current != NULL) {
+        collect(queue);
+        dispatch(queue);
+        if (!atomic_load(&queue->running) && queue->line.current == NULL)
+            break;
+
+        if (poll(fds, 2, -1) < 0 && errno != EINTR)
+            break;
+
+        if (fds[0].revents & POLLIN) {
+            uint64_t count;
+            if (read(queue->event_fd, &count, sizeof(count)) < 0) {
+                // Spurious wake up, nothing to acknowledge
+            }
+        }
+        if (fds[1].revents & POLLIN)
+            sbus_master_poll(&queue->master, 0);
+    }
+
+    return NULL;
+}
+
+
+/*
+ * Moves everything the producers pushed to the private queues. A stack holds the newest transaction first, so it is
+ * reversed on the way.
+ */
+static void collect(sbus_queue_t *queue) {
+    for (size_t priority = 0; priority < SBUS_PRIORITIES; priority++) {
+        sbus_transaction_t *stack = atomic_exchange_explicit(&queue->incoming[priority], NULL, memory_order_acquire);
+        sbus_transaction_t *first = NULL;
+        sbus_transaction_t *last  = stack;
+
+        while (stack != NULL) {
+            sbus_transaction_t *next = stack->next;
+            stack->next              = first;
+            first                    = stack;
+            stack                    = next;
+        }
+
+        if (first == NULL)
+            continue;
+        if (queue->tail[priority] != NULL)
+            queue->tail[priority]->next = first;
+        else
+            queue->head[priority] = first;
+        queue->tail[priority] = last;
+    }
+}
+
+
+static void dispatch(sbus_queue_t *queue) {
+    while (queue->line.current == NULL && atomic_load(&queue->running)) {
+        sbus_transaction_t *transaction = pop(queue);
+        if (transaction == NULL)
+            return;
+
+        if (transaction->expires_us != 0 && sbus_master_now_us() >= transaction->expires_us) {
+            atomic_fetch_add_explicit(&queue->expired, 1, memory_order_relaxed);
+            complete(transaction, SBUS_TIMEOUT);
+            continue;
+        }
+
+        // Transactions that cannot be sent (broadcasts, errors) complete right away and the loop goes on
+        sbus_master_submit(&queue->line, transaction);
+    }
+}
+
+
+static sbus_transaction_t *pop(sbus_queue_t *queue) {
+    for (size_t priority = 0; priority < SBUS_PRIORITIES; priority++) {
+        sbus_transaction_t *transaction = queue->head[priority];
+        if (transaction == NULL)
+            continue;
+
+        queue->head[priority] = transaction->next;
+        if (queue->head[priority] == NULL)
+            queue->tail[priority] = NULL;
+        transaction->next = NULL;
+        return transaction;
+    }
+    return NULL;
+}
+
+
+static void complete(sbus_transaction_t *transaction, sbus_result_t result) {
+    transaction->result = result;
+    atomic_store_explicit(&transaction->done, 1, memory_order_release);
+    if (transaction->callback != NULL)
+        transaction->callback(transaction);
+}
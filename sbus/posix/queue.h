@@ -0,0 +1,52 @@
+#ifndef SBUS_POSIX_QUEUE_H_INCLUDED
+#define SBUS_POSIX_QUEUE_H_INCLUDED
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "master.h"
+
+
+typedef enum {
+    SBUS_PRIORITY_HIGH = 0,     // Alarms
+    SBUS_PRIORITY_NORMAL,
+    SBUS_PRIORITY_LOW,     // Historian, bulk transfers
+} sbus_priority_t;
+
+#define SBUS_PRIORITIES 3
+
+
+/*
+ * A serial line shared by several threads. Any thread can submit transactions without locking; a single worker
+ * thread owns the line, always transmits the oldest transaction of the most urgent priority class next, and drops
+ * those whose `expires_us` passed while they were waiting. Completions (including drops, reported as SBUS_TIMEOUT)
+ * are delivered through the transaction callback, which runs on the worker thread and may submit again; transactions
+ * without a callback can be waited on from the submitting thread through `done`.
+ */
+typedef struct {
+    sbus_master_t      master;
+    sbus_master_line_t line;
+    int                event_fd;
+    pthread_t          thread;
+    atomic_int         running;
+
+    // Lock free stacks pushed by the producers, emptied all at once by the worker
+    _Atomic(sbus_transaction_t *) incoming[SBUS_PRIORITIES];
+
+    // Owned by the worker: submission order queues, one per priority class
+    sbus_transaction_t *head[SBUS_PRIORITIES];
+    sbus_transaction_t *tail[SBUS_PRIORITIES];
+
+    atomic_ulong expired;
+} sbus_queue_t;
+
+
+int  sbus_queue_init(sbus_queue_t *queue, int fd, unsigned timeout_ms);
+void sbus_queue_deinit(sbus_queue_t *queue);
+int  sbus_queue_start(sbus_queue_t *queue);
+void sbus_queue_stop(sbus_queue_t *queue);
+int  sbus_queue_submit(sbus_queue_t *queue, sbus_transaction_t *transaction);
+
+#endif
@@ -0,0 +1,115 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "packet.h"
+#include "scheduler.h"
+#include "wire.h"
+
+
+#define PPM 1000000ULL
+
+
+/*
+ * Computes the cost of every poll and the planned utilization, and releases all polls at `now_us`. The polls are
+ * reported feasible when the utilization leaves room for the longest exchange within the shortest period: that
+ * is the blocking a poll may suffer because exchanges cannot be interrupted.
+ */
+sbus_result_t sbus_scheduler_init(sbus_scheduler_t *scheduler, const sbus_wire_t *wire, sbus_poll_t *polls,
+                                  size_t num_polls, uint64_t now_us) {
+    uint64_t utilization = 0;
+    uint32_t max_cost    = 0;
+    uint32_t min_period  = UINT32_MAX;
+
+    if (wire->baud == 0)
+        return SBUS_INVALID_ARGS;
+
+    for (size_t i = 0; i < num_polls; i++) {
+        sbus_poll_t *poll = &polls[i];
+        if (poll->period_us == 0)
+            return SBUS_INVALID_ARGS;
+
+        poll->cost_us     = sbus_wire_exchange_us(wire, &poll->request);
+        poll->release_us  = now_us;
+        poll->deadline_us = now_us + poll->period_us;
+        poll->polls       = 0;
+        poll->misses      = 0;
+
+        utilization += (uint64_t)poll->cost_us * PPM / poll->period_us;
+        if (poll->cost_us > max_cost)
+            max_cost = poll->cost_us;
+        if (poll->period_us < min_period)
+            min_period = poll->period_us;
+    }
+
+    scheduler->wire        = *wire;
+    scheduler->polls       = polls;
+    scheduler->num_polls   = num_polls;
+    scheduler->planned_ppm = utilization > UINT32_MAX ? UINT32_MAX : (uint32_t)utilization;
+    scheduler->feasible    = num_polls == 0 || utilization + (uint64_t)max_cost * PPM / min_period <= PPM;
+    scheduler->start_us    = now_us;
+    scheduler->busy_us     = 0;
+    scheduler->misses      = 0;
+    return SBUS_OK;
+}
+
+
+/*
+ * Picks the released poll with the earliest deadline and releases its next period. Periods that are already over are
+ * counted as misses and dropped rather than polled back to back. Returns SBUS_NOT_FOUND and the time until the next
+ * release when no poll is ready.
+ */
+sbus_result_t sbus_scheduler_next(sbus_scheduler_t *scheduler, uint64_t now_us, sbus_poll_t **poll,
+                                  uint64_t *wait_us) {
+    sbus_poll_t *earliest = NULL;
+    uint64_t     release  = UINT64_MAX;
+
+    for (size_t i = 0; i < scheduler->num_polls; i++) {
+        sbus_poll_t *candidate = &scheduler->polls[i];
+
+        while (candidate->release_us + candidate->period_us <= now_us) {
+            candidate->release_us += candidate->period_us;
+            candidate->misses++;
+            scheduler->misses++;
+        }
+
+        if (candidate->release_us > now_us) {
+            if (candidate->release_us < release)
+                release = candidate->release_us;
+        } else if (earliest == NULL || candidate->release_us + candidate->period_us <
+                                           earliest->release_us + earliest->period_us) {
+            earliest = candidate;
+        }
+    }
+
+    if (earliest == NULL) {
+        *wait_us = release == UINT64_MAX ? 0 : release - now_us;
+        return SBUS_NOT_FOUND;
+    }
+
+    earliest->deadline_us = earliest->release_us + earliest->period_us;
+    earliest->release_us  = earliest->deadline_us;
+
+    *poll = earliest;
+    return SBUS_OK;
+}
+
+
+/*
+ * Accounts for a finished exchange that kept the bus busy for `busy_us` (measured, or `poll->cost_us`).
+ */
+void sbus_scheduler_complete(sbus_scheduler_t *scheduler, sbus_poll_t *poll, uint64_t now_us, uint32_t busy_us) {
+    poll->polls++;
+    scheduler->busy_us += busy_us;
+
+    if (now_us > poll->deadline_us) {
+        poll->misses++;
+        scheduler->misses++;
+    }
+}
+
+
+uint32_t sbus_scheduler_measured_ppm(const sbus_scheduler_t *scheduler, uint64_t now_us) {
+    if (now_us <= scheduler->start_us)
+        return 0;
+    return (uint32_t)(scheduler->busy_us * PPM / (now_us - scheduler->start_us));
+}
@@ -0,0 +1,53 @@
+#ifndef SBUS_SCHEDULER_H_INCLUDED
+#define SBUS_SCHEDULER_H_INCLUDED
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "packet.h"
+#include "wire.h"
+
+
+/*
+ * A request polled every `period_us`; polls sharing a period form a group (e.g. alarm flags every 200 ms). The
+ * deadline of every poll is the end of its period.
+ */
+typedef struct {
+    sbus_request_t request;
+    uint32_t       period_us;
+    void          *arg;
+
+    // Maintained by the scheduler
+    uint32_t      cost_us;     // Bus time of one exchange according to the wire model
+    uint64_t      release_us;
+    uint64_t      deadline_us;
+    unsigned long polls;
+    unsigned long misses;     // Completed after the deadline, or skipped because the bus fell a whole period behind
+} sbus_poll_t;
+
+
+/*
+ * Earliest deadline first dispatcher for a single line. Utilizations are in parts per million of the bus time.
+ */
+typedef struct {
+    sbus_wire_t  wire;
+    sbus_poll_t *polls;
+    size_t       num_polls;
+
+    uint32_t planned_ppm;
+    int      feasible;     // The polls are guaranteed to meet their deadlines
+
+    uint64_t      start_us;
+    uint64_t      busy_us;
+    unsigned long misses;
+} sbus_scheduler_t;
+
+
+sbus_result_t sbus_scheduler_init(sbus_scheduler_t *scheduler, const sbus_wire_t *wire, sbus_poll_t *polls,
+                                  size_t num_polls, uint64_t now_us);
+sbus_result_t sbus_scheduler_next(sbus_scheduler_t *scheduler, uint64_t now_us, sbus_poll_t **poll,
+                                  uint64_t *wait_us);
+void     sbus_scheduler_complete(sbus_scheduler_t *scheduler, sbus_poll_t *poll, uint64_t now_us, uint32_t busy_us);
+uint32_t sbus_scheduler_measured_ppm(const sbus_scheduler_t *scheduler, uint64_t now_us);
+
+#endif
@@ -0,0 +1,288 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "datamode.h"
+#include "packet.h"
+#include "parser.h"
+#include "simulator.h"
+#include "slave.h"
+#include "wire.h"
+
+
+static int      deliver(sbus_sim_t *sim, size_t len, uint16_t *response, size_t capacity, sbus_sim_station_t **from);
+static size_t   characters(const sbus_sim_t *sim, const uint16_t *words, size_t len);
+static void     damage(sbus_sim_t *sim, uint16_t *words, size_t len);
+static int      chance(sbus_sim_t *sim, uint32_t ppm);
+static uint32_t next_random(sbus_sim_t *sim);
+static size_t   bucket(uint64_t value);
+static uint64_t bucket_start(size_t index);
+
+
+/*
+ * Starts an empty segment at time 0. The same seed gives the same run.
+ */
+sbus_result_t sbus_sim_init(sbus_sim_t *sim, const sbus_wire_t *wire, uint32_t seed) {
+    if (wire->baud == 0)
+        return SBUS_INVALID_ARGS;
+
+    memset(sim, 0, sizeof(sbus_sim_t));
+    sim->wire   = *wire;
+    sim->random = seed != 0 ? seed : 1;
+    sbus_parser_init(&sim->parser);
+    return SBUS_OK;
+}
+
+
+/*
+ * Connects a station to the segment, at the address of its slave.
+ */
+sbus_result_t sbus_sim_attach(sbus_sim_t *sim, sbus_sim_station_t *station) {
+    uint8_t address = station->slave->station;
+
+    if (address == SBUS_BROADCAST_ADDRESS || sim->stations[address] != NULL)
+        return SBUS_INVALID_ARGS;
+
+    station->requests      = 0;
+    station->answered      = 0;
+    sim->stations[address] = station;
+    return SBUS_OK;
+}
+
+
+/*
+ * Runs one master transaction starting at `now_us`. The response is left in `response` (`len` words, at most the
+ * initial `len`) and the result is the one of the master validation, or SBUS_TIMEOUT when nothing valid arrived
+ * within `timeout_us` from the start of the request. Broadcasts complete when the request is on the wire.
+ */
+sbus_result_t sbus_sim_exchange(sbus_sim_t *sim, const sbus_request_t *request, uint32_t timeout_us,
+                                uint16_t *response, size_t *len) {
+    uint64_t            start   = sim->now_us;
+    size_t              words   = sbus_packet_serialize_request(sim->words, request);
+    uint64_t            sent    = start + sbus_wire_characters_us(&sim->wire, characters(sim, sim->words, words));
+    sbus_sim_station_t *station = NULL;
+    int                 answer  = 0;
+
+    sim->exchanges++;
+    sim->busy_us += sent - start;
+
+    if (start < sim->busy_until_us) {
+        // A late answer is still on the line: both frames are garbled
+        sim->collisions++;
+    } else {
+        if (chance(sim, sim->noise_ppm))
+            damage(sim, sim->words, words);
+        answer = deliver(sim, words, response, *len, &station);
+    }
+    sim->busy_until_us = 0;
+
+    if (request->destination == SBUS_BROADCAST_ADDRESS) {
+        sim->now_us = sent;
+        sim->ok++;
+        *len = 0;
+        return SBUS_OK;
+    }
+
+    uint64_t deadline = start + timeout_us;
+    if (answer > 0) {
+        uint64_t turnaround = station->turnaround_us;
+        if (station->jitter_us > 0)
+            turnaround += next_random(sim) % (station->jitter_us + 1);
+
+        uint64_t reply = sent + turnaround;
+        uint64_t end   = reply + sbus_wire_characters_us(&sim->wire, characters(sim, response, (size_t)answer));
+        sim->busy_us += end - reply;
+
+        if (end <= deadline) {
+            sbus_request_t copy = *request;
+            sbus_result_t  res;
+
+            sim->now_us = end;
+            *len        = (size_t)answer;
+            res         = sbus_packet_validate_response_9bit(&copy, response, len);
+            if (res == SBUS_OK) {
+                sim->ok++;
+                sbus_sim_histogram_add(&sim->latency, end - start);
+            } else if (res == SBUS_WRONG_CRC) {
+                sim->wrong_crc++;
+            } else {
+                sim->invalid++;
+            }
+            return res;
+        }
+
+        sim->busy_until_us = end;
+    }
+
+    sim->now_us = deadline > sent ? deadline : sent;
+    sim->timeouts++;
+    *len = 0;
+    return SBUS_TIMEOUT;
+}
+
+
+/*
+ * Leaves the line idle for `us`.
+ */
+void sbus_sim_wait(sbus_sim_t *sim, uint64_t us) {
+    sim->now_us += us;
+}
+
+
+/*
+ * Fraction of the elapsed time the line carried characters.
+ */
+uint32_t sbus_sim_utilization_ppm(const sbus_sim_t *sim) {
+    if (sim->now_us == 0)
+        return 0;
+    return (uint32_t)(sim->busy_us * SBUS_SIM_PPM / sim->now_us);
+}
+
+
+void sbus_sim_histogram_add(sbus_sim_histogram_t *histogram, uint64_t value_us) {
+    histogram->count++;
+    histogram->total_us += value_us;
+    if (value_us > histogram->max_us)
+        histogram->max_us = value_us;
+    histogram->buckets[bucket(value_us)]++;
+}
+
+
+/*
+ * Upper bound of the bucket holding the `permille`-th value (500 for the median, 990 for the 99th percentile).
+ */
+uint64_t sbus_sim_histogram_percentile(const sbus_sim_histogram_t *histogram, uint32_t permille) {
+    unsigned long rank = (unsigned long)(((uint64_t)histogram->count * permille + 999) / 1000);
+    unsigned long seen = 0;
+
+    if (histogram->count == 0)
+        return 0;
+    if (rank == 0)
+        rank = 1;
+
+    for (size_t i = 0; i < SBUS_SIM_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= rank) {
+            uint64_t limit = i + 1 < SBUS_SIM_BUCKETS ? bucket_start(i + 1) - 1 : histogram->max_us;
+            return limit < histogram->max_us ? limit : histogram->max_us;
+        }
+    }
+
+    return histogram->max_us;
+}
+
+
+/*
+ * Hands the request on the line to the slaves, through the same parser a station would run. Returns the number of
+ * response words and the station answering, or 0 when nobody answers.
+ */
+static int deliver(sbus_sim_t *sim, size_t len, uint16_t *response, size_t capacity, sbus_sim_station_t **from) {
+    const uint16_t *words = sim->words;
+    sbus_result_t   res   = SBUS_INCOMPLETE_PACKET;
+
+    // Every frame starts on an idle line
+    sbus_parser_reset(&sim->parser);
+    while (len > 0) {
+        size_t consumed = len;
+        res             = sbus_parser_feed(&sim->parser, words, &consumed);
+        words += consumed;
+        len -= consumed;
+        if (res != SBUS_INCOMPLETE_PACKET && len > 0)
+            sbus_parser_reset(&sim->parser);
+    }
+    if (res != SBUS_OK)
+        return 0;
+
+    const sbus_request_t *request = &sim->parser.request;
+    if (request->destination == SBUS_BROADCAST_ADDRESS) {
+        for (size_t i = 0; i < SBUS_SIM_STATIONS; i++) {
+            if (sim->stations[i] != NULL) {
+                sim->stations[i]->requests++;
+                sbus_slave_handle_request(sim->stations[i]->slave, request, response, capacity);
+            }
+        }
+        return 0;
+    }
+
+    sbus_sim_station_t *station = sim->stations[request->destination];
+    if (station == NULL)
+        return 0;
+
+    station->requests++;
+    if (chance(sim, station->drop_ppm))
+        return 0;
+
+    int answer = sbus_slave_handle_request(station->slave, request, response, capacity);
+    if (answer <= 0)
+        return 0;
+
+    if (chance(sim, station->corrupt_ppm))
+        damage(sim, response, (size_t)answer);
+    station->answered++;
+    *from = station;
+    return answer;
+}
+
+
+/*
+ * Characters on the wire for a frame: one per word in parity mode, SYN, attribute and escapes in data mode.
+ */
+static size_t characters(const sbus_sim_t *sim, const uint16_t *words, size_t len) {
+    if (sim->wire.format != SBUS_WIRE_DATA)
+        return len;
+
+    size_t count = 2 + len;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t byte = (uint8_t)(words[i] & 0xFF);
+        if (byte == SBUS_DATA_MODE_SYN || byte == SBUS_DATA_MODE_DLE)
+            count++;
+    }
+    return count;
+}
+
+
+/*
+ * Flips a data bit of a word other than the first, so the frame keeps its start but fails its CRC.
+ */
+static void damage(sbus_sim_t *sim, uint16_t *words, size_t len) {
+    if (len < 2)
+        return;
+    words[1 + next_random(sim) % (len - 1)] ^= (uint16_t)(1 << (next_random(sim) % 8));
+}
+
+
+static int chance(sbus_sim_t *sim, uint32_t ppm) {
+    return ppm > 0 && next_random(sim) % SBUS_SIM_PPM < ppm;
+}
+
+
+static uint32_t next_random(sbus_sim_t *sim) {
+    // xorshift32
+    sim->random ^= sim->random << 13;
+    sim->random ^= sim->random >> 17;
+    sim->random ^= sim->random << 5;
+    return sim->random;
+}
+
+
+/*
+ * Values below 8 have their own bucket, larger ones are split in 8 buckets per power of two.
+ */
+static size_t bucket(uint64_t value) {
+    if (value < 8)
+        return (size_t)value;
+
+    unsigned msb = 3;
+    while ((value >> (msb + 1)) != 0)
+        msb++;
+
+    size_t index = (msb - 2) * 8 + ((value >> (msb - 3)) & 7);
+    return index < SBUS_SIM_BUCKETS ? index : SBUS_SIM_BUCKETS - 1;
+}
+
+
+static uint64_t bucket_start(size_t index) {
+    if (index < 8)
+        return index;
+    return (uint64_t)(8 + index % 8) << (index / 8 - 1);
+}
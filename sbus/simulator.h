@@ -0,0 +1,84 @@
+#ifndef SBUS_SIMULATOR_H_INCLUDED
+#define SBUS_SIMULATOR_H_INCLUDED
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "packet.h"
+#include "parser.h"
+#include "slave.h"
+#include "wire.h"
+
+#define SBUS_SIM_STATIONS  256
+#define SBUS_SIM_BUCKETS   256     // 8 buckets per power of two, about 12% resolution up to 2^34 microseconds
+#define SBUS_SIM_MAX_WORDS 260     // Address, command, up to 255 data words and CRC
+#define SBUS_SIM_PPM       1000000
+
+
+/*
+ * Value distribution with bounded relative error, for latency percentiles.
+ */
+typedef struct {
+    unsigned long count;
+    uint64_t      total_us;
+    uint64_t      max_us;
+    unsigned long buckets[SBUS_SIM_BUCKETS];
+} sbus_sim_histogram_t;
+
+
+/*
+ * A simulated station: a slave answering after `turnaround_us` plus a uniformly distributed jitter. Fault rates are
+ * in parts per million of the requests addressed to the station.
+ */
+typedef struct {
+    sbus_slave_t *slave;
+    uint32_t      turnaround_us;     // From the end of the request to the start of the response
+    uint32_t      jitter_us;
+    uint32_t      drop_ppm;        // Requests left unanswered
+    uint32_t      corrupt_ppm;     // Responses with a damaged word
+
+    unsigned long requests;     // Requests received intact
+    unsigned long answered;
+} sbus_sim_station_t;
+
+
+/*
+ * Deterministic simulation of an RS-485 segment in 9-bit (parity) or data mode. Time is virtual: every exchange
+ * moves `now_us` forward by the character times of the frames on the wire and the turnaround of the station. The
+ * request is serialized by the master code, parsed by the slave parser, executed by the slave and the response is
+ * validated like the master does. Answers arriving after the master gave up keep the line busy and collide with
+ * the next request.
+ */
+typedef struct {
+    sbus_wire_t         wire;     // `turnaround_us` is ignored, stations have their own
+    sbus_sim_station_t *stations[SBUS_SIM_STATIONS];
+    uint32_t            noise_ppm;     // Requests with a word damaged on the wire
+    uint32_t            random;
+
+    uint64_t      now_us;
+    uint64_t      busy_us;            // Time the line was driven by either side
+    uint64_t      busy_until_us;      // End of a late response
+    unsigned long exchanges;
+    unsigned long ok;
+    unsigned long timeouts;
+    unsigned long wrong_crc;
+    unsigned long invalid;
+    unsigned long collisions;
+    sbus_sim_histogram_t latency;     // Successful exchanges, from the start of the request to the end of the response
+
+    sbus_parser_t parser;
+    uint16_t      words[SBUS_SIM_MAX_WORDS];
+} sbus_sim_t;
+
+
+sbus_result_t sbus_sim_init(sbus_sim_t *sim, const sbus_wire_t *wire, uint32_t seed);
+sbus_result_t sbus_sim_attach(sbus_sim_t *sim, sbus_sim_station_t *station);
+sbus_result_t sbus_sim_exchange(sbus_sim_t *sim, const sbus_request_t *request, uint32_t timeout_us,
+                                uint16_t *response, size_t *len);
+void          sbus_sim_wait(sbus_sim_t *sim, uint64_t us);
+uint32_t      sbus_sim_utilization_ppm(const sbus_sim_t *sim);
+
+void     sbus_sim_histogram_add(sbus_sim_histogram_t *histogram, uint64_t value_us);
+uint64_t sbus_sim_histogram_percentile(const sbus_sim_histogram_t *histogram, uint32_t permille);
+
+#endif
@@ -0,0 +1,354 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "crc.h"
+#include "packet.h"
+#include "sink.h"
+
+
+static void init(sbus_sink_t *sink, sbus_sink_format_t format, size_t size);
+static int  reserve(sbus_sink_t *sink, size_t count);
+static void put(sbus_sink_t *sink, const uint8_t *data, size_t count, int address);
+static void settle(sbus_sink_t *sink, size_t count, int address);
+
+
+void sbus_sink_init_8bit(sbus_sink_t *sink, uint8_t *bytes, uint8_t *address_map, size_t size) {
+    init(sink, SBUS_SINK_8BIT, size);
+    sink->bytes       = bytes;
+    sink->address_map = address_map;
+}
+
+
+/*
+ * A 9-bit sink over a plain word buffer, with nothing queued yet, receives its first frame at the start of the
+ * buffer, exactly like the `sbus_packet_serialize_*` functions would write it. A sink of size 0 discards everything.
+ */
+void sbus_sink_init_9bit(sbus_sink_t *sink, uint16_t *words, size_t size) {
+    init(sink, SBUS_SINK_9BIT, size);
+    sink->words = words;
+}
+
+
+/*
+ * Characters available to the next frame.
+ */
+size_t sbus_sink_room(const sbus_sink_t *sink) {
+    return sink->size - sink->count;
+}
+
+
+/*
+ * Starts a new frame after the queued ones, dropping any frame that was begun and not committed.
+ */
+void sbus_sink_begin(sbus_sink_t *sink) {
+    size_t tail = sink->head + sink->count;
+
+    sink->position = tail >= sink->size ? tail - sink->size : tail;
+    sink->len      = 0;
+    sink->crc      = sbus_crc16_init();
+    sink->failed   = 0;
+}
+
+
+/*
+ * Address character of a request. Like the rest of the frame it is covered by the CRC.
+ */
+void sbus_sink_address(sbus_sink_t *sink, uint8_t station) {
+    if (reserve(sink, 1))
+        put(sink, &station, 1, 1);
+}
+
+
+void sbus_sink_bytes(sbus_sink_t *sink, const uint8_t *bytes, size_t count) {
+    if (reserve(sink, count))
+        put(sink, bytes, count, 0);
+}
+
+
+/*
+ * `count` 32 bit values, big endian.
+ */
+void sbus_sink_values(sbus_sink_t *sink, const uint32_t *values, size_t count) {
+    if (!reserve(sink, count * 4))
+        return;
+
+    if (sink->format == SBUS_SINK_9BIT) {
+        for (size_t i = 0; i < count; i++) {
+            uint8_t value[4] = {(uint8_t)(values[i] >> 24), (uint8_t)(values[i] >> 16), (uint8_t)(values[i] >> 8),
+                                (uint8_t)values[i]};
+            put(sink, value, sizeof(value), 0);
+        }
+        return;
+    }
+
+    // Stored straight into the ring, the CRC is then taken from there
+    uint8_t *ring     = sink->bytes;
+    size_t   position = sink->position;
+    for (size_t i = 0; i < count; i++) {
+        if (position + 4 <= sink->size) {
+            ring[position++] = (uint8_t)(values[i] >> 24);
+            ring[position++] = (uint8_t)(values[i] >> 16);
+            ring[position++] = (uint8_t)(values[i] >> 8);
+            ring[position++] = (uint8_t)values[i];
+            if (position == sink->size)
+                position = 0;
+        } else {
+            for (int shift = 24; shift >= 0; shift -= 8) {
+                ring[position] = (uint8_t)(values[i] >> shift);
+                position       = position + 1 == sink->size ? 0 : position + 1;
+            }
+        }
+    }
+    settle(sink, count * 4, 0);
+}
+
+
+/*
+ * `count` elements of the packed array `bits` starting at element `first`, repacked from the first bit.
+ */
+void sbus_sink_bits(sbus_sink_t *sink, const uint8_t *bits, size_t first, size_t count) {
+    size_t bytes = SBUS_FIO_BYTES(count);
+    if (!reserve(sink, bytes))
+        return;
+
+    for (size_t i = 0; i < bytes; i++) {
+        uint8_t byte = 0;
+        for (size_t j = i * 8; j < count && j < i * 8 + 8; j++) {
+            if (bits[SBUS_FIO_BYTE(first + j)] & SBUS_FIO_MASK(first + j))
+                byte |= SBUS_FIO_MASK(j);
+        }
+        put(sink, &byte, 1, 0);
+    }
+}
+
+
+/*
+ * CRC of everything written since `sbus_sink_begin`, most significant byte first.
+ */
+void sbus_sink_crc(sbus_sink_t *sink) {
+    uint16_t crc      = sbus_crc16_final(sink->crc);
+    uint8_t  bytes[2] = {(uint8_t)(crc >> 8), (uint8_t)crc};
+
+    if (reserve(sink, 2))
+        put(sink, bytes, sizeof(bytes), 0);
+}
+
+
+/*
+ * Queues the frame being written. Returns its length in characters, or -1 if some segment did not fit, in which case
+ * nothing is queued.
+ */
+int sbus_sink_commit(sbus_sink_t *sink) {
+    int res = sink->failed ? -1 : (int)sink->len;
+
+    if (!sink->failed)
+        sink->count += sink->len;
+    sink->len    = 0;
+    sink->failed = 1;     // Until the next begin
+    return res;
+}
+
+
+/*
+ * Fills `spans` with the queued characters, in order, the way a scatter-gather or DMA transfer takes them. Returns
+ * the number of spans used: 0 for an empty sink, 2 when the queue wraps around the end of the ring.
+ */
+size_t sbus_sink_spans(const sbus_sink_t *sink, sbus_span_t spans[2]) {
+    size_t first = sink->size - sink->head;
+    size_t width = sink->format == SBUS_SINK_9BIT ? sizeof(uint16_t) : sizeof(uint8_t);
+    char  *data  = sink->format == SBUS_SINK_9BIT ? (char *)sink->words : (char *)sink->bytes;
+
+    if (sink->count == 0)
+        return 0;
+
+    spans[0].data = data + sink->head * width;
+    if (sink->count <= first) {
+        spans[0].len = sink->count;
+        return 1;
+    }
+
+    spans[0].len  = first;
+    spans[1].data = data;
+    spans[1].len  = sink->count - first;
+    return 2;
+}
+
+
+/*
+ * For 8-bit sinks: the longest stretch of queued bytes, starting at the first one, that is contiguous in the ring and
+ * whose characters all have the same address flag (`*address`), that is the part a parity mode UART can send without
+ * changing its parity setting. Returns its length, 0 for an empty or 9-bit sink.
+ */
+size_t sbus_sink_run(const sbus_sink_t *sink, const uint8_t **bytes, int *address) {
+    size_t available = sink->size - sink->head;
+    size_t len       = 1;
+
+    if (sink->count == 0 || sink->format != SBUS_SINK_8BIT)
+        return 0;
+    if (available > sink->count)
+        available = sink->count;
+
+    *bytes = &sink->bytes[sink->head];
+    if (sink->address_map == NULL) {
+        *address = 0;
+        return available;
+    }
+
+    *address = SBUS_ADDRESS_MAP_GET(sink->address_map, sink->head);
+    while (len < available && SBUS_ADDRESS_MAP_GET(sink->address_map, sink->head + len) == *address)
+        len++;
+    return len;
+}
+
+
+/*
+ * Releases the first `count` queued characters, once the driver has handed them to the hardware.
+ */
+void sbus_sink_consume(sbus_sink_t *sink, size_t count) {
+    if (count > sink->count)
+        count = sink->count;
+
+    sink->head += count;
+    if (sink->head >= sink->size)
+        sink->head -= sink->size;
+    sink->count -= count;
+}
+
+
+/*
+ * Same frame as `sbus_packet_serialize_request`. Returns its length or -1 if it does not fit.
+ */
+int sbus_sink_serialize_request(sbus_sink_t *sink, const sbus_request_t *request) {
+    uint8_t command = (uint8_t)request->command;
+
+    sbus_sink_begin(sink);
+    sbus_sink_address(sink, request->destination);
+    sbus_sink_bytes(sink, &command, 1);
+    sbus_sink_bytes(sink, request->data, request->data_len);
+    sbus_sink_crc(sink);
+    return sbus_sink_commit(sink);
+}
+
+
+int sbus_sink_serialize_register_read_response(sbus_sink_t *sink, const uint32_t *registers, size_t count,
+                                               const sbus_request_t *request) {
+    if (sbus_sink_room(sink) < sbus_packet_response_length(request) ||
+        request->command != SBUS_COMMAND_READ_REGISTER) {
+        return -1;
+    }
+
+    return sbus_sink_serialize_values_response(sink, registers, count);
+}
+
+
+int sbus_sink_serialize_values_response(sbus_sink_t *sink, const uint32_t *values, size_t count) {
+    sbus_sink_begin(sink);
+    sbus_sink_values(sink, values, count);
+    sbus_sink_crc(sink);
+    return sbus_sink_commit(sink);
+}
+
+
+int sbus_sink_serialize_bits_response(sbus_sink_t *sink, const uint8_t *bits, size_t first, size_t count) {
+    sbus_sink_begin(sink);
+    sbus_sink_bits(sink, bits, first, count);
+    sbus_sink_crc(sink);
+    return sbus_sink_commit(sink);
+}
+
+
+int sbus_sink_serialize_bytes_response(sbus_sink_t *sink, const uint8_t *bytes, size_t count) {
+    sbus_sink_begin(sink);
+    sbus_sink_bytes(sink, bytes, count);
+    sbus_sink_crc(sink);
+    return sbus_sink_commit(sink);
+}
+
+
+int sbus_sink_serialize_ack_response(sbus_sink_t *sink, uint8_t code) {
+    uint8_t ack[2] = {code, 0x00};
+
+    sbus_sink_begin(sink);
+    sbus_sink_bytes(sink, ack, sizeof(ack));
+    return sbus_sink_commit(sink);
+}
+
+
+static void init(sbus_sink_t *sink, sbus_sink_format_t format, size_t size) {
+    memset(sink, 0, sizeof(sbus_sink_t));
+    sink->format = format;
+    sink->size   = size;
+    sink->failed = 1;
+}
+
+
+/*
+ * Checks that `count` more characters fit in the frame being written, failing it otherwise.
+ */
+static int reserve(sbus_sink_t *sink, size_t count) {
+    if (sink->failed || count > sink->size - sink->count - sink->len) {
+        sink->failed = 1;
+        return 0;
+    }
+    return 1;
+}
+
+
+/*
+ * Stores `count` characters that are known to fit.
+ */
+static void put(sbus_sink_t *sink, const uint8_t *data, size_t count, int address) {
+    size_t position = sink->position;
+
+    for (size_t done = 0; done < count;) {
+        size_t chunk = sink->size - position;
+        if (chunk > count - done)
+            chunk = count - done;
+
+        if (sink->format == SBUS_SINK_9BIT) {
+            uint16_t *words = &sink->words[position];
+            uint16_t  flag  = address ? SBUS_ADDRESS(0) : 0;
+            for (size_t i = 0; i < chunk; i++)
+                words[i] = (uint16_t)(data[done + i] | flag);
+        } else {
+            memcpy(&sink->bytes[position], &data[done], chunk);
+        }
+
+        done += chunk;
+        position = 0;
+    }
+
+    settle(sink, count, address);
+}
+
+
+/*
+ * Adds the `count` characters just stored at the write position to the frame: CRC, address flags and position, one
+ * contiguous stretch of the ring at a time.
+ */
+static void settle(sbus_sink_t *sink, size_t count, int address) {
+    while (count > 0) {
+        size_t position = sink->position;
+        size_t chunk    = sink->size - position;
+        if (chunk > count)
+            chunk = count;
+
+        if (sink->format == SBUS_SINK_9BIT)
+            sink->crc = sbus_crc16_update_9bit(sink->crc, &sink->words[position], chunk);
+        else
+            sink->crc = sbus_crc16_update_8bit(sink->crc, &sink->bytes[position], chunk);
+
+        for (size_t i = position; sink->address_map != NULL && i < position + chunk; i++) {
+            if (address)
+                SBUS_ADDRESS_MAP_SET(sink->address_map, i);
+            else
+                sink->address_map[SBUS_FIO_BYTE(i)] &= (uint8_t)~SBUS_FIO_MASK(i);
+        }
+
+        position += chunk;
+        sink->position = position == sink->size ? 0 : position;
+        sink->len += chunk;
+        count -= chunk;
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef SBUS_SINK_H_INCLUDED
+#define SBUS_SINK_H_INCLUDED
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "packet.h"
+
+typedef enum {
+    SBUS_SINK_8BIT = 0,     // Bytes, with the address flags in an optional bitmap (SBUS_ADDRESS_MAP_* layout)
+    SBUS_SINK_9BIT,         // Words, the address flag in bit 8 like the rest of the library
+} sbus_sink_format_t;
+
+
+/*
+ * Contiguous stretch of queued characters: bytes for 8-bit sinks, words for 9-bit ones.
+ */
+typedef struct {
+    const void *data;
+    size_t      len;
+} sbus_span_t;
+
+
+/*
+ * Transmit ring in caller provided memory, typically the one a UART driver or its DMA channel drains, that frames
+ * are serialized into without an intermediate buffer.
+ *
+ * A frame is written as segments between `sbus_sink_begin` and `sbus_sink_commit`, with the CRC computed on the way.
+ * A segment that does not fit marks the frame as failed; a failed frame is dropped by `sbus_sink_commit`, so the
+ * driver only ever sees complete frames. The producer owns the frame being written and the consumer the queued
+ * characters, `sbus_sink_consume` being the only call that moves `head`.
+ */
+typedef struct {
+    sbus_sink_format_t format;
+    uint8_t           *bytes;
+    uint8_t           *address_map;     // 8-bit sinks only, may be NULL when the line has no address flag
+    uint16_t          *words;
+    size_t             size;            // Characters the ring holds
+
+    size_t head;      // First queued character
+    size_t count;     // Characters of committed frames
+
+    // Frame being written
+    size_t   position;     // Next character
+    size_t   len;
+    uint16_t crc;
+    int      failed;
+} sbus_sink_t;
+
+
+void   sbus_sink_init_8bit(sbus_sink_t *sink, uint8_t *bytes, uint8_t *address_map, size_t size);
+void   sbus_sink_init_9bit(sbus_sink_t *sink, uint16_t *words, size_t size);
+size_t sbus_sink_room(const sbus_sink_t *sink);
+void   sbus_sink_begin(sbus_sink_t *sink);
+void   sbus_sink_address(sbus_sink_t *sink, uint8_t station);
+void   sbus_sink_bytes(sbus_sink_t *sink, const uint8_t *bytes, size_t count);
+void   sbus_sink_values(sbus_sink_t *sink, const uint32_t *values, size_t count);
+void   sbus_sink_bits(sbus_sink_t *sink, const uint8_t *bits, size_t first, size_t count);
+void   sbus_sink_crc(sbus_sink_t *sink);
+int    sbus_sink_commit(sbus_sink_t *sink);
+size_t sbus_sink_spans(const sbus_sink_t *sink, sbus_span_t spans[2]);
+size_t sbus_sink_run(const sbus_sink_t *sink, const uint8_t **bytes, int *address);
+void   sbus_sink_consume(sbus_sink_t *sink, size_t count);
+int    sbus_sink_serialize_request(sbus_sink_t *sink, const sbus_request_t *request);
+int    sbus_sink_serialize_register_read_response(sbus_sink_t *sink, const uint32_t *registers, size_t count,
+                                                  const sbus_request_t *request);
+int    sbus_sink_serialize_values_response(sbus_sink_t *sink, const uint32_t *values, size_t count);
+int    sbus_sink_serialize_bits_response(sbus_sink_t *sink, const uint8_t *bits, size_t first, size_t count);
+int    sbus_sink_serialize_bytes_response(sbus_sink_t *sink, const uint8_t *bytes, size_t count);
+int    sbus_sink_serialize_ack_response(sbus_sink_t *sink, uint8_t code);
+
+#endif
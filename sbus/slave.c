@@ -0,0 +1,247 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "packet.h"
+#include "sink.h"
+#include "slave.h"
+
+
+typedef int (*handler_t)(sbus_slave_t *slave, const sbus_request_t *request, sbus_media_type_t media,
+                         sbus_sink_t *sink);
+
+static int read_values(sbus_slave_t *slave, const sbus_request_t *request, sbus_media_type_t media, sbus_sink_t *sink);
+static int read_bits(sbus_slave_t *slave, const sbus_request_t *request, sbus_media_type_t media, sbus_sink_t *sink);
+static int write_values(sbus_slave_t *slave, const sbus_request_t *request, sbus_media_type_t media,
+                        sbus_sink_t *sink);
+static int write_bits(sbus_slave_t *slave, const sbus_request_t *request, sbus_media_type_t media, sbus_sink_t *sink);
+static int read_display(sbus_slave_t *slave, const sbus_request_t *request, sbus_media_type_t media,
+                        sbus_sink_t *sink);
+static int read_clock(sbus_slave_t *slave, const sbus_request_t *request, sbus_media_type_t media, sbus_sink_t *sink);
+static int write_clock(sbus_slave_t *slave, const sbus_request_t *request, sbus_media_type_t media,
+                       sbus_sink_t *sink);
+static int read_status(sbus_slave_t *slave, const sbus_request_t *request, sbus_media_type_t media, sbus_sink_t *sink);
+static int read_station(sbus_slave_t *slave, const sbus_request_t *request, sbus_media_type_t media,
+                        sbus_sink_t *sink);
+static int check_range(sbus_slave_t *slave, sbus_media_type_t media, uint16_t address, size_t count);
+
+
+// The media of the handlers comes from the command descriptor
+static const handler_t commands[] = {
+    [SBUS_COMMAND_READ_COUNTER]          = read_values,
+    [SBUS_COMMAND_READ_DISPLAY_REGISTER] = read_display,
+    [SBUS_COMMAND_READ_FLAG]             = read_bits,
+    [SBUS_COMMAND_READ_INPUT]            = read_bits,
+    [SBUS_COMMAND_READ_REAL_TIME_CLOCK]  = read_clock,
+    [SBUS_COMMAND_READ_OUTPUT]           = read_bits,
+    [SBUS_COMMAND_READ_REGISTER]         = read_values,
+    [SBUS_COMMAND_READ_TIMER]            = read_values,
+    [SBUS_COMMAND_WRITE_COUNTER]         = write_values,
+    [SBUS_COMMAND_WRITE_FLAG]            = write_bits,
+    [SBUS_COMMAND_WRITE_REAL_TIME_CLOCK] = write_clock,
+    [SBUS_COMMAND_WRITE_OUTPUT]          = write_bits,
+    [SBUS_COMMAND_WRITE_REGISTER]        = write_values,
+    [SBUS_COMMAND_WRITE_TIMER]           = write_values,
+    [SBUS_COMMAND_READ_PCD_STATUS_CPU_0] = read_status,
+    [SBUS_COMMAND_READ_PCD_STATUS_CPU_1] = read_status,
+    [SBUS_COMMAND_READ_PCD_STATUS_CPU_2] = read_status,
+    [SBUS_COMMAND_READ_PCD_STATUS_CPU_3] = read_status,
+    [SBUS_COMMAND_READ_PCD_STATUS_CPU_4] = read_status,
+    [SBUS_COMMAND_READ_PCD_STATUS_CPU_5] = read_status,
+    [SBUS_COMMAND_READ_PCD_STATUS_CPU_6] = read_status,
+    [SBUS_COMMAND_READ_PCD_STATUS_SELF]  = read_status,
+    [SBUS_COMMAND_READ_STATION_NUMBER]   = read_station,
+};
+
+#define NUM_COMMANDS (sizeof(commands) / sizeof(commands[0]))
+
+
+void sbus_slave_init(sbus_slave_t *slave, uint8_t station) {
+    memset(slave, 0, sizeof(sbus_slave_t));
+    slave->station = station;
+    slave->status  = SBUS_PCD_STATUS_RUN;
+}
+
+
+void sbus_slave_set_media(sbus_slave_t *slave, sbus_media_type_t media, void *storage, uint16_t count) {
+    sbus_media_area_t *area = &slave->media[media];
+
+    if (sbus_media_is_bit(media)) {
+        area->bits   = storage;
+        area->values = NULL;
+    } else {
+        area->values = storage;
+        area->bits   = NULL;
+    }
+    area->count = storage != NULL ? count : 0;
+}
+
+
+/*
+ * Executes `request` and serializes the response into `buffer`. Returns the number of words to transmit, 0 when
+ * nothing must be sent (request for another station or broadcast) and -1 if `len` is too small for the response.
+ * Requests that cannot be served are answered with a NAK.
+ */
+int sbus_slave_handle_request(sbus_slave_t *slave, const sbus_request_t *request, uint16_t *buffer, size_t len) {
+    sbus_sink_t sink;
+
+    sbus_sink_init_9bit(&sink, buffer, len);
+    return sbus_slave_respond(slave, request, &sink);
+}
+
+
+/*
+ * Same as `sbus_slave_handle_request`, queueing the response straight into the transmit ring `sink`. Returns the
+ * number of characters queued, 0 when nothing must be sent and -1, with nothing queued, if the ring is full.
+ */
+int sbus_slave_respond(sbus_slave_t *slave, const sbus_request_t *request, sbus_sink_t *sink) {
+    int broadcast = request->destination == SBUS_BROADCAST_ADDRESS;
+    if (request->destination != slave->station && !broadcast)
+        return 0;
+
+    // Broadcasts are executed all the same, their response goes nowhere
+    sbus_sink_t discard;
+    if (broadcast) {
+        sbus_sink_init_9bit(&discard, NULL, 0);
+        sink = &discard;
+    }
+
+    int res;
+    if ((size_t)request->command < NUM_COMMANDS && commands[request->command] != NULL) {
+        sbus_media_type_t media = (sbus_media_type_t)sbus_command_describe(request->command)->media;
+        res                     = commands[request->command](slave, request, media, sink);
+    } else {
+        res = sbus_sink_serialize_ack_response(sink, SBUS_NAK);
+    }
+
+    return broadcast ? 0 : res;
+}
+
+
+static int read_values(sbus_slave_t *slave, const sbus_request_t *request, sbus_media_type_t media, sbus_sink_t *sink) {
+    if (request->data_len < 3)
+        return sbus_sink_serialize_ack_response(sink, SBUS_NAK);
+
+    size_t   count   = (size_t)SBUS_PACKET_R_COUNT(request) + 1;
+    uint16_t address = (uint16_t)((request->data[1] << 8) | request->data[2]);
+    if (!check_range(slave, media, address, count))
+        return sbus_sink_serialize_ack_response(sink, SBUS_NAK);
+
+    return sbus_sink_serialize_values_response(sink, &slave->media[media].values[address], count);
+}
+
+
+static int read_bits(sbus_slave_t *slave, const sbus_request_t *request, sbus_media_type_t media, sbus_sink_t *sink) {
+    if (request->data_len < 3)
+        return sbus_sink_serialize_ack_response(sink, SBUS_NAK);
+
+    size_t   count   = (size_t)SBUS_PACKET_R_COUNT(request) + 1;
+    uint16_t address = (uint16_t)((request->data[1] << 8) | request->data[2]);
+    if (!check_range(slave, media, address, count))
+        return sbus_sink_serialize_ack_response(sink, SBUS_NAK);
+
+    return sbus_sink_serialize_bits_response(sink, slave->media[media].bits, address, count);
+}
+
+
+static int write_values(sbus_slave_t *slave, const sbus_request_t *request, sbus_media_type_t media,
+                        sbus_sink_t *sink) {
+    // <w-count> <address> {<4-byte>}+
+    if (request->data_len < 3 || request->data[0] < 5)
+        return sbus_sink_serialize_ack_response(sink, SBUS_NAK);
+
+    size_t   count   = (size_t)(request->data[0] - 1) / 4;
+    uint16_t address = (uint16_t)((request->data[1] << 8) | request->data[2]);
+    if (request->data_len < 3 + count * 4 || !check_range(slave, media, address, count))
+        return sbus_sink_serialize_ack_response(sink, SBUS_NAK);
+
+    uint32_t      *values = &slave->media[media].values[address];
+    const uint8_t *data   = &request->data[3];
+    for (size_t i = 0; i < count; i++, data += 4) {
+        values[i] = ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+    }
+
+    if (slave->written != NULL)
+        slave->written(slave, media, address, count);
+
+    return sbus_sink_serialize_ack_response(sink, SBUS_ACK);
+}
+
+
+static int write_bits(sbus_slave_t *slave, const sbus_request_t *request, sbus_media_type_t media, sbus_sink_t *sink) {
+    // <w-count> <address> <fio-count> {<fio-byte>}+
+    if (request->data_len < 4)
+        return sbus_sink_serialize_ack_response(sink, SBUS_NAK);
+
+    size_t   count   = (size_t)request->data[3] + 1;
+    uint16_t address = (uint16_t)((request->data[1] << 8) | request->data[2]);
+    if ((size_t)request->data_len - 4 < SBUS_FIO_BYTES(count) || !check_range(slave, media, address, count))
+        return sbus_sink_serialize_ack_response(sink, SBUS_NAK);
+
+    uint8_t       *bits = slave->media[media].bits;
+    const uint8_t *data = &request->data[4];
+    for (size_t i = 0; i < count; i++) {
+        size_t index = address + i;
+        if (data[SBUS_FIO_BYTE(i)] & SBUS_FIO_MASK(i))
+            bits[SBUS_FIO_BYTE(index)] |= SBUS_FIO_MASK(index);
+        else
+            bits[SBUS_FIO_BYTE(index)] &= (uint8_t)~SBUS_FIO_MASK(index);
+    }
+
+    if (slave->written != NULL)
+        slave->written(slave, media, address, count);
+
+    return sbus_sink_serialize_ack_response(sink, SBUS_ACK);
+}
+
+
+static int read_display(sbus_slave_t *slave, const sbus_request_t *request, sbus_media_type_t media,
+                        sbus_sink_t *sink) {
+    (void)request;
+    (void)media;
+    return sbus_sink_serialize_values_response(sink, &slave->display, 1);
+}
+
+
+static int read_clock(sbus_slave_t *slave, const sbus_request_t *request, sbus_media_type_t media, sbus_sink_t *sink) {
+    (void)request;
+    (void)media;
+    uint8_t clock[SBUS_CLOCK_SIZE];
+
+    if (slave->read_clock == NULL || slave->read_clock(slave, clock) != 0)
+        return sbus_sink_serialize_ack_response(sink, SBUS_NAK);
+
+    return sbus_sink_serialize_bytes_response(sink, clock, sizeof(clock));
+}
+
+
+static int write_clock(sbus_slave_t *slave, const sbus_request_t *request, sbus_media_type_t media,
+                       sbus_sink_t *sink) {
+    (void)media;
+
+    if (request->data_len < SBUS_CLOCK_SIZE || slave->write_clock == NULL ||
+        slave->write_clock(slave, request->data) != 0)
+        return sbus_sink_serialize_ack_response(sink, SBUS_NAK);
+
+    return sbus_sink_serialize_ack_response(sink, SBUS_ACK);
+}
+
+
+static int read_status(sbus_slave_t *slave, const sbus_request_t *request, sbus_media_type_t media, sbus_sink_t *sink) {
+    (void)request;
+    (void)media;
+    return sbus_sink_serialize_bytes_response(sink, &slave->status, 1);
+}
+
+
+static int read_station(sbus_slave_t *slave, const sbus_request_t *request, sbus_media_type_t media,
+                        sbus_sink_t *sink) {
+    (void)request;
+    (void)media;
+    return sbus_sink_serialize_bytes_response(sink, &slave->station, 1);
+}
+
+
+static int check_range(sbus_slave_t *slave, sbus_media_type_t media, uint16_t address, size_t count) {
+    return count > 0 && count <= sbus_media_max_count(media) && (size_t)address + count <= slave->media[media].count;
+}
@@ -0,0 +1,48 @@
+#ifndef SBUS_SLAVE_H_INCLUDED
+#define SBUS_SLAVE_H_INCLUDED
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "packet.h"
+#include "sink.h"
+
+#define SBUS_PCD_STATUS_RUN  'R'
+#define SBUS_PCD_STATUS_STOP 'S'
+#define SBUS_PCD_STATUS_HALT 'H'
+
+
+/*
+ * Storage for one media type: `values` for registers, counters and timers, `bits` (packed with the SBUS_FIO_*
+ * layout) for flags, inputs and outputs. Media with a `count` of zero are not available on the station.
+ */
+typedef struct {
+    uint32_t *values;
+    uint8_t  *bits;
+    uint16_t  count;
+} sbus_media_area_t;
+
+
+typedef struct sbus_slave sbus_slave_t;
+
+struct sbus_slave {
+    uint8_t           station;
+    uint8_t           status;
+    uint32_t          display;
+    sbus_media_area_t media[SBUS_MEDIA_TYPES];
+
+    // Optional; without them real time clock requests are refused
+    int (*read_clock)(sbus_slave_t *slave, uint8_t *clock);
+    int (*write_clock)(sbus_slave_t *slave, const uint8_t *clock);
+    // Optional notification sent after a successful write
+    void (*written)(sbus_slave_t *slave, sbus_media_type_t media, uint16_t address, size_t count);
+    void *arg;
+};
+
+
+void sbus_slave_init(sbus_slave_t *slave, uint8_t station);
+void sbus_slave_set_media(sbus_slave_t *slave, sbus_media_type_t media, void *storage, uint16_t count);
+int  sbus_slave_handle_request(sbus_slave_t *slave, const sbus_request_t *request, uint16_t *buffer, size_t len);
+int  sbus_slave_respond(sbus_slave_t *slave, const sbus_request_t *request, sbus_sink_t *sink);
+
+#endif
@@ -0,0 +1,185 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "packet.h"
+#include "stats.h"
+
+
+static sbus_latency_histogram_t *find(sbus_latency_table_t *table, unsigned key, int claim);
+static size_t                    bucket(unsigned long latency_us);
+
+#if SBUS_STATS
+static struct {
+    atomic_ulong frames[SBUS_STATS_COMMANDS];
+    atomic_ulong wrong_crc;
+    atomic_ulong invalid_data;
+    atomic_ulong not_found;
+    atomic_ulong unknown_command;
+    atomic_ulong discarded;
+} counters;
+
+
+void sbus_stats_count_result(sbus_command_code_t command, sbus_result_t result) {
+    switch (result) {
+        case SBUS_OK:
+            if ((unsigned)command < SBUS_STATS_COMMANDS)
+                atomic_fetch_add_explicit(&counters.frames[command], 1, memory_order_relaxed);
+            break;
+        case SBUS_WRONG_CRC:
+            atomic_fetch_add_explicit(&counters.wrong_crc, 1, memory_order_relaxed);
+            break;
+        case SBUS_INVALID_DATA:
+            atomic_fetch_add_explicit(&counters.invalid_data, 1, memory_order_relaxed);
+            break;
+        case SBUS_NOT_FOUND:
+            atomic_fetch_add_explicit(&counters.not_found, 1, memory_order_relaxed);
+            break;
+        case SBUS_UNKNOWN_COMMAND:
+            atomic_fetch_add_explicit(&counters.unknown_command, 1, memory_order_relaxed);
+            break;
+        default:
+            break;
+    }
+}
+
+
+void sbus_stats_count_discarded(size_t words) {
+    if (words > 0)
+        atomic_fetch_add_explicit(&counters.discarded, words, memory_order_relaxed);
+}
+#endif
+
+
+/*
+ * All zeroes when the library is built without SBUS_STATS.
+ */
+void sbus_stats_snapshot(sbus_stats_snapshot_t *snapshot) {
+    memset(snapshot, 0, sizeof(sbus_stats_snapshot_t));
+#if SBUS_STATS
+    for (size_t i = 0; i < SBUS_STATS_COMMANDS; i++)
+        snapshot->frames[i] = atomic_load_explicit(&counters.frames[i], memory_order_relaxed);
+    snapshot->wrong_crc       = atomic_load_explicit(&counters.wrong_crc, memory_order_relaxed);
+    snapshot->invalid_data    = atomic_load_explicit(&counters.invalid_data, memory_order_relaxed);
+    snapshot->not_found       = atomic_load_explicit(&counters.not_found, memory_order_relaxed);
+    snapshot->unknown_command = atomic_load_explicit(&counters.unknown_command, memory_order_relaxed);
+    snapshot->discarded       = atomic_load_explicit(&counters.discarded, memory_order_relaxed);
+#endif
+}
+
+
+void sbus_stats_reset(void) {
+#if SBUS_STATS
+    for (size_t i = 0; i < SBUS_STATS_COMMANDS; i++)
+        atomic_store_explicit(&counters.frames[i], 0, memory_order_relaxed);
+    atomic_store_explicit(&counters.wrong_crc, 0, memory_order_relaxed);
+    atomic_store_explicit(&counters.invalid_data, 0, memory_order_relaxed);
+    atomic_store_explicit(&counters.not_found, 0, memory_order_relaxed);
+    atomic_store_explicit(&counters.unknown_command, 0, memory_order_relaxed);
+    atomic_store_explicit(&counters.discarded, 0, memory_order_relaxed);
+#endif
+}
+
+
+/*
+ * Not thread safe; must complete before the table is shared.
+ */
+void sbus_latency_table_init(sbus_latency_table_t *table, sbus_latency_histogram_t *histograms, size_t capacity) {
+    table->histograms = histograms;
+    table->capacity   = capacity;
+    atomic_init(&table->dropped, 0);
+
+    for (size_t i = 0; i < capacity; i++) {
+        atomic_init(&histograms[i].key, 0);
+        atomic_init(&histograms[i].count, 0);
+        atomic_init(&histograms[i].total_us, 0);
+        atomic_init(&histograms[i].max_us, 0);
+        for (size_t j = 0; j < SBUS_STATS_BUCKETS; j++)
+            atomic_init(&histograms[i].buckets[j], 0);
+    }
+}
+
+
+/*
+ * Safe to call from several threads at once, and concurrently with `sbus_latency_snapshot`.
+ */
+void sbus_latency_record(sbus_latency_table_t *table, uint8_t station, sbus_command_code_t command,
+                         unsigned long latency_us) {
+    sbus_latency_histogram_t *histogram = find(table, 1 + ((unsigned)station << 8 | ((unsigned)command & 0xFF)), 1);
+    if (histogram == NULL) {
+        atomic_fetch_add_explicit(&table->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    atomic_fetch_add_explicit(&histogram->buckets[bucket(latency_us)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->total_us, latency_us, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->count, 1, memory_order_relaxed);
+
+    unsigned long max = atomic_load_explicit(&histogram->max_us, memory_order_relaxed);
+    while (latency_us > max &&
+           !atomic_compare_exchange_weak_explicit(&histogram->max_us, &max, latency_us, memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+    }
+}
+
+
+/*
+ * Returns -1 if nothing was ever recorded for the pair.
+ */
+int sbus_latency_snapshot(sbus_latency_table_t *table, uint8_t station, sbus_command_code_t command,
+                          sbus_latency_snapshot_t *snapshot) {
+    sbus_latency_histogram_t *histogram = find(table, 1 + ((unsigned)station << 8 | ((unsigned)command & 0xFF)), 0);
+
+    memset(snapshot, 0, sizeof(sbus_latency_snapshot_t));
+    if (histogram == NULL)
+        return -1;
+
+    snapshot->count    = atomic_load_explicit(&histogram->count, memory_order_relaxed);
+    snapshot->total_us = atomic_load_explicit(&histogram->total_us, memory_order_relaxed);
+    snapshot->max_us   = atomic_load_explicit(&histogram->max_us, memory_order_relaxed);
+    for (size_t i = 0; i < SBUS_STATS_BUCKETS; i++)
+        snapshot->buckets[i] = atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+    return 0;
+}
+
+
+/*
+ * Linear probing; a free slot is claimed with a compare and swap, so two threads racing for the same pair end up on
+ * the same slot.
+ */
+static sbus_latency_histogram_t *find(sbus_latency_table_t *table, unsigned key, int claim) {
+    if (table->capacity == 0)
+        return NULL;
+
+    size_t start = (key * 2654435761u) % table->capacity;
+
+    for (size_t i = 0; i < table->capacity; i++) {
+        sbus_latency_histogram_t *histogram = &table->histograms[(start + i) % table->capacity];
+        unsigned                  found     = atomic_load_explicit(&histogram->key, memory_order_acquire);
+
+        if (found == key)
+            return histogram;
+        if (found == 0) {
+            if (!claim)
+                return NULL;
+            unsigned expected = 0;
+            if (atomic_compare_exchange_strong_explicit(&histogram->key, &expected, key, memory_order_acq_rel,
+                                                        memory_order_acquire) ||
+                expected == key)
+                return histogram;
+        }
+    }
+
+    return NULL;
+}
+
+
+static size_t bucket(unsigned long latency_us) {
+    size_t index = 0;
+    while (latency_us > 1 && index < SBUS_STATS_BUCKETS - 1) {
+        latency_us >>= 1;
+        index++;
+    }
+    return index;
+}
@@ -0,0 +1,80 @@
+#ifndef SBUS_STATS_H_INCLUDED
+#define SBUS_STATS_H_INCLUDED
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "packet.h"
+
+/*
+ * Optional instrumentation of the parse and validate paths, enabled by building with SBUS_STATS=1. Counters are
+ * relaxed atomics, so they can be updated from the bus thread and read from any other without locks; a snapshot is
+ * not a consistent cut, but every single counter in it is exact.
+ */
+#ifndef SBUS_STATS
+#define SBUS_STATS 0
+#endif
+
+#define SBUS_STATS_COMMANDS SBUS_COMMAND_CODES
+#define SBUS_STATS_BUCKETS  24     // Bucket i counts latencies in [2^i, 2^(i+1)) microseconds, the last one saturates
+
+
+typedef struct {
+    unsigned long frames[SBUS_STATS_COMMANDS];     // Good requests parsed and responses validated, per command
+    unsigned long wrong_crc;
+    unsigned long invalid_data;
+    unsigned long not_found;
+    unsigned long unknown_command;
+    unsigned long discarded;     // Words skipped while looking for the start of a request
+} sbus_stats_snapshot_t;
+
+
+typedef struct {
+    unsigned long count;
+    unsigned long total_us;
+    unsigned long max_us;
+    unsigned long buckets[SBUS_STATS_BUCKETS];
+} sbus_latency_snapshot_t;
+
+
+typedef struct {
+    atomic_uint   key;     // 0 when free, otherwise 1 + (station << 8 | command)
+    atomic_ulong  count;
+    atomic_ulong  total_us;
+    atomic_ulong  max_us;
+    atomic_ulong  buckets[SBUS_STATS_BUCKETS];
+} sbus_latency_histogram_t;
+
+
+/*
+ * Request to response latencies per (station, command), in caller provided storage. Slots are claimed on first use
+ * and never released; when the table is full new pairs are not recorded.
+ */
+typedef struct {
+    sbus_latency_histogram_t *histograms;
+    size_t                    capacity;
+    atomic_ulong              dropped;
+} sbus_latency_table_t;
+
+
+#if SBUS_STATS
+void sbus_stats_count_result(sbus_command_code_t command, sbus_result_t result);
+void sbus_stats_count_discarded(size_t words);
+#define SBUS_STATS_RESULT(command, result) sbus_stats_count_result(command, result)
+#define SBUS_STATS_DISCARDED(words)        sbus_stats_count_discarded(words)
+#else
+#define SBUS_STATS_RESULT(command, result) ((void)(command), (void)(result))
+#define SBUS_STATS_DISCARDED(words)        ((void)0)
+#endif
+
+void sbus_stats_snapshot(sbus_stats_snapshot_t *snapshot);
+void sbus_stats_reset(void);
+
+void sbus_latency_table_init(sbus_latency_table_t *table, sbus_latency_histogram_t *histograms, size_t capacity);
+void sbus_latency_record(sbus_latency_table_t *table, uint8_t station, sbus_command_code_t command,
+                         unsigned long latency_us);
+int  sbus_latency_snapshot(sbus_latency_table_t *table, uint8_t station, sbus_command_code_t command,
+                           sbus_latency_snapshot_t *snapshot);
+
+#endif
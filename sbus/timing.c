@@ -0,0 +1,124 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "packet.h"
+#include "timing.h"
+#include "wire.h"
+
+
+static uint32_t allowance(const sbus_timing_t *timing, const sbus_station_timing_t *station);
+
+
+/*
+ * Fills in defaults that can be changed afterwards: 100 ms for unknown stations, allowances between 2 and 500 ms,
+ * offline after 3 timeouts and probed again after 1 s up to 60 s.
+ */
+sbus_result_t sbus_timing_init(sbus_timing_t *timing, const sbus_wire_t *wire, sbus_station_timing_t *stations) {
+    if (wire->baud == 0)
+        return SBUS_INVALID_ARGS;
+
+    memset(stations, 0, SBUS_TIMING_STATIONS * sizeof(sbus_station_timing_t));
+    timing->wire           = *wire;
+    timing->stations       = stations;
+    timing->initial_us     = 100000;
+    timing->min_us         = 2000;
+    timing->max_us         = 500000;
+    timing->offline_after  = 3;
+    timing->backoff_min_us = 1000000;
+    timing->backoff_max_us = 60000000;
+    return SBUS_OK;
+}
+
+
+/*
+ * Shortest possible time between the start of the request and the end of the response: both frames back to back
+ * on the wire, without stuffing.
+ */
+uint32_t sbus_timing_min_response_us(const sbus_timing_t *timing, const sbus_request_t *request) {
+    size_t characters = sbus_wire_request_characters(&timing->wire, request) +
+                        sbus_wire_response_characters(&timing->wire, request);
+    return sbus_wire_characters_us(&timing->wire, characters);
+}
+
+
+/*
+ * Time to wait for the response to `request`, counted from the start of the transmission.
+ */
+uint32_t sbus_timing_timeout_us(const sbus_timing_t *timing, const sbus_request_t *request) {
+    uint64_t transfer = sbus_timing_min_response_us(timing, request);
+    // In data mode every character after the attribute may be stuffed
+    if (timing->wire.format == SBUS_WIRE_DATA)
+        transfer *= 2;
+
+    uint64_t timeout = transfer + allowance(timing, &timing->stations[request->destination]);
+    return timeout > UINT32_MAX ? UINT32_MAX : (uint32_t)timeout;
+}
+
+
+/*
+ * Feeds the time a successful exchange took, from the start of the transmission to the end of the response.
+ */
+void sbus_timing_sample(sbus_timing_t *timing, const sbus_request_t *request, uint64_t elapsed_us) {
+    sbus_station_timing_t *station = &timing->stations[request->destination];
+    uint32_t               minimum = sbus_timing_min_response_us(timing, request);
+
+    if (sbus_packet_response_length(request) == 0)
+        return;
+
+    uint64_t turnaround = elapsed_us > minimum ? elapsed_us - minimum : 0;
+    uint32_t sample     = turnaround > UINT32_MAX / 8 ? UINT32_MAX / 8 : (uint32_t)turnaround;
+
+    if (station->srtt_us == 0) {
+        station->srtt_us   = sample;
+        station->rttvar_us = sample / 2;
+    } else {
+        uint32_t delta     = station->srtt_us > sample ? station->srtt_us - sample : sample - station->srtt_us;
+        station->rttvar_us = (3 * station->rttvar_us + delta) / 4;
+        station->srtt_us   = (7 * station->srtt_us + sample) / 8;
+    }
+    // 0 means no samples
+    if (station->srtt_us == 0)
+        station->srtt_us = 1;
+
+    station->failures = 0;
+    station->retry_us = 0;
+}
+
+
+/*
+ * Records that `station` did not answer in time. Further timeouts for the station double (up to `max_us`) until it
+ * answers again.
+ */
+void sbus_timing_timeout(sbus_timing_t *timing, uint8_t station, uint64_t now_us) {
+    sbus_station_timing_t *entry = &timing->stations[station];
+
+    if (entry->failures < UINT16_MAX)
+        entry->failures++;
+
+    if (entry->failures >= timing->offline_after) {
+        unsigned shift   = entry->failures - timing->offline_after;
+        uint64_t backoff = (uint64_t)timing->backoff_min_us << (shift > 16 ? 16 : shift);
+        entry->retry_us  = now_us + (backoff > timing->backoff_max_us ? timing->backoff_max_us : backoff);
+    }
+}
+
+
+/*
+ * Whether requests to `station` should be skipped for now. Once the backoff is over a single request probes the
+ * station again.
+ */
+int sbus_timing_offline(const sbus_timing_t *timing, uint8_t station, uint64_t now_us) {
+    const sbus_station_timing_t *entry = &timing->stations[station];
+    return entry->failures >= timing->offline_after && now_us < entry->retry_us;
+}
+
+
+static uint32_t allowance(const sbus_timing_t *timing, const sbus_station_timing_t *station) {
+    uint64_t value = station->srtt_us == 0 ? timing->initial_us : station->srtt_us + 4 * (uint64_t)station->rttvar_us;
+
+    if (value < timing->min_us)
+        value = timing->min_us;
+    value <<= station->failures > 8 ? 8 : station->failures;
+    return value > timing->max_us ? timing->max_us : (uint32_t)value;
+}
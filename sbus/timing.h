@@ -0,0 +1,51 @@
+#ifndef SBUS_TIMING_H_INCLUDED
+#define SBUS_TIMING_H_INCLUDED
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "packet.h"
+#include "wire.h"
+
+#define SBUS_TIMING_STATIONS 256
+
+
+/*
+ * What has been learned about a station's turnaround, i.e. the time it takes to start answering once the request
+ * has been received. Times are in microseconds.
+ */
+typedef struct {
+    uint32_t srtt_us;       // Smoothed turnaround; 0 until the first sample
+    uint32_t rttvar_us;     // Smoothed mean deviation
+    uint16_t failures;      // Consecutive timeouts
+    uint64_t retry_us;      // While offline, requests are refused until this time
+} sbus_station_timing_t;
+
+
+/*
+ * Per-transaction response timeouts: the time the request and the response take on the wire plus a turnaround
+ * allowance estimated like TCP does for its retransmission timeout (smoothed value plus four mean deviations).
+ * Stations failing `offline_after` times in a row are considered offline and only probed again after a backoff
+ * that doubles with every further failure.
+ */
+typedef struct {
+    sbus_wire_t            wire;
+    sbus_station_timing_t *stations;     // SBUS_TIMING_STATIONS entries, indexed by station number
+
+    uint32_t initial_us;          // Turnaround allowance for stations without samples
+    uint32_t min_us;              // Bounds for the turnaround allowance
+    uint32_t max_us;
+    uint16_t offline_after;
+    uint32_t backoff_min_us;
+    uint32_t backoff_max_us;
+} sbus_timing_t;
+
+
+sbus_result_t sbus_timing_init(sbus_timing_t *timing, const sbus_wire_t *wire, sbus_station_timing_t *stations);
+uint32_t      sbus_timing_min_response_us(const sbus_timing_t *timing, const sbus_request_t *request);
+uint32_t      sbus_timing_timeout_us(const sbus_timing_t *timing, const sbus_request_t *request);
+void sbus_timing_sample(sbus_timing_t *timing, const sbus_request_t *request, uint64_t elapsed_us);
+void sbus_timing_timeout(sbus_timing_t *timing, uint8_t station, uint64_t now_us);
+int  sbus_timing_offline(const sbus_timing_t *timing, uint8_t station, uint64_t now_us);
+
+#endif
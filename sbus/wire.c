@@ -0,0 +1,53 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "packet.h"
+#include "wire.h"
+
+
+#define FRAME_OVERHEAD(wire) ((wire)->format == SBUS_WIRE_DATA ? 2 : 0)     // SYN and attribute
+
+
+/*
+ * Time taken by `characters` back to back characters, rounded up.
+ */
+uint32_t sbus_wire_characters_us(const sbus_wire_t *wire, size_t characters) {
+    uint64_t bits = (uint64_t)characters * (wire->format == SBUS_WIRE_DATA ? 10 : 11);
+    return (uint32_t)((bits * 1000000 + wire->baud - 1) / wire->baud);
+}
+
+
+/*
+ * Characters of the request on the wire, without data mode stuffing.
+ */
+size_t sbus_wire_request_characters(const sbus_wire_t *wire, const sbus_request_t *request) {
+    // Address, command, data and CRC
+    return FRAME_OVERHEAD(wire) + 4 + request->data_len;
+}
+
+
+/*
+ * Characters of the expected response, 0 for broadcasts.
+ */
+size_t sbus_wire_response_characters(const sbus_wire_t *wire, const sbus_request_t *request) {
+    size_t len = sbus_packet_response_length(request);
+    return len > 0 ? FRAME_OVERHEAD(wire) + len : 0;
+}
+
+
+/*
+ * Bus time of a whole exchange: request, turnaround and response.
+ */
+uint32_t sbus_wire_exchange_us(const sbus_wire_t *wire, const sbus_request_t *request) {
+    size_t characters = sbus_wire_request_characters(wire, request) + sbus_wire_response_characters(wire, request);
+    return sbus_wire_characters_us(wire, characters) + wire->turnaround_us;
+}
+
+
+/*
+ * Time to leave after the start of a broadcast before the next frame: the broadcast itself plus the turnaround, so
+ * that the slowest station has executed it and is listening again. Same as the bus time of the exchange.
+ */
+uint32_t sbus_wire_guard_us(const sbus_wire_t *wire, const sbus_request_t *request) {
+    return sbus_wire_characters_us(wire, sbus_wire_request_characters(wire, request)) + wire->turnaround_us;
+}
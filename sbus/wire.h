@@ -0,0 +1,31 @@
+#ifndef SBUS_WIRE_H_INCLUDED
+#define SBUS_WIRE_H_INCLUDED
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "packet.h"
+
+typedef enum {
+    SBUS_WIRE_PARITY = 0,     // 11 bit characters: start, 8 data, parity (the address flag), stop
+    SBUS_WIRE_DATA,           // 10 bit characters, SYN and attribute before every frame
+} sbus_wire_format_t;
+
+
+/*
+ * Physical line parameters, to turn frames into time on the wire.
+ */
+typedef struct {
+    uint32_t           baud;
+    sbus_wire_format_t format;
+    uint32_t           turnaround_us;     // Station response delay and line turnaround, once per exchange
+} sbus_wire_t;
+
+
+uint32_t sbus_wire_characters_us(const sbus_wire_t *wire, size_t characters);
+size_t   sbus_wire_request_characters(const sbus_wire_t *wire, const sbus_request_t *request);
+size_t   sbus_wire_response_characters(const sbus_wire_t *wire, const sbus_request_t *request);
+uint32_t sbus_wire_exchange_us(const sbus_wire_t *wire, const sbus_request_t *request);
+uint32_t sbus_wire_guard_us(const sbus_wire_t *wire, const sbus_request_t *request);
+
+#endif
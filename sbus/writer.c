@@ -0,0 +1,237 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "packet.h"
+#include "writer.h"
+
+
+#define PROBE_LIMIT 16
+
+static sbus_write_entry_t *find(sbus_writer_t *writer, uint8_t station, sbus_media_type_t media, uint16_t address,
+                                sbus_write_state_t state);
+static size_t hash(const sbus_writer_t *writer, uint8_t station, sbus_media_type_t media, uint16_t address);
+static int    precedes(const sbus_write_entry_t *first, const sbus_write_entry_t *second);
+static void   finish(sbus_writer_t *writer, sbus_write_entry_t *entry, sbus_result_t result);
+
+
+/*
+ * `capacity` must be a power of two.
+ */
+sbus_result_t sbus_writer_init(sbus_writer_t *writer, sbus_write_entry_t *entries, size_t capacity,
+                               uint32_t flush_interval) {
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+        return SBUS_INVALID_ARGS;
+
+    memset(writer, 0, sizeof(sbus_writer_t));
+    memset(entries, 0, capacity * sizeof(sbus_write_entry_t));
+    writer->entries        = entries;
+    writer->capacity       = capacity;
+    writer->flush_interval = flush_interval;
+    return SBUS_OK;
+}
+
+
+/*
+ * Marks a value to be written. Setting an address that is still waiting replaces its value. Returns
+ * SBUS_INVALID_ARGS for media that cannot be written and when there is no room left around the key, in which case
+ * the writer should be flushed first.
+ */
+sbus_result_t sbus_writer_set(sbus_writer_t *writer, uint8_t station, sbus_media_type_t media, uint16_t address,
+                              uint32_t value, uint32_t now) {
+    sbus_command_code_t command;
+
+    if (sbus_media_write_command(media, &command) != SBUS_OK || station == SBUS_BROADCAST_ADDRESS)
+        return SBUS_INVALID_ARGS;
+    if (sbus_media_is_bit(media))
+        value = value != 0;
+
+    sbus_write_entry_t *entry = find(writer, station, media, address, SBUS_WRITE_DIRTY);
+    if (entry != NULL) {
+        entry->value = value;
+        return SBUS_OK;
+    }
+
+    size_t index = hash(writer, station, media, address);
+    for (size_t i = 0; i < PROBE_LIMIT && i < writer->capacity; i++) {
+        entry = &writer->entries[(index + i) & (writer->capacity - 1)];
+
+        if (entry->state == 0) {
+            entry->state     = SBUS_WRITE_DIRTY;
+            entry->isolate   = 0;
+            entry->station   = station;
+            entry->media     = (uint8_t)media;
+            entry->address   = address;
+            entry->value     = value;
+            entry->timestamp = now;
+            return SBUS_OK;
+        }
+    }
+
+    return SBUS_INVALID_ARGS;
+}
+
+
+/*
+ * Number of values waiting to be sent.
+ */
+size_t sbus_writer_pending(const sbus_writer_t *writer) {
+    size_t pending = 0;
+
+    for (size_t i = 0; i < writer->capacity; i++)
+        pending += writer->entries[i].state == SBUS_WRITE_DIRTY;
+
+    return pending;
+}
+
+
+/*
+ * Builds the next write frame. Once a value of a station has waited for `flush_interval` milliseconds (or right away
+ * with `flush`) all of the station's values are due; the lowest address of a due station starts the frame, which
+ * grows over the adjacent addresses up to the per-command limit. Returns SBUS_NOT_FOUND when nothing is due.
+ *
+ * The values of the frame stay in flight until `sbus_writer_complete` is called with the same frame.
+ */
+sbus_result_t sbus_writer_next(sbus_writer_t *writer, uint32_t now, int flush, sbus_write_frame_t *frame,
+                               sbus_request_t *request) {
+    uint8_t             due[SBUS_FIO_BYTES(256)] = {0};
+    sbus_write_entry_t *run[SBUS_MAX_BITS_PER_WRITE];
+    sbus_write_entry_t *seed = NULL;
+
+    for (size_t i = 0; i < writer->capacity; i++) {
+        const sbus_write_entry_t *entry = &writer->entries[i];
+        if (entry->state == SBUS_WRITE_DIRTY && (flush || now - entry->timestamp >= writer->flush_interval))
+            due[SBUS_FIO_BYTE(entry->station)] |= SBUS_FIO_MASK(entry->station);
+    }
+
+    for (size_t i = 0; i < writer->capacity; i++) {
+        sbus_write_entry_t *entry = &writer->entries[i];
+        if (entry->state != SBUS_WRITE_DIRTY || !(due[SBUS_FIO_BYTE(entry->station)] & SBUS_FIO_MASK(entry->station)))
+            continue;
+
+        // Stays due until sent, like the value that triggered the flush
+        entry->timestamp = now - writer->flush_interval;
+        if (seed == NULL || precedes(entry, seed))
+            seed = entry;
+    }
+
+    if (seed == NULL)
+        return SBUS_NOT_FOUND;
+
+    sbus_media_type_t media = (sbus_media_type_t)seed->media;
+    size_t            limit = sbus_media_is_bit(media) ? SBUS_MAX_BITS_PER_WRITE : SBUS_MAX_VALUES_PER_FRAME;
+    size_t            count = 1;
+
+    run[0] = seed;
+    while (!seed->isolate && count < limit && (size_t)seed->address + count <= UINT16_MAX) {
+        sbus_write_entry_t *next =
+            find(writer, seed->station, media, (uint16_t)(seed->address + count), SBUS_WRITE_DIRTY);
+        if (next == NULL || next->isolate)
+            break;
+        run[count++] = next;
+    }
+
+    frame->station = seed->station;
+    frame->media   = media;
+    frame->start   = seed->address;
+    frame->count   = (uint8_t)count;
+
+    // Cannot fail: the media was checked by sbus_writer_set and the run respects the frame and address limits
+    if (sbus_media_is_bit(media)) {
+        uint8_t bits[SBUS_FIO_BYTES(SBUS_MAX_BITS_PER_WRITE)] = {0};
+        for (size_t i = 0; i < count; i++) {
+            if (run[i]->value)
+                bits[SBUS_FIO_BYTE(i)] |= SBUS_FIO_MASK(i);
+        }
+        sbus_packet_write_bits_request(frame->station, media, frame->start, bits, count, request);
+    } else {
+        uint32_t values[SBUS_MAX_VALUES_PER_FRAME];
+        for (size_t i = 0; i < count; i++)
+            values[i] = run[i]->value;
+        sbus_packet_write_values_request(frame->station, media, frame->start, values, count, request);
+    }
+
+    for (size_t i = 0; i < count; i++)
+        run[i]->state = SBUS_WRITE_IN_FLIGHT;
+
+    return SBUS_OK;
+}
+
+
+/*
+ * Hands back the outcome of a frame: `result` is the transport result and `response` the ACK/NAK character received
+ * when it is SBUS_OK. A station refuses a whole frame for a single bad address, so the values of a NAKed frame with
+ * more than one value are sent again one per frame to tell which ones were refused.
+ */
+void sbus_writer_complete(sbus_writer_t *writer, const sbus_write_frame_t *frame, sbus_result_t result,
+                          uint8_t response) {
+    int refused = result == SBUS_OK && response != SBUS_ACK;
+
+    writer->frames++;
+
+    for (size_t i = 0; i < frame->count; i++) {
+        uint16_t            address = (uint16_t)(frame->start + i);
+        sbus_write_entry_t *entry   = find(writer, frame->station, frame->media, address, SBUS_WRITE_IN_FLIGHT);
+        if (entry == NULL)
+            continue;
+
+        if (refused && frame->count > 1) {
+            sbus_write_entry_t *newer = find(writer, frame->station, frame->media, address, SBUS_WRITE_DIRTY);
+            if (newer != NULL) {
+                // Superseded while in flight: not written and not retried, the newer value is checked on its own
+                newer->isolate = 1;
+                finish(writer, entry, SBUS_INVALID_DATA);
+            } else {
+                entry->state   = SBUS_WRITE_DIRTY;
+                entry->isolate = 1;
+            }
+        } else if (refused) {
+            finish(writer, entry, SBUS_INVALID_DATA);
+        } else {
+            finish(writer, entry, result);
+        }
+    }
+}
+
+
+static sbus_write_entry_t *find(sbus_writer_t *writer, uint8_t station, sbus_media_type_t media, uint16_t address,
+                                sbus_write_state_t state) {
+    size_t index = hash(writer, station, media, address);
+
+    // Entries are freed once written, so the whole probe window is scanned
+    for (size_t i = 0; i < PROBE_LIMIT && i < writer->capacity; i++) {
+        sbus_write_entry_t *entry = &writer->entries[(index + i) & (writer->capacity - 1)];
+
+        if (entry->state == state && entry->station == station && entry->media == media && entry->address == address)
+            return entry;
+    }
+
+    return NULL;
+}
+
+
+static size_t hash(const sbus_writer_t *writer, uint8_t station, sbus_media_type_t media, uint16_t address) {
+    uint32_t key = ((uint32_t)station << 19) ^ ((uint32_t)media << 16) ^ address;
+    key *= 2654435761u;
+    key ^= key >> 15;
+    return key & (writer->capacity - 1);
+}
+
+
+static int precedes(const sbus_write_entry_t *first, const sbus_write_entry_t *second) {
+    if (first->station != second->station)
+        return first->station < second->station;
+    if (first->media != second->media)
+        return first->media < second->media;
+    return first->address < second->address;
+}
+
+
+static void finish(sbus_writer_t *writer, sbus_write_entry_t *entry, sbus_result_t result) {
+    entry->state = 0;
+    if (result == SBUS_OK)
+        writer->values++;
+    if (writer->report != NULL)
+        writer->report(writer, entry->station, (sbus_media_type_t)entry->media, entry->address, entry->value,
+                       result);
+}
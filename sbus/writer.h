@@ -0,0 +1,68 @@
+#ifndef SBUS_WRITER_H_INCLUDED
+#define SBUS_WRITER_H_INCLUDED
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "packet.h"
+
+typedef enum {
+    SBUS_WRITE_DIRTY = 1,
+    SBUS_WRITE_IN_FLIGHT,
+} sbus_write_state_t;
+
+
+typedef struct {
+    uint8_t  state;        // 0 when the entry is free
+    uint8_t  isolate;      // Part of a NAKed frame: sent alone to find out which value was refused
+    uint8_t  station;
+    uint8_t  media;
+    uint16_t address;
+    uint32_t value;        // 0 or 1 for flags and outputs
+    uint32_t timestamp;    // Milliseconds, when the value was first set since the last write
+} sbus_write_entry_t;
+
+
+typedef struct sbus_writer sbus_writer_t;
+
+/*
+ * Write-behind buffer: values set by the application are kept per (station, media type, address) until they are
+ * flushed, the latest value winning, and adjacent addresses are merged into multi-value write frames. The entries
+ * are provided by the caller; the caller also moves the frames on the bus and hands back the outcome.
+ */
+struct sbus_writer {
+    sbus_write_entry_t *entries;
+    size_t              capacity;
+    uint32_t            flush_interval;     // Milliseconds a value may wait for others to join it
+
+    // Optional, called once for every value with SBUS_OK if it was acknowledged, SBUS_INVALID_DATA if the station
+    // refused it (or the frame carrying it, when a newer value was set before it could be retried alone), or the
+    // transport error
+    void (*report)(sbus_writer_t *writer, uint8_t station, sbus_media_type_t media, uint16_t address, uint32_t value,
+                   sbus_result_t result);
+    void *arg;
+
+    unsigned long frames;
+    unsigned long values;
+};
+
+
+typedef struct {
+    uint8_t           station;
+    sbus_media_type_t media;
+    uint16_t          start;
+    uint8_t           count;
+} sbus_write_frame_t;
+
+
+sbus_result_t sbus_writer_init(sbus_writer_t *writer, sbus_write_entry_t *entries, size_t capacity,
+                               uint32_t flush_interval);
+sbus_result_t sbus_writer_set(sbus_writer_t *writer, uint8_t station, sbus_media_type_t media, uint16_t address,
+                              uint32_t value, uint32_t now);
+size_t        sbus_writer_pending(const sbus_writer_t *writer);
+sbus_result_t sbus_writer_next(sbus_writer_t *writer, uint32_t now, int flush, sbus_write_frame_t *frame,
+                               sbus_request_t *request);
+void          sbus_writer_complete(sbus_writer_t *writer, const sbus_write_frame_t *frame, sbus_result_t result,
+                                   uint8_t response);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef BENCH_H_INCLUDED
+#define BENCH_H_INCLUDED
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Helpers shared by the benchmark programs. Results are printed one per line, either as CSV (the default) or, when
+ * the program is started with `--json`, as one JSON object per line.
+ */
+
+static int               bench_json;
+static volatile uint32_t bench_sink;     // Keeps computed values alive under optimization
+
+
+static inline void bench_init(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0)
+            bench_json = 1;
+    }
+
+    if (!bench_json)
+        printf("benchmark,metric,value,unit\n");
+}
+
+
+static inline double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+
+static inline void bench_report(const char *benchmark, const char *metric, double value, const char *unit) {
+    if (bench_json)
+        printf("{\"benchmark\":\"%s\",\"metric\":\"%s\",\"value\":%.3f,\"unit\":\"%s\"}\n", benchmark, metric, value,
+               unit);
+    else
+        printf("%s,%s,%.3f,%s\n", benchmark, metric, value, unit);
+}
+
+#endif
@@ -0,0 +1,165 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sbus/packet.h"
+#include "sbus/scheduler.h"
+#include "sbus/simulator.h"
+#include "sbus/slave.h"
+#include "sbus/timing.h"
+#include "sbus/wire.h"
+#include "bench.h"
+
+#define STATIONS      60
+#define ABSENT        13     // Configured but not on the bus
+#define FLAKY         27     // Loses one request out of five
+#define REGISTERS     256
+#define FLAGS         256
+#define POLLS_PER     3
+#define DURATION_US   3600000000ULL
+#define FIXED_TIMEOUT 100000
+
+/*
+ * Polling strategies compared over an hour of simulated time on the same 115200 baud segment: every poll list entry
+ * back to back with a fixed timeout, earliest deadline first with a fixed timeout, and earliest deadline first with
+ * learned timeouts and offline stations. Refresh is the time between two successful reads of the alarm flags.
+ */
+
+typedef enum {
+    STRATEGY_ROUND_ROBIN = 0,
+    STRATEGY_EDF,
+    STRATEGY_EDF_ADAPTIVE,
+} strategy_t;
+
+static const char *const names[] = {"bus_round_robin", "bus_edf", "bus_edf_adaptive"};
+
+static sbus_slave_t          slaves[STATIONS];
+static sbus_sim_station_t    stations[STATIONS];
+static uint32_t              registers[STATIONS][REGISTERS];
+static uint8_t               flags[STATIONS][SBUS_FIO_BYTES(FLAGS)];
+static sbus_poll_t           polls[STATIONS * POLLS_PER];
+static uint64_t              last_ok[STATIONS * POLLS_PER];
+static sbus_sim_t            sim;
+static sbus_scheduler_t      scheduler;
+static sbus_station_timing_t timings[SBUS_TIMING_STATIONS];
+static sbus_timing_t         timing;
+static sbus_sim_histogram_t  refresh;
+static uint16_t              response[256];
+
+
+static void setup(const sbus_wire_t *wire) {
+    sbus_sim_init(&sim, wire, 0xC0FFEE);
+    sim.noise_ppm = 100;
+
+    for (size_t i = 0; i < STATIONS; i++) {
+        uint8_t station = (uint8_t)(i + 1);
+
+        sbus_slave_init(&slaves[i], station);
+        sbus_slave_set_media(&slaves[i], SBUS_MEDIA_REGISTER, registers[i], REGISTERS);
+        sbus_slave_set_media(&slaves[i], SBUS_MEDIA_FLAG, flags[i], FLAGS);
+        stations[i] = (sbus_sim_station_t){.slave = &slaves[i], .turnaround_us = 1000, .jitter_us = 1000};
+        if (station == FLAKY)
+            stations[i].drop_ppm = SBUS_SIM_PPM / 5;
+        if (station != ABSENT)
+            sbus_sim_attach(&sim, &stations[i]);
+
+        polls[i * POLLS_PER + 0] = (sbus_poll_t){.request   = SBUS_REQUEST(station, SBUS_COMMAND_READ_FLAG, {31, 0, 0}),
+                                                 .period_us = 500000};
+        polls[i * POLLS_PER + 1] =
+            (sbus_poll_t){.request = SBUS_READ_REGISTERS_REQUEST(station, 0, 32), .period_us = 5000000};
+        polls[i * POLLS_PER + 2] =
+            (sbus_poll_t){.request = SBUS_READ_REGISTERS_REQUEST(station, 100, 32), .period_us = 60000000};
+    }
+
+    memset(last_ok, 0, sizeof(last_ok));
+    memset(&refresh, 0, sizeof(refresh));
+    sbus_scheduler_init(&scheduler, wire, polls, STATIONS * POLLS_PER, 0);
+    sbus_timing_init(&timing, wire, timings);
+    // Never wait longer than the fixed strategies do
+    timing.max_us = FIXED_TIMEOUT;
+}
+
+
+static void poll_once(strategy_t strategy, sbus_poll_t *poll) {
+    size_t        index   = (size_t)(poll - polls);
+    uint8_t       station = poll->request.destination;
+    uint64_t      start   = sim.now_us;
+    uint32_t      timeout = FIXED_TIMEOUT;
+    size_t        len     = sizeof(response) / sizeof(response[0]);
+    sbus_result_t res;
+
+    if (strategy == STRATEGY_EDF_ADAPTIVE) {
+        if (sbus_timing_offline(&timing, station, start)) {
+            sbus_scheduler_complete(&scheduler, poll, start, 0);
+            return;
+        }
+        timeout = sbus_timing_timeout_us(&timing, &poll->request);
+    }
+
+    res = sbus_sim_exchange(&sim, &poll->request, timeout, response, &len);
+
+    if (strategy == STRATEGY_EDF_ADAPTIVE) {
+        if (res == SBUS_OK)
+            sbus_timing_sample(&timing, &poll->request, sim.now_us - start);
+        else if (res == SBUS_TIMEOUT)
+            sbus_timing_timeout(&timing, station, sim.now_us);
+    }
+    if (strategy != STRATEGY_ROUND_ROBIN)
+        sbus_scheduler_complete(&scheduler, poll, sim.now_us, (uint32_t)(sim.now_us - start));
+
+    if (res == SBUS_OK) {
+        if (index % POLLS_PER == 0 && last_ok[index] != 0 && station != FLAKY)
+            sbus_sim_histogram_add(&refresh, sim.now_us - last_ok[index]);
+        last_ok[index] = sim.now_us;
+    }
+}
+
+
+static void run(strategy_t strategy) {
+    sbus_wire_t wire = {.baud = 115200, .format = SBUS_WIRE_PARITY, .turnaround_us = 1500};
+    size_t      next = 0;
+
+    setup(&wire);
+
+    double start = bench_now();
+    while (sim.now_us < DURATION_US) {
+        if (strategy == STRATEGY_ROUND_ROBIN) {
+            poll_once(strategy, &polls[next]);
+            next = (next + 1) % (STATIONS * POLLS_PER);
+        } else {
+            sbus_poll_t *poll = NULL;
+            uint64_t     wait = 0;
+
+            if (sbus_scheduler_next(&scheduler, sim.now_us, &poll, &wait) == SBUS_NOT_FOUND)
+                sbus_sim_wait(&sim, wait);
+            else
+                poll_once(strategy, poll);
+        }
+    }
+    double elapsed = bench_now() - start;
+    double seconds = (double)sim.now_us / 1e6;
+
+    const char *name = names[strategy];
+    bench_report(name, "exchanges", (double)sim.exchanges / seconds, "1/s");
+    bench_report(name, "successful", (double)sim.ok / seconds, "1/s");
+    bench_report(name, "timeouts", (double)sim.timeouts, "exchanges");
+    bench_report(name, "utilization", (double)sbus_sim_utilization_ppm(&sim) / 1e4, "%");
+    bench_report(name, "exchange_p50", (double)sbus_sim_histogram_percentile(&sim.latency, 500) / 1e3, "ms");
+    bench_report(name, "exchange_p99", (double)sbus_sim_histogram_percentile(&sim.latency, 990) / 1e3, "ms");
+    bench_report(name, "alarm_refresh_p50", (double)sbus_sim_histogram_percentile(&refresh, 500) / 1e3, "ms");
+    bench_report(name, "alarm_refresh_p99", (double)sbus_sim_histogram_percentile(&refresh, 990) / 1e3, "ms");
+    if (strategy != STRATEGY_ROUND_ROBIN)
+        bench_report(name, "deadline_misses", (double)scheduler.misses, "polls");
+    bench_report(name, "speed", seconds / elapsed, "simulated s/s");
+}
+
+
+int main(int argc, char **argv) {
+    bench_init(argc, argv);
+
+    run(STRATEGY_ROUND_ROBIN);
+    run(STRATEGY_EDF);
+    run(STRATEGY_EDF_ADAPTIVE);
+
+    return 0;
+}
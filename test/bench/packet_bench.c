@@ -0,0 +1,354 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "sbus/crc.h"
+#include "sbus/decode.h"
+#include "sbus/packet.h"
+#include "sbus/sink.h"
+#include "bench.h"
+
+#define CRC_BLOCK      4096
+#define CRC_ITERATIONS 20000
+#define FRAMES         4096
+#define ITERATIONS     200
+#define CALLS          200000
+
+static uint8_t  bytes[CRC_BLOCK];
+static uint16_t words[CRC_BLOCK];
+static uint16_t clean[FRAMES * 48];
+static uint16_t noisy[FRAMES * 64];
+static uint8_t  packed[FRAMES * 48];
+static uint8_t  address_map[SBUS_ADDRESS_MAP_BYTES(FRAMES * 48)];
+
+
+static uint32_t xorshift(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+
+static sbus_request_t request_for(size_t i) {
+    sbus_request_t request;
+
+    if (i % 2 == 0) {
+        request = (sbus_request_t)SBUS_READ_REGISTERS_REQUEST((uint8_t)(i % 30), (uint16_t)i, 32);
+    } else {
+        request.destination = (uint8_t)(i % 30);
+        request.command     = SBUS_COMMAND_WRITE_REGISTER;
+        request.data_len    = 3 + 8 * 4;
+        request.data[0]     = 1 + 8 * 4;
+        request.data[1]     = 0;
+        request.data[2]     = (uint8_t)i;
+        for (size_t j = 3; j < request.data_len; j++)
+            request.data[j] = (uint8_t)(i + j);
+    }
+
+    return request;
+}
+
+
+/*
+ * The noisy stream interleaves the frames with runs of line garbage (data words only) and corrupts the CRC of one
+ * frame out of eight.
+ */
+static size_t build_streams(size_t *noisy_total, size_t *garbage) {
+    uint32_t state = 0x1234567;
+    size_t   total = 0;
+
+    *noisy_total = 0;
+    *garbage     = 0;
+
+    for (size_t i = 0; i < FRAMES; i++) {
+        sbus_request_t request = request_for(i);
+        size_t         len     = sbus_packet_serialize_request(&clean[total], &request);
+
+        size_t noise = xorshift(&state) % 8;
+        for (size_t j = 0; j < noise; j++)
+            noisy[(*noisy_total)++] = (uint16_t)(xorshift(&state) & 0xFF);
+        *garbage += noise;
+
+        for (size_t j = 0; j < len; j++)
+            noisy[*noisy_total + j] = clean[total + j];
+        if (i % 8 == 7)
+            noisy[*noisy_total + len - 1] ^= 0x55;
+
+        *noisy_total += len;
+        total += len;
+    }
+
+    return total;
+}
+
+
+/*
+ * Parses a whole stream, skipping one word past the start of any frame that cannot be decoded. Returns the number of
+ * frames found with a good CRC.
+ */
+static size_t parse_stream(uint16_t *stream, size_t total, size_t *wrong_crc) {
+    size_t offset = 0;
+    size_t found  = 0;
+
+    while (offset < total) {
+        sbus_request_t request;
+        size_t         len = total - offset;
+        sbus_result_t  res = sbus_packet_parse_request(&stream[offset], &len, &request);
+
+        switch (res) {
+            case SBUS_OK:
+                found++;
+                bench_sink += request.data[0];
+                offset += len;
+                break;
+
+            case SBUS_WRONG_CRC:
+                (*wrong_crc)++;
+                offset += len;
+                break;
+
+            case SBUS_NOT_FOUND:
+            case SBUS_INCOMPLETE_PACKET:
+                offset = total;
+                break;
+
+            default:
+                // Resync on the word after the first address character
+                while (offset < total && !(stream[offset] & 0x100))
+                    offset++;
+                offset++;
+                break;
+        }
+    }
+
+    return found;
+}
+
+
+static void bench_crc(void) {
+    uint32_t state = 42;
+    for (size_t i = 0; i < CRC_BLOCK; i++) {
+        bytes[i] = (uint8_t)xorshift(&state);
+        words[i] = (uint16_t)(bytes[i] | (i % 64 == 0 ? 0x100 : 0));
+    }
+
+    double   start = bench_now();
+    uint16_t crc   = 0;
+    for (size_t it = 0; it < CRC_ITERATIONS; it++)
+        crc ^= sbus_crc16_8bit(bytes, CRC_BLOCK);
+    double elapsed = bench_now() - start;
+    bench_sink += crc;
+    bench_report("crc16_8bit", "throughput", (double)CRC_BLOCK * CRC_ITERATIONS / elapsed / 1e6, "MB/s");
+
+    start = bench_now();
+    for (size_t it = 0; it < CRC_ITERATIONS; it++)
+        crc ^= sbus_crc16_9bit(words, CRC_BLOCK);
+    elapsed = bench_now() - start;
+    bench_sink += crc;
+    bench_report("crc16_9bit", "throughput", (double)CRC_BLOCK * CRC_ITERATIONS / elapsed / 1e6, "Mwords/s");
+    bench_report("crc16", "slices", SBUS_CRC_SLICES, "tables");
+}
+
+
+static void bench_parse(void) {
+    size_t noisy_total = 0;
+    size_t garbage     = 0;
+    size_t total       = build_streams(&noisy_total, &garbage);
+    size_t wrong_crc   = 0;
+    size_t found       = 0;
+
+    double start = bench_now();
+    for (size_t it = 0; it < ITERATIONS; it++)
+        found += parse_stream(clean, total, &wrong_crc);
+    double elapsed = bench_now() - start;
+    bench_report("parse_request_clean", "frames_per_second", (double)found / elapsed, "frames/s");
+    bench_report("parse_request_clean", "words_per_second", (double)total * ITERATIONS / elapsed, "words/s");
+
+    found     = 0;
+    wrong_crc = 0;
+    start     = bench_now();
+    for (size_t it = 0; it < ITERATIONS; it++)
+        found += parse_stream(noisy, noisy_total, &wrong_crc);
+    elapsed = bench_now() - start;
+    bench_report("parse_request_noisy", "frames_per_second", (double)(found + wrong_crc) / elapsed, "frames/s");
+    bench_report("parse_request_noisy", "words_per_second", (double)noisy_total * ITERATIONS / elapsed, "words/s");
+    bench_report("parse_request_noisy", "good_frames", (double)found / ITERATIONS, "frames");
+    bench_report("parse_request_noisy", "wrong_crc_frames", (double)wrong_crc / ITERATIONS, "frames");
+    bench_report("parse_request_noisy", "garbage_words", (double)garbage, "words");
+}
+
+
+/*
+ * Parsing straight from bytes and an address bitmap, and the conversions between the two stream layouts.
+ */
+static void bench_8bit(void) {
+    size_t noisy_total = 0;
+    size_t garbage     = 0;
+    size_t total       = build_streams(&noisy_total, &garbage);
+    size_t found       = 0;
+
+    double start = bench_now();
+    for (size_t it = 0; it < ITERATIONS; it++)
+        sbus_packet_pack_9bit(clean, total, packed, address_map);
+    double elapsed = bench_now() - start;
+    bench_report("pack_9bit", "throughput", (double)total * ITERATIONS / elapsed / 1e6, "Mwords/s");
+
+    start = bench_now();
+    for (size_t it = 0; it < ITERATIONS; it++)
+        sbus_packet_unpack_9bit(packed, address_map, total, noisy);
+    elapsed = bench_now() - start;
+    bench_report("unpack_9bit", "throughput", (double)total * ITERATIONS / elapsed / 1e6, "Mwords/s");
+
+    start = bench_now();
+    for (size_t it = 0; it < ITERATIONS; it++) {
+        size_t offset = 0;
+        while (offset < total) {
+            sbus_request_t request;
+            size_t         len = total - offset;
+            if (sbus_packet_parse_request_8bit(packed, address_map, offset, &len, &request) != SBUS_OK)
+                return;
+            bench_sink += request.data[0];
+            offset += len;
+            found++;
+        }
+    }
+    elapsed = bench_now() - start;
+    bench_report("parse_request_8bit", "frames_per_second", (double)found / elapsed, "frames/s");
+}
+
+
+static void bench_validate(void) {
+    uint16_t wide[SBUS_MAX_VALUES_PER_FRAME * 4 + 2];
+    uint8_t  narrow[SBUS_MAX_VALUES_PER_FRAME * 4 + 2];
+    uint32_t values[SBUS_MAX_VALUES_PER_FRAME];
+    char     name[64];
+
+    for (size_t i = 0; i < SBUS_MAX_VALUES_PER_FRAME; i++)
+        values[i] = (uint32_t)(i * 0x01010101u);
+
+    for (size_t count = 1; count <= SBUS_MAX_VALUES_PER_FRAME; count *= 2) {
+        sbus_request_t request = SBUS_READ_REGISTERS_REQUEST(1, 0, count);
+        int            len     = sbus_packet_serialize_values_response(wide, sizeof(wide) / sizeof(wide[0]), values,
+                                                                       count);
+        for (int i = 0; i < len; i++)
+            narrow[i] = (uint8_t)wide[i];
+
+        double start = bench_now();
+        for (size_t it = 0; it < CALLS; it++) {
+            size_t size = (size_t)len;
+            bench_sink += (uint32_t)sbus_packet_validate_response_9bit(&request, wide, &size);
+        }
+        double elapsed = bench_now() - start;
+        snprintf(name, sizeof(name), "validate_response_9bit_r%zu", count);
+        bench_report(name, "time_per_call", elapsed / CALLS * 1e9, "ns");
+
+        start = bench_now();
+        for (size_t it = 0; it < CALLS; it++) {
+            size_t size = (size_t)len;
+            bench_sink += (uint32_t)sbus_packet_validate_response_8bit(&request, narrow, &size);
+        }
+        elapsed = bench_now() - start;
+        snprintf(name, sizeof(name), "validate_response_8bit_r%zu", count);
+        bench_report(name, "time_per_call", elapsed / CALLS * 1e9, "ns");
+
+        // Validation followed by a separate decode pass, against the fused decoder
+        uint32_t decoded[SBUS_MAX_VALUES_PER_FRAME];
+        start = bench_now();
+        for (size_t it = 0; it < CALLS; it++) {
+            size_t size = (size_t)len;
+            if (sbus_packet_validate_response_9bit(&request, wide, &size) == SBUS_OK)
+                sbus_decode_be32_9bit(wide, count, decoded);
+            bench_sink += decoded[count - 1];
+        }
+        elapsed = bench_now() - start;
+        snprintf(name, sizeof(name), "validate_then_decode_9bit_r%zu", count);
+        bench_report(name, "time_per_call", elapsed / CALLS * 1e9, "ns");
+
+        start = bench_now();
+        for (size_t it = 0; it < CALLS; it++) {
+            size_t size = (size_t)len;
+            sbus_decode_values_9bit(&request, wide, &size, decoded);
+            bench_sink += decoded[count - 1];
+        }
+        elapsed = bench_now() - start;
+        snprintf(name, sizeof(name), "decode_values_9bit_r%zu", count);
+        bench_report(name, "time_per_call", elapsed / CALLS * 1e9, "ns");
+    }
+}
+
+
+static void bench_serialize(void) {
+    sbus_request_t read  = request_for(0);
+    sbus_request_t write = request_for(1);
+    uint16_t       buffer[sizeof(read.data) + 4];
+
+    double start = bench_now();
+    for (size_t it = 0; it < CALLS; it++) {
+        read.data[2] = (uint8_t)it;
+        bench_sink += (uint32_t)sbus_packet_serialize_request(buffer, &read) + buffer[5];
+    }
+    double elapsed = bench_now() - start;
+    bench_report("serialize_request_read", "time_per_call", elapsed / CALLS * 1e9, "ns");
+
+    start = bench_now();
+    for (size_t it = 0; it < CALLS; it++) {
+        write.data[3] = (uint8_t)it;
+        bench_sink += (uint32_t)sbus_packet_serialize_request(buffer, &write) + buffer[38];
+    }
+    elapsed = bench_now() - start;
+    bench_report("serialize_request_write8", "time_per_call", elapsed / CALLS * 1e9, "ns");
+}
+
+
+/*
+ * Queueing a 32 register response on a UART ring: serialized into words and narrowed into the ring, against
+ * serialized straight into it.
+ */
+static void bench_transmit(void) {
+    uint32_t    values[SBUS_MAX_VALUES_PER_FRAME];
+    uint16_t    wide[SBUS_MAX_VALUES_PER_FRAME * 4 + 2];
+    uint8_t     ring[256];
+    size_t      head = 0;
+    sbus_sink_t sink;
+
+    for (size_t i = 0; i < SBUS_MAX_VALUES_PER_FRAME; i++)
+        values[i] = (uint32_t)(i * 0x01010101u);
+
+    double start = bench_now();
+    for (size_t it = 0; it < CALLS; it++) {
+        values[0] = (uint32_t)it;
+        int len   = sbus_packet_serialize_values_response(wide, sizeof(wide) / sizeof(wide[0]), values,
+                                                          SBUS_MAX_VALUES_PER_FRAME);
+        for (int i = 0; i < len; i++) {
+            ring[head] = (uint8_t)wide[i];
+            head       = (head + 1) % sizeof(ring);
+        }
+        bench_sink += ring[head];
+    }
+    double elapsed = bench_now() - start;
+    bench_report("transmit_copy_r32", "time_per_call", elapsed / CALLS * 1e9, "ns");
+
+    sbus_sink_init_8bit(&sink, ring, NULL, sizeof(ring));
+    start = bench_now();
+    for (size_t it = 0; it < CALLS; it++) {
+        values[0] = (uint32_t)it;
+        int len   = sbus_sink_serialize_values_response(&sink, values, SBUS_MAX_VALUES_PER_FRAME);
+        sbus_sink_consume(&sink, (size_t)len);
+        bench_sink += ring[sink.head];
+    }
+    elapsed = bench_now() - start;
+    bench_report("transmit_sink_r32", "time_per_call", elapsed / CALLS * 1e9, "ns");
+}
+
+
+int main(int argc, char **argv) {
+    bench_init(argc, argv);
+
+    bench_crc();
+    bench_parse();
+    bench_8bit();
+    bench_validate();
+    bench_serialize();
+    bench_transmit();
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "sbus/packet.h"
+#include "bench.h"
+
+#define FRAMES     4096
+#define ITERATIONS 200
+
+static uint16_t stream[FRAMES * 48];
+
+
+static size_t build_stream(void) {
+    size_t total = 0;
+
+    for (size_t i = 0; i < FRAMES; i++) {
+        sbus_request_t request;
+        if (i % 2 == 0) {
+            request = (sbus_request_t)SBUS_READ_REGISTERS_REQUEST((uint8_t)(i % 30), (uint16_t)i, 32);
+        } else {
+            // Eight values in a single multi-value write
+            request.destination = (uint8_t)(i % 30);
+            request.command     = SBUS_COMMAND_WRITE_REGISTER;
+            request.data_len    = 3 + 8 * 4;
+            request.data[0]     = 1 + 8 * 4;
+            request.data[1]     = 0;
+            request.data[2]     = (uint8_t)i;
+            for (size_t j = 3; j < request.data_len; j++)
+                request.data[j] = (uint8_t)(i + j);
+        }
+        total += sbus_packet_serialize_request(&stream[total], &request);
+    }
+
+    return total;
+}
+
+
+int main(int argc, char **argv) {
+    bench_init(argc, argv);
+
+    size_t   total       = build_stream();
+    size_t   data_copied = 0;
+    uint32_t checksum    = 0;
+
+    double start = bench_now();
+    for (size_t it = 0; it < ITERATIONS; it++) {
+        size_t offset = 0;
+        while (offset < total) {
+            sbus_request_t request;
+            size_t         len = total - offset;
+            if (sbus_packet_parse_request(&stream[offset], &len, &request) != SBUS_OK)
+                return 1;
+            checksum += request.data[0];
+            data_copied += request.data_len;
+            offset += len;
+        }
+    }
+    double copy_time = bench_now() - start;
+
+    start = bench_now();
+    for (size_t it = 0; it < ITERATIONS; it++) {
+        size_t offset = 0;
+        while (offset < total) {
+            sbus_request_view_t view;
+            size_t              len = total - offset;
+            if (sbus_packet_parse_request_view(&stream[offset], &len, &view) != SBUS_OK)
+                return 1;
+            checksum += sbus_request_view_byte(&view, 0);
+            offset += len;
+        }
+    }
+    double view_time = bench_now() - start;
+
+    double frames = (double)FRAMES * ITERATIONS;
+    bench_report("parse_request", "frames_per_second", frames / copy_time, "frames/s");
+    bench_report("parse_request", "bytes_copied_per_frame", (double)data_copied / frames, "bytes");
+    bench_report("parse_request", "bytes_per_request", (double)sizeof(sbus_request_t), "bytes");
+    bench_report("parse_request_view", "frames_per_second", frames / view_time, "frames/s");
+    bench_report("parse_request_view", "bytes_copied_per_frame", 0, "bytes");
+    bench_report("parse_request_view", "bytes_per_request", (double)sizeof(sbus_request_view_t), "bytes");
+
+    bench_sink = checksum;
+    return 0;
+}
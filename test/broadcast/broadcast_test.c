@@ -0,0 +1,172 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sbus/broadcast.h"
+#include "sbus/decode.h"
+#include "sbus/packet.h"
+#include "sbus/planner.h"
+#include "sbus/simulator.h"
+#include "sbus/slave.h"
+#include "sbus/wire.h"
+#include "unity.h"
+
+#define STATIONS  30
+#define REGISTERS 64
+#define FLAGS     64
+#define SMALL     20     // Station with fewer registers than the broadcast writes
+#define SILENT    12     // Station that never answers
+
+static sbus_slave_t       slaves[STATIONS];
+static sbus_sim_station_t stations[STATIONS];
+static uint32_t           registers[STATIONS][REGISTERS];
+static uint8_t            flags[STATIONS][SBUS_FIO_BYTES(FLAGS)];
+static sbus_sim_t         sim;
+static sbus_wire_t        wire = {.baud = 38400, .format = SBUS_WIRE_PARITY, .turnaround_us = 2000};
+static uint16_t           response[256];
+
+void setUp() {
+    memset(registers, 0, sizeof(registers));
+    memset(flags, 0, sizeof(flags));
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_sim_init(&sim, &wire, 7));
+
+    for (size_t i = 0; i < STATIONS; i++) {
+        uint8_t station = (uint8_t)(i + 1);
+        sbus_slave_init(&slaves[i], station);
+        sbus_slave_set_media(&slaves[i], SBUS_MEDIA_REGISTER, registers[i], station == SMALL ? 4 : REGISTERS);
+        sbus_slave_set_media(&slaves[i], SBUS_MEDIA_FLAG, flags[i], FLAGS);
+        stations[i] = (sbus_sim_station_t){.slave = &slaves[i], .turnaround_us = wire.turnaround_us};
+        if (station == SILENT)
+            stations[i].drop_ppm = SBUS_SIM_PPM;
+        TEST_ASSERT_EQUAL(SBUS_OK, sbus_sim_attach(&sim, &stations[i]));
+    }
+}
+
+void tearDown() {}
+
+
+static sbus_result_t send(const sbus_request_t *request) {
+    size_t        len   = sizeof(response) / sizeof(response[0]);
+    uint64_t      start = sim.now_us;
+    sbus_result_t res   = sbus_sim_exchange(&sim, request, 100000, response, &len);
+
+    if (request->destination == SBUS_BROADCAST_ADDRESS)
+        sbus_sim_wait(&sim, start + sbus_wire_guard_us(&wire, request) - sim.now_us);
+    return res;
+}
+
+
+void test_requests() {
+    uint32_t       values[2] = {0x01020304, 7};
+    uint8_t        bits[2]   = {0xFF, 0xFF};
+    sbus_request_t request;
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_broadcast_values_request(SBUS_MEDIA_REGISTER, 300, values, 2, &request));
+    TEST_ASSERT_EQUAL(SBUS_BROADCAST_ADDRESS, request.destination);
+    TEST_ASSERT_EQUAL(SBUS_COMMAND_WRITE_REGISTER, request.command);
+    TEST_ASSERT_EQUAL(11, request.data_len);
+    TEST_ASSERT_EQUAL(9, request.data[0]);
+    TEST_ASSERT_EQUAL(300, SBUS_PACKET_REG_ADDR(&request));
+    TEST_ASSERT_EQUAL(0x04, request.data[6]);
+    TEST_ASSERT_EQUAL(0, sbus_packet_response_length(&request));
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_broadcast_bits_request(SBUS_MEDIA_FLAG, 8, bits, 10, &request));
+    TEST_ASSERT_EQUAL(SBUS_COMMAND_WRITE_FLAG, request.command);
+    TEST_ASSERT_EQUAL(6, request.data_len);
+    TEST_ASSERT_EQUAL(9, request.data[3]);
+    TEST_ASSERT_EQUAL(0xFF, request.data[4]);
+    TEST_ASSERT_EQUAL(0x03, request.data[5]);
+
+    sbus_clock_t clock = {.year = 24, .month = 12, .day = 31, .hour = 23, .minute = 59, .second = 58};
+    sbus_broadcast_clock_request(&clock, &request);
+    TEST_ASSERT_EQUAL(SBUS_COMMAND_WRITE_REAL_TIME_CLOCK, request.command);
+    TEST_ASSERT_EQUAL(0x24, request.data[0]);
+    TEST_ASSERT_EQUAL(0x58, request.data[5]);
+
+    TEST_ASSERT_EQUAL(SBUS_INVALID_ARGS, sbus_broadcast_values_request(SBUS_MEDIA_FLAG, 0, values, 2, &request));
+    TEST_ASSERT_EQUAL(SBUS_INVALID_ARGS, sbus_broadcast_values_request(SBUS_MEDIA_REGISTER, 0, values, 33, &request));
+    TEST_ASSERT_EQUAL(SBUS_INVALID_ARGS,
+                      sbus_broadcast_values_request(SBUS_MEDIA_REGISTER, UINT16_MAX, values, 2, &request));
+    TEST_ASSERT_EQUAL(SBUS_INVALID_ARGS, sbus_broadcast_bits_request(SBUS_MEDIA_INPUT, 0, bits, 8, &request));
+    TEST_ASSERT_EQUAL(SBUS_INVALID_ARGS, sbus_broadcast_bits_request(SBUS_MEDIA_OUTPUT, 0, bits, 121, &request));
+}
+
+
+/*
+ * A setpoint block pushed to every station in one frame, then verified on a few of them with one read each.
+ */
+void test_fan_out_and_verify() {
+    uint32_t       setpoints[8] = {210, 215, 220, 180, 0, 1, 2, 3};
+    sbus_request_t request;
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_broadcast_values_request(SBUS_MEDIA_REGISTER, 0, setpoints, 8, &request));
+    TEST_ASSERT_EQUAL(SBUS_OK, send(&request));
+    uint64_t broadcast_us = sim.now_us;
+    TEST_ASSERT_EQUAL(sbus_wire_guard_us(&wire, &request), broadcast_us);
+
+    for (size_t i = 0; i < STATIONS; i++) {
+        uint32_t expected = i + 1 == SMALL ? 0 : 220;
+        TEST_ASSERT_EQUAL(expected, registers[i][2]);
+    }
+
+    // The same block written station by station
+    sbus_request_t unicast = request;
+    for (uint8_t station = 1; station <= STATIONS; station++) {
+        unicast.destination = station;
+        send(&unicast);
+    }
+    TEST_ASSERT_GREATER_THAN(20 * broadcast_us, sim.now_us - broadcast_us);
+
+    uint8_t               checked[4] = {3, 7, SILENT, SMALL};
+    sbus_point_t          points[4 * 8];
+    size_t                num_points = 0;
+    sbus_read_frame_t     frames[8];
+    size_t                num_frames = 0;
+    sbus_planner_config_t config     = {.gap_tolerance = 0};
+
+    TEST_ASSERT_EQUAL(SBUS_INVALID_ARGS, sbus_broadcast_readback(&request, checked, 4, points, 31, &num_points));
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_broadcast_readback(&request, checked, 4, points, 32, &num_points));
+    TEST_ASSERT_EQUAL(32, num_points);
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_planner_plan(&config, points, num_points, frames, 8, &num_frames));
+    TEST_ASSERT_EQUAL(4, num_frames);
+
+    registers[6][5] = 99;     // Station 7 changed one value since
+    for (size_t i = 0; i < num_frames; i++) {
+        sbus_request_t read;
+        sbus_planner_frame_request(&frames[i], &read);
+        if (send(&read) == SBUS_OK)
+            sbus_planner_scatter_9bit(&frames[i], points, response);
+    }
+
+    uint8_t failed[4];
+    TEST_ASSERT_EQUAL(3, sbus_broadcast_verify(&request, points, num_points, failed, 4));
+    TEST_ASSERT_EQUAL(7, failed[0]);
+    TEST_ASSERT_EQUAL(SILENT, failed[1]);
+    TEST_ASSERT_EQUAL(SMALL, failed[2]);
+    TEST_ASSERT_EQUAL(3, sbus_broadcast_verify(&request, points, num_points, failed, 1));
+}
+
+
+void test_flags_fan_out() {
+    uint8_t        bits[1] = {0x05};
+    sbus_request_t request;
+    sbus_point_t   points[2 * 3];
+    size_t         num_points = 0;
+    uint8_t        checked[2] = {1, 30};
+    uint8_t        failed[2];
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_broadcast_bits_request(SBUS_MEDIA_FLAG, 9, bits, 3, &request));
+    TEST_ASSERT_EQUAL(SBUS_OK, send(&request));
+    TEST_ASSERT_EQUAL(0x0A, flags[0][1]);
+    TEST_ASSERT_EQUAL(0x0A, flags[STATIONS - 1][1]);
+    TEST_ASSERT_EQUAL(0x00, flags[STATIONS - 1][0]);
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_broadcast_readback(&request, checked, 2, points, 6, &num_points));
+    for (size_t i = 0; i < num_points; i++) {
+        points[i].valid = 1;
+        points[i].value = (points[i].address - 9) % 2 == 0;
+    }
+    TEST_ASSERT_EQUAL(0, sbus_broadcast_verify(&request, points, num_points, failed, 2));
+    points[4].value = 1;
+    TEST_ASSERT_EQUAL(1, sbus_broadcast_verify(&request, points, num_points, failed, 2));
+    TEST_ASSERT_EQUAL(30, failed[0]);
+}
@@ -0,0 +1,132 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "sbus/cache.h"
+#include "sbus/packet.h"
+#include "sbus/planner.h"
+#include "unity.h"
+
+static sbus_cache_t       cache;
+static sbus_cache_entry_t entries[64];
+
+void setUp() {
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_cache_init(&cache, entries, 64));
+}
+
+void tearDown() {}
+
+
+void test_read_response_and_max_age() {
+    sbus_request_t request    = SBUS_READ_REGISTERS_REQUEST(3, 100, 2);
+    uint16_t       response[] = {0x00, 0x00, 0x01, 0x02, 0x12, 0x34, 0x56, 0x78};
+    uint32_t       value      = 0;
+
+    TEST_ASSERT_EQUAL(SBUS_INVALID_ARGS, sbus_cache_init(&cache, entries, 48));
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_cache_init(&cache, entries, 64));
+
+    TEST_ASSERT_EQUAL(SBUS_NOT_FOUND, sbus_cache_get(&cache, 3, SBUS_MEDIA_REGISTER, 100, 0, 1000, &value));
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_cache_update_9bit(&cache, &request, response, 8, 1000));
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_cache_get(&cache, 3, SBUS_MEDIA_REGISTER, 100, 1050, 100, &value));
+    TEST_ASSERT_EQUAL(0x0102, value);
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_cache_get(&cache, 3, SBUS_MEDIA_REGISTER, 101, 1050, 100, &value));
+    TEST_ASSERT_EQUAL(0x12345678, value);
+    TEST_ASSERT_EQUAL(SBUS_NOT_FOUND, sbus_cache_get(&cache, 3, SBUS_MEDIA_COUNTER, 100, 1050, 100, &value));
+    TEST_ASSERT_EQUAL(SBUS_NOT_FOUND, sbus_cache_get(&cache, 3, SBUS_MEDIA_REGISTER, 100, 1200, 100, &value));
+
+    TEST_ASSERT_EQUAL(2, cache.hits);
+    TEST_ASSERT_EQUAL(3, cache.misses);
+    TEST_ASSERT_EQUAL(1, cache.stale);
+
+    // Timestamps wrap around
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_cache_update_9bit(&cache, &request, response, 8, 0xFFFFFFF0));
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_cache_get(&cache, 3, SBUS_MEDIA_REGISTER, 100, 0x10, 100, &value));
+
+    sbus_cache_invalidate_station(&cache, 3);
+    TEST_ASSERT_EQUAL(SBUS_NOT_FOUND, sbus_cache_get(&cache, 3, SBUS_MEDIA_REGISTER, 100, 0x10, 100, &value));
+}
+
+
+void test_flags_8bit() {
+    sbus_request_t request = {
+        .destination = 1,
+        .command     = SBUS_COMMAND_READ_FLAG,
+        .data_len    = 3,
+        .data        = {9, 0x00, 0x08},
+    };
+    uint8_t  response[] = {0x05, 0x02};
+    uint32_t value      = 0;
+
+    TEST_ASSERT_EQUAL(SBUS_INCOMPLETE_PACKET, sbus_cache_update_8bit(&cache, &request, response, 1, 0));
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_cache_update_8bit(&cache, &request, response, 2, 0));
+
+    uint32_t expected[] = {1, 0, 1, 0, 0, 0, 0, 0, 0, 1};
+    for (uint16_t i = 0; i < 10; i++) {
+        TEST_ASSERT_EQUAL(SBUS_OK, sbus_cache_get(&cache, 1, SBUS_MEDIA_FLAG, 8 + i, 0, 0, &value));
+        TEST_ASSERT_EQUAL(expected[i], value);
+    }
+}
+
+
+void test_acked_writes() {
+    sbus_request_t write   = SBUS_WRITE_REGISTER_REQUEST(2, 7, 99);
+    uint16_t       ack[]   = {SBUS_ACK, 0x00};
+    uint16_t       nak[]   = {SBUS_NAK, 0x00};
+    uint32_t       value   = 0;
+    sbus_request_t flags   = {
+          .destination = 2,
+          .command     = SBUS_COMMAND_WRITE_FLAG,
+          .data_len    = 5,
+          .data        = {4, 0x00, 0x20, 2, 0x05},
+    };
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_cache_update_9bit(&cache, &write, nak, 2, 0));
+    TEST_ASSERT_EQUAL(SBUS_NOT_FOUND, sbus_cache_get(&cache, 2, SBUS_MEDIA_REGISTER, 7, 0, 10, &value));
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_cache_update_9bit(&cache, &write, ack, 2, 0));
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_cache_get(&cache, 2, SBUS_MEDIA_REGISTER, 7, 0, 10, &value));
+    TEST_ASSERT_EQUAL(99, value);
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_cache_update_9bit(&cache, &flags, ack, 2, 0));
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_cache_get(&cache, 2, SBUS_MEDIA_FLAG, 0x20, 0, 10, &value));
+    TEST_ASSERT_EQUAL(1, value);
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_cache_get(&cache, 2, SBUS_MEDIA_FLAG, 0x21, 0, 10, &value));
+    TEST_ASSERT_EQUAL(0, value);
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_cache_get(&cache, 2, SBUS_MEDIA_FLAG, 0x22, 0, 10, &value));
+    TEST_ASSERT_EQUAL(1, value);
+}
+
+
+void test_resolve_points() {
+    sbus_point_t points[] = {
+        {.station = 1, .media = SBUS_MEDIA_REGISTER, .address = 1},
+        {.station = 1, .media = SBUS_MEDIA_REGISTER, .address = 2},
+        {.station = 1, .media = SBUS_MEDIA_REGISTER, .address = 3},
+        {.station = 1, .media = SBUS_MEDIA_REGISTER, .address = 4},
+    };
+
+    sbus_cache_put(&cache, 1, SBUS_MEDIA_REGISTER, 2, 22, 100);
+    sbus_cache_put(&cache, 1, SBUS_MEDIA_REGISTER, 4, 44, 10);
+
+    TEST_ASSERT_EQUAL(3, sbus_cache_resolve(&cache, points, 4, 120, 50));
+    TEST_ASSERT_EQUAL(1, points[0].address);
+    TEST_ASSERT_EQUAL(3, points[1].address);
+    TEST_ASSERT_EQUAL(4, points[2].address);
+    TEST_ASSERT_EQUAL(2, points[3].address);
+    TEST_ASSERT_TRUE(points[3].valid);
+    TEST_ASSERT_EQUAL(22, points[3].value);
+}
+
+
+void test_eviction_keeps_table_bounded() {
+    sbus_cache_entry_t small[4];
+    uint32_t           value = 0;
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_cache_init(&cache, small, 4));
+    for (uint16_t i = 0; i < 16; i++)
+        sbus_cache_put(&cache, 1, SBUS_MEDIA_TIMER, i, i, i);
+
+    // Only the most recent values survive
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_cache_get(&cache, 1, SBUS_MEDIA_TIMER, 15, 15, 100, &value));
+    TEST_ASSERT_EQUAL(15, value);
+    TEST_ASSERT_EQUAL(SBUS_NOT_FOUND, sbus_cache_get(&cache, 1, SBUS_MEDIA_TIMER, 0, 15, 100, &value));
+}
@@ -0,0 +1,109 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "sbus/capture.h"
+#include "sbus/packet.h"
+#include "sbus/posix/capture_file.h"
+#include "unity.h"
+
+#define RING_SIZE 4096
+
+static uint64_t       memory[RING_SIZE / sizeof(uint64_t)];
+static sbus_capture_t capture;
+
+
+void setUp() {
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_capture_init(&capture, memory, sizeof(memory)));
+}
+
+void tearDown() {}
+
+
+void test_round_trip() {
+    uint16_t       words[16];
+    sbus_request_t request = SBUS_READ_REGISTERS_REQUEST(7, 300, 2);
+    size_t         len     = sbus_packet_serialize_request(words, &request);
+    uint8_t        reply[] = {0x00, 0x00, 0x01, 0x2C, 0x12, 0x34};
+
+    sbus_capture_9bit(&capture, 1000, SBUS_CAPTURE_TX, SBUS_OK, words, len);
+    sbus_capture_8bit(&capture, 1900, SBUS_CAPTURE_RX, SBUS_WRONG_CRC, reply, sizeof(reply));
+
+    sbus_capture_record_t record;
+    uint64_t              position = sbus_capture_first(&capture);
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_capture_next(&capture, &position, &record));
+    TEST_ASSERT_EQUAL(1000, record.timestamp_us);
+    TEST_ASSERT_EQUAL(SBUS_CAPTURE_TX, record.direction);
+    TEST_ASSERT_EQUAL(len, record.count);
+    TEST_ASSERT_NOT_NULL(record.address_map);
+
+    uint16_t unpacked[16];
+    sbus_packet_unpack_9bit(record.bytes, record.address_map, record.count, unpacked);
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(words, unpacked, len);
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_capture_next(&capture, &position, &record));
+    TEST_ASSERT_EQUAL(SBUS_CAPTURE_RX, record.direction);
+    TEST_ASSERT_EQUAL(SBUS_WRONG_CRC, record.result);
+    TEST_ASSERT_NULL(record.address_map);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(reply, record.bytes, sizeof(reply));
+
+    TEST_ASSERT_EQUAL(SBUS_NOT_FOUND, sbus_capture_next(&capture, &position, &record));
+}
+
+
+void test_wrap_around() {
+    uint8_t bytes[100];
+
+    // Far more than the ring holds; only the newest records survive, in order, across the wrap
+    for (uint32_t i = 0; i < 500; i++) {
+        memset(bytes, (int)i, sizeof(bytes));
+        sbus_capture_8bit(&capture, i, SBUS_CAPTURE_RX, SBUS_OK, bytes, 1 + i % sizeof(bytes));
+    }
+
+    sbus_capture_record_t record;
+    uint64_t              position = sbus_capture_first(&capture);
+    uint64_t              expected = 0;
+    size_t                found    = 0;
+
+    while (sbus_capture_next(&capture, &position, &record) == SBUS_OK) {
+        if (found > 0)
+            TEST_ASSERT_EQUAL(expected, record.timestamp_us);
+        expected = record.timestamp_us + 1;
+        TEST_ASSERT_EQUAL(1 + record.timestamp_us % sizeof(bytes), record.count);
+        TEST_ASSERT_EQUAL((uint8_t)record.timestamp_us, record.bytes[record.count - 1]);
+        found++;
+    }
+
+    TEST_ASSERT_EQUAL(500, expected);
+    TEST_ASSERT_GREATER_THAN(10, found);
+    TEST_ASSERT_EQUAL(500, capture.header->records);
+    TEST_ASSERT_EQUAL(500 - found, capture.header->overwritten);
+}
+
+
+void test_file() {
+    char                path[] = "/tmp/sbus_capture_XXXXXX";
+    int                 fd     = mkstemp(path);
+    sbus_capture_file_t file;
+    uint8_t             ack[]  = {SBUS_ACK, 0x00};
+
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+    close(fd);
+
+    TEST_ASSERT_EQUAL(0, sbus_capture_file_create(&file, path, 1 << 16));
+    sbus_capture_8bit(&file.capture, 42, SBUS_CAPTURE_RX, SBUS_OK, ack, 2);
+    sbus_capture_file_close(&file);
+
+    TEST_ASSERT_EQUAL(0, sbus_capture_file_open(&file, path));
+    sbus_capture_record_t record;
+    uint64_t              position = sbus_capture_first(&file.capture);
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_capture_next(&file.capture, &position, &record));
+    TEST_ASSERT_EQUAL(42, record.timestamp_us);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(ack, record.bytes, 2);
+    sbus_capture_file_close(&file);
+
+    // Anything else is refused
+    memory[0] = 0;
+    TEST_ASSERT_EQUAL(SBUS_INVALID_DATA, sbus_capture_attach(&capture, memory, sizeof(memory)));
+    unlink(path);
+}
@@ -0,0 +1,85 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "sbus/crc.h"
+#include "unity.h"
+
+void setUp() {}
+
+void tearDown() {}
+
+static uint16_t reference_crc(uint8_t *buffer, size_t length) {
+    uint16_t crc = 0;
+    for (size_t i = 0; i < length; i++) {
+        crc = (uint16_t)(crc ^ (buffer[i] << 8));
+        for (int j = 0; j < 8; j++) {
+            if (crc & 0x8000)
+                crc = (uint16_t)((crc << 1) ^ 0x1021);
+            else
+                crc <<= 1;
+        }
+    }
+    return crc;
+}
+
+
+void test_check_value() {
+    uint8_t buffer[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    TEST_ASSERT_EQUAL_HEX16(0x31C3, sbus_crc16_8bit(buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_HEX16(0, sbus_crc16_8bit(buffer, 0));
+}
+
+
+void test_table_matches_bitwise() {
+    for (unsigned i = 0; i < 256; i++) {
+        uint8_t byte = (uint8_t)i;
+        TEST_ASSERT_EQUAL_HEX16(reference_crc(&byte, 1), sbus_crc16_table[0][i]);
+    }
+}
+
+
+void test_both_layouts() {
+    uint8_t  buffer_8bit[300];
+    uint16_t buffer_9bit[300];
+
+    srand(42);
+    for (size_t i = 0; i < sizeof(buffer_8bit); i++) {
+        buffer_8bit[i] = (uint8_t)rand();
+        // The address flag must not take part in the checksum
+        buffer_9bit[i] = (uint16_t)(buffer_8bit[i] | (rand() & 0x0100));
+    }
+
+    for (size_t len = 0; len <= sizeof(buffer_8bit); len++) {
+        uint16_t expected = reference_crc(buffer_8bit, len);
+        TEST_ASSERT_EQUAL_HEX16(expected, sbus_crc16_8bit(buffer_8bit, len));
+        TEST_ASSERT_EQUAL_HEX16(expected, sbus_crc16_9bit(buffer_9bit, len));
+    }
+}
+
+
+void test_incremental() {
+    uint8_t  buffer_8bit[137];
+    uint16_t buffer_9bit[137];
+
+    for (size_t i = 0; i < sizeof(buffer_8bit); i++) {
+        buffer_8bit[i] = (uint8_t)(i * 31 + 7);
+        buffer_9bit[i] = buffer_8bit[i];
+    }
+    uint16_t expected = reference_crc(buffer_8bit, sizeof(buffer_8bit));
+
+    for (size_t chunk = 1; chunk < sizeof(buffer_8bit); chunk++) {
+        uint16_t crc_8bit = sbus_crc16_init();
+        uint16_t crc_9bit = sbus_crc16_init();
+        for (size_t i = 0; i < sizeof(buffer_8bit); i += chunk) {
+            size_t len = sizeof(buffer_8bit) - i < chunk ? sizeof(buffer_8bit) - i : chunk;
+            crc_8bit   = sbus_crc16_update_8bit(crc_8bit, &buffer_8bit[i], len);
+            crc_9bit   = sbus_crc16_update_9bit(crc_9bit, &buffer_9bit[i], len);
+        }
+        TEST_ASSERT_EQUAL_HEX16(expected, sbus_crc16_final(crc_8bit));
+        TEST_ASSERT_EQUAL_HEX16(expected, sbus_crc16_final(crc_9bit));
+    }
+
+    uint16_t crc = sbus_crc16_init();
+    for (size_t i = 0; i < sizeof(buffer_8bit); i++)
+        crc = sbus_crc16_update_byte(crc, buffer_8bit[i]);
+    TEST_ASSERT_EQUAL_HEX16(expected, sbus_crc16_final(crc));
+}
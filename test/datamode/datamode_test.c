@@ -0,0 +1,119 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "sbus/crc.h"
+#include "sbus/datamode.h"
+#include "sbus/packet.h"
+#include "unity.h"
+
+static sbus_data_mode_decoder_t decoder;
+
+void setUp() {
+    sbus_data_mode_decoder_init(&decoder);
+}
+
+void tearDown() {}
+
+
+void test_request_round_trip() {
+    // 0xB5 and 0xC5 in the data have to be stuffed
+    sbus_request_t request = SBUS_WRITE_REGISTER_REQUEST(0xC5, 0xB5, 0xB5C5B5C5);
+    uint8_t        buffer[SBUS_DATA_MODE_FRAME_SIZE(2 + 7)];
+    size_t         total = sbus_data_mode_serialize_request(buffer, sizeof(buffer), &request);
+
+    TEST_ASSERT_GREATER_THAN(0, total);
+    TEST_ASSERT_EQUAL(SBUS_DATA_MODE_SYN, buffer[0]);
+    TEST_ASSERT_EQUAL(SBUS_ATTRIBUTE_REQUEST, buffer[1]);
+    TEST_ASSERT_EQUAL(SBUS_DATA_MODE_DLE, buffer[2]);
+    TEST_ASSERT_EQUAL(0x01, buffer[3]);
+    for (size_t i = 1; i < total; i++)
+        TEST_ASSERT_TRUE(buffer[i] != SBUS_DATA_MODE_SYN);
+
+    size_t len = total;
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_data_mode_feed(&decoder, buffer, &len));
+    TEST_ASSERT_EQUAL(total, len);
+
+    sbus_request_t parsed;
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_data_mode_get_request(&decoder, &parsed));
+    TEST_ASSERT_EQUAL(request.destination, parsed.destination);
+    TEST_ASSERT_EQUAL(request.command, parsed.command);
+    TEST_ASSERT_EQUAL(request.data_len, parsed.data_len);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(request.data, parsed.data, request.data_len);
+
+    TEST_ASSERT_EQUAL(0, sbus_data_mode_serialize_request(buffer, 8, &request));
+}
+
+
+void test_crc_covers_syn_and_attribute() {
+    uint8_t payload[] = {0x01, 0x02, 0x03};
+    uint8_t buffer[SBUS_DATA_MODE_FRAME_SIZE(3)];
+    size_t  total = sbus_data_mode_encode(buffer, sizeof(buffer), SBUS_ATTRIBUTE_RESPONSE, payload, 3);
+
+    uint8_t  plain[] = {SBUS_DATA_MODE_SYN, SBUS_ATTRIBUTE_RESPONSE, 0x01, 0x02, 0x03};
+    uint16_t crc     = sbus_crc16_8bit(plain, sizeof(plain));
+    TEST_ASSERT_EQUAL(7, total);
+    TEST_ASSERT_EQUAL(crc >> 8, buffer[5]);
+    TEST_ASSERT_EQUAL(crc & 0xFF, buffer[6]);
+}
+
+
+void test_response_and_ack() {
+    sbus_request_t read   = SBUS_READ_REGISTERS_REQUEST(3, 0, 1);
+    uint8_t        data[] = {0x00, 0x00, 0xB5, 0x01};
+    uint8_t        buffer[SBUS_DATA_MODE_FRAME_SIZE(4)];
+    size_t         total = sbus_data_mode_encode(buffer, sizeof(buffer), SBUS_ATTRIBUTE_RESPONSE, data, 4);
+
+    // Unsolicited responses are refused
+    size_t len = total;
+    TEST_ASSERT_EQUAL(SBUS_INVALID_DATA, sbus_data_mode_feed(&decoder, buffer, &len));
+
+    sbus_data_mode_decoder_reset(&decoder);
+    sbus_data_mode_expect_response(&decoder, &read);
+    len = total;
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_data_mode_feed(&decoder, buffer, &len));
+    TEST_ASSERT_EQUAL(SBUS_ATTRIBUTE_RESPONSE, decoder.attribute);
+    TEST_ASSERT_EQUAL(6, decoder.len);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(data, decoder.payload, 4);
+
+    uint8_t ack[] = {0x00, 0x00};
+    total         = sbus_data_mode_encode(buffer, sizeof(buffer), SBUS_ATTRIBUTE_ACK, ack, 2);
+    len           = total;
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_data_mode_feed(&decoder, buffer, &len));
+    TEST_ASSERT_EQUAL(SBUS_ATTRIBUTE_ACK, decoder.attribute);
+}
+
+
+void test_resync_and_errors() {
+    sbus_request_t request = SBUS_READ_REGISTERS_REQUEST(7, 10, 2);
+    uint8_t        stream[64] = {0x11, 0x22};
+    size_t         total      = 2;
+
+    // A frame cut short by the next SYN, then a good one, then one with a bad escape
+    total += sbus_data_mode_serialize_request(&stream[total], sizeof(stream) - total, &request) - 3;
+    total += sbus_data_mode_serialize_request(&stream[total], sizeof(stream) - total, &request);
+    stream[total++] = SBUS_DATA_MODE_SYN;
+    stream[total++] = SBUS_ATTRIBUTE_REQUEST;
+    stream[total++] = SBUS_DATA_MODE_DLE;
+    stream[total++] = 0x07;
+
+    size_t offset = 0;
+    size_t len    = total;
+    TEST_ASSERT_EQUAL(SBUS_INVALID_DATA, sbus_data_mode_feed(&decoder, stream, &len));
+    TEST_ASSERT_EQUAL(2, decoder.discarded);
+
+    offset += len;
+    len = total - offset;
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_data_mode_feed(&decoder, &stream[offset], &len));
+    sbus_request_t parsed;
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_data_mode_get_request(&decoder, &parsed));
+    TEST_ASSERT_EQUAL(7, parsed.destination);
+
+    offset += len;
+    len = total - offset;
+    TEST_ASSERT_EQUAL(SBUS_INVALID_DATA, sbus_data_mode_feed(&decoder, &stream[offset], &len));
+
+    // Corrupted CRC
+    offset = sbus_data_mode_serialize_request(stream, sizeof(stream), &request);
+    stream[offset - 1] ^= 0x01;
+    len = offset;
+    TEST_ASSERT_EQUAL(SBUS_WRONG_CRC, sbus_data_mode_feed(&decoder, stream, &len));
+}
@@ -0,0 +1,185 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "sbus/crc.h"
+#include "sbus/decode.h"
+#include "sbus/packet.h"
+#include "sbus/slave.h"
+#include "unity.h"
+
+static sbus_slave_t slave;
+static uint32_t     registers[256];
+static uint8_t      flags[SBUS_FIO_BYTES(256)];
+
+static int read_clock(sbus_slave_t *slave, uint8_t *clock) {
+    (void)slave;
+    const uint8_t bcd[SBUS_CLOCK_SIZE] = {0x24, 0x02, 0x29, 0x23, 0x59, 0x58};
+    memcpy(clock, bcd, SBUS_CLOCK_SIZE);
+    return 0;
+}
+
+void setUp() {
+    for (size_t i = 0; i < 256; i++) {
+        registers[i] = 0x01020304u * (uint32_t)i + 0x89ABCDEF;
+        if (i % 3 == 0)
+            flags[SBUS_FIO_BYTE(i)] |= SBUS_FIO_MASK(i);
+    }
+
+    sbus_slave_init(&slave, 7);
+    sbus_slave_set_media(&slave, SBUS_MEDIA_REGISTER, registers, 256);
+    sbus_slave_set_media(&slave, SBUS_MEDIA_FLAG, flags, 256);
+    slave.read_clock = read_clock;
+}
+
+void tearDown() {}
+
+
+static size_t respond(const sbus_request_t *request, uint16_t *words, uint8_t *bytes) {
+    int res = sbus_slave_handle_request(&slave, request, words, 256);
+    TEST_ASSERT_GREATER_THAN(0, res);
+    for (int i = 0; i < res; i++)
+        bytes[i] = (uint8_t)words[i];
+    return (size_t)res;
+}
+
+
+void test_values() {
+    sbus_request_t request = SBUS_READ_REGISTERS_REQUEST(7, 100, 32);
+    uint16_t       words[256];
+    uint8_t        bytes[256];
+    uint32_t       values[32];
+    size_t         total = respond(&request, words, bytes);
+    size_t         len   = total;
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_decode_values_9bit(&request, words, &len, values));
+    TEST_ASSERT_EQUAL(sbus_packet_response_length(&request), len);
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(&registers[100], values, 32);
+
+    memset(values, 0, sizeof(values));
+    len = total;
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_decode_values_8bit(&request, bytes, &len, values));
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(&registers[100], values, 32);
+
+    len = total - 1;
+    TEST_ASSERT_EQUAL(SBUS_INCOMPLETE_PACKET, sbus_decode_values_9bit(&request, words, &len, values));
+    TEST_ASSERT_EQUAL(0, len);
+
+    // Same outcome as the validator on a corrupted payload
+    words[17] ^= 0x40;
+    bytes[17] ^= 0x40;
+    len = total;
+    TEST_ASSERT_EQUAL(SBUS_WRONG_CRC, sbus_decode_values_9bit(&request, words, &len, values));
+    len = total;
+    TEST_ASSERT_EQUAL(SBUS_WRONG_CRC, sbus_packet_validate_response_9bit(&request, words, &len));
+    len = total;
+    TEST_ASSERT_EQUAL(SBUS_WRONG_CRC, sbus_decode_values_8bit(&request, bytes, &len, values));
+
+    // A new request on the line
+    words[17] ^= 0x40;
+    words[21] = SBUS_ADDRESS(3);
+    len       = total;
+    TEST_ASSERT_EQUAL(SBUS_NOT_FOUND, sbus_decode_values_9bit(&request, words, &len, values));
+    TEST_ASSERT_EQUAL(21, len);
+
+    request.command = SBUS_COMMAND_READ_FLAG;
+    len             = total;
+    TEST_ASSERT_EQUAL(SBUS_INVALID_ARGS, sbus_decode_values_9bit(&request, words, &len, values));
+    request = (sbus_request_t)SBUS_READ_REGISTERS_REQUEST(SBUS_BROADCAST_ADDRESS, 100, 32);
+    TEST_ASSERT_EQUAL(SBUS_INVALID_ARGS, sbus_decode_values_9bit(&request, words, &len, values));
+}
+
+
+void test_flags() {
+    sbus_request_t request = SBUS_REQUEST(7, SBUS_COMMAND_READ_FLAG, {20, 0, 37});
+    uint16_t       words[256];
+    uint8_t        bytes[256];
+    uint8_t        bits[32];
+    size_t         total = respond(&request, words, bytes);
+    size_t         len   = total;
+
+    memset(bits, 0xAA, sizeof(bits));
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_decode_flags_9bit(&request, words, &len, bits));
+    TEST_ASSERT_EQUAL(5, len);
+    for (size_t i = 0; i < 21; i++)
+        TEST_ASSERT_EQUAL((37 + i) % 3 == 0, bits[i]);
+    TEST_ASSERT_EQUAL(0xAA, bits[21]);
+
+    memset(bits, 0xAA, sizeof(bits));
+    len = total;
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_decode_flags_8bit(&request, bytes, &len, bits));
+    for (size_t i = 0; i < 21; i++)
+        TEST_ASSERT_EQUAL((37 + i) % 3 == 0, bits[i]);
+
+    bytes[4] ^= 1;
+    len = total;
+    TEST_ASSERT_EQUAL(SBUS_WRONG_CRC, sbus_decode_flags_8bit(&request, bytes, &len, bits));
+}
+
+
+void test_clock() {
+    sbus_request_t request = SBUS_REQUEST(7, SBUS_COMMAND_READ_REAL_TIME_CLOCK, {});
+    uint16_t       words[256];
+    uint8_t        bytes[256];
+    uint8_t        bcd[SBUS_CLOCK_SIZE];
+    sbus_clock_t   clock = {0};
+    size_t         total = respond(&request, words, bytes);
+    size_t         len   = total;
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_decode_clock_9bit(&request, words, &len, &clock));
+    TEST_ASSERT_EQUAL(24, clock.year);
+    TEST_ASSERT_EQUAL(2, clock.month);
+    TEST_ASSERT_EQUAL(29, clock.day);
+    TEST_ASSERT_EQUAL(23, clock.hour);
+    TEST_ASSERT_EQUAL(59, clock.minute);
+    TEST_ASSERT_EQUAL(58, clock.second);
+
+    memset(&clock, 0, sizeof(clock));
+    len = total;
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_decode_clock_8bit(&request, bytes, &len, &clock));
+    TEST_ASSERT_EQUAL(58, clock.second);
+
+    sbus_clock_to_bcd(&clock, bcd);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(bytes, bcd, SBUS_CLOCK_SIZE);
+
+    // Not BCD, with a correct CRC
+    bytes[4]        = 0x5A;
+    uint16_t crc    = sbus_crc16_8bit(bytes, SBUS_CLOCK_SIZE);
+    bytes[6]        = (uint8_t)(crc >> 8);
+    bytes[7]        = (uint8_t)crc;
+    len             = total;
+    TEST_ASSERT_EQUAL(SBUS_INVALID_DATA, sbus_decode_clock_8bit(&request, bytes, &len, &clock));
+    const uint8_t month_zero[SBUS_CLOCK_SIZE] = {0x24, 0x00, 0x01, 0x00, 0x00, 0x00};
+    TEST_ASSERT_EQUAL(SBUS_INVALID_DATA, sbus_clock_from_bcd(month_zero, &clock));
+}
+
+
+void test_kernels_and_register_address() {
+    uint16_t words[4 * 37];
+    uint8_t  bytes[4 * 37];
+    uint32_t values[37];
+    uint8_t  bits[4 * 37 * 8];
+
+    for (size_t i = 0; i < sizeof(bytes); i++) {
+        bytes[i] = (uint8_t)(i * 37 + 11);
+        words[i] = (uint16_t)(bytes[i] | (i % 5 == 0 ? 0x100 : 0));
+    }
+
+    sbus_decode_be32_9bit(words, 37, values);
+    for (size_t i = 0; i < 37; i++)
+        TEST_ASSERT_EQUAL_HEX32(((uint32_t)bytes[i * 4] << 24) | ((uint32_t)bytes[i * 4 + 1] << 16) |
+                                    ((uint32_t)bytes[i * 4 + 2] << 8) | bytes[i * 4 + 3],
+                                values[i]);
+    uint32_t narrow[37];
+    sbus_decode_be32_8bit(bytes, 37, narrow);
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(values, narrow, 37);
+
+    // Odd counts exercise the tail of the loop
+    sbus_decode_bits_9bit(words, 61, bits);
+    for (size_t i = 0; i < 61; i++)
+        TEST_ASSERT_EQUAL((bytes[SBUS_FIO_BYTE(i)] & SBUS_FIO_MASK(i)) != 0, bits[i]);
+    uint8_t unpacked[61];
+    sbus_decode_bits_8bit(bytes, 61, unpacked);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(bits, unpacked, 61);
+
+    sbus_request_t request = SBUS_READ_REGISTERS_REQUEST(7, 0x1234, 1);
+    TEST_ASSERT_EQUAL_HEX16(0x1234, SBUS_PACKET_REG_ADDR((&request)));
+}
@@ -0,0 +1,130 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sbus/discovery.h"
+#include "sbus/packet.h"
+#include "sbus/simulator.h"
+#include "sbus/slave.h"
+#include "sbus/wire.h"
+#include "unity.h"
+
+#define STATIONS 3
+
+static const uint8_t addresses[STATIONS] = {5, 17, 200};
+static const sbus_wire_t settings[] = {
+    {.baud = 9600, .format = SBUS_WIRE_PARITY, .turnaround_us = 5000},
+    {.baud = 19200, .format = SBUS_WIRE_PARITY, .turnaround_us = 5000},
+    {.baud = 38400, .format = SBUS_WIRE_DATA, .turnaround_us = 5000},
+    {.baud = 38400, .format = SBUS_WIRE_PARITY, .turnaround_us = 5000},
+    {.baud = 115200, .format = SBUS_WIRE_PARITY, .turnaround_us = 5000},
+};
+
+#define NUM_SETTINGS (sizeof(settings) / sizeof(settings[0]))
+
+static sbus_slave_t       slaves[STATIONS];
+static sbus_sim_station_t stations[STATIONS];
+static sbus_sim_t         sim;
+static sbus_discovery_t   discovery;
+static uint16_t           response[256];
+
+void setUp() {}
+
+void tearDown() {}
+
+
+static void line(uint32_t baud) {
+    sbus_wire_t wire = {.baud = baud, .format = SBUS_WIRE_PARITY};
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_sim_init(&sim, &wire, 3));
+    for (size_t i = 0; i < STATIONS; i++) {
+        sbus_slave_init(&slaves[i], addresses[i]);
+        stations[i] = (sbus_sim_station_t){.slave = &slaves[i], .turnaround_us = 1000};
+        TEST_ASSERT_EQUAL(SBUS_OK, sbus_sim_attach(&sim, &stations[i]));
+    }
+    slaves[1].status = SBUS_PCD_STATUS_STOP;
+}
+
+
+/*
+ * Stations ignore requests sent at the wrong baud rate; in the wrong wire format they answer, but the answer does
+ * not validate.
+ */
+static void drive(void) {
+    sbus_probe_t probe;
+
+    while (sbus_discovery_next(&discovery, &probe) == SBUS_OK) {
+        const sbus_wire_t *setting = &discovery.settings[probe.setting];
+        size_t             len     = sizeof(response) / sizeof(response[0]);
+        sbus_result_t      res     = SBUS_TIMEOUT;
+
+        if (setting->baud != sim.wire.baud) {
+            sbus_sim_wait(&sim, probe.timeout_us);
+        } else {
+            res = sbus_sim_exchange(&sim, &probe.request, probe.timeout_us, response, &len);
+            if (res == SBUS_OK && setting->format != sim.wire.format)
+                res = SBUS_WRONG_CRC;
+        }
+        sbus_discovery_complete(&discovery, &probe, res, (uint8_t)response[0]);
+    }
+}
+
+
+void test_scan() {
+    line(38400);
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_discovery_init(&discovery, settings, NUM_SETTINGS, 0, 254, NULL));
+    drive();
+
+    TEST_ASSERT_EQUAL(SBUS_DISCOVERY_DONE, discovery.phase);
+    TEST_ASSERT_EQUAL(3, discovery.locked);
+    TEST_ASSERT_EQUAL(STATIONS, sbus_discovery_count(&discovery));
+    for (size_t i = 0; i < STATIONS; i++)
+        TEST_ASSERT_TRUE(sbus_discovery_present(&discovery, addresses[i]));
+    TEST_ASSERT_EQUAL(SBUS_PCD_STATUS_RUN, discovery.status[5]);
+    TEST_ASSERT_EQUAL(SBUS_PCD_STATUS_STOP, discovery.status[17]);
+
+    // Every setting on the empty addresses, four until station 5 validates, then one probe per address
+    TEST_ASSERT_EQUAL(5 * NUM_SETTINGS + 4 + 249 + STATIONS, discovery.probes);
+    TEST_ASSERT_LESS_OR_EQUAL(discovery.budget_us, sim.now_us);
+    TEST_ASSERT_LESS_THAN(3000000, sim.now_us);
+}
+
+
+void test_saved_topology() {
+    sbus_topology_t topology;
+
+    line(38400);
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_discovery_init(&discovery, settings, NUM_SETTINGS, 0, 254, NULL));
+    drive();
+    sbus_discovery_save(&discovery, &topology);
+    TEST_ASSERT_EQUAL(38400, topology.baud);
+    TEST_ASSERT_EQUAL(SBUS_PCD_STATUS_STOP, topology.status[17]);
+
+    // Everybody is still there: only the known stations are asked
+    line(38400);
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_discovery_init(&discovery, settings, NUM_SETTINGS, 0, 254, &topology));
+    drive();
+    TEST_ASSERT_EQUAL(2 * STATIONS, discovery.probes);
+    TEST_ASSERT_EQUAL(STATIONS, sbus_discovery_count(&discovery));
+    TEST_ASSERT_LESS_THAN(50000, sim.now_us);
+
+    // A station is gone: full scan, still at the saved setting
+    line(38400);
+    stations[2].drop_ppm = SBUS_SIM_PPM;
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_discovery_init(&discovery, settings, NUM_SETTINGS, 0, 254, &topology));
+    drive();
+    TEST_ASSERT_EQUAL(STATIONS + 253 + 2, discovery.probes);
+    TEST_ASSERT_EQUAL(2, sbus_discovery_count(&discovery));
+    TEST_ASSERT_FALSE(sbus_discovery_present(&discovery, 200));
+
+    // The line was moved to another baud rate: nobody answers at the saved one
+    line(115200);
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_discovery_init(&discovery, settings, NUM_SETTINGS, 0, 254, &topology));
+    drive();
+    TEST_ASSERT_EQUAL(4, discovery.locked);
+    TEST_ASSERT_EQUAL(STATIONS, sbus_discovery_count(&discovery));
+
+    memcpy(topology.magic, "NOTATOP", 8);
+    TEST_ASSERT_EQUAL(SBUS_INVALID_DATA, sbus_discovery_init(&discovery, settings, NUM_SETTINGS, 0, 254, &topology));
+    TEST_ASSERT_EQUAL(SBUS_INVALID_ARGS, sbus_discovery_init(&discovery, settings, NUM_SETTINGS, 0, 255, NULL));
+    TEST_ASSERT_EQUAL(SBUS_INVALID_ARGS, sbus_discovery_init(&discovery, settings, 0, 0, 254, NULL));
+}
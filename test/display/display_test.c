@@ -0,0 +1,31 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sbus/display.h"
+#include "sbus/packet.h"
+#include "unity.h"
+
+
+void setUp() {}
+
+void tearDown() {}
+
+
+void test_truncated_display() {
+    sbus_request_t request = SBUS_WRITE_REGISTER_REQUEST(3, 0x10, 0xDEADBEEF);
+    char           full[256];
+    char           short_buffer[24 + 8];
+
+    size_t len = sbus_request_display(full, sizeof(full), &request);
+    TEST_ASSERT_EQUAL(strlen(full), len);
+    TEST_ASSERT_EQUAL_STRING("Request for 3, command 14 (WRITE_REGISTER)\n\tData: 0x05 0x00 0x10 0xDE 0xAD 0xBE 0xEF\n",
+                             full);
+
+    // The canary past the declared length must survive
+    memset(short_buffer, 'X', sizeof(short_buffer));
+    TEST_ASSERT_EQUAL(len, sbus_request_display(short_buffer, 24, &request));
+    TEST_ASSERT_EQUAL(23, strlen(short_buffer));
+    TEST_ASSERT_EQUAL_STRING_LEN(full, short_buffer, 23);
+    TEST_ASSERT_EQUAL('X', short_buffer[24]);
+    TEST_ASSERT_EQUAL_STRING("UNKNOWN", sbus_command_name(9));
+}
@@ -0,0 +1,223 @@
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "sbus/ether.h"
+#include "sbus/packet.h"
+#include "sbus/slave.h"
+#include "sbus/posix/ether_master.h"
+#include "unity.h"
+
+/*
+ * A simulated PCD on a loopback UDP socket. Requests are collected and answered in reverse order, so that replies
+ * can only be matched through their sequence number.
+ */
+typedef struct {
+    int          fd;
+    uint16_t     port;
+    int          drop;     // Number of datagrams to ignore
+    size_t       max_pending;
+    sbus_slave_t slave;
+    uint32_t     registers[32];
+} simulated_pcd_t;
+
+static sbus_ether_master_t  master;
+static sbus_ether_station_t station;
+static simulated_pcd_t      pcd;
+static atomic_int           completed;
+
+
+static void open_pcd(simulated_pcd_t *pcd, uint8_t address) {
+    struct sockaddr_in local = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    socklen_t          len   = sizeof(local);
+
+    memset(pcd, 0, sizeof(simulated_pcd_t));
+    pcd->fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, pcd->fd);
+    TEST_ASSERT_EQUAL(0, bind(pcd->fd, (struct sockaddr *)&local, sizeof(local)));
+    TEST_ASSERT_EQUAL(0, getsockname(pcd->fd, (struct sockaddr *)&local, &len));
+    pcd->port = ntohs(local.sin_port);
+
+    sbus_slave_init(&pcd->slave, address);
+    sbus_slave_set_media(&pcd->slave, SBUS_MEDIA_REGISTER, pcd->registers, 32);
+    for (size_t i = 0; i < 32; i++)
+        pcd->registers[i] = 1000 + (uint32_t)i;
+}
+
+
+static void serve(simulated_pcd_t *pcd) {
+    uint8_t            datagrams[SBUS_ETHER_MAX_IN_FLIGHT][SBUS_ETHER_MAX_DATAGRAM];
+    size_t             lengths[SBUS_ETHER_MAX_IN_FLIGHT];
+    struct sockaddr_in peers[SBUS_ETHER_MAX_IN_FLIGHT];
+    size_t             pending = 0;
+
+    while (pending < SBUS_ETHER_MAX_IN_FLIGHT) {
+        socklen_t peer_len = sizeof(peers[pending]);
+        ssize_t   res      = recvfrom(pcd->fd, datagrams[pending], SBUS_ETHER_MAX_DATAGRAM, 0,
+                                      (struct sockaddr *)&peers[pending], &peer_len);
+        if (res < 0)
+            break;
+        if (pcd->drop > 0) {
+            pcd->drop--;
+            continue;
+        }
+        lengths[pending++] = (size_t)res;
+    }
+
+    if (pending > pcd->max_pending)
+        pcd->max_pending = pending;
+
+    while (pending-- > 0) {
+        uint16_t       sequence;
+        sbus_request_t request;
+        TEST_ASSERT_EQUAL(SBUS_OK, sbus_ether_parse_request(datagrams[pending], lengths[pending], &sequence, &request));
+
+        uint16_t words[256];
+        uint8_t  data[256];
+        int      num = sbus_slave_handle_request(&pcd->slave, &request, words, 256);
+        if (num <= 0)
+            continue;
+        for (int i = 0; i < num; i++)
+            data[i] = (uint8_t)words[i];
+
+        uint8_t reply[SBUS_ETHER_MAX_DATAGRAM];
+        size_t  len;
+        if (sbus_packet_response_length(&request) == 2) {
+            uint8_t code[2] = {0x00, data[0] == SBUS_ACK ? 0x00 : 0x01};
+            len = sbus_ether_serialize_response(reply, sizeof(reply), sequence, SBUS_ATTRIBUTE_ACK, code, 2);
+        } else {
+            // The parity mode CRC is replaced by the one covering the Ether-S-Bus header
+            len = sbus_ether_serialize_response(reply, sizeof(reply), sequence, SBUS_ATTRIBUTE_RESPONSE, data,
+                                                (size_t)num - 2);
+        }
+        TEST_ASSERT_EQUAL(len, sendto(pcd->fd, reply, len, 0, (struct sockaddr *)&peers[pending],
+                                      sizeof(peers[pending])));
+    }
+}
+
+
+static void run_until(atomic_int *condition, int target) {
+    for (int i = 0; i < 1000 && *condition < target; i++) {
+        sbus_ether_master_poll(&master, 1);
+        serve(&pcd);
+    }
+}
+
+
+static void on_complete(sbus_transaction_t *transaction) {
+    (void)transaction;
+    completed++;
+}
+
+
+void setUp() {
+    completed = 0;
+    open_pcd(&pcd, 5);
+    TEST_ASSERT_EQUAL(0, sbus_ether_master_init(&master, 20, 2));
+    TEST_ASSERT_EQUAL(0, sbus_ether_station_init(&station, "127.0.0.1", pcd.port, 4));
+}
+
+void tearDown() {
+    sbus_ether_master_deinit(&master);
+    close(pcd.fd);
+}
+
+
+void test_codec() {
+    sbus_request_t request = SBUS_READ_REGISTERS_REQUEST(5, 2, 1);
+    uint8_t        datagram[SBUS_ETHER_MAX_DATAGRAM];
+    size_t         len = sbus_ether_serialize_request(datagram, sizeof(datagram), 0x1234, &request);
+
+    TEST_ASSERT_EQUAL(SBUS_ETHER_HEADER_SIZE + 2 + 3 + 2, len);
+    TEST_ASSERT_EQUAL(len, datagram[3]);
+    TEST_ASSERT_EQUAL(0x12, datagram[6]);
+    TEST_ASSERT_EQUAL(0x34, datagram[7]);
+
+    uint16_t       sequence = 0;
+    sbus_request_t parsed;
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_ether_parse_request(datagram, len, &sequence, &parsed));
+    TEST_ASSERT_EQUAL(0x1234, sequence);
+    TEST_ASSERT_EQUAL(5, parsed.destination);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(request.data, parsed.data, 3);
+
+    datagram[len - 1] ^= 1;
+    TEST_ASSERT_EQUAL(SBUS_WRONG_CRC, sbus_ether_parse_request(datagram, len, &sequence, &parsed));
+    TEST_ASSERT_EQUAL(SBUS_INVALID_DATA, sbus_ether_parse_request(datagram, len - 1, &sequence, &parsed));
+
+    uint8_t values[] = {0x00, 0x00, 0x03, 0xE9};
+    uint8_t response[256];
+    size_t  response_len;
+    len = sbus_ether_serialize_response(datagram, sizeof(datagram), 7, SBUS_ATTRIBUTE_RESPONSE, values, 4);
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_ether_validate_response(&request, datagram, len, response, &response_len));
+    TEST_ASSERT_EQUAL(6, response_len);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(values, response, 4);
+
+    datagram[10] ^= 1;
+    TEST_ASSERT_EQUAL(SBUS_WRONG_CRC, sbus_ether_validate_response(&request, datagram, len, response, &response_len));
+
+    uint8_t nak[] = {0x00, 0x01};
+    len           = sbus_ether_serialize_response(datagram, sizeof(datagram), 7, SBUS_ATTRIBUTE_ACK, nak, 2);
+    TEST_ASSERT_EQUAL(SBUS_INVALID_DATA,
+                      sbus_ether_validate_response(&request, datagram, len, response, &response_len));
+    TEST_ASSERT_EQUAL(SBUS_NAK, response[0]);
+}
+
+
+void test_window_and_matching() {
+    sbus_transaction_t       transactions[10];
+    sbus_latency_histogram_t histograms[4];
+    sbus_latency_table_t     latency;
+
+    sbus_latency_table_init(&latency, histograms, 4);
+    master.latency = &latency;
+
+    for (size_t i = 0; i < 10; i++) {
+        memset(&transactions[i], 0, sizeof(sbus_transaction_t));
+        transactions[i].request  = SBUS_READ_REGISTERS_REQUEST(5, i, 2);
+        transactions[i].callback = on_complete;
+        sbus_ether_master_submit(&master, &station, &transactions[i]);
+    }
+    TEST_ASSERT_EQUAL(4, master.num_in_flight);
+
+    run_until(&completed, 10);
+    TEST_ASSERT_EQUAL(10, completed);
+    TEST_ASSERT_LESS_OR_EQUAL(4, pcd.max_pending);
+    TEST_ASSERT_GREATER_THAN(1, pcd.max_pending);
+
+    for (size_t i = 0; i < 10; i++) {
+        TEST_ASSERT_EQUAL(SBUS_OK, transactions[i].result);
+        TEST_ASSERT_EQUAL(2 * 4 + 2, transactions[i].response_len);
+        TEST_ASSERT_EQUAL((1000 + i) & 0xFF, transactions[i].response[3]);
+        TEST_ASSERT_EQUAL((1001 + i) & 0xFF, transactions[i].response[7]);
+    }
+    TEST_ASSERT_EQUAL(0, master.retransmissions);
+
+    sbus_latency_snapshot_t snapshot;
+    TEST_ASSERT_EQUAL(0, sbus_latency_snapshot(&latency, 5, SBUS_COMMAND_READ_REGISTER, &snapshot));
+    TEST_ASSERT_EQUAL(10, snapshot.count);
+    master.latency = NULL;
+}
+
+
+void test_retransmit_and_timeout() {
+    sbus_transaction_t write = {.request = SBUS_WRITE_REGISTER_REQUEST(5, 3, 77), .callback = on_complete};
+
+    pcd.drop = 1;
+    sbus_ether_master_submit(&master, &station, &write);
+    run_until(&write.done, 1);
+    TEST_ASSERT_EQUAL(SBUS_OK, write.result);
+    TEST_ASSERT_EQUAL(SBUS_ACK, write.response[0]);
+    TEST_ASSERT_EQUAL(2, write.attempts);
+    TEST_ASSERT_EQUAL(77, pcd.registers[3]);
+
+    sbus_transaction_t lost = {.request = SBUS_READ_REGISTERS_REQUEST(5, 0, 1), .callback = on_complete};
+    pcd.drop                = 3;
+    sbus_ether_master_submit(&master, &station, &lost);
+    run_until(&lost.done, 1);
+    TEST_ASSERT_EQUAL(SBUS_TIMEOUT, lost.result);
+    TEST_ASSERT_EQUAL(3, lost.attempts);
+    TEST_ASSERT_EQUAL(0, station.in_flight);
+}
@@ -0,0 +1,406 @@
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "sbus/gateway.h"
+#include "sbus/packet.h"
+#include "sbus/posix/master.h"
+#include "sbus/posix/modbus_server.h"
+#include "sbus/simulator.h"
+#include "sbus/slave.h"
+#include "sbus/wire.h"
+#include "unity.h"
+
+#define STATION   3
+#define REGISTERS 64
+#define FLAGS     256
+#define READS     8
+#define CALLS     8
+#define REPLIES   16
+
+typedef struct {
+    void   *client;
+    uint8_t adu[SBUS_MODBUS_MAX_ADU];
+    size_t  len;
+} reply_t;
+
+static sbus_slave_t          slave;
+static sbus_sim_station_t    station;
+static sbus_sim_t            sim;
+static uint32_t              registers[REGISTERS];
+static uint8_t               flags[SBUS_FIO_BYTES(FLAGS)];
+static sbus_gateway_t        gateway;
+static sbus_gateway_read_t   reads[READS];
+static sbus_gateway_call_t   calls[CALLS];
+static reply_t               replies[REPLIES];
+static size_t                num_replies;
+static int                   clients[4];
+static sbus_gateway_config_t pairs = {.register_words = 2};
+
+
+static void on_reply(sbus_gateway_t *gateway, void *client, const uint8_t *adu, size_t len) {
+    (void)gateway;
+    TEST_ASSERT_LESS_THAN(REPLIES, num_replies);
+    replies[num_replies].client = client;
+    replies[num_replies].len    = len;
+    memcpy(replies[num_replies].adu, adu, len);
+    num_replies++;
+}
+
+
+static void start(const sbus_gateway_config_t *config) {
+    sbus_wire_t wire = {.baud = 38400, .format = SBUS_WIRE_PARITY};
+
+    for (size_t i = 0; i < REGISTERS; i++)
+        registers[i] = (uint32_t)(0x10000 * (i + 1) + i);
+    memset(flags, 0, sizeof(flags));
+    flags[0] = 0xA5;
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_sim_init(&sim, &wire, 1));
+    sbus_slave_init(&slave, STATION);
+    sbus_slave_set_media(&slave, SBUS_MEDIA_REGISTER, registers, REGISTERS);
+    sbus_slave_set_media(&slave, SBUS_MEDIA_FLAG, flags, FLAGS);
+    station = (sbus_sim_station_t){.slave = &slave, .turnaround_us = 1000};
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_sim_attach(&sim, &station));
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_gateway_init(&gateway, config, reads, READS, calls, CALLS));
+    gateway.reply = on_reply;
+    num_replies   = 0;
+}
+
+
+void setUp() {
+    start(&pairs);
+}
+
+void tearDown() {}
+
+
+static size_t request(uint8_t *adu, uint16_t transaction, uint8_t unit, uint8_t function, uint16_t address,
+                      uint16_t quantity) {
+    uint8_t header[12] = {transaction >> 8, transaction & 0xFF, 0, 0, 0, 6, unit, function,
+                          address >> 8,     address & 0xFF,     quantity >> 8, quantity & 0xFF};
+    memcpy(adu, header, sizeof(header));
+    return sizeof(header);
+}
+
+
+// Multiple writes: `data` follows the byte count
+static size_t write_request(uint8_t *adu, uint8_t function, uint16_t address, uint16_t quantity, const uint8_t *data,
+                            size_t data_len) {
+    size_t len = request(adu, 1, STATION, function, address, quantity);
+    adu[len++] = (uint8_t)data_len;
+    memcpy(&adu[len], data, data_len);
+    len += data_len;
+    adu[5] = (uint8_t)(len - 6);
+    return len;
+}
+
+
+static void submit(void *client, const uint8_t *adu, size_t len) {
+    size_t consumed = len;
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_gateway_submit(&gateway, client, adu, &consumed));
+    TEST_ASSERT_EQUAL(len, consumed);
+}
+
+
+static void drive(void) {
+    sbus_gateway_exchange_t exchange;
+    sbus_request_t          sbus_request;
+
+    while (sbus_gateway_next(&gateway, &exchange, &sbus_request) == SBUS_OK) {
+        uint16_t words[256];
+        uint8_t  bytes[256];
+        size_t   len = 256;
+
+        sbus_result_t res = sbus_sim_exchange(&sim, &sbus_request, 50000, words, &len);
+        for (size_t i = 0; i < len; i++)
+            bytes[i] = (uint8_t)words[i];
+        sbus_gateway_complete(&gateway, &exchange, res, bytes, len);
+    }
+}
+
+
+static uint16_t word(const reply_t *reply, size_t index) {
+    return (uint16_t)((reply->adu[9 + index * 2] << 8) | reply->adu[9 + index * 2 + 1]);
+}
+
+
+static const reply_t *reply_to(void *client) {
+    for (size_t i = 0; i < num_replies; i++) {
+        if (replies[i].client == client)
+            return &replies[i];
+    }
+    TEST_FAIL_MESSAGE("no reply");
+    return NULL;
+}
+
+
+/*
+ * Same block twice, an overlapping one and coils: two S-Bus reads in all.
+ */
+void test_collapsing() {
+    uint8_t adu[SBUS_MODBUS_MAX_ADU];
+
+    submit(&clients[0], adu, request(adu, 1, STATION, SBUS_MODBUS_READ_HOLDING_REGISTERS, 0, 20));
+    submit(&clients[1], adu, request(adu, 2, STATION, SBUS_MODBUS_READ_HOLDING_REGISTERS, 0, 20));
+    submit(&clients[2], adu, request(adu, 3, STATION, SBUS_MODBUS_READ_HOLDING_REGISTERS, 11, 39));
+    submit(&clients[3], adu, request(adu, 4, STATION, SBUS_MODBUS_READ_COILS, 2, 10));
+    TEST_ASSERT_EQUAL(0, num_replies);
+    drive();
+
+    TEST_ASSERT_EQUAL(2, sim.exchanges);
+    TEST_ASSERT_EQUAL(2, gateway.reads_sent);
+    TEST_ASSERT_EQUAL(2, gateway.collapsed);
+    TEST_ASSERT_EQUAL(4, num_replies);
+
+    const reply_t *reply = reply_to(&clients[1]);
+    TEST_ASSERT_EQUAL(2, reply->adu[1]);
+    TEST_ASSERT_EQUAL(3 + 40, reply->adu[5]);
+    TEST_ASSERT_EQUAL(40, reply->adu[8]);
+    TEST_ASSERT_EQUAL(0x0001, word(reply, 0));     // Register 0, high word first
+    TEST_ASSERT_EQUAL(0x0000, word(reply, 1));
+    TEST_ASSERT_EQUAL(0x000A, word(reply, 18));
+    TEST_ASSERT_EQUAL(0x0009, word(reply, 19));
+
+    reply = reply_to(&clients[2]);
+    TEST_ASSERT_EQUAL(78, reply->adu[8]);
+    TEST_ASSERT_EQUAL(0x0005, word(reply, 0));     // Low word of register 5
+    TEST_ASSERT_EQUAL(0x0007, word(reply, 1));
+    TEST_ASSERT_EQUAL(0x0018, word(reply, 38));
+
+    reply = reply_to(&clients[3]);
+    TEST_ASSERT_EQUAL(2, reply->adu[8]);
+    TEST_ASSERT_EQUAL(0x29, reply->adu[9]);     // 0xA5 from the third bit on
+    TEST_ASSERT_EQUAL(0x00, reply->adu[10]);
+
+    // A read already on the line still takes company
+    sbus_gateway_exchange_t exchange;
+    sbus_request_t          sbus_request;
+    submit(&clients[0], adu, request(adu, 5, STATION, SBUS_MODBUS_READ_HOLDING_REGISTERS, 4, 2));
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_gateway_next(&gateway, &exchange, &sbus_request));
+    submit(&clients[1], adu, request(adu, 6, STATION, SBUS_MODBUS_READ_HOLDING_REGISTERS, 5, 1));
+    TEST_ASSERT_EQUAL(SBUS_NOT_FOUND, sbus_gateway_next(&gateway, &exchange, &sbus_request));
+    sbus_gateway_complete(&gateway, &exchange, SBUS_OK, (const uint8_t[]){0x12, 0x34, 0x56, 0x78}, 4);
+    TEST_ASSERT_EQUAL(6, num_replies);
+    TEST_ASSERT_EQUAL(0x5678, word(&replies[5], 0));
+}
+
+
+void test_writes() {
+    uint8_t adu[SBUS_MODBUS_MAX_ADU];
+    uint8_t values[16] = {0xDE, 0xAD, 0xBE, 0xEF, 0, 0, 0, 1, 0, 0, 0, 2, 0x80, 0, 0, 0};
+    uint8_t coils[25];
+
+    // Four registers in one frame
+    submit(&clients[0], adu, write_request(adu, SBUS_MODBUS_WRITE_MULTIPLE_REGISTERS, 4, 8, values, 16));
+    drive();
+    TEST_ASSERT_EQUAL(1, gateway.writes_sent);
+    TEST_ASSERT_EQUAL_HEX32(0xDEADBEEF, registers[2]);
+    TEST_ASSERT_EQUAL_HEX32(0x80000000, registers[5]);
+    TEST_ASSERT_EQUAL(12, replies[0].len);
+    TEST_ASSERT_EQUAL(SBUS_MODBUS_WRITE_MULTIPLE_REGISTERS, replies[0].adu[7]);
+    TEST_ASSERT_EQUAL(4, replies[0].adu[9]);
+    TEST_ASSERT_EQUAL(8, replies[0].adu[11]);
+
+    // 200 coils take two frames
+    memset(coils, 0xFF, sizeof(coils));
+    submit(&clients[0], adu, write_request(adu, SBUS_MODBUS_WRITE_MULTIPLE_COILS, 0, 200, coils, 25));
+    drive();
+    TEST_ASSERT_EQUAL(3, gateway.writes_sent);
+    TEST_ASSERT_EQUAL(0xFF, flags[0]);
+    TEST_ASSERT_EQUAL(0xFF, flags[24]);
+    TEST_ASSERT_EQUAL(0x00, flags[25]);
+
+    submit(&clients[0], adu, request(adu, 1, STATION, SBUS_MODBUS_WRITE_SINGLE_COIL, 7, 0x0000));
+    drive();
+    TEST_ASSERT_EQUAL(0x7F, flags[0]);
+    TEST_ASSERT_EQUAL(0, memcmp(adu, replies[2].adu, 12));
+
+    // A read queued before a write is not joined by a read that comes after it
+    num_replies = 0;
+    submit(&clients[0], adu, request(adu, 1, STATION, SBUS_MODBUS_READ_HOLDING_REGISTERS, 4, 2));
+    submit(&clients[1], adu, write_request(adu, SBUS_MODBUS_WRITE_MULTIPLE_REGISTERS, 4, 2, values + 4, 4));
+    submit(&clients[2], adu, request(adu, 1, STATION, SBUS_MODBUS_READ_HOLDING_REGISTERS, 4, 2));
+    drive();
+    TEST_ASSERT_EQUAL(3, num_replies);
+    TEST_ASSERT_EQUAL(0xDEAD, word(reply_to(&clients[0]), 0));
+    TEST_ASSERT_EQUAL(0x0001, word(reply_to(&clients[2]), 1));
+    TEST_ASSERT_EQUAL(0, gateway.collapsed);
+
+    // Nor grown into the range of a write queued after it
+    uint8_t nines[8] = {0, 0, 0, 9, 0, 0, 0, 9};
+    num_replies      = 0;
+    submit(&clients[0], adu, request(adu, 1, STATION, SBUS_MODBUS_READ_HOLDING_REGISTERS, 0, 4));
+    submit(&clients[1], adu, write_request(adu, SBUS_MODBUS_WRITE_MULTIPLE_REGISTERS, 4, 4, nines, 8));
+    submit(&clients[2], adu, request(adu, 1, STATION, SBUS_MODBUS_READ_HOLDING_REGISTERS, 0, 8));
+    drive();
+    TEST_ASSERT_EQUAL(3, num_replies);
+    TEST_ASSERT_EQUAL(9, word(reply_to(&clients[2]), 5));
+    TEST_ASSERT_EQUAL(9, word(reply_to(&clients[2]), 7));
+
+    // Also when the submission order wraps around between the read and the write
+    uint8_t sevens[8] = {0, 0, 0, 7, 0, 0, 0, 7};
+    num_replies       = 0;
+    gateway.order     = UINT32_MAX;
+    submit(&clients[0], adu, request(adu, 1, STATION, SBUS_MODBUS_READ_HOLDING_REGISTERS, 0, 4));
+    submit(&clients[1], adu, write_request(adu, SBUS_MODBUS_WRITE_MULTIPLE_REGISTERS, 4, 4, sevens, 8));
+    submit(&clients[2], adu, request(adu, 1, STATION, SBUS_MODBUS_READ_HOLDING_REGISTERS, 0, 8));
+    drive();
+    TEST_ASSERT_EQUAL(3, num_replies);
+    TEST_ASSERT_EQUAL(7, word(reply_to(&clients[2]), 5));
+    TEST_ASSERT_EQUAL(7, word(reply_to(&clients[2]), 7));
+
+    // One holding register per S-Bus register
+    sbus_gateway_config_t single = {.register_words = 1};
+    start(&single);
+    submit(&clients[0], adu, request(adu, 1, STATION, SBUS_MODBUS_WRITE_SINGLE_REGISTER, 9, 0xBEEF));
+    submit(&clients[0], adu, request(adu, 2, STATION, SBUS_MODBUS_READ_HOLDING_REGISTERS, 8, 2));
+    drive();
+    TEST_ASSERT_EQUAL_HEX32(0xBEEF, registers[9]);
+    TEST_ASSERT_EQUAL(0x0008, word(&replies[1], 0));
+    TEST_ASSERT_EQUAL(0xBEEF, word(&replies[1], 1));
+}
+
+
+void test_exceptions() {
+    uint8_t adu[SBUS_MODBUS_MAX_ADU];
+    size_t  len;
+
+    submit(&clients[0], adu, request(adu, 1, STATION, 0x04, 0, 1));
+    submit(&clients[0], adu, request(adu, 2, STATION, SBUS_MODBUS_READ_HOLDING_REGISTERS, 0, 126));
+    submit(&clients[0], adu, write_request(adu, SBUS_MODBUS_WRITE_MULTIPLE_REGISTERS, 1, 2, (uint8_t[4]){0}, 4));
+    submit(&clients[0], adu, request(adu, 4, STATION, SBUS_MODBUS_WRITE_SINGLE_REGISTER, 0, 1));
+    submit(&clients[0], adu, request(adu, 5, SBUS_BROADCAST_ADDRESS, SBUS_MODBUS_READ_COILS, 0, 1));
+    submit(&clients[0], adu, request(adu, 6, STATION, SBUS_MODBUS_WRITE_SINGLE_COIL, 0, 0x1234));
+    submit(&clients[0], adu, request(adu, 7, STATION, SBUS_MODBUS_READ_COILS, 65535, 2));
+
+    uint8_t expected[7] = {
+        SBUS_MODBUS_ILLEGAL_FUNCTION,         SBUS_MODBUS_ILLEGAL_DATA_VALUE,   SBUS_MODBUS_ILLEGAL_DATA_ADDRESS,
+        SBUS_MODBUS_ILLEGAL_DATA_ADDRESS,     SBUS_MODBUS_GATEWAY_PATH_UNAVAILABLE, SBUS_MODBUS_ILLEGAL_DATA_VALUE,
+        SBUS_MODBUS_ILLEGAL_DATA_ADDRESS,
+    };
+    TEST_ASSERT_EQUAL(7, num_replies);
+    for (size_t i = 0; i < 7; i++) {
+        TEST_ASSERT_EQUAL(9, replies[i].len);
+        TEST_ASSERT_EQUAL(3, replies[i].adu[5]);
+        TEST_ASSERT_EQUAL(0x80, replies[i].adu[7] & 0x80);
+        TEST_ASSERT_EQUAL(expected[i], replies[i].adu[8]);
+    }
+    TEST_ASSERT_EQUAL(7, gateway.exceptions);
+
+    // Nobody home
+    num_replies = 0;
+    submit(&clients[0], adu, request(adu, 1, STATION + 1, SBUS_MODBUS_READ_HOLDING_REGISTERS, 0, 2));
+    drive();
+    TEST_ASSERT_EQUAL(SBUS_MODBUS_GATEWAY_TARGET_FAILED, replies[0].adu[8]);
+
+    // Out of calls, and a client that went away
+    num_replies = 0;
+    for (uint16_t i = 0; i < CALLS + 1; i++)
+        submit(&clients[1], adu, request(adu, i, STATION, SBUS_MODBUS_READ_HOLDING_REGISTERS, (uint16_t)(i * 2), 2));
+    TEST_ASSERT_EQUAL(1, num_replies);
+    TEST_ASSERT_EQUAL(SBUS_MODBUS_SERVER_DEVICE_BUSY, replies[0].adu[8]);
+    sbus_gateway_forget(&gateway, &clients[1]);
+    drive();
+    TEST_ASSERT_EQUAL(1, num_replies);
+
+    // Framing
+    len = 7;
+    request(adu, 1, STATION, SBUS_MODBUS_READ_COILS, 0, 1);
+    TEST_ASSERT_EQUAL(SBUS_INCOMPLETE_PACKET, sbus_gateway_submit(&gateway, &clients[0], adu, &len));
+    len = 11;
+    TEST_ASSERT_EQUAL(SBUS_INCOMPLETE_PACKET, sbus_gateway_submit(&gateway, &clients[0], adu, &len));
+    adu[3] = 1;
+    len    = 12;
+    TEST_ASSERT_EQUAL(SBUS_INVALID_DATA, sbus_gateway_submit(&gateway, &clients[0], adu, &len));
+}
+
+
+/*
+ * The whole gateway on localhost: two Modbus TCP clients ask for the same block at the same time, the station
+ * answers on a pseudo terminal (see test/master).
+ */
+void test_localhost() {
+    static sbus_master_t        master;
+    static sbus_master_line_t   line;
+    static sbus_modbus_server_t server;
+    uint8_t                     adu[SBUS_MODBUS_MAX_ADU];
+    int                         sockets[2];
+    size_t                      received[2] = {0};
+
+    int ptm = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, ptm);
+    TEST_ASSERT_EQUAL(0, grantpt(ptm));
+    TEST_ASSERT_EQUAL(0, unlockpt(ptm));
+    int fd = sbus_master_open_serial(ptsname(ptm), 115200);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+
+    TEST_ASSERT_EQUAL(0, sbus_master_init(&master));
+    TEST_ASSERT_EQUAL(0, sbus_master_add_line(&master, &line, fd, 500));
+    TEST_ASSERT_EQUAL(0, sbus_modbus_server_init(&server, &master, &line, &pairs, "127.0.0.1", 0));
+
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons(server.port)};
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    for (size_t i = 0; i < 2; i++) {
+        sockets[i] = socket(AF_INET, SOCK_STREAM, 0);
+        TEST_ASSERT_EQUAL(0, connect(sockets[i], (struct sockaddr *)&address, sizeof(address)));
+        size_t len = request(adu, (uint16_t)(100 + i), STATION, SBUS_MODBUS_READ_HOLDING_REGISTERS, 6, 4);
+        TEST_ASSERT_EQUAL(len, send(sockets[i], adu, len, 0));
+    }
+
+    uint16_t rx[64];
+    size_t   rx_len = 0;
+    for (int round = 0; round < 200 && (received[0] < 17 || received[1] < 17); round++) {
+        TEST_ASSERT_GREATER_OR_EQUAL(0, sbus_modbus_server_poll(&server, 5));
+
+        // The station: the first character of a frame is the address, the parity bit is lost
+        uint8_t bytes[256];
+        ssize_t res;
+        while ((res = read(ptm, bytes, sizeof(bytes))) > 0) {
+            for (ssize_t i = 0; i < res; i++, rx_len++)
+                rx[rx_len] = rx_len == 0 ? SBUS_ADDRESS(bytes[i]) : bytes[i];
+
+            sbus_request_t sbus_request;
+            size_t         len = rx_len;
+            if (sbus_packet_parse_request(rx, &len, &sbus_request) == SBUS_INCOMPLETE_PACKET)
+                continue;
+            rx_len = 0;
+
+            uint16_t response[256];
+            int      num = sbus_slave_handle_request(&slave, &sbus_request, response, 256);
+            for (int i = 0; i < num; i++)
+                bytes[i] = (uint8_t)response[i];
+            TEST_ASSERT_EQUAL(num, write(ptm, bytes, (size_t)num));
+        }
+
+        for (size_t i = 0; i < 2; i++) {
+            ssize_t got = recv(sockets[i], &replies[i].adu[received[i]], sizeof(replies[i].adu) - received[i],
+                               MSG_DONTWAIT);
+            if (got > 0)
+                received[i] += (size_t)got;
+        }
+    }
+
+    for (size_t i = 0; i < 2; i++) {
+        TEST_ASSERT_EQUAL(17, received[i]);
+        TEST_ASSERT_EQUAL(100 + i, replies[i].adu[1]);
+        TEST_ASSERT_EQUAL(8, replies[i].adu[8]);
+        TEST_ASSERT_EQUAL(0x0004, word(&replies[i], 0));     // Register 3
+        TEST_ASSERT_EQUAL(0x0005, word(&replies[i], 2));     // Register 4
+        close(sockets[i]);
+    }
+    TEST_ASSERT_EQUAL(1, server.gateway.reads_sent);
+    TEST_ASSERT_EQUAL(1, server.gateway.collapsed);
+
+    sbus_modbus_server_deinit(&server);
+    sbus_master_remove_line(&master, &line);
+    sbus_master_deinit(&master);
+    close(fd);
+    close(ptm);
+}
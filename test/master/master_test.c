@@ -0,0 +1,260 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "sbus/packet.h"
+#include "sbus/slave.h"
+#include "sbus/posix/master.h"
+#include "unity.h"
+
+/*
+ * Each line is a pseudo terminal pair: the master runtime drives the terminal side like a serial port, while a
+ * simulated slave station answers on the multiplexer side. Pseudo terminals lose the parity bit, so the simulated
+ * slave takes the first character after each exchange as the address.
+ */
+typedef struct {
+    int          ptm;
+    int          fd;
+    int          drop;     // Number of requests to leave unanswered
+    uint16_t     rx[512];
+    size_t       received;
+    sbus_slave_t slave;
+    uint32_t     registers[32];
+} simulated_line_t;
+
+static sbus_master_t      master;
+static simulated_line_t   simulated[2];
+static sbus_master_line_t lines[2];
+static atomic_int         completed;
+
+
+static void open_line(simulated_line_t *line, uint8_t station) {
+    memset(line, 0, sizeof(simulated_line_t));
+    line->ptm = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, line->ptm);
+    TEST_ASSERT_EQUAL(0, grantpt(line->ptm));
+    TEST_ASSERT_EQUAL(0, unlockpt(line->ptm));
+    line->fd = sbus_master_open_serial(ptsname(line->ptm), 115200);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, line->fd);
+
+    sbus_slave_init(&line->slave, station);
+    sbus_slave_set_media(&line->slave, SBUS_MEDIA_REGISTER, line->registers, 32);
+    for (size_t i = 0; i < 32; i++)
+        line->registers[i] = station * 1000 + (uint32_t)i;
+}
+
+
+static void serve(simulated_line_t *line) {
+    uint8_t bytes[256];
+    ssize_t res;
+
+    while ((res = read(line->ptm, bytes, sizeof(bytes))) > 0) {
+        for (ssize_t i = 0; i < res; i++) {
+            line->rx[line->received] = line->received == 0 ? SBUS_ADDRESS(bytes[i]) : bytes[i];
+            line->received++;
+        }
+
+        sbus_request_t request;
+        size_t         len = line->received;
+        if (sbus_packet_parse_request(line->rx, &len, &request) == SBUS_INCOMPLETE_PACKET)
+            continue;
+        line->received = 0;
+
+        uint16_t response[256];
+        int      num = sbus_slave_handle_request(&line->slave, &request, response, 256);
+        if (num <= 0)
+            continue;
+        if (line->drop > 0) {
+            line->drop--;
+            continue;
+        }
+
+        for (int i = 0; i < num; i++)
+            bytes[i] = (uint8_t)response[i];
+        TEST_ASSERT_EQUAL(num, write(line->ptm, bytes, (size_t)num));
+    }
+}
+
+
+static void run_until(atomic_int *condition, int target) {
+    for (int i = 0; i < 1000 && *condition < target; i++) {
+        sbus_master_poll(&master, 1);
+        serve(&simulated[0]);
+        serve(&simulated[1]);
+    }
+}
+
+
+static void on_complete(sbus_transaction_t *transaction) {
+    (void)transaction;
+    completed++;
+}
+
+
+void setUp() {
+    completed = 0;
+    TEST_ASSERT_EQUAL(0, sbus_master_init(&master));
+    for (size_t i = 0; i < 2; i++) {
+        open_line(&simulated[i], (uint8_t)(i + 1));
+        TEST_ASSERT_EQUAL(0, sbus_master_add_line(&master, &lines[i], simulated[i].fd, 100));
+    }
+}
+
+void tearDown() {
+    for (size_t i = 0; i < 2; i++) {
+        sbus_master_remove_line(&master, &lines[i]);
+        close(simulated[i].fd);
+        close(simulated[i].ptm);
+    }
+    sbus_master_deinit(&master);
+}
+
+
+void test_pipelined_lines() {
+    sbus_transaction_t transactions[8];
+
+    for (size_t i = 0; i < 8; i++) {
+        memset(&transactions[i], 0, sizeof(sbus_transaction_t));
+        uint8_t station          = (uint8_t)(i % 2 + 1);
+        transactions[i].request  = SBUS_READ_REGISTERS_REQUEST(station, i, 2);
+        transactions[i].callback = on_complete;
+        sbus_master_submit(&lines[i % 2], &transactions[i]);
+    }
+
+    run_until(&completed, 8);
+    TEST_ASSERT_EQUAL(8, completed);
+
+    for (size_t i = 0; i < 8; i++) {
+        uint32_t expected = (uint32_t)((i % 2 + 1) * 1000 + i + 1);
+        TEST_ASSERT_EQUAL(SBUS_OK, transactions[i].result);
+        TEST_ASSERT_EQUAL(2 * 4 + 2, transactions[i].response_len);
+        TEST_ASSERT_EQUAL((expected >> 8) & 0xFF, transactions[i].response[6]);
+        TEST_ASSERT_EQUAL(expected & 0xFF, transactions[i].response[7]);
+    }
+}
+
+
+void test_timeout_and_next() {
+    sbus_transaction_t lost = {.request = SBUS_READ_REGISTERS_REQUEST(1, 0, 1), .callback = on_complete};
+    sbus_transaction_t next = {.request = SBUS_WRITE_REGISTER_REQUEST(1, 3, 77), .callback = on_complete};
+
+    simulated[0].drop = 1;
+    sbus_master_submit(&lines[0], &lost);
+    sbus_master_submit(&lines[0], &next);
+
+    run_until(&lost.done, 1);
+    TEST_ASSERT_EQUAL(SBUS_TIMEOUT, lost.result);
+
+    run_until(&next.done, 1);
+    TEST_ASSERT_EQUAL(SBUS_OK, next.result);
+    TEST_ASSERT_EQUAL(SBUS_ACK, next.response[0]);
+    TEST_ASSERT_EQUAL(77, simulated[0].registers[3]);
+}
+
+
+void test_broadcast() {
+    static sbus_latency_histogram_t histograms[4];
+    sbus_latency_table_t            latency;
+    sbus_latency_snapshot_t         snapshot;
+    sbus_transaction_t              broadcast = {.request  = SBUS_WRITE_REGISTER_REQUEST(SBUS_BROADCAST_ADDRESS, 0, 5),
+                                                 .callback = on_complete};
+
+    // Without a wire model the guard time comes from the speed of the port, and is not a latency
+    sbus_latency_table_init(&latency, histograms, 4);
+    lines[1].latency = &latency;
+    sbus_master_submit(&lines[1], &broadcast);
+    TEST_ASSERT_FALSE(broadcast.done);
+    run_until(&broadcast.done, 1);
+    TEST_ASSERT_EQUAL(SBUS_OK, broadcast.result);
+    TEST_ASSERT_EQUAL(5, simulated[1].registers[0]);
+    TEST_ASSERT_EQUAL(-1, sbus_latency_snapshot(&latency, SBUS_BROADCAST_ADDRESS, SBUS_COMMAND_WRITE_REGISTER,
+                                                &snapshot));
+    lines[1].latency = NULL;
+
+    // With a wire model the next frame waits for the guard time
+    static sbus_station_timing_t stations[SBUS_TIMING_STATIONS];
+    sbus_timing_t                timing;
+    sbus_wire_t                  wire = {.baud = 115200, .format = SBUS_WIRE_PARITY, .turnaround_us = 20000};
+    sbus_transaction_t           read = {.request = SBUS_READ_REGISTERS_REQUEST(2, 0, 1), .callback = on_complete};
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_timing_init(&timing, &wire, stations));
+    lines[1].timing = &timing;
+    broadcast       = (sbus_transaction_t){.request = SBUS_WRITE_REGISTER_REQUEST(SBUS_BROADCAST_ADDRESS, 0, 6),
+                                           .callback = on_complete};
+
+    uint64_t start = sbus_master_now_us();
+    sbus_master_submit(&lines[1], &broadcast);
+    sbus_master_submit(&lines[1], &read);
+    TEST_ASSERT_FALSE(broadcast.done);
+    run_until(&read.done, 1);
+    TEST_ASSERT_EQUAL(SBUS_OK, broadcast.result);
+    TEST_ASSERT_EQUAL(SBUS_OK, read.result);
+    TEST_ASSERT_GREATER_OR_EQUAL(sbus_wire_guard_us(&wire, &broadcast.request), sbus_master_now_us() - start);
+    TEST_ASSERT_EQUAL(6, simulated[1].registers[0]);
+    TEST_ASSERT_EQUAL(6, read.response[3]);
+    lines[1].timing = NULL;
+}
+
+
+void test_capture() {
+    static uint64_t       memory[1024];
+    sbus_capture_t        capture;
+    sbus_capture_record_t record;
+    sbus_transaction_t    read = {.request = SBUS_READ_REGISTERS_REQUEST(1, 4, 1), .callback = on_complete};
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_capture_init(&capture, memory, sizeof(memory)));
+    lines[0].capture = &capture;
+    sbus_master_submit(&lines[0], &read);
+    run_until(&read.done, 1);
+    lines[0].capture = NULL;
+
+    uint64_t position = sbus_capture_first(&capture);
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_capture_next(&capture, &position, &record));
+    TEST_ASSERT_EQUAL(SBUS_CAPTURE_TX, record.direction);
+    TEST_ASSERT_EQUAL(7, record.count);
+    TEST_ASSERT_TRUE(SBUS_ADDRESS_MAP_GET(record.address_map, 0));
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_capture_next(&capture, &position, &record));
+    TEST_ASSERT_EQUAL(SBUS_CAPTURE_RX, record.direction);
+    TEST_ASSERT_EQUAL(SBUS_OK, record.result);
+    TEST_ASSERT_EQUAL(6, record.count);
+    TEST_ASSERT_EQUAL(1004 & 0xFF, record.bytes[3]);
+}
+
+
+void test_adaptive_timeouts() {
+    static sbus_station_timing_t stations[SBUS_TIMING_STATIONS];
+    sbus_timing_t                timing;
+    sbus_wire_t                  wire = {.baud = 115200, .format = SBUS_WIRE_PARITY};
+    sbus_transaction_t           read = {.request = SBUS_READ_REGISTERS_REQUEST(1, 0, 1), .callback = on_complete};
+    sbus_transaction_t           lost[3];
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_timing_init(&timing, &wire, stations));
+    timing.initial_us     = 20000;
+    timing.offline_after  = 2;
+    timing.backoff_min_us = 10000000;
+    lines[0].timing       = &timing;
+
+    sbus_master_submit(&lines[0], &read);
+    run_until(&read.done, 1);
+    TEST_ASSERT_EQUAL(SBUS_OK, read.result);
+    TEST_ASSERT_GREATER_THAN(0, stations[1].srtt_us);
+
+    // Nobody answers as station 9: much faster than the line timeout, then not even sent
+    uint64_t start = sbus_master_now_us();
+    for (size_t i = 0; i < 2; i++) {
+        lost[i] = (sbus_transaction_t){.request = SBUS_READ_REGISTERS_REQUEST(9, 0, 1), .callback = on_complete};
+        sbus_master_submit(&lines[0], &lost[i]);
+        run_until(&lost[i].done, 1);
+        TEST_ASSERT_EQUAL(SBUS_TIMEOUT, lost[i].result);
+    }
+    TEST_ASSERT_LESS_THAN(100000, sbus_master_now_us() - start);
+    TEST_ASSERT_EQUAL(2, stations[9].failures);
+
+    lost[2] = (sbus_transaction_t){.request = SBUS_READ_REGISTERS_REQUEST(9, 0, 1)};
+    sbus_master_submit(&lines[0], &lost[2]);
+    TEST_ASSERT_TRUE(lost[2].done);
+    TEST_ASSERT_EQUAL(SBUS_TIMEOUT, lost[2].result);
+    lines[0].timing = NULL;
+}
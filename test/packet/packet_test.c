@@ -121,6 +121,66 @@ void test_unknown_command() {
     int            res = sbus_packet_parse_request(buffer, &len, &request);
 
     TEST_ASSERT_EQUAL(SBUS_UNKNOWN_COMMAND, res);
+
+    // Unknown commands are refused instead of being trusted with a guessed length
+    uint16_t       response[8] = {0x00, 0x00};
+    uint8_t        bytes[8]    = {0x00, 0x00};
+    sbus_request_t unknown     = {.destination = 1, .command = 9};
+    len                        = 8;
+    TEST_ASSERT_EQUAL(0, sbus_packet_response_length(&unknown));
+    TEST_ASSERT_EQUAL(SBUS_UNKNOWN_COMMAND, sbus_packet_validate_response_9bit(&unknown, response, &len));
+    len = 8;
+    TEST_ASSERT_EQUAL(SBUS_UNKNOWN_COMMAND, sbus_packet_validate_response_8bit(&unknown, bytes, &len));
+    unknown.command = 200;
+    TEST_ASSERT_EQUAL(SBUS_COMMAND_KIND_UNKNOWN, sbus_command_describe(unknown.command)->kind);
+}
+
+
+void test_command_descriptors() {
+    sbus_request_t request = SBUS_READ_REGISTERS_REQUEST(1, 0, 1);
+    size_t         required;
+
+    for (size_t r_count = 0; r_count < 128; r_count++) {
+        request.data[0] = (uint8_t)r_count;
+
+        request.command = SBUS_COMMAND_READ_TIMER;
+        TEST_ASSERT_EQUAL((r_count + 1) * 4 + 2, sbus_packet_response_length(&request));
+        request.command = SBUS_COMMAND_READ_INPUT;
+        TEST_ASSERT_EQUAL((r_count + 8) / 8 + 2, sbus_packet_response_length(&request));
+    }
+
+    request.command = SBUS_COMMAND_READ_REAL_TIME_CLOCK;
+    TEST_ASSERT_EQUAL(8, sbus_packet_response_length(&request));
+    request.command = SBUS_COMMAND_READ_STATION_NUMBER;
+    TEST_ASSERT_EQUAL(3, sbus_packet_response_length(&request));
+    request.command = SBUS_COMMAND_WRITE_FLAG;
+    TEST_ASSERT_EQUAL(2, sbus_packet_response_length(&request));
+    request.destination = SBUS_BROADCAST_ADDRESS;
+    TEST_ASSERT_EQUAL(0, sbus_packet_response_length(&request));
+
+    uint8_t values[] = {9};
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_packet_request_data_length(SBUS_COMMAND_WRITE_TIMER, values, 1, &required));
+    TEST_ASSERT_EQUAL(11, required);
+    values[0] = 8;
+    TEST_ASSERT_EQUAL(SBUS_INVALID_DATA,
+                      sbus_packet_request_data_length(SBUS_COMMAND_WRITE_TIMER, values, 1, &required));
+
+    uint8_t bits[] = {3, 0, 0, 127};
+    TEST_ASSERT_EQUAL(SBUS_INCOMPLETE_PACKET,
+                      sbus_packet_request_data_length(SBUS_COMMAND_WRITE_OUTPUT, bits, 3, &required));
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_packet_request_data_length(SBUS_COMMAND_WRITE_OUTPUT, bits, 4, &required));
+    TEST_ASSERT_EQUAL(5, required);
+    bits[3] = 128;
+    TEST_ASSERT_EQUAL(SBUS_INVALID_DATA,
+                      sbus_packet_request_data_length(SBUS_COMMAND_WRITE_OUTPUT, bits, 4, &required));
+
+    const sbus_command_descriptor_t *descriptor = sbus_command_describe(SBUS_COMMAND_WRITE_COUNTER);
+    TEST_ASSERT_EQUAL(SBUS_COMMAND_KIND_WRITE, descriptor->kind);
+    TEST_ASSERT_EQUAL(SBUS_MEDIA_COUNTER, descriptor->media);
+    TEST_ASSERT_EQUAL(SBUS_MAX_VALUES_PER_FRAME, descriptor->max_count);
+    TEST_ASSERT_EQUAL_STRING("WRITE_COUNTER", descriptor->name);
+    TEST_ASSERT_EQUAL_STRING("UNKNOWN", sbus_command_describe(9)->name);
+    TEST_ASSERT_FALSE(sbus_command_describe(SBUS_COMMAND_READ_DISPLAY_REGISTER)->has_media);
 }
 
 
@@ -216,4 +276,126 @@ void test_field_data() {
     sbus_result_t res = sbus_packet_validate_response_9bit(&request, data, &len);
 
     TEST_ASSERT_EQUAL(res, SBUS_OK);
-}
\ No newline at end of file
+}
+
+void test_request_view() {
+    uint16_t       buffer[32] = {0x55, 0x66};
+    sbus_request_t request    = SBUS_WRITE_REGISTER_REQUEST(10, 100, 12345);
+    size_t         total      = 2 + sbus_packet_serialize_request(&buffer[2], &request);
+
+    sbus_request_view_t view;
+    size_t              len = total;
+    int                 res = sbus_packet_parse_request_view(buffer, &len, &view);
+
+    TEST_ASSERT_EQUAL(SBUS_OK, res);
+    TEST_ASSERT_EQUAL(total, len);
+    TEST_ASSERT_EQUAL(10, view.destination);
+    TEST_ASSERT_EQUAL(SBUS_COMMAND_WRITE_REGISTER, view.command);
+    TEST_ASSERT_EQUAL(7, view.data_len);
+    TEST_ASSERT_TRUE(view.data == &buffer[4]);
+    TEST_ASSERT_EQUAL(100, sbus_request_view_address(&view));
+    TEST_ASSERT_EQUAL(1, sbus_request_view_value_count(&view));
+    TEST_ASSERT_EQUAL(12345, sbus_request_view_value(&view, 0));
+
+    sbus_request_t copy;
+    sbus_request_view_copy(&view, &copy);
+    TEST_ASSERT_EQUAL(request.destination, copy.destination);
+    TEST_ASSERT_EQUAL(request.command, copy.command);
+    TEST_ASSERT_EQUAL(request.data_len, copy.data_len);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(request.data, copy.data, request.data_len);
+    TEST_ASSERT_EQUAL(2, sbus_packet_response_length_view(&view));
+
+    uint16_t ack[] = {SBUS_ACK, 0};
+    len            = 2;
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_packet_validate_response_view_9bit(&view, ack, &len));
+}
+
+
+void test_read_registers_view() {
+    uint16_t       buffer[16] = {0};
+    sbus_request_t request    = SBUS_READ_REGISTERS_REQUEST(75, 9, 4);
+    size_t         len        = sbus_packet_serialize_request(buffer, &request);
+
+    sbus_request_view_t view;
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_packet_parse_request_view(buffer, &len, &view));
+    TEST_ASSERT_EQUAL(3, sbus_request_view_r_count(&view));
+    TEST_ASSERT_EQUAL(9, sbus_request_view_address(&view));
+
+    uint16_t data[] = {0x00, 0x02, 0x00, 0x4B, 0x02, 0x08, 0x00, 0xCA, 0x00, 0xB4,
+                       0x00, 0x00, 0xF1, 0x22, 0x41, 0x01, 0x64, 0x50, 0xCA, 0x00};
+    len             = 20;
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_packet_validate_response_view_9bit(&view, data, &len));
+    TEST_ASSERT_EQUAL(18, len);
+}
+
+
+void test_parse_request_8bit() {
+    uint16_t       words[64] = {0x55, 0x66};
+    sbus_request_t request   = SBUS_WRITE_REGISTER_REQUEST(10, 100, 12345);
+    size_t         total     = 2 + sbus_packet_serialize_request(&words[2], &request);
+    total += sbus_packet_serialize_request(&words[total], &request);
+
+    uint8_t bytes[64];
+    uint8_t map[SBUS_ADDRESS_MAP_BYTES(64)];
+    sbus_packet_pack_9bit(words, total, bytes, map);
+    TEST_ASSERT_EQUAL(1, SBUS_ADDRESS_MAP_GET(map, 2));
+    TEST_ASSERT_EQUAL(0, SBUS_ADDRESS_MAP_GET(map, 3));
+
+    uint16_t unpacked[64];
+    sbus_packet_unpack_9bit(bytes, map, total, unpacked);
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(words, unpacked, total);
+
+    sbus_request_t parsed;
+    size_t         len = total;
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_packet_parse_request_8bit(bytes, map, 0, &len, &parsed));
+    TEST_ASSERT_EQUAL(2 + 11, len);
+    TEST_ASSERT_EQUAL(10, parsed.destination);
+    TEST_ASSERT_EQUAL(SBUS_COMMAND_WRITE_REGISTER, parsed.command);
+    TEST_ASSERT_EQUAL(request.data_len, parsed.data_len);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(request.data, parsed.data, request.data_len);
+
+    size_t first = len;
+    len          = total - first;
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_packet_parse_request_8bit(bytes, map, first, &len, &parsed));
+    TEST_ASSERT_EQUAL(11, len);
+    TEST_ASSERT_EQUAL(10, parsed.destination);
+
+    // Truncated frame
+    len = 2 + 5;
+    TEST_ASSERT_EQUAL(SBUS_INCOMPLETE_PACKET, sbus_packet_parse_request_8bit(bytes, map, 0, &len, &parsed));
+    TEST_ASSERT_EQUAL(2, len);
+
+    // A marker inside the data is an error
+    SBUS_ADDRESS_MAP_SET(map, 7);
+    len = total;
+    TEST_ASSERT_EQUAL(SBUS_INVALID_DATA, sbus_packet_parse_request_8bit(bytes, map, 0, &len, &parsed));
+
+    // And so is a wrong CRC
+    sbus_packet_pack_9bit(words, total, bytes, map);
+    bytes[12] ^= 0xFF;
+    len = total;
+    TEST_ASSERT_EQUAL(SBUS_WRONG_CRC, sbus_packet_parse_request_8bit(bytes, map, 0, &len, &parsed));
+
+    len = 2;
+    TEST_ASSERT_EQUAL(SBUS_NOT_FOUND, sbus_packet_parse_request_8bit(bytes, map, 0, &len, &parsed));
+}
+
+
+void test_pack_9bit_long_stream() {
+    uint16_t words[77];
+    uint16_t unpacked[77];
+    uint8_t  bytes[77];
+    uint8_t  map[SBUS_ADDRESS_MAP_BYTES(77)];
+
+    for (size_t i = 0; i < 77; i++)
+        words[i] = (uint16_t)((i * 37) & 0xFF) | (i % 13 == 0 ? 0x100 : 0);
+
+    sbus_packet_pack_9bit(words, 77, bytes, map);
+    for (size_t i = 0; i < 77; i++) {
+        TEST_ASSERT_EQUAL(words[i] & 0xFF, bytes[i]);
+        TEST_ASSERT_EQUAL(i % 13 == 0, SBUS_ADDRESS_MAP_GET(map, i));
+    }
+
+    sbus_packet_unpack_9bit(bytes, map, 77, unpacked);
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(words, unpacked, 77);
+}
@@ -0,0 +1,132 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "sbus/packet.h"
+#include "sbus/parser.h"
+#include "unity.h"
+
+void setUp() {}
+
+void tearDown() {}
+
+static size_t build_packet(uint16_t *buffer, uint8_t address, uint8_t command, uint8_t *data, size_t data_len) {
+    sbus_request_t request = {
+        .destination = address,
+        .command     = command,
+        .data_len    = data_len,
+    };
+    if (data_len > 0)
+        memcpy(request.data, data, data_len);
+    return sbus_packet_serialize_request(buffer, &request);
+}
+
+
+static void try_packet(uint8_t address, uint8_t command, uint8_t *data, size_t data_len) {
+    uint16_t      buffer[300] = {0x12, 0x34};
+    size_t        total       = 2 + build_packet(&buffer[2], address, command, data, data_len);
+    sbus_parser_t parser;
+    sbus_parser_init(&parser);
+
+    for (size_t i = 0; i < total - 1; i++)
+        TEST_ASSERT_EQUAL(SBUS_INCOMPLETE_PACKET, sbus_parser_feed_byte(&parser, buffer[i]));
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_parser_feed_byte(&parser, buffer[total - 1]));
+    TEST_ASSERT_EQUAL(address, parser.request.destination);
+    TEST_ASSERT_EQUAL(command, parser.request.command);
+    TEST_ASSERT_EQUAL(data_len, parser.request.data_len);
+    if (data_len > 0)
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(data, parser.request.data, data_len);
+    TEST_ASSERT_EQUAL(2, parser.discarded);
+}
+
+
+void test_read_packet() {
+    uint8_t buffer[3] = {4, 0x01, 0x02};
+    try_packet(1, SBUS_COMMAND_READ_COUNTER, buffer, 3);
+    try_packet(1, SBUS_COMMAND_READ_DISPLAY_REGISTER, NULL, 0);
+    try_packet(1, SBUS_COMMAND_READ_FLAG, buffer, 3);
+    try_packet(1, SBUS_COMMAND_READ_INPUT, buffer, 3);
+    try_packet(1, SBUS_COMMAND_READ_REAL_TIME_CLOCK, NULL, 0);
+    try_packet(1, SBUS_COMMAND_READ_OUTPUT, buffer, 3);
+    try_packet(1, SBUS_COMMAND_READ_REGISTER, buffer, 3);
+    try_packet(1, SBUS_COMMAND_READ_TIMER, buffer, 3);
+    try_packet(1, SBUS_COMMAND_READ_PCD_STATUS_SELF, NULL, 0);
+    try_packet(1, SBUS_COMMAND_READ_STATION_NUMBER, NULL, 0);
+}
+
+
+void test_write_packet() {
+    uint8_t buffer[256] = {0};
+
+    buffer[0] = 33;
+    try_packet(1, SBUS_COMMAND_WRITE_REGISTER, buffer, buffer[0] + 2);
+    buffer[0] = 129;
+    try_packet(1, SBUS_COMMAND_WRITE_COUNTER, buffer, buffer[0] + 2);
+    buffer[0] = 17;
+    try_packet(1, SBUS_COMMAND_WRITE_FLAG, buffer, buffer[0] + 2);
+    try_packet(1, SBUS_COMMAND_WRITE_REAL_TIME_CLOCK, buffer, 6);
+}
+
+
+void test_multiple_packets() {
+    uint16_t buffer[64];
+    size_t   total = 0;
+    total += build_packet(&buffer[total], 1, SBUS_COMMAND_READ_REGISTER, (uint8_t[]){1, 0, 10}, 3);
+    total += build_packet(&buffer[total], 2, SBUS_COMMAND_READ_STATION_NUMBER, NULL, 0);
+
+    sbus_parser_t parser;
+    sbus_parser_init(&parser);
+
+    size_t len = total;
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_parser_feed(&parser, buffer, &len));
+    TEST_ASSERT_EQUAL(7, len);
+    TEST_ASSERT_EQUAL(1, parser.request.destination);
+    TEST_ASSERT_EQUAL(SBUS_COMMAND_READ_REGISTER, parser.request.command);
+
+    size_t second = total - len;
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_parser_feed(&parser, &buffer[len], &second));
+    TEST_ASSERT_EQUAL(4, second);
+    TEST_ASSERT_EQUAL(2, parser.request.destination);
+    TEST_ASSERT_EQUAL(SBUS_COMMAND_READ_STATION_NUMBER, parser.request.command);
+
+    len = 0;
+    TEST_ASSERT_EQUAL(SBUS_INCOMPLETE_PACKET, sbus_parser_feed(&parser, buffer, &len));
+}
+
+
+void test_errors() {
+    uint16_t      buffer[32];
+    sbus_parser_t parser;
+    sbus_parser_init(&parser);
+
+    size_t total = build_packet(buffer, 1, SBUS_COMMAND_READ_REGISTER, (uint8_t[]){1, 0, 10}, 3);
+    buffer[total - 1] ^= 0x01;
+    size_t len = total;
+    TEST_ASSERT_EQUAL(SBUS_WRONG_CRC, sbus_parser_feed(&parser, buffer, &len));
+    TEST_ASSERT_EQUAL(total, len);
+
+    buffer[0] = SBUS_ADDRESS(1);
+    buffer[1] = 0xFF;
+    len       = 2;
+    TEST_ASSERT_EQUAL(SBUS_UNKNOWN_COMMAND, sbus_parser_feed(&parser, buffer, &len));
+
+    uint16_t invalid[] = {SBUS_ADDRESS(1), SBUS_COMMAND_WRITE_REGISTER, 4};
+    len                = 3;
+    TEST_ASSERT_EQUAL(SBUS_INVALID_DATA, sbus_parser_feed(&parser, invalid, &len));
+}
+
+
+void test_resync_on_address() {
+    uint16_t buffer[32] = {SBUS_ADDRESS(3), SBUS_COMMAND_READ_REGISTER, 1};
+    size_t   total      = 3 + build_packet(&buffer[3], 4, SBUS_COMMAND_READ_REGISTER, (uint8_t[]){1, 0, 10}, 3);
+
+    sbus_parser_t parser;
+    sbus_parser_init(&parser);
+
+    size_t len = total;
+    TEST_ASSERT_EQUAL(SBUS_INVALID_DATA, sbus_parser_feed(&parser, buffer, &len));
+    TEST_ASSERT_EQUAL(4, len);
+
+    size_t rest = total - len;
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_parser_feed(&parser, &buffer[len], &rest));
+    TEST_ASSERT_EQUAL(4, parser.request.destination);
+}
@@ -0,0 +1,104 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "sbus/packet.h"
+#include "sbus/planner.h"
+#include "unity.h"
+
+void setUp() {}
+
+void tearDown() {}
+
+
+void test_coalesce_with_gap() {
+    sbus_point_t points[] = {
+        {.station = 2, .media = SBUS_MEDIA_REGISTER, .address = 10},
+        {.station = 1, .media = SBUS_MEDIA_REGISTER, .address = 14},
+        {.station = 1, .media = SBUS_MEDIA_REGISTER, .address = 10},
+        {.station = 1, .media = SBUS_MEDIA_REGISTER, .address = 12},
+        {.station = 1, .media = SBUS_MEDIA_REGISTER, .address = 30},
+        {.station = 1, .media = SBUS_MEDIA_FLAG, .address = 12},
+    };
+    sbus_planner_config_t config = {.gap_tolerance = 2};
+    sbus_read_frame_t     frames[8];
+    size_t                num_frames = 0;
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_planner_plan(&config, points, 6, frames, 8, &num_frames));
+    TEST_ASSERT_EQUAL(4, num_frames);
+
+    TEST_ASSERT_EQUAL(1, frames[0].station);
+    TEST_ASSERT_EQUAL(SBUS_MEDIA_REGISTER, frames[0].media);
+    TEST_ASSERT_EQUAL(10, frames[0].start);
+    TEST_ASSERT_EQUAL(5, frames[0].count);
+    TEST_ASSERT_EQUAL(3, frames[0].num_points);
+
+    TEST_ASSERT_EQUAL(30, frames[1].start);
+    TEST_ASSERT_EQUAL(1, frames[1].count);
+    TEST_ASSERT_EQUAL(SBUS_MEDIA_FLAG, frames[2].media);
+    TEST_ASSERT_EQUAL(2, frames[3].station);
+
+    config.gap_tolerance = 0;
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_planner_plan(&config, points, 6, frames, 8, &num_frames));
+    TEST_ASSERT_EQUAL(6, num_frames);
+
+    TEST_ASSERT_EQUAL(SBUS_INVALID_ARGS, sbus_planner_plan(&config, points, 6, frames, 2, &num_frames));
+}
+
+
+void test_frame_limits() {
+    sbus_point_t points[200];
+    for (size_t i = 0; i < 200; i++) {
+        points[i] = (sbus_point_t){.station = 1, .media = i < 100 ? SBUS_MEDIA_REGISTER : SBUS_MEDIA_FLAG,
+                                   .address = (uint16_t)i};
+    }
+
+    sbus_planner_config_t config = {.gap_tolerance = 0};
+    sbus_read_frame_t     frames[16];
+    size_t                num_frames = 0;
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_planner_plan(&config, points, 200, frames, 16, &num_frames));
+    // 100 registers in frames of 32, then flags 100-199 in a single frame
+    TEST_ASSERT_EQUAL(5, num_frames);
+    TEST_ASSERT_EQUAL(32, frames[0].count);
+    TEST_ASSERT_EQUAL(4, frames[3].count);
+    TEST_ASSERT_EQUAL(100, frames[4].count);
+
+    sbus_request_t request;
+    sbus_planner_frame_request(&frames[0], &request);
+    TEST_ASSERT_EQUAL(SBUS_COMMAND_READ_REGISTER, request.command);
+    TEST_ASSERT_EQUAL(31 * 4 + 4 + 2, sbus_packet_response_length(&request));
+    sbus_planner_frame_request(&frames[4], &request);
+    TEST_ASSERT_EQUAL(SBUS_COMMAND_READ_FLAG, request.command);
+    TEST_ASSERT_EQUAL(13 + 2, sbus_packet_response_length(&request));
+
+    config.max_values = 10;
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_planner_plan(&config, points, 200, frames, 16, &num_frames));
+    TEST_ASSERT_EQUAL(11, num_frames);
+}
+
+
+void test_scatter() {
+    sbus_point_t points[] = {
+        {.station = 5, .media = SBUS_MEDIA_REGISTER, .address = 3},
+        {.station = 5, .media = SBUS_MEDIA_REGISTER, .address = 1},
+        {.station = 5, .media = SBUS_MEDIA_OUTPUT, .address = 9},
+        {.station = 5, .media = SBUS_MEDIA_OUTPUT, .address = 0},
+    };
+    sbus_planner_config_t config = {.gap_tolerance = 16};
+    sbus_read_frame_t     frames[4];
+    size_t                num_frames = 0;
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_planner_plan(&config, points, 4, frames, 4, &num_frames));
+    TEST_ASSERT_EQUAL(2, num_frames);
+
+    uint16_t registers[] = {0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0x12, 0x34, 0x56, 0x78};
+    sbus_planner_scatter_9bit(&frames[0], points, registers);
+    TEST_ASSERT_EQUAL(1, points[0].address);
+    TEST_ASSERT_EQUAL(1, points[0].value);
+    TEST_ASSERT_EQUAL(0x12345678, points[1].value);
+    TEST_ASSERT_TRUE(points[1].valid);
+
+    uint8_t outputs[] = {0x00, 0x02};
+    sbus_planner_scatter_8bit(&frames[1], points, outputs);
+    TEST_ASSERT_EQUAL(0, points[2].value);
+    TEST_ASSERT_EQUAL(1, points[3].value);
+}
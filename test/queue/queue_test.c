@@ -0,0 +1,200 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "sbus/packet.h"
+#include "sbus/slave.h"
+#include "sbus/posix/master.h"
+#include "sbus/posix/queue.h"
+#include "unity.h"
+
+#define PRODUCERS    4
+#define PER_PRODUCER 25
+
+/*
+ * The line is a pseudo terminal pair like in the master tests: the queue worker owns the terminal side, the test
+ * thread answers as station 1 on the multiplexer side whenever it calls `serve`.
+ */
+static int          ptm;
+static int          fd;
+static sbus_slave_t slave;
+static uint32_t     registers[32];
+static uint16_t     rx[512];
+static size_t       received;
+
+static sbus_queue_t queue;
+static atomic_int   completed;
+static atomic_int   order[8];
+
+static sbus_transaction_t transactions[PRODUCERS][PER_PRODUCER];
+
+
+static void serve(void) {
+    uint8_t bytes[256];
+    ssize_t res;
+
+    while ((res = read(ptm, bytes, sizeof(bytes))) > 0) {
+        for (ssize_t i = 0; i < res; i++) {
+            rx[received] = received == 0 ? SBUS_ADDRESS(bytes[i]) : bytes[i];
+            received++;
+        }
+
+        sbus_request_t request;
+        size_t         len = received;
+        if (sbus_packet_parse_request(rx, &len, &request) == SBUS_INCOMPLETE_PACKET)
+            continue;
+        received = 0;
+
+        uint16_t response[256];
+        int      num = sbus_slave_handle_request(&slave, &request, response, 256);
+        for (int i = 0; i < num; i++)
+            bytes[i] = (uint8_t)response[i];
+        if (num > 0)
+            TEST_ASSERT_EQUAL(num, write(ptm, bytes, (size_t)num));
+    }
+}
+
+
+static void serve_until(int target) {
+    for (int i = 0; i < 2000 && atomic_load(&completed) < target; i++) {
+        struct pollfd pfd = {.fd = ptm, .events = POLLIN};
+        poll(&pfd, 1, 1);
+        serve();
+    }
+}
+
+
+static void on_complete(sbus_transaction_t *transaction) {
+    int position = atomic_fetch_add(&completed, 1);
+    if (position < 8)
+        atomic_store(&order[position], (int)(intptr_t)transaction->arg);
+}
+
+
+static void *produce(void *arg) {
+    size_t producer = (size_t)(uintptr_t)arg;
+
+    for (size_t i = 0; i < PER_PRODUCER; i++) {
+        sbus_transaction_t *transaction = &transactions[producer][i];
+        memset(transaction, 0, sizeof(sbus_transaction_t));
+        transaction->request  = SBUS_READ_REGISTERS_REQUEST(1, (producer * 7 + i) % 31, 2);
+        transaction->priority = (unsigned)(i % SBUS_PRIORITIES);
+        transaction->callback = on_complete;
+        sbus_queue_submit(&queue, transaction);
+    }
+    return NULL;
+}
+
+
+void setUp() {
+    atomic_store(&completed, 0);
+    received = 0;
+
+    ptm = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, ptm);
+    TEST_ASSERT_EQUAL(0, grantpt(ptm));
+    TEST_ASSERT_EQUAL(0, unlockpt(ptm));
+    fd = sbus_master_open_serial(ptsname(ptm), 115200);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+
+    sbus_slave_init(&slave, 1);
+    sbus_slave_set_media(&slave, SBUS_MEDIA_REGISTER, registers, 32);
+    for (size_t i = 0; i < 32; i++)
+        registers[i] = 1000 + (uint32_t)i;
+
+    TEST_ASSERT_EQUAL(0, sbus_queue_init(&queue, fd, 200));
+    TEST_ASSERT_EQUAL(0, sbus_queue_start(&queue));
+}
+
+void tearDown() {
+    sbus_queue_stop(&queue);
+    sbus_queue_deinit(&queue);
+    close(fd);
+    close(ptm);
+}
+
+
+void test_concurrent_producers() {
+    pthread_t threads[PRODUCERS];
+
+    for (uintptr_t i = 0; i < PRODUCERS; i++)
+        TEST_ASSERT_EQUAL(0, pthread_create(&threads[i], NULL, produce, (void *)i));
+
+    serve_until(PRODUCERS * PER_PRODUCER);
+    for (size_t i = 0; i < PRODUCERS; i++)
+        pthread_join(threads[i], NULL);
+    TEST_ASSERT_EQUAL(PRODUCERS * PER_PRODUCER, atomic_load(&completed));
+
+    for (size_t producer = 0; producer < PRODUCERS; producer++) {
+        for (size_t i = 0; i < PER_PRODUCER; i++) {
+            sbus_transaction_t *transaction = &transactions[producer][i];
+            uint32_t            expected    = 1000 + (uint32_t)((producer * 7 + i) % 31);
+            TEST_ASSERT_EQUAL(SBUS_OK, transaction->result);
+            TEST_ASSERT_EQUAL(expected & 0xFF, transaction->response[3]);
+            TEST_ASSERT_EQUAL((expected + 1) & 0xFF, transaction->response[7]);
+        }
+    }
+}
+
+
+void test_priority_and_deadline() {
+    sbus_transaction_t blocker = {.request = SBUS_READ_REGISTERS_REQUEST(1, 0, 1), .arg = (void *)1};
+    sbus_transaction_t low     = {.request = SBUS_READ_REGISTERS_REQUEST(1, 1, 1), .arg = (void *)2};
+    sbus_transaction_t normal  = {.request = SBUS_READ_REGISTERS_REQUEST(1, 2, 1), .arg = (void *)3};
+    sbus_transaction_t high    = {.request = SBUS_READ_REGISTERS_REQUEST(1, 3, 1), .arg = (void *)4};
+    sbus_transaction_t stale   = {.request = SBUS_READ_REGISTERS_REQUEST(1, 4, 1), .arg = (void *)5};
+
+    sbus_transaction_t *all[] = {&blocker, &low, &normal, &high, &stale};
+    for (size_t i = 0; i < 5; i++)
+        all[i]->callback = on_complete;
+    low.priority    = SBUS_PRIORITY_LOW;
+    normal.priority = SBUS_PRIORITY_NORMAL;
+    high.priority   = SBUS_PRIORITY_HIGH;
+    stale.priority  = SBUS_PRIORITY_HIGH;
+
+    // Keep the line busy until everything else is queued
+    sbus_queue_submit(&queue, &blocker);
+    struct pollfd pfd = {.fd = ptm, .events = POLLIN};
+    TEST_ASSERT_EQUAL(1, poll(&pfd, 1, 1000));
+
+    stale.expires_us = sbus_master_now_us() + 1000;
+    sbus_queue_submit(&queue, &low);
+    sbus_queue_submit(&queue, &normal);
+    sbus_queue_submit(&queue, &stale);
+    sbus_queue_submit(&queue, &high);
+    usleep(5000);
+
+    serve_until(5);
+    TEST_ASSERT_EQUAL(5, atomic_load(&completed));
+    TEST_ASSERT_EQUAL(1, atomic_load(&order[0]));
+    TEST_ASSERT_EQUAL(5, atomic_load(&order[1]));     // Dropped before it could be sent
+    TEST_ASSERT_EQUAL(4, atomic_load(&order[2]));
+    TEST_ASSERT_EQUAL(3, atomic_load(&order[3]));
+    TEST_ASSERT_EQUAL(2, atomic_load(&order[4]));
+
+    TEST_ASSERT_EQUAL(SBUS_TIMEOUT, stale.result);
+    TEST_ASSERT_EQUAL(1, atomic_load(&queue.expired));
+    TEST_ASSERT_EQUAL(SBUS_OK, high.result);
+    TEST_ASSERT_EQUAL(1003 & 0xFF, high.response[3]);
+}
+
+
+void test_wait_on_done() {
+    sbus_transaction_t read = {.request = SBUS_READ_REGISTERS_REQUEST(1, 6, 1)};
+
+    // No callback: the submitting thread sees the response once `done` is set by the worker
+    sbus_queue_submit(&queue, &read);
+    for (int i = 0; i < 2000 && !atomic_load_explicit(&read.done, memory_order_acquire); i++) {
+        struct pollfd pfd = {.fd = ptm, .events = POLLIN};
+        poll(&pfd, 1, 1);
+        serve();
+    }
+
+    TEST_ASSERT_TRUE(atomic_load_explicit(&read.done, memory_order_acquire));
+    TEST_ASSERT_EQUAL(SBUS_OK, read.result);
+    TEST_ASSERT_EQUAL(1006 & 0xFF, read.response[3]);
+}
@@ -0,0 +1,126 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "sbus/packet.h"
+#include "sbus/scheduler.h"
+#include "sbus/wire.h"
+#include "unity.h"
+
+#define STATIONS 30
+
+static sbus_poll_t      polls[STATIONS * 4];
+static sbus_scheduler_t scheduler;
+
+void setUp() {}
+
+void tearDown() {}
+
+
+/*
+ * Alarm flags every 200 ms, process values every 2 s and two frames of configuration every minute on every station.
+ */
+static size_t configure(void) {
+    size_t count = 0;
+
+    for (uint8_t station = 1; station <= STATIONS; station++) {
+        polls[count++] = (sbus_poll_t){.request   = SBUS_REQUEST(station, SBUS_COMMAND_READ_FLAG, {31, 0, 0}),
+                                       .period_us = 200000};
+        polls[count++] = (sbus_poll_t){.request = SBUS_READ_REGISTERS_REQUEST(station, 0, 32), .period_us = 2000000};
+        polls[count++] = (sbus_poll_t){.request = SBUS_READ_REGISTERS_REQUEST(station, 100, 32), .period_us = 60000000};
+        polls[count++] = (sbus_poll_t){.request = SBUS_READ_REGISTERS_REQUEST(station, 132, 32), .period_us = 60000000};
+    }
+
+    return count;
+}
+
+
+/*
+ * Runs the bus for `duration_us`, every exchange taking exactly its planned cost.
+ */
+static uint64_t simulate(uint64_t duration_us) {
+    uint64_t now = 0;
+
+    while (now < duration_us) {
+        sbus_poll_t *poll = NULL;
+        uint64_t     wait = 0;
+
+        if (sbus_scheduler_next(&scheduler, now, &poll, &wait) == SBUS_NOT_FOUND) {
+            now += wait;
+        } else {
+            now += poll->cost_us;
+            sbus_scheduler_complete(&scheduler, poll, now, poll->cost_us);
+        }
+    }
+
+    return now;
+}
+
+
+void test_wire_model() {
+    sbus_wire_t    parity  = {.baud = 9600, .format = SBUS_WIRE_PARITY, .turnaround_us = 0};
+    sbus_wire_t    data    = {.baud = 9600, .format = SBUS_WIRE_DATA, .turnaround_us = 500};
+    sbus_request_t request = SBUS_READ_REGISTERS_REQUEST(1, 0, 2);
+
+    TEST_ASSERT_EQUAL(7, sbus_wire_request_characters(&parity, &request));
+    TEST_ASSERT_EQUAL(10, sbus_wire_response_characters(&parity, &request));
+    TEST_ASSERT_EQUAL(1146, sbus_wire_characters_us(&parity, 1));
+    TEST_ASSERT_EQUAL((17 * 11 * 1000000 + 9599) / 9600, sbus_wire_exchange_us(&parity, &request));
+    TEST_ASSERT_EQUAL((21 * 10 * 1000000 + 9599) / 9600 + 500, sbus_wire_exchange_us(&data, &request));
+
+    request.destination = SBUS_BROADCAST_ADDRESS;
+    TEST_ASSERT_EQUAL(0, sbus_wire_response_characters(&parity, &request));
+}
+
+
+void test_rates_fit() {
+    sbus_wire_t wire  = {.baud = 115200, .format = SBUS_WIRE_PARITY, .turnaround_us = 1000};
+    size_t      count = configure();
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_scheduler_init(&scheduler, &wire, polls, count, 0));
+    TEST_ASSERT_TRUE(scheduler.feasible);
+    TEST_ASSERT_LESS_THAN(700000, scheduler.planned_ppm);
+
+    uint64_t now      = simulate(120000000);
+    uint32_t measured = sbus_scheduler_measured_ppm(&scheduler, now);
+    TEST_ASSERT_EQUAL(0, scheduler.misses);
+    TEST_ASSERT_LESS_THAN(10000, measured > scheduler.planned_ppm ? measured - scheduler.planned_ppm
+                                                                   : scheduler.planned_ppm - measured);
+    TEST_ASSERT_EQUAL(600, polls[0].polls);
+    TEST_ASSERT_EQUAL(60, polls[1].polls);
+    TEST_ASSERT_EQUAL(2, polls[2].polls);
+}
+
+
+void test_rates_do_not_fit() {
+    sbus_wire_t wire  = {.baud = 9600, .format = SBUS_WIRE_PARITY, .turnaround_us = 1000};
+    size_t      count = configure();
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_scheduler_init(&scheduler, &wire, polls, count, 0));
+    TEST_ASSERT_FALSE(scheduler.feasible);
+    TEST_ASSERT_GREATER_THAN(1000000, scheduler.planned_ppm);
+
+    uint64_t now = simulate(10000000);
+    TEST_ASSERT_GREATER_THAN(0, scheduler.misses);
+    TEST_ASSERT_LESS_OR_EQUAL(1000000, sbus_scheduler_measured_ppm(&scheduler, now));
+
+    polls[0].period_us = 0;
+    TEST_ASSERT_EQUAL(SBUS_INVALID_ARGS, sbus_scheduler_init(&scheduler, &wire, polls, count, 0));
+}
+
+
+void test_late_poll() {
+    sbus_wire_t  wire = {.baud = 115200, .format = SBUS_WIRE_PARITY, .turnaround_us = 0};
+    sbus_poll_t *poll = NULL;
+    uint64_t     wait = 0;
+
+    polls[0] = (sbus_poll_t){.request = SBUS_READ_REGISTERS_REQUEST(1, 0, 1), .period_us = 200};
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_scheduler_init(&scheduler, &wire, polls, 1, 0));
+
+    // More than one period late: the periods that are over are missed, the current one is polled once
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_scheduler_next(&scheduler, 450, &poll, &wait));
+    TEST_ASSERT_TRUE(poll == &polls[0]);
+    TEST_ASSERT_EQUAL(600, poll->deadline_us);
+    TEST_ASSERT_EQUAL(2, scheduler.misses);
+
+    TEST_ASSERT_EQUAL(SBUS_NOT_FOUND, sbus_scheduler_next(&scheduler, 451, &poll, &wait));
+    TEST_ASSERT_EQUAL(149, wait);
+}
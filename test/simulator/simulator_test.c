@@ -0,0 +1,187 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sbus/packet.h"
+#include "sbus/simulator.h"
+#include "sbus/slave.h"
+#include "sbus/wire.h"
+#include "unity.h"
+
+#define STATIONS  30
+#define REGISTERS 64
+
+static sbus_slave_t       slaves[STATIONS];
+static sbus_sim_station_t stations[STATIONS];
+static uint32_t           registers[STATIONS][REGISTERS];
+static sbus_sim_t         sim;
+static uint16_t           response[256];
+
+void setUp() {}
+
+void tearDown() {}
+
+
+/*
+ * Stations 1 to STATIONS, answering after `turnaround_us`.
+ */
+static void populate(sbus_sim_t *target, uint32_t turnaround_us) {
+    memset(registers, 0, sizeof(registers));
+
+    for (size_t i = 0; i < STATIONS; i++) {
+        sbus_slave_init(&slaves[i], (uint8_t)(i + 1));
+        sbus_slave_set_media(&slaves[i], SBUS_MEDIA_REGISTER, registers[i], REGISTERS);
+        stations[i] = (sbus_sim_station_t){.slave = &slaves[i], .turnaround_us = turnaround_us};
+        TEST_ASSERT_EQUAL(SBUS_OK, sbus_sim_attach(target, &stations[i]));
+    }
+}
+
+
+static sbus_result_t exchange(sbus_sim_t *target, sbus_request_t request, uint32_t timeout_us) {
+    size_t len = sizeof(response) / sizeof(response[0]);
+    return sbus_sim_exchange(target, &request, timeout_us, response, &len);
+}
+
+
+void test_exchange_timing() {
+    sbus_wire_t wire = {.baud = 9600, .format = SBUS_WIRE_PARITY};
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_sim_init(&sim, &wire, 1));
+    populate(&sim, 500);
+    TEST_ASSERT_EQUAL(SBUS_INVALID_ARGS, sbus_sim_attach(&sim, &stations[0]));
+
+    sbus_request_t write = SBUS_WRITE_REGISTER_REQUEST(3, 10, 0x11223344);
+    TEST_ASSERT_EQUAL(SBUS_OK, exchange(&sim, write, 100000));
+    TEST_ASSERT_EQUAL_HEX32(0x11223344, registers[2][10]);
+    uint64_t expected = sbus_wire_characters_us(&wire, 11) + 500 + sbus_wire_characters_us(&wire, 2);
+    TEST_ASSERT_EQUAL(expected, sim.now_us);
+
+    sbus_request_t read = SBUS_READ_REGISTERS_REQUEST(3, 10, 1);
+    size_t         len  = sizeof(response) / sizeof(response[0]);
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_sim_exchange(&sim, &read, 100000, response, &len));
+    TEST_ASSERT_EQUAL(6, len);
+    TEST_ASSERT_EQUAL(0x11, response[0]);
+    TEST_ASSERT_EQUAL(0x44, response[3]);
+    expected += sbus_wire_characters_us(&wire, 7) + 500 + sbus_wire_characters_us(&wire, 6);
+    TEST_ASSERT_EQUAL(expected, sim.now_us);
+
+    // Broadcasts reach every station and are over once sent
+    write = SBUS_WRITE_REGISTER_REQUEST(SBUS_BROADCAST_ADDRESS, 0, 77);
+    TEST_ASSERT_EQUAL(SBUS_OK, exchange(&sim, write, 100000));
+    TEST_ASSERT_EQUAL(77, registers[0][0]);
+    TEST_ASSERT_EQUAL(77, registers[STATIONS - 1][0]);
+    expected += sbus_wire_characters_us(&wire, 11);
+    TEST_ASSERT_EQUAL(expected, sim.now_us);
+
+    TEST_ASSERT_EQUAL(3, sim.ok);
+    TEST_ASSERT_EQUAL(2, sim.latency.count);
+    TEST_ASSERT_GREATER_THAN(800000, sbus_sim_utilization_ppm(&sim));
+}
+
+
+void test_faults() {
+    sbus_wire_t wire = {.baud = 115200, .format = SBUS_WIRE_PARITY};
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_sim_init(&sim, &wire, 1));
+    populate(&sim, 1000);
+
+    // Unknown station
+    TEST_ASSERT_EQUAL(SBUS_TIMEOUT, exchange(&sim, SBUS_READ_REGISTERS_REQUEST(40, 0, 1), 20000));
+    TEST_ASSERT_EQUAL(20000, sim.now_us);
+
+    stations[0].drop_ppm = SBUS_SIM_PPM;
+    TEST_ASSERT_EQUAL(SBUS_TIMEOUT, exchange(&sim, SBUS_READ_REGISTERS_REQUEST(1, 0, 1), 20000));
+    TEST_ASSERT_EQUAL(40000, sim.now_us);
+    TEST_ASSERT_EQUAL(1, stations[0].requests);
+
+    stations[1].corrupt_ppm = SBUS_SIM_PPM;
+    TEST_ASSERT_EQUAL(SBUS_WRONG_CRC, exchange(&sim, SBUS_READ_REGISTERS_REQUEST(2, 0, 4), 20000));
+
+    // A damaged request never reaches the slave
+    sim.noise_ppm = SBUS_SIM_PPM;
+    TEST_ASSERT_EQUAL(SBUS_TIMEOUT, exchange(&sim, SBUS_READ_REGISTERS_REQUEST(3, 0, 1), 20000));
+    TEST_ASSERT_EQUAL(0, stations[2].requests);
+    sim.noise_ppm = 0;
+
+    // A late answer garbles the next request, then the line recovers
+    stations[3].turnaround_us = 30000;
+    TEST_ASSERT_EQUAL(SBUS_TIMEOUT, exchange(&sim, SBUS_READ_REGISTERS_REQUEST(4, 0, 1), 20000));
+    TEST_ASSERT_EQUAL(SBUS_TIMEOUT, exchange(&sim, SBUS_READ_REGISTERS_REQUEST(5, 0, 1), 20000));
+    TEST_ASSERT_EQUAL(1, sim.collisions);
+    TEST_ASSERT_EQUAL(0, stations[4].requests);
+    TEST_ASSERT_EQUAL(SBUS_OK, exchange(&sim, SBUS_READ_REGISTERS_REQUEST(5, 0, 1), 20000));
+
+    TEST_ASSERT_EQUAL(7, sim.exchanges);
+    TEST_ASSERT_EQUAL(5, sim.timeouts);
+    TEST_ASSERT_EQUAL(1, sim.wrong_crc);
+    TEST_ASSERT_EQUAL(1, sim.ok);
+}
+
+
+/*
+ * A mixed workload with jitter and faults, run twice from the same seed.
+ */
+static void run(sbus_sim_t *target, uint32_t seed) {
+    sbus_wire_t wire  = {.baud = 38400, .format = SBUS_WIRE_DATA};
+    uint32_t    state = 12345;
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_sim_init(target, &wire, seed));
+    populate(target, 800);
+    target->noise_ppm = 2000;
+    for (size_t i = 0; i < STATIONS; i++) {
+        stations[i].jitter_us   = 400;
+        stations[i].drop_ppm    = 5000;
+        stations[i].corrupt_ppm = 5000;
+    }
+
+    for (size_t i = 0; i < 5000; i++) {
+        state          = state * 1103515245 + 12345;
+        uint8_t  dest  = (uint8_t)(1 + (state >> 16) % STATIONS);
+        uint16_t start = (uint16_t)((state >> 8) % 32);
+
+        if (i % 4 == 0)
+            exchange(target, SBUS_WRITE_REGISTER_REQUEST(dest, start, i), 10000);
+        else
+            exchange(target, SBUS_READ_REGISTERS_REQUEST(dest, start, 32), 60000);
+    }
+}
+
+
+void test_deterministic() {
+    static sbus_sim_t other;
+
+    run(&sim, 99);
+    run(&other, 99);
+
+    TEST_ASSERT_EQUAL(5000, sim.exchanges);
+    TEST_ASSERT_EQUAL(sim.now_us, other.now_us);
+    TEST_ASSERT_EQUAL(sim.ok, other.ok);
+    TEST_ASSERT_EQUAL(sim.timeouts, other.timeouts);
+    TEST_ASSERT_EQUAL(sim.wrong_crc, other.wrong_crc);
+    TEST_ASSERT_EQUAL(sim.busy_us, other.busy_us);
+    TEST_ASSERT_GREATER_THAN(4800, sim.ok);
+    TEST_ASSERT_GREATER_THAN(0, sim.timeouts);
+    TEST_ASSERT_GREATER_THAN(0, sim.wrong_crc);
+    TEST_ASSERT_EQUAL(sim.exchanges, sim.ok + sim.timeouts + sim.wrong_crc + sim.invalid);
+
+    run(&other, 100);
+    TEST_ASSERT_NOT_EQUAL(sim.now_us, other.now_us);
+}
+
+
+void test_percentiles() {
+    sbus_sim_histogram_t histogram;
+
+    memset(&histogram, 0, sizeof(histogram));
+    TEST_ASSERT_EQUAL(0, sbus_sim_histogram_percentile(&histogram, 500));
+
+    for (uint64_t i = 1; i <= 10000; i++)
+        sbus_sim_histogram_add(&histogram, i);
+
+    uint64_t median = sbus_sim_histogram_percentile(&histogram, 500);
+    uint64_t p99    = sbus_sim_histogram_percentile(&histogram, 990);
+    TEST_ASSERT_GREATER_OR_EQUAL(5000, median);
+    TEST_ASSERT_LESS_OR_EQUAL(5000 * 9 / 8, median);
+    TEST_ASSERT_GREATER_OR_EQUAL(9900, p99);
+    TEST_ASSERT_EQUAL(10000, sbus_sim_histogram_percentile(&histogram, 1000));
+    TEST_ASSERT_EQUAL(1, sbus_sim_histogram_percentile(&histogram, 0));
+}
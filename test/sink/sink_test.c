@@ -0,0 +1,221 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sbus/packet.h"
+#include "sbus/sink.h"
+#include "sbus/slave.h"
+#include "unity.h"
+
+static sbus_sink_t sink;
+static uint8_t     bytes[64];
+static uint8_t     address_map[SBUS_ADDRESS_MAP_BYTES(64)];
+static uint16_t    words[64];
+
+void setUp() {
+    memset(bytes, 0, sizeof(bytes));
+    memset(address_map, 0xFF, sizeof(address_map));
+    memset(words, 0, sizeof(words));
+}
+
+void tearDown() {}
+
+
+/*
+ * Copies out the queued characters through the spans, as 9-bit words.
+ */
+static size_t drain(uint16_t *out) {
+    sbus_span_t spans[2];
+    size_t      total = 0;
+    size_t      num   = sbus_sink_spans(&sink, spans);
+
+    for (size_t i = 0; i < num; i++) {
+        for (size_t j = 0; j < spans[i].len; j++) {
+            if (sink.format == SBUS_SINK_9BIT) {
+                out[total++] = ((const uint16_t *)spans[i].data)[j];
+            } else {
+                size_t position = (size_t)((const uint8_t *)spans[i].data - sink.bytes) + j;
+                out[total++]    = (uint16_t)(sink.bytes[position] |
+                                          (SBUS_ADDRESS_MAP_GET(sink.address_map, position) ? 0x100 : 0));
+            }
+        }
+    }
+
+    sbus_sink_consume(&sink, total);
+    return total;
+}
+
+
+static sbus_request_t write_request(void) {
+    sbus_request_t request = {.destination = 7, .command = SBUS_COMMAND_WRITE_REGISTER, .data_len = 11};
+
+    request.data[0] = 9;
+    request.data[1] = 0;
+    request.data[2] = 3;
+    for (size_t i = 3; i < request.data_len; i++)
+        request.data[i] = (uint8_t)(0xA0 + i);
+    return request;
+}
+
+
+void test_request() {
+    sbus_request_t request = write_request();
+    uint16_t       expected[64];
+    uint16_t       out[64];
+    size_t         len = sbus_packet_serialize_request(expected, &request);
+
+    sbus_sink_init_9bit(&sink, words, 64);
+    TEST_ASSERT_EQUAL(len, sbus_sink_serialize_request(&sink, &request));
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(expected, words, len);
+
+    sbus_sink_init_8bit(&sink, bytes, address_map, 64);
+    TEST_ASSERT_EQUAL(len, sbus_sink_serialize_request(&sink, &request));
+    TEST_ASSERT_EQUAL(len, drain(out));
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(expected, out, len);
+    TEST_ASSERT_EQUAL(0, sbus_sink_spans(&sink, NULL));
+}
+
+
+void test_responses() {
+    uint32_t       values[3] = {0x01020304, 0xCAFEBABE, 0x7F};
+    uint8_t        bits[4]   = {0xA5, 0x3C, 0xFF, 0x01};
+    uint8_t        raw[6]    = {1, 2, 3, 4, 5, 6};
+    sbus_request_t request   = SBUS_READ_REGISTERS_REQUEST(7, 0, 3);
+    uint16_t       expected[64];
+    uint16_t       out[64];
+    int            len;
+
+    sbus_sink_init_8bit(&sink, bytes, address_map, 64);
+
+    len = sbus_packet_serialize_values_response(expected, 64, values, 3);
+    TEST_ASSERT_EQUAL(len, sbus_sink_serialize_values_response(&sink, values, 3));
+    TEST_ASSERT_EQUAL(len, drain(out));
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(expected, out, len);
+
+    len = sbus_packet_serialize_bits_response(expected, 64, bits, 5, 13);
+    TEST_ASSERT_EQUAL(len, sbus_sink_serialize_bits_response(&sink, bits, 5, 13));
+    TEST_ASSERT_EQUAL(len, drain(out));
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(expected, out, len);
+
+    len = sbus_packet_serialize_bytes_response(expected, 64, raw, sizeof(raw));
+    TEST_ASSERT_EQUAL(len, sbus_sink_serialize_bytes_response(&sink, raw, sizeof(raw)));
+    TEST_ASSERT_EQUAL(len, drain(out));
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(expected, out, len);
+
+    len = sbus_packet_serialize_ack_response(expected, 64, SBUS_NAK);
+    TEST_ASSERT_EQUAL(len, sbus_sink_serialize_ack_response(&sink, SBUS_NAK));
+    TEST_ASSERT_EQUAL(len, drain(out));
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(expected, out, len);
+
+    len = sbus_packet_serialize_register_read_response(expected, 64, values, 3, &request);
+    TEST_ASSERT_EQUAL(len, sbus_sink_serialize_register_read_response(&sink, values, 3, &request));
+    TEST_ASSERT_EQUAL(len, drain(out));
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(expected, out, len);
+
+    request.command = SBUS_COMMAND_READ_TIMER;
+    TEST_ASSERT_EQUAL(-1, sbus_sink_serialize_register_read_response(&sink, values, 3, &request));
+    TEST_ASSERT_EQUAL(0, sink.count);
+}
+
+
+void test_wraparound() {
+    sbus_request_t request = write_request();
+    uint16_t       expected[64];
+    uint16_t       out[64];
+    size_t         len = sbus_packet_serialize_request(expected, &request);
+    sbus_span_t    spans[2];
+    const uint8_t *run;
+    int            address;
+
+    // Leaves the second frame straddling the end of a 20 character ring
+    sbus_sink_init_8bit(&sink, bytes, address_map, 20);
+    TEST_ASSERT_EQUAL(len, sbus_sink_serialize_request(&sink, &request));
+    sbus_sink_consume(&sink, 12);
+    TEST_ASSERT_EQUAL(len, sbus_sink_serialize_request(&sink, &request));
+    TEST_ASSERT_EQUAL(2 * len - 12, sink.count);
+
+    TEST_ASSERT_EQUAL(2, sbus_sink_spans(&sink, spans));
+    TEST_ASSERT_EQUAL(8, spans[0].len);
+    TEST_ASSERT_EQUAL(2 * len - 12 - 8, spans[1].len);
+
+    // Parity mode runs: the rest of the first frame, its address character alone, then the data up to the wrap
+    TEST_ASSERT_EQUAL(len - 12, sbus_sink_run(&sink, &run, &address));
+    TEST_ASSERT_EQUAL(0, address);
+    sbus_sink_consume(&sink, len - 12);
+    TEST_ASSERT_EQUAL(1, sbus_sink_run(&sink, &run, &address));
+    TEST_ASSERT_EQUAL(1, address);
+    TEST_ASSERT_EQUAL(7, run[0]);
+    sbus_sink_consume(&sink, 1);
+    TEST_ASSERT_EQUAL(20 - len - 1, sbus_sink_run(&sink, &run, &address));
+    TEST_ASSERT_EQUAL(0, address);
+
+    TEST_ASSERT_EQUAL(len - 1, drain(out));
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(&expected[1], out, len - 1);
+
+    // Values ending right at the end of the ring, then straddling it
+    uint32_t values[4] = {0x01020304, 0x05060708, 0x090A0B0C, 0x0D0E0F10};
+    uint8_t  filler[4] = {0};
+    for (size_t i = 0; i < 2; i++) {
+        int res = sbus_packet_serialize_values_response(expected, 64, values, 4);
+        sbus_sink_init_8bit(&sink, bytes, address_map, 20);
+        sbus_sink_consume(&sink, (size_t)sbus_sink_serialize_bytes_response(&sink, filler, 2 + i * 2));
+        TEST_ASSERT_EQUAL(res, sbus_sink_serialize_values_response(&sink, values, 4));
+        TEST_ASSERT_EQUAL(res, drain(out));
+        TEST_ASSERT_EQUAL_UINT16_ARRAY(expected, out, res);
+    }
+}
+
+
+void test_overflow() {
+    sbus_request_t request = write_request();
+    uint16_t       expected[64];
+    uint16_t       out[64];
+    size_t         len = sbus_packet_serialize_request(expected, &request);
+
+    sbus_sink_init_9bit(&sink, words, 2 * len - 1);
+    TEST_ASSERT_EQUAL(len, sbus_sink_serialize_request(&sink, &request));
+    TEST_ASSERT_EQUAL(-1, sbus_sink_serialize_request(&sink, &request));
+    TEST_ASSERT_EQUAL(len, sink.count);
+
+    // Segments outside of a frame, or of a frame that was not committed, are never queued
+    sbus_sink_bytes(&sink, bytes, 0);
+    TEST_ASSERT_EQUAL(-1, sbus_sink_commit(&sink));
+    sbus_sink_begin(&sink);
+    sbus_sink_address(&sink, 1);
+    TEST_ASSERT_EQUAL(len, sink.count);
+
+    TEST_ASSERT_EQUAL(len, drain(out));
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(expected, out, len);
+    TEST_ASSERT_EQUAL(len, sbus_sink_serialize_request(&sink, &request));
+
+    sbus_sink_init_9bit(&sink, NULL, 0);
+    TEST_ASSERT_EQUAL(-1, sbus_sink_serialize_ack_response(&sink, SBUS_ACK));
+}
+
+
+void test_slave() {
+    sbus_slave_t   slave;
+    uint32_t       registers[16];
+    uint16_t       expected[64];
+    uint16_t       out[64];
+    sbus_request_t request = SBUS_READ_REGISTERS_REQUEST(3, 4, 5);
+
+    for (size_t i = 0; i < 16; i++)
+        registers[i] = 0x11111111 * (uint32_t)i;
+    sbus_slave_init(&slave, 3);
+    sbus_slave_set_media(&slave, SBUS_MEDIA_REGISTER, registers, 16);
+
+    int len = sbus_slave_handle_request(&slave, &request, expected, 64);
+    TEST_ASSERT_EQUAL(5 * 4 + 2, len);
+
+    sbus_sink_init_8bit(&sink, bytes, NULL, 64);
+    TEST_ASSERT_EQUAL(len, sbus_slave_respond(&slave, &request, &sink));
+    for (int i = 0; i < len; i++)
+        out[i] = bytes[i];
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(expected, out, len);
+    sbus_sink_consume(&sink, (size_t)len);
+
+    sbus_request_t broadcast = SBUS_WRITE_REGISTER_REQUEST(SBUS_BROADCAST_ADDRESS, 1, 0xCAFE);
+    TEST_ASSERT_EQUAL(0, sbus_slave_respond(&slave, &broadcast, &sink));
+    TEST_ASSERT_EQUAL(0xCAFE, registers[1]);
+    TEST_ASSERT_EQUAL(0, sink.count);
+}
@@ -0,0 +1,141 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "sbus/packet.h"
+#include "sbus/slave.h"
+#include "unity.h"
+
+static sbus_slave_t slave;
+static uint32_t     registers[64];
+static uint32_t     timers[8];
+static uint8_t      flags[SBUS_FIO_BYTES(256)];
+static size_t       written_count;
+
+static void written(sbus_slave_t *slave, sbus_media_type_t media, uint16_t address, size_t count) {
+    (void)slave;
+    (void)media;
+    (void)address;
+    written_count += count;
+}
+
+static int read_clock(sbus_slave_t *slave, uint8_t *clock) {
+    (void)slave;
+    for (size_t i = 0; i < SBUS_CLOCK_SIZE; i++)
+        clock[i] = (uint8_t)(0x10 + i);
+    return 0;
+}
+
+void setUp() {
+    memset(registers, 0, sizeof(registers));
+    memset(flags, 0, sizeof(flags));
+    written_count = 0;
+
+    sbus_slave_init(&slave, 10);
+    sbus_slave_set_media(&slave, SBUS_MEDIA_REGISTER, registers, 64);
+    sbus_slave_set_media(&slave, SBUS_MEDIA_TIMER, timers, 8);
+    sbus_slave_set_media(&slave, SBUS_MEDIA_FLAG, flags, 256);
+    slave.written    = written;
+    slave.read_clock = read_clock;
+}
+
+void tearDown() {}
+
+
+static sbus_result_t exchange(sbus_request_t *request, uint16_t *response, size_t *len) {
+    int res = sbus_slave_handle_request(&slave, request, response, 256);
+    TEST_ASSERT_GREATER_THAN(0, res);
+    *len = (size_t)res;
+    return sbus_packet_validate_response_9bit(request, response, len);
+}
+
+
+void test_registers() {
+    uint16_t       response[256];
+    size_t         len     = 0;
+    sbus_request_t request = SBUS_WRITE_REGISTER_REQUEST(10, 5, 0xCAFEBABE);
+
+    TEST_ASSERT_EQUAL(SBUS_OK, exchange(&request, response, &len));
+    TEST_ASSERT_EQUAL(SBUS_ACK, response[0]);
+    TEST_ASSERT_EQUAL(0xCAFEBABE, registers[5]);
+    TEST_ASSERT_EQUAL(1, written_count);
+
+    registers[6] = 42;
+    request      = SBUS_READ_REGISTERS_REQUEST(10, 5, 2);
+    TEST_ASSERT_EQUAL(SBUS_OK, exchange(&request, response, &len));
+    TEST_ASSERT_EQUAL(2 * 4 + 2, len);
+    TEST_ASSERT_EQUAL(0xCA, response[0]);
+    TEST_ASSERT_EQUAL(0xBE, response[3]);
+    TEST_ASSERT_EQUAL(42, response[7]);
+}
+
+
+void test_out_of_range() {
+    uint16_t       response[256];
+    sbus_request_t request = SBUS_WRITE_REGISTER_REQUEST(10, 64, 1);
+
+    TEST_ASSERT_EQUAL(2, sbus_slave_handle_request(&slave, &request, response, 256));
+    TEST_ASSERT_EQUAL(SBUS_NAK, response[0]);
+
+    request = SBUS_READ_REGISTERS_REQUEST(10, 60, 8);
+    TEST_ASSERT_EQUAL(2, sbus_slave_handle_request(&slave, &request, response, 256));
+    TEST_ASSERT_EQUAL(SBUS_NAK, response[0]);
+
+    request = SBUS_REQUEST(10, SBUS_COMMAND_READ_COUNTER, {0, 0, 0});
+    TEST_ASSERT_EQUAL(2, sbus_slave_handle_request(&slave, &request, response, 256));
+    TEST_ASSERT_EQUAL(SBUS_NAK, response[0]);
+
+    request = SBUS_READ_REGISTERS_REQUEST(10, 0, 32);
+    TEST_ASSERT_EQUAL(-1, sbus_slave_handle_request(&slave, &request, response, 16));
+}
+
+
+void test_flags() {
+    uint16_t response[256];
+    size_t   len = 0;
+    // Write 10 flags starting at 200: 1010000011
+    sbus_request_t request = SBUS_REQUEST(10, SBUS_COMMAND_WRITE_FLAG, {4, 0, 200, 9, 0x05, 0x03});
+
+    TEST_ASSERT_EQUAL(SBUS_OK, exchange(&request, response, &len));
+    TEST_ASSERT_EQUAL(SBUS_ACK, response[0]);
+    TEST_ASSERT_EQUAL(0x05, flags[25]);
+    TEST_ASSERT_EQUAL(0x03, flags[26]);
+
+    request = SBUS_REQUEST(10, SBUS_COMMAND_READ_FLAG, {9, 0, 202});
+    TEST_ASSERT_EQUAL(SBUS_OK, exchange(&request, response, &len));
+    TEST_ASSERT_EQUAL(2 + 2, len);
+    TEST_ASSERT_EQUAL(0xC1, response[0]);
+    TEST_ASSERT_EQUAL(0x00, response[1]);
+}
+
+
+void test_misc_commands() {
+    uint16_t       response[256];
+    size_t         len     = 0;
+    sbus_request_t request = SBUS_REQUEST(10, SBUS_COMMAND_READ_STATION_NUMBER, {});
+
+    TEST_ASSERT_EQUAL(SBUS_OK, exchange(&request, response, &len));
+    TEST_ASSERT_EQUAL(10, response[0]);
+
+    request = SBUS_REQUEST(10, SBUS_COMMAND_READ_PCD_STATUS_SELF, {});
+    TEST_ASSERT_EQUAL(SBUS_OK, exchange(&request, response, &len));
+    TEST_ASSERT_EQUAL(SBUS_PCD_STATUS_RUN, response[0]);
+
+    request = SBUS_REQUEST(10, SBUS_COMMAND_READ_REAL_TIME_CLOCK, {});
+    TEST_ASSERT_EQUAL(SBUS_OK, exchange(&request, response, &len));
+    TEST_ASSERT_EQUAL(0x15, response[5]);
+
+    request = SBUS_REQUEST(10, SBUS_COMMAND_WRITE_REAL_TIME_CLOCK, {0, 0, 0, 0, 0, 0});
+    TEST_ASSERT_EQUAL(SBUS_OK, exchange(&request, response, &len));
+    TEST_ASSERT_EQUAL(SBUS_NAK, response[0]);
+}
+
+
+void test_addressing() {
+    uint16_t       response[256];
+    sbus_request_t request = SBUS_WRITE_REGISTER_REQUEST(11, 1, 1);
+    TEST_ASSERT_EQUAL(0, sbus_slave_handle_request(&slave, &request, response, 256));
+    TEST_ASSERT_EQUAL(0, registers[1]);
+
+    request = SBUS_WRITE_REGISTER_REQUEST(SBUS_BROADCAST_ADDRESS, 1, 7);
+    TEST_ASSERT_EQUAL(0, sbus_slave_handle_request(&slave, &request, response, 256));
+    TEST_ASSERT_EQUAL(7, registers[1]);
+}
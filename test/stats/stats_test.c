@@ -0,0 +1,116 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "sbus/packet.h"
+#include "sbus/parser.h"
+#include "sbus/stats.h"
+#include "unity.h"
+
+#define THREADS 4
+#define RECORDS 10000
+
+static sbus_latency_table_t     table;
+static sbus_latency_histogram_t histograms[16];
+
+void setUp() {
+    sbus_stats_reset();
+    sbus_latency_table_init(&table, histograms, 16);
+}
+
+void tearDown() {}
+
+
+void test_parse_counters() {
+    uint16_t       buffer[64] = {0x11, 0x22, 0x33};
+    sbus_request_t request    = SBUS_READ_REGISTERS_REQUEST(4, 0, 2);
+    size_t         total      = 3 + sbus_packet_serialize_request(&buffer[3], &request);
+
+    sbus_request_t parsed;
+    size_t         len = total;
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_packet_parse_request(buffer, &len, &parsed));
+
+    buffer[total - 1] ^= 1;
+    len = total;
+    TEST_ASSERT_EQUAL(SBUS_WRONG_CRC, sbus_packet_parse_request(buffer, &len, &parsed));
+
+    len = 3;
+    TEST_ASSERT_EQUAL(SBUS_NOT_FOUND, sbus_packet_parse_request(buffer, &len, &parsed));
+
+    sbus_stats_snapshot_t snapshot;
+    sbus_stats_snapshot(&snapshot);
+    TEST_ASSERT_EQUAL(1, snapshot.frames[SBUS_COMMAND_READ_REGISTER]);
+    TEST_ASSERT_EQUAL(1, snapshot.wrong_crc);
+    TEST_ASSERT_EQUAL(1, snapshot.not_found);
+    TEST_ASSERT_EQUAL(3 + 3 + 3, snapshot.discarded);
+
+    // The byte-at-a-time parser reports to the same counters
+    sbus_parser_t parser;
+    sbus_parser_init(&parser);
+    len = total;
+    TEST_ASSERT_EQUAL(SBUS_WRONG_CRC, sbus_parser_feed(&parser, buffer, &len));
+    sbus_stats_snapshot(&snapshot);
+    TEST_ASSERT_EQUAL(2, snapshot.wrong_crc);
+    TEST_ASSERT_EQUAL(12, snapshot.discarded);
+}
+
+
+void test_validate_counters() {
+    sbus_request_t request = SBUS_READ_REGISTERS_REQUEST(4, 0, 1);
+    uint8_t        data[]  = {0x00, 0x00, 0x00, 0x01, 0x00, 0x00};
+    size_t         len     = sizeof(data);
+
+    TEST_ASSERT_EQUAL(SBUS_WRONG_CRC, sbus_packet_validate_response_8bit(&request, data, &len));
+
+    sbus_stats_snapshot_t snapshot;
+    sbus_stats_snapshot(&snapshot);
+    TEST_ASSERT_EQUAL(1, snapshot.wrong_crc);
+    TEST_ASSERT_EQUAL(0, snapshot.frames[SBUS_COMMAND_READ_REGISTER]);
+}
+
+
+void test_latency_histogram() {
+    sbus_latency_snapshot_t snapshot;
+
+    TEST_ASSERT_EQUAL(-1, sbus_latency_snapshot(&table, 3, SBUS_COMMAND_READ_FLAG, &snapshot));
+
+    sbus_latency_record(&table, 3, SBUS_COMMAND_READ_FLAG, 1);
+    sbus_latency_record(&table, 3, SBUS_COMMAND_READ_FLAG, 1500);
+    sbus_latency_record(&table, 3, SBUS_COMMAND_READ_FLAG, 1800);
+    sbus_latency_record(&table, 4, SBUS_COMMAND_READ_FLAG, 50);
+
+    TEST_ASSERT_EQUAL(0, sbus_latency_snapshot(&table, 3, SBUS_COMMAND_READ_FLAG, &snapshot));
+    TEST_ASSERT_EQUAL(3, snapshot.count);
+    TEST_ASSERT_EQUAL(3301, snapshot.total_us);
+    TEST_ASSERT_EQUAL(1800, snapshot.max_us);
+    TEST_ASSERT_EQUAL(1, snapshot.buckets[0]);
+    TEST_ASSERT_EQUAL(2, snapshot.buckets[10]);
+
+    TEST_ASSERT_EQUAL(0, sbus_latency_snapshot(&table, 4, SBUS_COMMAND_READ_FLAG, &snapshot));
+    TEST_ASSERT_EQUAL(1, snapshot.buckets[5]);
+}
+
+
+static void *record(void *arg) {
+    uint8_t station = (uint8_t)(uintptr_t)arg;
+    for (unsigned long i = 0; i < RECORDS; i++) {
+        sbus_latency_record(&table, station % 2, SBUS_COMMAND_READ_REGISTER, i % 100);
+    }
+    return NULL;
+}
+
+
+void test_concurrent_recording() {
+    pthread_t threads[THREADS];
+
+    for (uintptr_t i = 0; i < THREADS; i++)
+        TEST_ASSERT_EQUAL(0, pthread_create(&threads[i], NULL, record, (void *)i));
+    for (size_t i = 0; i < THREADS; i++)
+        pthread_join(threads[i], NULL);
+
+    sbus_latency_snapshot_t snapshot;
+    for (uint8_t station = 0; station < 2; station++) {
+        TEST_ASSERT_EQUAL(0, sbus_latency_snapshot(&table, station, SBUS_COMMAND_READ_REGISTER, &snapshot));
+        TEST_ASSERT_EQUAL(RECORDS * THREADS / 2, snapshot.count);
+        TEST_ASSERT_EQUAL(99, snapshot.max_us);
+    }
+}
@@ -0,0 +1,72 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "sbus/packet.h"
+#include "sbus/timing.h"
+#include "sbus/wire.h"
+#include "unity.h"
+
+static sbus_station_timing_t stations[SBUS_TIMING_STATIONS];
+static sbus_timing_t         timing;
+
+void setUp() {
+    sbus_wire_t wire = {.baud = 115200, .format = SBUS_WIRE_PARITY};
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_timing_init(&timing, &wire, stations));
+}
+
+void tearDown() {}
+
+
+void test_learned_turnaround() {
+    sbus_request_t request = SBUS_READ_REGISTERS_REQUEST(4, 0, 32);
+    uint32_t       minimum = sbus_timing_min_response_us(&timing, &request);
+
+    TEST_ASSERT_EQUAL((7 + 130) * 11 * 1000000 / 115200 + 1, minimum);
+    TEST_ASSERT_EQUAL(minimum + timing.initial_us, sbus_timing_timeout_us(&timing, &request));
+
+    // A station answering in about 3 ms gets a timeout close to that
+    for (size_t i = 0; i < 32; i++)
+        sbus_timing_sample(&timing, &request, minimum + 3000 + (i % 2) * 200);
+    uint32_t timeout = sbus_timing_timeout_us(&timing, &request);
+    TEST_ASSERT_GREATER_THAN(minimum + 3000, timeout);
+    TEST_ASSERT_LESS_THAN(minimum + 4000, timeout);
+
+    // Never below the minimum allowance
+    for (size_t i = 0; i < 32; i++)
+        sbus_timing_sample(&timing, &request, minimum);
+    TEST_ASSERT_EQUAL(minimum + timing.min_us, sbus_timing_timeout_us(&timing, &request));
+
+    // Data mode waits for a fully stuffed response
+    timing.wire.format = SBUS_WIRE_DATA;
+    TEST_ASSERT_EQUAL(2 * sbus_timing_min_response_us(&timing, &request) + timing.min_us,
+                      sbus_timing_timeout_us(&timing, &request));
+}
+
+
+void test_offline_backoff() {
+    sbus_request_t request = SBUS_READ_REGISTERS_REQUEST(4, 0, 1);
+    uint32_t       minimum = sbus_timing_min_response_us(&timing, &request);
+
+    sbus_timing_timeout(&timing, 4, 0);
+    sbus_timing_timeout(&timing, 4, 0);
+    TEST_ASSERT_FALSE(sbus_timing_offline(&timing, 4, 0));
+    TEST_ASSERT_EQUAL(minimum + timing.initial_us * 4, sbus_timing_timeout_us(&timing, &request));
+
+    sbus_timing_timeout(&timing, 4, 1000);
+    TEST_ASSERT_TRUE(sbus_timing_offline(&timing, 4, 1000));
+    TEST_ASSERT_FALSE(sbus_timing_offline(&timing, 4, 1000 + timing.backoff_min_us));
+    TEST_ASSERT_FALSE(sbus_timing_offline(&timing, 5, 1000));
+    TEST_ASSERT_EQUAL(minimum + timing.max_us, sbus_timing_timeout_us(&timing, &request));
+
+    // The probe fails again: twice the wait, up to the maximum
+    sbus_timing_timeout(&timing, 4, 2000000);
+    TEST_ASSERT_TRUE(sbus_timing_offline(&timing, 4, 2000000 + 2 * timing.backoff_min_us - 1));
+    TEST_ASSERT_FALSE(sbus_timing_offline(&timing, 4, 2000000 + 2 * timing.backoff_min_us));
+    for (size_t i = 0; i < 20; i++)
+        sbus_timing_timeout(&timing, 4, 0);
+    TEST_ASSERT_FALSE(sbus_timing_offline(&timing, 4, timing.backoff_max_us));
+
+    // Back online at the first answer
+    sbus_timing_sample(&timing, &request, minimum + 5000);
+    TEST_ASSERT_FALSE(sbus_timing_offline(&timing, 4, 0));
+    TEST_ASSERT_EQUAL(0, stations[4].failures);
+}
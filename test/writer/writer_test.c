@@ -0,0 +1,161 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "sbus/packet.h"
+#include "sbus/slave.h"
+#include "sbus/writer.h"
+#include "unity.h"
+
+typedef struct {
+    uint16_t      address;
+    uint32_t      value;
+    sbus_result_t result;
+} report_t;
+
+static sbus_slave_t       slave;
+static uint32_t           registers[64];
+static uint8_t            flags[SBUS_FIO_BYTES(256)];
+static sbus_writer_t      writer;
+static sbus_write_entry_t entries[128];
+static report_t           reports[128];
+static size_t             num_reports;
+
+
+static void report(sbus_writer_t *writer, uint8_t station, sbus_media_type_t media, uint16_t address, uint32_t value,
+                   sbus_result_t result) {
+    (void)writer;
+    (void)media;
+    TEST_ASSERT_EQUAL(7, station);
+    reports[num_reports++] = (report_t){.address = address, .value = value, .result = result};
+}
+
+
+void setUp() {
+    memset(registers, 0, sizeof(registers));
+    memset(flags, 0, sizeof(flags));
+    num_reports = 0;
+
+    sbus_slave_init(&slave, 7);
+    sbus_slave_set_media(&slave, SBUS_MEDIA_REGISTER, registers, 64);
+    sbus_slave_set_media(&slave, SBUS_MEDIA_FLAG, flags, 256);
+
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_writer_init(&writer, entries, 128, 100));
+    writer.report = report;
+}
+
+void tearDown() {}
+
+
+/*
+ * Sends every due frame to the slave, returning the number of frames.
+ */
+static size_t flush(uint32_t now, int force) {
+    sbus_write_frame_t frame;
+    sbus_request_t     request;
+    size_t             frames = 0;
+
+    while (sbus_writer_next(&writer, now, force, &frame, &request) == SBUS_OK) {
+        uint16_t words[256];
+        size_t   len = sbus_packet_serialize_request(words, &request);
+        TEST_ASSERT_EQUAL(SBUS_OK, sbus_packet_parse_request(words, &len, &request));
+
+        uint16_t response[256];
+        TEST_ASSERT_EQUAL(2, sbus_slave_handle_request(&slave, &request, response, 256));
+        sbus_writer_complete(&writer, &frame, SBUS_OK, (uint8_t)response[0]);
+        frames++;
+    }
+
+    return frames;
+}
+
+
+void test_coalescing() {
+    for (uint16_t i = 10; i < 50; i++)
+        TEST_ASSERT_EQUAL(SBUS_OK, sbus_writer_set(&writer, 7, SBUS_MEDIA_REGISTER, i, 1000u + i, 0));
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_writer_set(&writer, 7, SBUS_MEDIA_REGISTER, 60, 1, 20));
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_writer_set(&writer, 7, SBUS_MEDIA_REGISTER, 60, 2, 30));     // Latest wins
+    for (uint16_t i = 0; i < 10; i++)
+        TEST_ASSERT_EQUAL(SBUS_OK, sbus_writer_set(&writer, 7, SBUS_MEDIA_FLAG, 100 + i, i % 2, 40));
+    TEST_ASSERT_EQUAL(SBUS_INVALID_ARGS, sbus_writer_set(&writer, 7, SBUS_MEDIA_INPUT, 0, 1, 40));
+    TEST_ASSERT_EQUAL(51, sbus_writer_pending(&writer));
+
+    TEST_ASSERT_EQUAL(0, flush(99, 0));
+    // 32 + 8 registers, the lone one and the flags
+    TEST_ASSERT_EQUAL(4, flush(100, 0));
+    TEST_ASSERT_EQUAL(0, sbus_writer_pending(&writer));
+    TEST_ASSERT_EQUAL(4, writer.frames);
+    TEST_ASSERT_EQUAL(51, writer.values);
+    TEST_ASSERT_EQUAL(51, num_reports);
+
+    for (uint16_t i = 10; i < 50; i++)
+        TEST_ASSERT_EQUAL(1000u + i, registers[i]);
+    TEST_ASSERT_EQUAL(2, registers[60]);
+    for (size_t i = 100; i < 110; i++)
+        TEST_ASSERT_EQUAL(i % 2, (flags[SBUS_FIO_BYTE(i)] & SBUS_FIO_MASK(i)) != 0);
+    for (size_t i = 0; i < num_reports; i++)
+        TEST_ASSERT_EQUAL(SBUS_OK, reports[i].result);
+
+    // An explicit flush does not wait
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_writer_set(&writer, 7, SBUS_MEDIA_REGISTER, 0, 5, 200));
+    TEST_ASSERT_EQUAL(0, flush(200, 0));
+    TEST_ASSERT_EQUAL(1, flush(200, 1));
+    TEST_ASSERT_EQUAL(5, registers[0]);
+}
+
+
+void test_refused_values() {
+    sbus_write_frame_t frame;
+    sbus_request_t     request;
+
+    // 64 and 65 do not exist: the frame is refused, then the values are tried one by one
+    for (uint16_t i = 62; i < 66; i++)
+        TEST_ASSERT_EQUAL(SBUS_OK, sbus_writer_set(&writer, 7, SBUS_MEDIA_REGISTER, i, i, 0));
+    TEST_ASSERT_EQUAL(5, flush(0, 1));
+
+    TEST_ASSERT_EQUAL(4, num_reports);
+    for (size_t i = 0; i < num_reports; i++)
+        TEST_ASSERT_EQUAL(reports[i].address < 64 ? SBUS_OK : SBUS_INVALID_DATA, reports[i].result);
+    TEST_ASSERT_EQUAL(62, registers[62]);
+    TEST_ASSERT_EQUAL(63, registers[63]);
+
+    // A value set while the previous one is in flight is written afterwards
+    num_reports = 0;
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_writer_set(&writer, 7, SBUS_MEDIA_REGISTER, 1, 10, 0));
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_writer_next(&writer, 0, 1, &frame, &request));
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_writer_set(&writer, 7, SBUS_MEDIA_REGISTER, 1, 11, 0));
+    TEST_ASSERT_EQUAL(1, sbus_writer_pending(&writer));
+    sbus_writer_complete(&writer, &frame, SBUS_TIMEOUT, 0);
+    TEST_ASSERT_EQUAL(1, num_reports);
+    TEST_ASSERT_EQUAL(SBUS_TIMEOUT, reports[0].result);
+    TEST_ASSERT_EQUAL(10, reports[0].value);
+
+    TEST_ASSERT_EQUAL(1, flush(0, 1));
+    TEST_ASSERT_EQUAL(11, registers[1]);
+
+    // Values replaced while their frame is refused are reported too: every value set gets exactly one report
+    num_reports = 0;
+    for (uint16_t i = 62; i < 66; i++)
+        TEST_ASSERT_EQUAL(SBUS_OK, sbus_writer_set(&writer, 7, SBUS_MEDIA_REGISTER, i, i, 0));
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_writer_next(&writer, 0, 1, &frame, &request));
+    TEST_ASSERT_EQUAL(4, frame.count);
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_writer_set(&writer, 7, SBUS_MEDIA_REGISTER, 63, 163, 0));
+    TEST_ASSERT_EQUAL(SBUS_OK, sbus_writer_set(&writer, 7, SBUS_MEDIA_REGISTER, 64, 164, 0));
+    sbus_writer_complete(&writer, &frame, SBUS_OK, SBUS_NAK);
+    TEST_ASSERT_EQUAL(4, flush(0, 1));
+    TEST_ASSERT_EQUAL(0, sbus_writer_pending(&writer));
+
+    uint32_t      values[6]   = {62, 63, 163, 64, 164, 65};
+    sbus_result_t expected[6] = {SBUS_OK, SBUS_INVALID_DATA, SBUS_OK, SBUS_INVALID_DATA, SBUS_INVALID_DATA,
+                                 SBUS_INVALID_DATA};
+    TEST_ASSERT_EQUAL(6, num_reports);
+    for (size_t i = 0; i < 6; i++) {
+        size_t found = 0;
+        for (size_t j = 0; j < num_reports; j++) {
+            if (reports[j].value == values[i]) {
+                TEST_ASSERT_EQUAL(expected[i], reports[j].result);
+                found++;
+            }
+        }
+        TEST_ASSERT_EQUAL(1, found);
+    }
+    TEST_ASSERT_EQUAL(163, registers[63]);
+}
@@ -0,0 +1,168 @@
+/*
+ * Offline decoder for traffic captures (see sbus/capture.h). Every request is parsed again and every response
+ * validated against the request before it, exactly like the live master does:
+ *
+ *     capture_decode [-x] <capture file>
+ *
+ * `-x` adds a hex dump of the captured characters.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sbus/capture.h"
+#include "sbus/display.h"
+#include "sbus/packet.h"
+#include "sbus/posix/capture_file.h"
+
+
+static void decode_request(const sbus_capture_record_t *record, sbus_request_t *request, int *valid);
+static void decode_response(const sbus_capture_record_t *record, sbus_request_t *request, int valid);
+static void dump(const sbus_capture_record_t *record);
+static const char *result_name(int result);
+
+
+int main(int argc, char *argv[]) {
+    int         hex  = argc > 2 && strcmp(argv[1], "-x") == 0;
+    const char *path = argv[argc - 1];
+
+    if (argc < 2 || (argc > 2 && !hex)) {
+        fprintf(stderr, "usage: %s [-x] <capture file>\n", argv[0]);
+        return 1;
+    }
+
+    sbus_capture_file_t file;
+    if (sbus_capture_file_open(&file, path) < 0) {
+        perror(path);
+        return 1;
+    }
+
+    sbus_capture_t *capture = &file.capture;
+    printf("# %lu records captured, %lu overwritten\n", (unsigned long)capture->header->records,
+           (unsigned long)capture->header->overwritten);
+
+    sbus_capture_record_t record;
+    sbus_request_t        request;
+    int                   valid    = 0;
+    uint64_t              position = sbus_capture_first(capture);
+    uint64_t              start    = 0;
+    uint64_t              previous = 0;
+    uint64_t              sent     = 0;
+    sbus_result_t         res;
+
+    while ((res = sbus_capture_next(capture, &position, &record)) == SBUS_OK) {
+        if (start == 0)
+            start = previous = record.timestamp_us;
+
+        uint64_t elapsed = record.timestamp_us - start;
+        printf("%8lu.%06lu  +%-9lu ", (unsigned long)(elapsed / 1000000), (unsigned long)(elapsed % 1000000),
+               (unsigned long)(record.timestamp_us - previous));
+        previous = record.timestamp_us;
+
+        if (record.direction == SBUS_CAPTURE_TX) {
+            sent = record.timestamp_us;
+            decode_request(&record, &request, &valid);
+        } else {
+            decode_response(&record, &request, valid);
+            if (valid)
+                printf("  after %lu us", (unsigned long)(record.timestamp_us - sent));
+        }
+        printf("\n");
+
+        if (hex)
+            dump(&record);
+    }
+
+    if (res != SBUS_NOT_FOUND)
+        fprintf(stderr, "capture corrupted at position %lu\n", (unsigned long)position);
+
+    sbus_capture_file_close(&file);
+    return res == SBUS_NOT_FOUND ? 0 : 1;
+}
+
+
+static void decode_request(const sbus_capture_record_t *record, sbus_request_t *request, int *valid) {
+    uint16_t words[SBUS_CAPTURE_MAX_CHARACTERS];
+    size_t   len = record->count;
+
+    // Without address flags (8-bit captures) the first character is the address
+    if (record->address_map != NULL) {
+        sbus_packet_unpack_9bit(record->bytes, record->address_map, len, words);
+    } else {
+        for (size_t i = 0; i < len; i++)
+            words[i] = i == 0 ? SBUS_ADDRESS(record->bytes[i]) : record->bytes[i];
+    }
+
+    sbus_result_t res = sbus_packet_parse_request(words, &len, request);
+    *valid            = res == SBUS_OK;
+
+    if (res == SBUS_OK || res == SBUS_WRONG_CRC) {
+        printf("TX  station %3u  %-22s", request->destination, sbus_command_name(request->command));
+        const sbus_command_descriptor_t *descriptor = sbus_command_describe(request->command);
+        if (descriptor->has_media) {
+            unsigned count = request->data[0] + 1u;     // Reads carry the r-count
+            if (descriptor->kind == SBUS_COMMAND_KIND_WRITE)
+                count = sbus_media_is_bit(descriptor->media) ? request->data[3] + 1u : (request->data[0] - 1u) / 4;
+            printf(" address %5u count %3u", (request->data[1] << 8) | request->data[2], count);
+        }
+        printf("  %s", result_name(res));
+    } else {
+        printf("TX  %u characters  %s", record->count, result_name(res));
+    }
+}
+
+
+static void decode_response(const sbus_capture_record_t *record, sbus_request_t *request, int valid) {
+    uint8_t bytes[SBUS_CAPTURE_MAX_CHARACTERS];
+    size_t  len = record->count;
+
+    memcpy(bytes, record->bytes, len);
+    printf("RX  %3u characters", record->count);
+
+    if (!valid) {
+        printf("  (no request)  captured as %s", result_name(record->result));
+        return;
+    }
+
+    sbus_result_t res = record->count > 0 ? sbus_packet_validate_response_8bit(request, bytes, &len) : record->result;
+    printf("  %-22s  %s", sbus_command_name(request->command), result_name(res));
+    if (res != record->result)
+        printf(" (captured as %s)", result_name(record->result));
+}
+
+
+static void dump(const sbus_capture_record_t *record) {
+    for (size_t i = 0; i < record->count; i++) {
+        int address = record->address_map != NULL && SBUS_ADDRESS_MAP_GET(record->address_map, i);
+        printf("%s%s%02X", i % 16 == 0 ? "    " : " ", address ? "*" : "", record->bytes[i]);
+        if (i % 16 == 15 || i + 1 == record->count)
+            printf("\n");
+    }
+}
+
+
+static const char *result_name(int result) {
+    switch (result) {
+        case SBUS_OK:
+            return "OK";
+        case SBUS_INCOMPLETE_PACKET:
+            return "INCOMPLETE";
+        case SBUS_INVALID_DATA:
+            return "INVALID_DATA";
+        case SBUS_UNKNOWN_COMMAND:
+            return "UNKNOWN_COMMAND";
+        case SBUS_NOT_FOUND:
+            return "NOT_FOUND";
+        case SBUS_WRONG_CRC:
+            return "WRONG_CRC";
+        case SBUS_INVALID_ARGS:
+            return "INVALID_ARGS";
+        case SBUS_TIMEOUT:
+            return "TIMEOUT";
+        case SBUS_IO_ERROR:
+            return "IO_ERROR";
+        default:
+            return "?";
+    }
+}
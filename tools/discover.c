@@ -0,0 +1,282 @@
+/*
+ * Finds the stations on one or more serial lines, all of them at the same time:
+ *
+ *     discover [-a first-last] [-b baud,...] [-r turnaround_us] [-d directory] <serial port>...
+ *
+ * Every line is scanned with READ_STATION_NUMBER at the baud rates given with `-b` (all the standard ones by
+ * default) until a station answers, then at that baud rate only; the PCD status of every station found is read
+ * last. Probes wait for the exchange on the wire plus `-r` microseconds (5000 by default) and no more.
+ *
+ * With `-d` the result is saved as `<directory>/<port name>.topology`; when that file exists the next run only asks
+ * the stations found last time, and scans again only if some of them are gone.
+ */
+#include <errno.h>
+#include <libgen.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sbus/discovery.h"
+#include "sbus/packet.h"
+#include "sbus/posix/master.h"
+#include "sbus/wire.h"
+
+
+#define MAX_PORTS 16
+
+typedef struct {
+    const char        *path;
+    char               topology_path[512];
+    sbus_master_line_t line;
+    sbus_discovery_t   discovery;
+    sbus_probe_t       probe;
+    sbus_transaction_t transaction;
+    unsigned           baud;     // Current speed of the port
+    int                busy;
+    int                done;
+} port_t;
+
+static struct {
+    unsigned    first;
+    unsigned    last;
+    unsigned    turnaround_us;
+    const char *directory;
+} options = {.first = 0, .last = 253, .turnaround_us = 5000};
+
+static const unsigned standard_bauds[] = {9600, 19200, 38400, 57600, 115200, 4800, 2400, 1200};
+
+static sbus_wire_t settings[SBUS_DISCOVERY_MAX_SETTINGS];
+static size_t      num_settings = 0;
+static port_t      ports[MAX_PORTS];
+static size_t      num_ports = 0;
+
+
+static int  parse_options(int argc, char *argv[]);
+static int  add_baud(unsigned baud);
+static int  open_port(sbus_master_t *master, port_t *port, const char *path);
+static int  send_probe(port_t *port);
+static void on_probe(sbus_transaction_t *transaction);
+static void report(port_t *port);
+
+
+int main(int argc, char *argv[]) {
+    if (parse_options(argc, argv) < 0 || optind >= argc || argc - optind > MAX_PORTS) {
+        fprintf(stderr, "usage: %s [-a first-last] [-b baud,...] [-r turnaround_us] [-d directory] <serial port>...\n",
+                argv[0]);
+        return 1;
+    }
+
+    sbus_master_t master;
+    if (sbus_master_init(&master) < 0) {
+        perror("epoll");
+        return 1;
+    }
+
+    uint64_t start = sbus_master_now_us();
+    for (int i = optind; i < argc; i++) {
+        port_t *port = &ports[num_ports++];
+        if (open_port(&master, port, argv[i]) < 0)
+            return 1;
+    }
+
+    for (;;) {
+        size_t running = 0;
+        size_t idle    = 0;
+
+        for (size_t i = 0; i < num_ports; i++) {
+            port_t *port = &ports[i];
+            if (!port->done && !port->busy && send_probe(port) < 0)
+                port->done = 1;
+            running += !port->done;
+            // The master completes a probe it cannot send (I/O error) before returning from the submit
+            idle += !port->done && !port->busy;
+        }
+        if (running == 0)
+            break;
+        if (idle > 0)
+            continue;
+
+        if (sbus_master_poll(&master, -1) < 0 && errno != EINTR) {
+            perror("poll");
+            return 1;
+        }
+    }
+
+    uint64_t elapsed = sbus_master_now_us() - start;
+    for (size_t i = 0; i < num_ports; i++)
+        report(&ports[i]);
+    printf("# %lu.%03lu s\n", (unsigned long)(elapsed / 1000000), (unsigned long)(elapsed / 1000 % 1000));
+
+    sbus_master_deinit(&master);
+    return 0;
+}
+
+
+static int parse_options(int argc, char *argv[]) {
+    int option;
+
+    while ((option = getopt(argc, argv, "a:b:r:d:")) != -1) {
+        switch (option) {
+            case 'a':
+                if (sscanf(optarg, "%u-%u", &options.first, &options.last) != 2 || options.first > options.last ||
+                    options.last >= SBUS_BROADCAST_ADDRESS)
+                    return -1;
+                break;
+            case 'b':
+                for (char *baud = strtok(optarg, ","); baud != NULL; baud = strtok(NULL, ",")) {
+                    if (add_baud((unsigned)strtoul(baud, NULL, 10)) < 0)
+                        return -1;
+                }
+                break;
+            case 'r':
+                options.turnaround_us = (unsigned)strtoul(optarg, NULL, 10);
+                break;
+            case 'd':
+                options.directory = optarg;
+                break;
+            default:
+                return -1;
+        }
+    }
+
+    for (size_t i = 0; num_settings == 0 && i < sizeof(standard_bauds) / sizeof(standard_bauds[0]); i++)
+        add_baud(standard_bauds[i]);
+    for (size_t i = 0; i < num_settings; i++)
+        settings[i].turnaround_us = options.turnaround_us;     // `-r` may come after `-b`
+    return 0;
+}
+
+
+/*
+ * The serial master only speaks parity mode, so that is the only wire format tried.
+ */
+static int add_baud(unsigned baud) {
+    if (baud == 0 || num_settings == SBUS_DISCOVERY_MAX_SETTINGS)
+        return -1;
+
+    settings[num_settings++] = (sbus_wire_t){.baud = baud, .format = SBUS_WIRE_PARITY};
+    return 0;
+}
+
+
+static int open_port(sbus_master_t *master, port_t *port, const char *path) {
+    sbus_topology_t  topology;
+    sbus_topology_t *saved = NULL;
+
+    memset(port, 0, sizeof(port_t));
+    port->path = path;
+
+    if (options.directory != NULL) {
+        char name[256];
+        snprintf(name, sizeof(name), "%s", path);
+        snprintf(port->topology_path, sizeof(port->topology_path), "%s/%s.topology", options.directory,
+                 basename(name));
+
+        FILE *file = fopen(port->topology_path, "rb");
+        if (file != NULL) {
+            if (fread(&topology, sizeof(topology), 1, file) == 1)
+                saved = &topology;
+            fclose(file);
+        }
+    }
+
+    sbus_result_t res = sbus_discovery_init(&port->discovery, settings, num_settings, (uint8_t)options.first,
+                                            (uint8_t)options.last, saved);
+    if (res == SBUS_INVALID_DATA) {
+        fprintf(stderr, "%s: not a topology, ignored\n", port->topology_path);
+        res = sbus_discovery_init(&port->discovery, settings, num_settings, (uint8_t)options.first,
+                                  (uint8_t)options.last, NULL);
+    }
+    if (res != SBUS_OK)
+        return -1;
+
+    port->baud = settings[port->discovery.locked >= 0 ? (size_t)port->discovery.locked : 0].baud;
+    int fd     = sbus_master_open_serial(path, port->baud);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+
+    port->line.parity_mode = 1;
+    if (sbus_master_add_line(master, &port->line, fd, 1000) < 0) {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
+
+
+/*
+ * Puts the next probe of the port on its line, switching speed first if needed; the port is done when there are
+ * no probes left.
+ */
+static int send_probe(port_t *port) {
+    if (sbus_discovery_next(&port->discovery, &port->probe) != SBUS_OK) {
+        port->done = 1;
+        return 0;
+    }
+
+    unsigned baud = port->discovery.settings[port->probe.setting].baud;
+    if (baud != port->baud) {
+        if (sbus_master_set_speed(port->line.fd, baud) < 0) {
+            perror(port->path);
+            return -1;
+        }
+        port->baud = baud;
+    }
+
+    memset(&port->transaction, 0, sizeof(sbus_transaction_t));
+    port->transaction.request    = port->probe.request;
+    port->transaction.timeout_us = port->probe.timeout_us;
+    port->transaction.callback   = on_probe;
+    port->transaction.arg        = port;
+
+    port->busy = 1;
+    if (sbus_master_submit(&port->line, &port->transaction) < 0) {
+        perror(port->path);
+        return -1;
+    }
+    return 0;
+}
+
+
+static void on_probe(sbus_transaction_t *transaction) {
+    port_t *port = transaction->arg;
+
+    sbus_discovery_complete(&port->discovery, &port->probe, transaction->result,
+                            transaction->response_len > 0 ? transaction->response[0] : 0);
+    port->busy = 0;
+}
+
+
+static void report(port_t *port) {
+    sbus_discovery_t *discovery = &port->discovery;
+
+    if (discovery->locked < 0) {
+        printf("%s: no stations (%lu probes)\n", port->path, discovery->probes);
+    } else {
+        printf("%s: %zu stations at %lu baud (%lu probes)\n", port->path, sbus_discovery_count(discovery),
+               (unsigned long)discovery->settings[discovery->locked].baud, discovery->probes);
+        for (unsigned station = 0; station < SBUS_DISCOVERY_STATIONS; station++) {
+            if (!sbus_discovery_present(discovery, (uint8_t)station))
+                continue;
+            if (discovery->status[station] != 0)
+                printf("    %3u  status %c\n", station, discovery->status[station]);
+            else
+                printf("    %3u  status unknown\n", station);
+        }
+    }
+
+    if (port->topology_path[0] != '\0' && discovery->locked >= 0) {
+        sbus_topology_t topology;
+        sbus_discovery_save(discovery, &topology);
+
+        FILE *file = fopen(port->topology_path, "wb");
+        if (file == NULL || fwrite(&topology, sizeof(topology), 1, file) != 1)
+            perror(port->topology_path);
+        if (file != NULL)
+            fclose(file);
+    }
+}
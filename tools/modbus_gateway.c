@@ -0,0 +1,124 @@
+/*
+ * Modbus TCP gateway to the S-Bus stations of a serial line (see sbus/gateway.h):
+ *
+ *     modbus_gateway [-l address] [-p port] [-b baud] [-t timeout_ms] [-w 1|2] <serial port>
+ *
+ * Listens on `-l`:`-p` (0.0.0.0:502 by default). The Modbus unit identifier selects the station; holding registers
+ * map to registers, two per register unless `-w 1` is given, and coils to flags. Statistics are printed on standard
+ * error at exit (SIGINT or SIGTERM).
+ *
+ * On localhost, against the simulated stations:
+ *
+ *     slave_simulator pty &
+ *     modbus_gateway -p 5020 /dev/pts/N
+ */
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sbus/gateway.h"
+#include "sbus/posix/master.h"
+#include "sbus/posix/modbus_server.h"
+
+
+static struct {
+    const char *address;
+    unsigned    port;
+    unsigned    baud;
+    unsigned    timeout_ms;
+    unsigned    register_words;
+} options = {.address = "0.0.0.0", .port = SBUS_MODBUS_PORT, .baud = 38400, .timeout_ms = 100, .register_words = 2};
+
+static volatile sig_atomic_t stop;
+
+
+static int  parse_options(int argc, char *argv[]);
+static void on_signal(int signal);
+
+
+int main(int argc, char *argv[]) {
+    if (parse_options(argc, argv) < 0 || optind != argc - 1) {
+        fprintf(stderr, "usage: %s [-l address] [-p port] [-b baud] [-t timeout_ms] [-w 1|2] <serial port>\n",
+                argv[0]);
+        return 1;
+    }
+
+    static sbus_master_t        master;
+    static sbus_master_line_t   line;
+    static sbus_modbus_server_t server;
+    sbus_gateway_config_t       config = {.register_words = (uint8_t)options.register_words};
+
+    int fd = sbus_master_open_serial(argv[optind], options.baud);
+    if (fd < 0) {
+        perror(argv[optind]);
+        return 1;
+    }
+    if (sbus_master_init(&master) < 0 || sbus_master_add_line(&master, &line, fd, options.timeout_ms) < 0) {
+        perror("master");
+        return 1;
+    }
+    if (sbus_modbus_server_init(&server, &master, &line, &config, options.address, (uint16_t)options.port) < 0) {
+        perror("server");
+        return 1;
+    }
+    printf("listening on %s:%u\n", options.address, server.port);
+    fflush(stdout);
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    while (!stop) {
+        if (sbus_modbus_server_poll(&server, 500) < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+    }
+
+    sbus_gateway_t *gateway = &server.gateway;
+    fprintf(stderr, "requests %lu, exceptions %lu, reads %lu (%lu collapsed), write frames %lu\n", gateway->requests,
+            gateway->exceptions, gateway->reads_sent, gateway->collapsed, gateway->writes_sent);
+
+    sbus_modbus_server_deinit(&server);
+    sbus_master_remove_line(&master, &line);
+    sbus_master_deinit(&master);
+    close(fd);
+    return 0;
+}
+
+
+static int parse_options(int argc, char *argv[]) {
+    int option;
+
+    while ((option = getopt(argc, argv, "l:p:b:t:w:")) != -1) {
+        switch (option) {
+            case 'l':
+                options.address = optarg;
+                break;
+            case 'p':
+                options.port = (unsigned)strtoul(optarg, NULL, 10);
+                break;
+            case 'b':
+                options.baud = (unsigned)strtoul(optarg, NULL, 10);
+                break;
+            case 't':
+                options.timeout_ms = (unsigned)strtoul(optarg, NULL, 10);
+                break;
+            case 'w':
+                options.register_words = (unsigned)strtoul(optarg, NULL, 10);
+                break;
+            default:
+                return -1;
+        }
+    }
+
+    return options.port <= UINT16_MAX && (options.register_words == 1 || options.register_words == 2) ? 0 : -1;
+}
+
+
+static void on_signal(int signal) {
+    (void)signal;
+    stop = 1;
+}
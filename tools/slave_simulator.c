@@ -0,0 +1,532 @@
+/*
+ * Simulated S-Bus stations, the reference target for load tests, benchmarks and soak tests of masters:
+ *
+ *     slave_simulator [-s first-last] [-r registers] [-f flags] [-d turnaround_us] [-c crc_permille]
+ *                     [-l drop_permille] [-S seed] <endpoint>...
+ *
+ * Every endpoint is either `pty`, a new pseudo terminal whose name is printed on standard output, or `udp:<port>`
+ * for Ether-S-Bus. All endpoints serve the same stations (1-30 by default); each station has its own registers,
+ * counters, timers, flags, inputs and outputs. Register `i` of station `s` starts as `s << 16 | i`.
+ *
+ * Answers are sent `-d` microseconds after the request was received; `-c` and `-l` corrupt the CRC of, or drop,
+ * that many answers out of a thousand. Broadcasts are executed by every station and never answered. Statistics are
+ * printed on standard error at exit (SIGINT or SIGTERM).
+ *
+ * Pseudo terminals lose the parity bit, so the first character after a complete frame, or after a pause on the
+ * line, is taken as the address.
+ */
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sbus/decode.h"
+#include "sbus/ether.h"
+#include "sbus/packet.h"
+#include "sbus/sink.h"
+#include "sbus/slave.h"
+
+
+#define MAX_ENDPOINTS 8
+#define MAX_PENDING   64
+#define RESYNC_US     5000     // A pause this long on a serial line ends any partial frame
+#define VALUES        256      // Counters and timers per station
+
+typedef struct {
+    uint64_t           due_us;
+    size_t             len;
+    uint8_t            data[SBUS_ETHER_MAX_DATAGRAM];
+    struct sockaddr_in peer;
+} reply_t;
+
+typedef struct {
+    int      udp;
+    int      fd;
+    int      pts;     // Kept open so that the terminal survives masters coming and going
+    uint16_t rx[512];
+    size_t   received;
+    uint64_t last_rx_us;
+    reply_t  pending[MAX_PENDING];
+    size_t   head;
+    size_t   count;
+} endpoint_t;
+
+static struct {
+    unsigned first;
+    unsigned last;
+    unsigned registers;
+    unsigned flags;
+    unsigned turnaround_us;
+    unsigned crc_permille;
+    unsigned drop_permille;
+    uint32_t seed;
+} options = {.first = 1, .last = 30, .registers = 1024, .flags = 1024, .seed = 1};
+
+static struct {
+    unsigned long requests;
+    unsigned long broadcasts;
+    unsigned long answers;
+    unsigned long dropped;
+    unsigned long corrupted;
+    unsigned long wrong_crc;
+    unsigned long overruns;
+} counters;
+
+static sbus_slave_t         *stations[SBUS_BROADCAST_ADDRESS];
+static endpoint_t            endpoints[MAX_ENDPOINTS];
+static size_t                num_endpoints;
+static int                   timer_fd;
+static volatile sig_atomic_t stop;
+
+static int      parse_options(int argc, char *argv[]);
+static int      create_stations(void);
+static int      open_endpoint(endpoint_t *endpoint, const char *spec);
+static void     handle_serial(endpoint_t *endpoint, uint64_t now);
+static void     handle_udp(endpoint_t *endpoint, uint64_t now);
+static size_t   execute(const sbus_request_t *request, uint8_t *response);
+static int      inject(uint8_t *data, size_t len);
+static void     schedule(endpoint_t *endpoint, const uint8_t *data, size_t len, const struct sockaddr_in *peer,
+                         uint64_t now);
+static void     send_reply(endpoint_t *endpoint, const reply_t *reply);
+static void     flush_due(uint64_t now);
+static int      read_clock(sbus_slave_t *slave, uint8_t *clock);
+static int      write_clock(sbus_slave_t *slave, const uint8_t *clock);
+static uint64_t now_us(void);
+static uint32_t xorshift(void);
+static void     on_signal(int signal);
+
+
+int main(int argc, char *argv[]) {
+    if (parse_options(argc, argv) < 0) {
+        fprintf(stderr,
+                "usage: %s [-s first-last] [-r registers] [-f flags] [-d turnaround_us] [-c crc_permille] "
+                "[-l drop_permille] [-S seed] <pty | udp:port>...\n",
+                argv[0]);
+        return 1;
+    }
+    if (create_stations() < 0) {
+        perror("stations");
+        return 1;
+    }
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    timer_fd     = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (epoll_fd < 0 || timer_fd < 0) {
+        perror("epoll");
+        return 1;
+    }
+
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = NULL};
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &event);
+
+    for (int i = optind; i < argc; i++) {
+        endpoint_t *endpoint = &endpoints[num_endpoints++];
+        if (open_endpoint(endpoint, argv[i]) < 0) {
+            perror(argv[i]);
+            return 1;
+        }
+        event.data.ptr = endpoint;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, endpoint->fd, &event);
+    }
+    fflush(stdout);
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    while (!stop) {
+        struct epoll_event events[MAX_ENDPOINTS + 1];
+        int                num = epoll_wait(epoll_fd, events, MAX_ENDPOINTS + 1, -1);
+        if (num < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < num; i++) {
+            endpoint_t *endpoint = events[i].data.ptr;
+            uint64_t    now      = now_us();
+
+            if (endpoint == NULL) {
+                uint64_t expirations;
+                if (read(timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+                    perror("timer");
+                flush_due(now);
+            } else if (endpoint->udp) {
+                handle_udp(endpoint, now);
+            } else {
+                handle_serial(endpoint, now);
+            }
+        }
+    }
+
+    fprintf(stderr,
+            "requests %lu, broadcasts %lu, answers %lu, dropped %lu, corrupted %lu, wrong crc %lu, overruns %lu\n",
+            counters.requests, counters.broadcasts, counters.answers, counters.dropped, counters.corrupted,
+            counters.wrong_crc, counters.overruns);
+    return 0;
+}
+
+
+static int parse_options(int argc, char *argv[]) {
+    int option;
+
+    while ((option = getopt(argc, argv, "s:r:f:d:c:l:S:")) != -1) {
+        switch (option) {
+            case 's':
+                if (sscanf(optarg, "%u-%u", &options.first, &options.last) != 2)
+                    return -1;
+                break;
+            case 'r':
+                options.registers = (unsigned)strtoul(optarg, NULL, 0);
+                break;
+            case 'f':
+                options.flags = (unsigned)strtoul(optarg, NULL, 0);
+                break;
+            case 'd':
+                options.turnaround_us = (unsigned)strtoul(optarg, NULL, 0);
+                break;
+            case 'c':
+                options.crc_permille = (unsigned)strtoul(optarg, NULL, 0);
+                break;
+            case 'l':
+                options.drop_permille = (unsigned)strtoul(optarg, NULL, 0);
+                break;
+            case 'S':
+                options.seed = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            default:
+                return -1;
+        }
+    }
+
+    if (options.first > options.last || options.last >= SBUS_BROADCAST_ADDRESS || options.registers > UINT16_MAX ||
+        options.flags > UINT16_MAX || options.seed == 0)
+        return -1;
+    return optind < argc && argc - optind <= MAX_ENDPOINTS ? 0 : -1;
+}
+
+
+static int create_stations(void) {
+    for (unsigned station = options.first; station <= options.last; station++) {
+        sbus_slave_t *slave     = calloc(1, sizeof(sbus_slave_t));
+        uint32_t     *registers = calloc(options.registers, sizeof(uint32_t));
+        uint32_t     *counters  = calloc(VALUES, sizeof(uint32_t));
+        uint32_t     *timers    = calloc(VALUES, sizeof(uint32_t));
+        uint8_t      *bits[3];
+        for (size_t i = 0; i < 3; i++)
+            bits[i] = calloc(SBUS_FIO_BYTES(options.flags), 1);
+
+        if (slave == NULL || registers == NULL || counters == NULL || timers == NULL || bits[0] == NULL ||
+            bits[1] == NULL || bits[2] == NULL)
+            return -1;
+
+        for (uint32_t i = 0; i < options.registers; i++)
+            registers[i] = (station << 16) | i;
+
+        sbus_slave_init(slave, (uint8_t)station);
+        sbus_slave_set_media(slave, SBUS_MEDIA_REGISTER, registers, (uint16_t)options.registers);
+        sbus_slave_set_media(slave, SBUS_MEDIA_COUNTER, counters, VALUES);
+        sbus_slave_set_media(slave, SBUS_MEDIA_TIMER, timers, VALUES);
+        sbus_slave_set_media(slave, SBUS_MEDIA_FLAG, bits[0], (uint16_t)options.flags);
+        sbus_slave_set_media(slave, SBUS_MEDIA_INPUT, bits[1], (uint16_t)options.flags);
+        sbus_slave_set_media(slave, SBUS_MEDIA_OUTPUT, bits[2], (uint16_t)options.flags);
+        slave->read_clock  = read_clock;
+        slave->write_clock = write_clock;
+        slave->display     = station;
+        stations[station]  = slave;
+    }
+
+    return 0;
+}
+
+
+static int open_endpoint(endpoint_t *endpoint, const char *spec) {
+    memset(endpoint, 0, sizeof(endpoint_t));
+
+    if (strncmp(spec, "udp:", 4) == 0) {
+        struct sockaddr_in local = {
+            .sin_family      = AF_INET,
+            .sin_port        = htons((uint16_t)atoi(&spec[4])),
+            .sin_addr.s_addr = htonl(INADDR_ANY),
+        };
+
+        endpoint->udp = 1;
+        endpoint->fd  = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (endpoint->fd < 0 || bind(endpoint->fd, (struct sockaddr *)&local, sizeof(local)) < 0)
+            return -1;
+        printf("udp %s\n", &spec[4]);
+        return 0;
+    } else if (strcmp(spec, "pty") == 0) {
+        struct termios tty;
+
+        endpoint->fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+        if (endpoint->fd < 0 || grantpt(endpoint->fd) < 0 || unlockpt(endpoint->fd) < 0)
+            return -1;
+        endpoint->pts = open(ptsname(endpoint->fd), O_RDWR | O_NOCTTY | O_CLOEXEC);
+        if (endpoint->pts < 0 || tcgetattr(endpoint->pts, &tty) < 0)
+            return -1;
+        cfmakeraw(&tty);
+        if (tcsetattr(endpoint->pts, TCSANOW, &tty) < 0)
+            return -1;
+        printf("pty %s\n", ptsname(endpoint->fd));
+        return 0;
+    }
+
+    errno = EINVAL;
+    return -1;
+}
+
+
+static void handle_serial(endpoint_t *endpoint, uint64_t now) {
+    uint8_t bytes[256];
+    ssize_t res;
+
+    while ((res = read(endpoint->fd, bytes, sizeof(bytes))) > 0) {
+        if (now - endpoint->last_rx_us > RESYNC_US)
+            endpoint->received = 0;
+        endpoint->last_rx_us = now;
+
+        for (ssize_t i = 0; i < res; i++) {
+            if (endpoint->received >= sizeof(endpoint->rx) / sizeof(endpoint->rx[0])) {
+                counters.overruns++;
+                endpoint->received = 0;
+            }
+            endpoint->rx[endpoint->received] = endpoint->received == 0 ? SBUS_ADDRESS(bytes[i]) : bytes[i];
+            endpoint->received++;
+        }
+
+        for (;;) {
+            sbus_request_t request;
+            size_t         len = endpoint->received;
+            sbus_result_t  result;
+
+            if (len == 0 || (result = sbus_packet_parse_request(endpoint->rx, &len, &request)) ==
+                                SBUS_INCOMPLETE_PACKET)
+                break;
+
+            if (result == SBUS_OK) {
+                uint8_t response[SBUS_ETHER_MAX_DATAGRAM];
+                size_t  num = execute(&request, response);
+                if (num > 0)
+                    schedule(endpoint, response, num, NULL, now);
+            } else if (result == SBUS_WRONG_CRC) {
+                counters.wrong_crc++;
+            } else {
+                len = endpoint->received;     // Garbage, wait for the next pause
+            }
+
+            endpoint->received -= len;
+            memmove(endpoint->rx, &endpoint->rx[len], endpoint->received * sizeof(endpoint->rx[0]));
+            if (endpoint->received > 0)
+                endpoint->rx[0] = SBUS_ADDRESS((uint8_t)endpoint->rx[0]);
+        }
+    }
+}
+
+
+static void handle_udp(endpoint_t *endpoint, uint64_t now) {
+    uint8_t            datagram[SBUS_ETHER_MAX_DATAGRAM];
+    struct sockaddr_in peer;
+    socklen_t          peer_len = sizeof(peer);
+    ssize_t            res;
+
+    while ((res = recvfrom(endpoint->fd, datagram, sizeof(datagram), 0, (struct sockaddr *)&peer, &peer_len)) > 0) {
+        uint16_t       sequence;
+        sbus_request_t request;
+
+        peer_len = sizeof(peer);
+        if (sbus_ether_parse_request(datagram, (size_t)res, &sequence, &request) != SBUS_OK) {
+            counters.wrong_crc++;
+            continue;
+        }
+
+        uint8_t response[SBUS_ETHER_MAX_DATAGRAM];
+        size_t  num = execute(&request, response);
+        if (num == 0)
+            continue;
+
+        uint8_t reply[SBUS_ETHER_MAX_DATAGRAM];
+        size_t  len;
+        if (num == 2 && (response[0] == SBUS_ACK || response[0] == SBUS_NAK) &&
+            (sbus_packet_response_length(&request) == 2 || response[0] == SBUS_NAK)) {
+            uint8_t code[2] = {0x00, response[0] == SBUS_ACK ? 0x00 : 0x01};
+            len = sbus_ether_serialize_response(reply, sizeof(reply), sequence, SBUS_ATTRIBUTE_ACK, code, 2);
+        } else {
+            // The serial CRC is replaced by the one covering the Ether-S-Bus header
+            len = sbus_ether_serialize_response(reply, sizeof(reply), sequence, SBUS_ATTRIBUTE_RESPONSE, response,
+                                                num - 2);
+        }
+        schedule(endpoint, reply, len, &peer, now);
+    }
+}
+
+
+/*
+ * Runs `request` on the addressed station, or on all of them for broadcasts. Returns the length of the answer.
+ */
+static size_t execute(const sbus_request_t *request, uint8_t *response) {
+    sbus_sink_t sink;
+
+    // Responses have no address character, the bytes are the answer as sent
+    sbus_sink_init_8bit(&sink, response, NULL, SBUS_ETHER_MAX_DATAGRAM);
+
+    counters.requests++;
+    if (request->destination == SBUS_BROADCAST_ADDRESS) {
+        counters.broadcasts++;
+        for (unsigned station = options.first; station <= options.last; station++)
+            sbus_slave_respond(stations[station], request, &sink);
+        return 0;
+    }
+
+    sbus_slave_t *slave = stations[request->destination];
+    if (slave == NULL)
+        return 0;
+
+    int num = sbus_slave_respond(slave, request, &sink);
+    return num > 0 ? (size_t)num : 0;
+}
+
+
+/*
+ * Applies the configured faults to an answer. Returns 0 if it must be dropped.
+ */
+static int inject(uint8_t *data, size_t len) {
+    if (options.drop_permille > 0 && xorshift() % 1000 < options.drop_permille) {
+        counters.dropped++;
+        return 0;
+    }
+    if (options.crc_permille > 0 && xorshift() % 1000 < options.crc_permille) {
+        counters.corrupted++;
+        data[len - 1] ^= 0x5A;
+    }
+    return 1;
+}
+
+
+static void schedule(endpoint_t *endpoint, const uint8_t *data, size_t len, const struct sockaddr_in *peer,
+                     uint64_t now) {
+    reply_t reply = {.due_us = now + options.turnaround_us, .len = len};
+
+    memcpy(reply.data, data, len);
+    if (peer != NULL)
+        reply.peer = *peer;
+    if (!inject(reply.data, len))
+        return;
+
+    if (options.turnaround_us == 0) {
+        send_reply(endpoint, &reply);
+        return;
+    }
+    if (endpoint->count == MAX_PENDING) {
+        counters.overruns++;
+        return;
+    }
+
+    // The turnaround is the same for every answer, so the queue stays sorted by due time
+    endpoint->pending[(endpoint->head + endpoint->count) % MAX_PENDING] = reply;
+    if (endpoint->count++ == 0)
+        flush_due(now);
+}
+
+
+static void send_reply(endpoint_t *endpoint, const reply_t *reply) {
+    ssize_t res;
+
+    if (endpoint->udp)
+        res = sendto(endpoint->fd, reply->data, reply->len, 0, (const struct sockaddr *)&reply->peer,
+                     sizeof(reply->peer));
+    else
+        res = write(endpoint->fd, reply->data, reply->len);
+
+    if (res == (ssize_t)reply->len)
+        counters.answers++;
+    else
+        counters.overruns++;
+}
+
+
+/*
+ * Sends every answer whose time has come and arms the timer for the next one.
+ */
+static void flush_due(uint64_t now) {
+    uint64_t next = UINT64_MAX;
+
+    for (size_t i = 0; i < num_endpoints; i++) {
+        endpoint_t *endpoint = &endpoints[i];
+
+        while (endpoint->count > 0 && endpoint->pending[endpoint->head].due_us <= now) {
+            send_reply(endpoint, &endpoint->pending[endpoint->head]);
+            endpoint->head = (endpoint->head + 1) % MAX_PENDING;
+            endpoint->count--;
+        }
+        if (endpoint->count > 0 && endpoint->pending[endpoint->head].due_us < next)
+            next = endpoint->pending[endpoint->head].due_us;
+    }
+
+    if (next != UINT64_MAX) {
+        uint64_t          wait = next - now;
+        struct itimerspec spec = {
+            .it_value = {.tv_sec = (time_t)(wait / 1000000), .tv_nsec = (long)(wait % 1000000) * 1000L},
+        };
+        timerfd_settime(timer_fd, 0, &spec, NULL);
+    }
+}
+
+
+static int read_clock(sbus_slave_t *slave, uint8_t *clock) {
+    time_t    now = time(NULL);
+    struct tm local;
+    (void)slave;
+
+    localtime_r(&now, &local);
+    sbus_clock_t value = {
+        .year   = (uint8_t)(local.tm_year % 100),
+        .month  = (uint8_t)(local.tm_mon + 1),
+        .day    = (uint8_t)local.tm_mday,
+        .hour   = (uint8_t)local.tm_hour,
+        .minute = (uint8_t)local.tm_min,
+        .second = (uint8_t)local.tm_sec,
+    };
+    sbus_clock_to_bcd(&value, clock);
+    return 0;
+}
+
+
+static int write_clock(sbus_slave_t *slave, const uint8_t *clock) {
+    sbus_clock_t value;
+    (void)slave;
+    // Accepted but not kept: the simulated clock is the host clock
+    return sbus_clock_from_bcd(clock, &value) == SBUS_OK ? 0 : -1;
+}
+
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+
+static uint32_t xorshift(void) {
+    options.seed ^= options.seed << 13;
+    options.seed ^= options.seed >> 17;
+    options.seed ^= options.seed << 5;
+    return options.seed;
+}
+
+
+static void on_signal(int signal) {
+    (void)signal;
+    stop = 1;
+}